@@ -0,0 +1,172 @@
+/*
+Host accuracy and speed test of the fixed point math (main/fixed_math.c).
+
+    fixed_math_test [calls per timing]
+
+Accuracy, against the C library in double:
+- fixed_atan2 at every angle in steps of 0.01 degrees and lengths from 1 to 2^31, plus
+  random int16 pairs (accelerometer counts): largest error in degrees
+- fixed_sqrt32 / fixed_sqrt64 / fixed_sqrt_q16: must be exactly floor(sqrt(x)) for
+  random and edge inputs (squares and squares - 1)
+- fixed_inv_sqrt64 / fixed_inv_sqrt_q16: largest relative error over random inputs of every
+  bit length
+Exits with 1 if any bound in fixed_math.h is broken. Then times each function against
+atan2f, sqrtf and 1 / sqrtf; on the host those are instructions, so the ratios there say
+little about the ESP32, where they are library calls.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+#include "fixed_math.h"
+
+#define TEST_DEFAULT_CALLS 20000000
+#define TEST_RANDOM_INPUTS 2000000
+
+static uint64_t random_state = 1;
+
+static uint64_t random64(void);
+static double now_s(void);
+static bool check_atan2(void);
+static bool check_sqrt(void);
+static bool check_inv_sqrt(void);
+static void time_functions(size_t calls);
+
+int main(int argc, char** argv) {
+    size_t calls = argc > 1 ? strtoul(argv[1], NULL, 0) : TEST_DEFAULT_CALLS;
+    if (calls == 0) {
+        printf("usage: fixed_math_test [calls per timing]\n");
+        return 2;
+    }
+    bool passed = check_atan2();
+    passed = check_sqrt() && passed;
+    passed = check_inv_sqrt() && passed;
+    printf("%s\n", passed ? "PASSED" : "FAILED");
+    time_functions(calls);
+    return passed ? 0 : 1;
+}
+
+// xorshift64*: repeatable on every host
+static uint64_t random64(void) {
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return random_state * 2685821657736338717ULL;
+}
+
+static double now_s(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static double atan2_error(int32_t y, int32_t x) {
+    double expected = atan2((double)y, (double)x) * 180 / M_PI;
+    double error = fabs(fixed_atan2(y, x) / (double)FIXED_DEG_ONE - expected);
+    // +180 and -180 are the same direction
+    return error > 180 ? 360 - error : error;
+}
+
+static bool check_atan2(void) {
+    double worst = 0, worst_int16 = 0;
+    for (double length = 1; length < 2147483647.0; length *= 3.7) {
+        for (int step = -18000; step < 18000; step++) {
+            double angle = step / 100.0 * M_PI / 180;
+            int32_t x = (int32_t)lround(length * cos(angle));
+            int32_t y = (int32_t)lround(length * sin(angle));
+            if (x == 0 && y == 0) continue;
+            double error = atan2_error(y, x);
+            if (error > worst) worst = error;
+        }
+    }
+    for (int i = 0; i < TEST_RANDOM_INPUTS; i++) {
+        uint64_t r = random64();
+        int32_t x = (int16_t)r, y = (int16_t)(r >> 16);
+        if (x == 0 && y == 0) continue;
+        double error = atan2_error(y, x);
+        if (error > worst_int16) worst_int16 = error;
+    }
+    double limits[] = {atan2_error(0, -1), atan2_error(INT32_MIN, INT32_MIN), atan2_error(INT32_MAX, INT32_MIN)};
+    for (int i = 0; i < 3; i++) if (limits[i] > worst) worst = limits[i];
+    bool passed = worst <= FIXED_ATAN2_MAX_ERROR && worst_int16 <= FIXED_ATAN2_MAX_ERROR && fixed_atan2(0, 0) == 0;
+    printf("fixed_atan2: %.5f degrees worst over all lengths, %.5f over int16 pairs (limit %.3f)\n",
+           worst, worst_int16, FIXED_ATAN2_MAX_ERROR);
+    return passed;
+}
+
+static bool check_sqrt(void) {
+    size_t wrong = 0;
+    for (int i = 0; i < TEST_RANDOM_INPUTS; i++) {
+        uint64_t x = random64() >> (random64() % 64);
+        uint64_t root = fixed_sqrt64(x);
+        // floor: root^2 <= x < (root + 1)^2, in 128 bits
+        if ((unsigned __int128)root * root > x || (unsigned __int128)(root + 1) * (root + 1) <= x) wrong++;
+        uint32_t x32 = (uint32_t)x;
+        uint32_t root32 = fixed_sqrt32(x32);
+        if ((uint64_t)root32 * root32 > x32 || (uint64_t)(root32 + 1) * (root32 + 1) <= x32) wrong++;
+        uint32_t root_q16 = fixed_sqrt_q16(x32);
+        uint64_t scaled = (uint64_t)x32 << 16;
+        if ((uint64_t)root_q16 * root_q16 > scaled || (uint64_t)(root_q16 + 1) * (root_q16 + 1) <= scaled) wrong++;
+    }
+    for (uint64_t root = 1; root < ((uint64_t)1 << 32); root = root * 3 + 1) {
+        if (fixed_sqrt64(root * root) != root || fixed_sqrt64(root * root - 1) != root - 1) wrong++;
+    }
+    if (fixed_sqrt64(UINT64_MAX) != UINT32_MAX || fixed_sqrt32(UINT32_MAX) != 65535 || fixed_sqrt32(0) != 0) wrong++;
+    printf("fixed_sqrt32 / 64 / q16: %zu results not floor(sqrt(x))\n", wrong);
+    return wrong == 0;
+}
+
+static bool check_inv_sqrt(void) {
+    double worst = 0, worst_q16 = 0;
+    for (int i = 0; i < TEST_RANDOM_INPUTS; i++) {
+        uint64_t x = random64() >> (random64() % 64);
+        if (x == 0) continue;
+        // 62 fraction bits keep the rounding of the result below the error being measured
+        double expected = ldexp(1.0, 62) / sqrt((double)x);
+        double error = fabs(fixed_inv_sqrt64(x, 62) - expected) / expected;
+        if (error > worst) worst = error;
+        uint32_t x32 = (uint32_t)x;
+        if (x32 == 0) continue;
+        double expected_q16 = 65536.0 / sqrt(x32 / 65536.0);
+        // within half an LSB of the Q16 result or the relative bound
+        double error_q16 = fabs(fixed_inv_sqrt_q16(x32) - expected_q16) - 0.5;
+        if (error_q16 / expected_q16 > worst_q16) worst_q16 = error_q16 / expected_q16;
+    }
+    bool passed = worst <= FIXED_INV_SQRT_MAX_ERROR && worst_q16 <= FIXED_INV_SQRT_MAX_ERROR &&
+                  fixed_inv_sqrt64(0, 30) == 0 && fixed_inv_sqrt_q16(0) == UINT32_MAX;
+    printf("fixed_inv_sqrt64: %.2e worst relative error, q16: %.2e beyond rounding (limit %.1e)\n",
+           worst, worst_q16 > 0 ? worst_q16 : 0.0, FIXED_INV_SQRT_MAX_ERROR);
+    return passed;
+}
+
+// each loop feeds its result into the next input so the calls cannot be hoisted or overlapped
+static void time_functions(size_t calls) {
+    volatile uint32_t sink = 0;
+    uint32_t acc = 12345;
+    float facc = 0.5f;
+    double start = now_s();
+    for (size_t i = 0; i < calls; i++) acc += (uint32_t)fixed_atan2((int16_t)(acc * 7 + i), (int16_t)(i * 13 + 1));
+    double fixed_atan2_s = now_s() - start;
+    start = now_s();
+    for (size_t i = 0; i < calls; i++) facc += atan2f((float)(int16_t)((uint32_t)facc * 7 + i), (float)(int16_t)(i * 13 + 1));
+    double atan2f_s = now_s() - start;
+    start = now_s();
+    for (size_t i = 0; i < calls; i++) acc += fixed_sqrt32(acc ^ (uint32_t)i);
+    double sqrt32_s = now_s() - start;
+    start = now_s();
+    for (size_t i = 0; i < calls; i++) facc += sqrtf((float)(i + 1) + facc * 0.0f);
+    double sqrtf_s = now_s() - start;
+    start = now_s();
+    for (size_t i = 0; i < calls; i++) acc += fixed_inv_sqrt_q16((acc ^ (uint32_t)i) | 1);
+    double inv_sqrt_s = now_s() - start;
+    start = now_s();
+    for (size_t i = 0; i < calls; i++) facc += 1.0f / sqrtf((float)(i + 1) + facc * 0.0f);
+    double inv_sqrtf_s = now_s() - start;
+    sink = acc + (uint32_t)facc;
+    (void)sink;
+    printf("%zu calls each, ns per call:\n", calls);
+    printf("fixed_atan2        %6.2f   atan2f     %6.2f\n", fixed_atan2_s * 1e9 / calls, atan2f_s * 1e9 / calls);
+    printf("fixed_sqrt32       %6.2f   sqrtf      %6.2f\n", sqrt32_s * 1e9 / calls, sqrtf_s * 1e9 / calls);
+    printf("fixed_inv_sqrt_q16 %6.2f   1 / sqrtf  %6.2f\n", inv_sqrt_s * 1e9 / calls, inv_sqrtf_s * 1e9 / calls);
+}
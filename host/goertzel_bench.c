@@ -0,0 +1,155 @@
+/*
+Host benchmark of the Goertzel bank (main/goertzel.c) against the FFT spectra
+(main/spectrum.c).
+
+    goertzel_bench [seconds of samples]
+
+First checks the bank: sines of known amplitude at the targets on top of gravity and
+noise must come out within GOERTZEL_BENCH_TOLERANCE (plus the noise in a bin), and a
+retune must apply from the next block. Then feeds the same 1 kHz recording to banks of 1 to GOERTZEL_MAX_TARGETS targets
+and to the spectrum at 256 to 1024 points, and prints the time per sample of each. The
+bank costs one multiply per target and axis and sample; the FFT about
+5 log2(points) multiplies per axis and sample whatever is asked of it, so the table shows
+how many targets are still cheaper than the whole spectrum.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "goertzel.h"
+#include "spectrum.h"
+
+#define BENCH_RATE_HZ 1000
+#define BENCH_DEFAULT_SECONDS 600
+#define BENCH_BLOCK 1000
+#define BENCH_GRAVITY_COUNTS 4096
+#define BENCH_NOISE_COUNTS 20
+// of the amplitude, plus what the noise adds to a bin (about 2 sigma / sqrt(block))
+#define GOERTZEL_BENCH_TOLERANCE 0.01
+#define GOERTZEL_BENCH_NOISE_TOLERANCE_COUNTS 2.0
+
+static const float bench_targets_hz[GOERTZEL_MAX_TARGETS] = {25, 50, 75, 100, 125, 150, 175, 200};
+static const float bench_amplitudes[GOERTZEL_MAX_TARGETS] = {800, 300, 120, 60, 40, 25, 15, 10};
+
+static goertzel_bank_t bank;
+static spectrum_t spectrum;
+
+static double now_s(void);
+static void generate(mpu6050_raw_frame* frames, size_t frame_count);
+static bool check_bank(const mpu6050_raw_frame* frames, size_t frame_count);
+static double time_bank(const mpu6050_raw_frame* frames, size_t frame_count, size_t target_count);
+static double time_spectrum(const mpu6050_raw_frame* frames, size_t frame_count, uint8_t log2_points);
+
+int main(int argc, char** argv) {
+    size_t seconds = argc > 1 ? strtoul(argv[1], NULL, 0) : BENCH_DEFAULT_SECONDS;
+    if (seconds == 0) {
+        printf("usage: goertzel_bench [seconds of samples]\n");
+        return 2;
+    }
+    size_t frame_count = seconds * BENCH_RATE_HZ;
+    mpu6050_raw_frame* frames = malloc(frame_count * sizeof(mpu6050_raw_frame));
+    if (!frames) {
+        printf("could not allocate the recording\n");
+        return 1;
+    }
+    generate(frames, frame_count);
+    if (!check_bank(frames, frame_count)) {
+        free(frames);
+        return 1;
+    }
+    printf("%zu samples at %d Hz, 3 axes\n", frame_count, BENCH_RATE_HZ);
+    for (size_t targets = 1; targets <= GOERTZEL_MAX_TARGETS; targets *= 2) {
+        double ns = time_bank(frames, frame_count, targets);
+        printf("goertzel %zu target%s %8.1f ns/sample\n", targets, targets > 1 ? "s" : " ", ns);
+    }
+    for (uint8_t log2_points = 8; log2_points <= SPECTRUM_MAX_LOG2_POINTS; log2_points++) {
+        double ns = time_spectrum(frames, frame_count, log2_points);
+        printf("FFT %4d points       %8.1f ns/sample (%d bins)\n", 1 << log2_points, ns, (1 << log2_points) / 2 + 1);
+    }
+    free(frames);
+    return 0;
+}
+
+static double now_s(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// every target on every axis with its own phase, gravity on z, uniform noise
+static void generate(mpu6050_raw_frame* frames, size_t frame_count) {
+    srand(1);
+    for (size_t n = 0; n < frame_count; n++) {
+        for (int c = 0; c < 3; c++) {
+            double x = c == 2 ? BENCH_GRAVITY_COUNTS : 0;
+            for (int t = 0; t < GOERTZEL_MAX_TARGETS; t++) {
+                x += bench_amplitudes[t] * sin(2 * M_PI * bench_targets_hz[t] * n / BENCH_RATE_HZ + c + t);
+            }
+            x += (rand() % (2 * BENCH_NOISE_COUNTS + 1)) - BENCH_NOISE_COUNTS;
+            frames[n].accel[c] = (int16_t)lround(x);
+        }
+        frames[n].temperature = 0;
+        for (int c = 0; c < 3; c++) frames[n].gyro[c] = 0;
+    }
+}
+
+static bool check_bank(const mpu6050_raw_frame* frames, size_t frame_count) {
+    if (frame_count < 3 * BENCH_BLOCK) {
+        printf("need at least %d samples for the check\n", 3 * BENCH_BLOCK);
+        return false;
+    }
+    if (!goertzel_init(&bank, BENCH_RATE_HZ, BENCH_BLOCK, bench_targets_hz, GOERTZEL_MAX_TARGETS)) return false;
+    double worst = 0, worst_counts = 0;
+    size_t blocks = 0;
+    for (uint32_t n = 0; n < 3 * BENCH_BLOCK; n++) {
+        if (n == BENCH_BLOCK + 10) goertzel_set_target(&bank, 0, 60);
+        if (!goertzel_add(&bank, &frames[n], n)) continue;
+        blocks++;
+        // the first block still has gravity in it (its offset is the first sample), the third is retuned
+        for (size_t t = 0; t < GOERTZEL_MAX_TARGETS && blocks == 2; t++) {
+            for (int c = 0; c < 3; c++) {
+                double counts = fabs(goertzel_get_amplitude(&bank, t, c) - bench_amplitudes[t]);
+                double error = (counts - GOERTZEL_BENCH_NOISE_TOLERANCE_COUNTS) / bench_amplitudes[t];
+                if (error > worst) worst = error;
+                if (counts > worst_counts) worst_counts = counts;
+            }
+        }
+    }
+    // nothing at 60 Hz but noise and leakage
+    bool retuned = goertzel_get_frequency_hz(&bank, 0) == 60 && goertzel_get_amplitude(&bank, 0, 0) < 10 * BENCH_NOISE_COUNTS;
+    printf("goertzel check: amplitudes within %.2f counts (%.3f%% over the noise), retune %s\n", worst_counts, worst * 100,
+           retuned ? "applied" : "NOT applied");
+    if (worst > GOERTZEL_BENCH_TOLERANCE || !retuned) {
+        printf("FAILED\n");
+        return false;
+    }
+    return true;
+}
+
+static double time_bank(const mpu6050_raw_frame* frames, size_t frame_count, size_t target_count) {
+    goertzel_init(&bank, BENCH_RATE_HZ, BENCH_BLOCK, bench_targets_hz, target_count);
+    volatile float sink = 0;
+    double start = now_s();
+    for (size_t n = 0; n < frame_count; n++) {
+        if (goertzel_add(&bank, &frames[n], (uint32_t)n)) sink = goertzel_get_amplitude(&bank, 0, 0);
+    }
+    double seconds = now_s() - start;
+    (void)sink;
+    return seconds * 1e9 / frame_count;
+}
+
+static double time_spectrum(const mpu6050_raw_frame* frames, size_t frame_count, uint8_t log2_points) {
+    spectrum_init(&spectrum, log2_points, 1);
+    float power[SPECTRUM_MAX_BINS];
+    volatile float sink = 0;
+    double start = now_s();
+    for (size_t n = 0; n < frame_count; n++) {
+        if (spectrum_add(&spectrum, &frames[n], (uint32_t)n) && spectrum_process(&spectrum)) {
+            spectrum_get_power(&spectrum, 0, power);
+            sink = power[1];
+        }
+    }
+    double seconds = now_s() - start;
+    (void)sink;
+    return seconds * 1e9 / frame_count;
+}
@@ -0,0 +1,7 @@
+// Host build stand-in: declaration only, for the compile check of main.c (host/main_check.sh)
+#ifndef HOST_ESP_CPU_H
+#define HOST_ESP_CPU_H
+#include <stdint.h>
+typedef uint32_t esp_cpu_cycle_count_t;
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void);
+#endif /* HOST_ESP_CPU_H */
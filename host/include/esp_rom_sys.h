@@ -0,0 +1,6 @@
+// Host build stand-in: busy waits advance the emulated clock (host/my_SPI_host.c)
+#ifndef HOST_ESP_ROM_SYS_H
+#define HOST_ESP_ROM_SYS_H
+#include <stdint.h>
+void esp_rom_delay_us(uint32_t us);
+#endif /* HOST_ESP_ROM_SYS_H */
@@ -0,0 +1,6 @@
+// Host build stand-in: returns the emulated clock (host/my_SPI_host.c)
+#ifndef HOST_ESP_RTC_TIME_H
+#define HOST_ESP_RTC_TIME_H
+#include <stdint.h>
+uint64_t esp_rtc_get_time_us(void);
+#endif /* HOST_ESP_RTC_TIME_H */
@@ -0,0 +1,4 @@
+// Host build stand-in: main.c includes it but uses nothing from it
+#ifndef HOST_ESP_SYSTEM_H
+#define HOST_ESP_SYSTEM_H
+#endif /* HOST_ESP_SYSTEM_H */
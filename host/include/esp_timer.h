@@ -0,0 +1,6 @@
+// Host build stand-in: declaration only, for the compile check of main.c (host/main_check.sh)
+#ifndef HOST_ESP_TIMER_H
+#define HOST_ESP_TIMER_H
+#include <stdint.h>
+int64_t esp_timer_get_time(void);
+#endif /* HOST_ESP_TIMER_H */
@@ -0,0 +1,14 @@
+// Host build stand-in: the types and macros main.c and the MPU6050 driver use (host/main_check.sh)
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+#include <stdint.h>
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+typedef void* TaskHandle_t;
+#define pdFALSE 0
+#define pdTRUE 1
+#define portMAX_DELAY 0xFFFFFFFFu
+// 100 Hz tick, as on the board
+#define pdMS_TO_TICKS(ms) ((TickType_t)((ms) / 10))
+#define portYIELD_FROM_ISR() do {} while (0)
+#endif /* HOST_FREERTOS_H */
@@ -0,0 +1,9 @@
+// Host build stand-in: declarations only, for the compile check of main.c (host/main_check.sh)
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+#include "freertos/FreeRTOS.h"
+void vTaskDelay(TickType_t ticks);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higher_priority_task_woken);
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+#endif /* HOST_FREERTOS_TASK_H */
@@ -0,0 +1,5 @@
+// Host build stand-in: the settings main.c reads (host/main_check.sh)
+#ifndef HOST_SDKCONFIG_H
+#define HOST_SDKCONFIG_H
+#define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ 240
+#endif /* HOST_SDKCONFIG_H */
@@ -0,0 +1,51 @@
+#!/bin/sh
+# Host compile check of main/main.c: the feature switches are set with -D, so every one of
+# them is compiled at least once, with the ESP-IDF headers replaced by host/include.
+# Each supported configuration has to compile without warnings, and each combination main.c
+# rejects has to stop at its #error. Exits with 1 otherwise.
+#
+#     host/main_check.sh          from the repository root (or anywhere, it finds it)
+#     CC=clang host/main_check.sh
+cd "$(dirname "$0")/.." || exit 1
+CC=${CC:-gcc}
+failed=0
+
+compile() {
+    $CC -std=gnu17 -c -o /dev/null -Wall -Wextra -Werror -DSPI_HOST_EMULATION -Ihost/include -Ihost -Imain "$@" main/main.c
+}
+
+# supported: must compile cleanly
+for flags in \
+    "" \
+    "-DMPU_ORIENTATION=1 -DMPU_DECIMATION=1 -DMPU_LOG_COMPRESSED=1 -DMPU_WINDOW_STATS=1 -DMPU_SPECTRUM=1 -DMPU_GOERTZEL=1 -DMPU_ROLLUP=1 -DMPU_CAPTURE=1 -DMPU_VELOCITY=1 -DMPU_MOTION_GATED=1" \
+    "-DMPU_SAMPLING_DATA_READY=1 -DMPU_ADAPTIVE_RATE=1 -DMPU_LOG_PACKED=1 -DMPU_ORIENTATION=1 -DMPU_ORIENTATION_MADGWICK=0 -DMPU_WINDOW_STATS=1 -DMPU_SPECTRUM=1 -DMPU_GOERTZEL=1 -DMPU_ROLLUP=1 -DMPU_CAPTURE=1 -DMPU_VELOCITY=1" \
+    "-DMPU_SAMPLING_DATA_READY=1 -DMPU_DECIMATION=1 -DMPU_LOG_FULL_RATE=0" \
+    "-DMPU_ADAPTIVE_RATE=1 -DMPU_WINDOW_STATS=1 -DMPU_CHANNELS=MPU6050_CHANNEL_ACCEL" \
+    "-DMPU_SAMPLING_DATA_READY=1 -DMPU_DUAL_SENSORS=1"; do
+    if compile $flags; then
+        echo "ok      $flags"
+    else
+        echo "FAILED  $flags"
+        failed=1
+    fi
+done
+
+# rejected: must stop at an #error or a _Static_assert
+for flags in \
+    "-DMPU_DUAL_SENSORS=1" \
+    "-DMPU_SAMPLING_DATA_READY=1 -DMPU_DUAL_SENSORS=1 -DMPU_SPECTRUM=1" \
+    "-DMPU_SAMPLING_DATA_READY=1 -DMPU_DUAL_SENSORS=1 -DMPU_LOG_PACKED=1" \
+    "-DMPU_SAMPLING_DATA_READY=1 -DMPU_MOTION_GATED=1" \
+    "-DMPU_ADAPTIVE_RATE=1 -DMPU_DECIMATION=1" \
+    "-DMPU_LOG_COMPRESSED=1 -DMPU_LOG_PACKED=1" \
+    "-DMPU_LOG_FULL_RATE=0 -DMPU_LOG_COMPRESSED=1" \
+    "-DMPU_ORIENTATION=1 -DMPU_CHANNELS=MPU6050_CHANNEL_ACCEL" \
+    "-DMPU_VELOCITY=1 -DMPU_CHANNELS=MPU6050_CHANNEL_GYRO"; do
+    if ! compile $flags 2>&1 | grep -q -e "#error" -e "static assertion failed"; then
+        echo "FAILED  $flags (not rejected by its check)"
+        failed=1
+    else
+        echo "ok      $flags (rejected)"
+    fi
+done
+exit $failed
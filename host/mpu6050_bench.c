@@ -0,0 +1,170 @@
+/*
+Host benchmark of the MPU6050 batch conversion kernels (main/mpu6050_batch.c).
+
+    mpu6050_bench [frames per burst] [bursts]
+
+Converts random FIFO bursts three ways and prints samples (frames) per second for each:
+one frame at a time into a struct like the driver does (the baseline), the float SoA kernel
+and the Q15 SoA kernel. The kernel outputs are checked against the baseline first.
+Build with -O3 (see the README) so the host loops get vectorized.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "mpu6050_batch.h"
+
+#define BENCH_DEFAULT_FRAMES  MPU6050_FIFO_MAX_FRAMES
+#define BENCH_DEFAULT_BURSTS  200000
+#define BENCH_TEMPERATURE_TOLERANCE 1e-4f
+
+typedef struct {
+    mpu6050_xyz_data accel;
+    mpu6050_xyz_data gyro;
+    float temperature;
+} bench_sample_t;
+
+static double now_s(void);
+static void fill_session(mpu6050_session_t* session);
+static void convert_per_sample(const byte* frame, const mpu6050_session_t* session, bench_sample_t* sample);
+static bool check_kernels(const byte* frames, size_t frame_count, const mpu6050_session_t* session);
+static void print_rate(const char* name, size_t frame_count, size_t bursts, double seconds, double baseline_seconds);
+
+int main(int argc, char** argv) {
+    size_t frame_count = argc > 1 ? strtoul(argv[1], NULL, 0) : BENCH_DEFAULT_FRAMES;
+    size_t bursts = argc > 2 ? strtoul(argv[2], NULL, 0) : BENCH_DEFAULT_BURSTS;
+    if (frame_count == 0 || bursts == 0) {
+        printf("usage: mpu6050_bench [frames per burst] [bursts]\n");
+        return 2;
+    }
+
+    byte* frames = malloc(frame_count * MPU6050_FIFO_FRAME_SIZE);
+    bench_sample_t* samples = malloc(frame_count * sizeof(bench_sample_t));
+    float* f32 = malloc(7 * frame_count * sizeof(float));
+    int16_t* q15 = malloc(7 * frame_count * sizeof(int16_t));
+    if (!frames || !samples || !f32 || !q15) {
+        printf("could not allocate the bench buffers\n");
+        return 1;
+    }
+    srand(1);
+    for (size_t i = 0; i < frame_count * MPU6050_FIFO_FRAME_SIZE; i++) {
+        frames[i] = (byte)rand();
+    }
+    mpu6050_session_t session;
+    fill_session(&session);
+    if (!check_kernels(frames, frame_count, &session)) return 1;
+
+    mpu6050_channels_f32 f32_out = {
+        .accel = {&f32[0], &f32[frame_count], &f32[2 * frame_count]},
+        .temperature = &f32[3 * frame_count],
+        .gyro = {&f32[4 * frame_count], &f32[5 * frame_count], &f32[6 * frame_count]}
+    };
+    mpu6050_channels_q15 q15_out = {
+        .accel = {&q15[0], &q15[frame_count], &q15[2 * frame_count]},
+        .temperature = &q15[3 * frame_count],
+        .gyro = {&q15[4 * frame_count], &q15[5 * frame_count], &q15[6 * frame_count]}
+    };
+    // every pass reads one output so none of the work can be optimized away
+    volatile float float_sink = 0;
+    volatile int16_t q15_sink = 0;
+
+    double start = now_s();
+    for (size_t burst = 0; burst < bursts; burst++) {
+        for (size_t i = 0; i < frame_count; i++) {
+            convert_per_sample(&frames[i * MPU6050_FIFO_FRAME_SIZE], &session, &samples[i]);
+        }
+        float_sink = samples[burst % frame_count].accel.x;
+    }
+    double per_sample_s = now_s() - start;
+
+    start = now_s();
+    for (size_t burst = 0; burst < bursts; burst++) {
+        mpu6050_batch_to_f32(frames, frame_count, &session, &f32_out);
+        float_sink = f32[burst % frame_count];
+    }
+    double batch_f32_s = now_s() - start;
+
+    start = now_s();
+    for (size_t burst = 0; burst < bursts; burst++) {
+        mpu6050_batch_to_q15(frames, frame_count, &q15_out);
+        q15_sink = q15[burst % frame_count];
+    }
+    double batch_q15_s = now_s() - start;
+    (void)float_sink;
+    (void)q15_sink;
+
+    printf("%zu frames per burst, %zu bursts\n", frame_count, bursts);
+    print_rate("per sample (struct)", frame_count, bursts, per_sample_s, per_sample_s);
+    print_rate("batch float SoA", frame_count, bursts, batch_f32_s, per_sample_s);
+    print_rate("batch Q15 SoA", frame_count, bursts, batch_q15_s, per_sample_s);
+    free(frames);
+    free(samples);
+    free(f32);
+    free(q15);
+    return 0;
+}
+
+static double now_s(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// what the range setters store for +-8 g and +-1000 deg/s (the ranges main.c uses)
+static void fill_session(mpu6050_session_t* session) {
+    *session = (mpu6050_session_t){
+        .accel_range = MPU6050_RANGE_8_G,
+        .gyro_range = MPU6050_RANGE_1000_DEG,
+        .DLPF = MPU6050_DLPF_44_HZ,
+        .sample_rate_hz = 1000,
+        .accel_g_per_LSB = 1.0f / 4096.0f,
+        .gyro_dps_per_LSB = 1.0f / 32.8f
+    };
+}
+
+// one frame per call, like mpu6050_frame_to_raw() followed by mpu6050_raw_to_float()
+__attribute__((noinline))
+static void convert_per_sample(const byte* frame, const mpu6050_session_t* session, bench_sample_t* sample) {
+    mpu6050_raw_data raw[7];
+    for (int i = 0; i < 7; i++) {
+        raw[i] = (int16_t)((frame[2 * i] << 8) | frame[2 * i + 1]);
+    }
+    sample->accel.x = raw[0] * session->accel_g_per_LSB;
+    sample->accel.y = raw[1] * session->accel_g_per_LSB;
+    sample->accel.z = raw[2] * session->accel_g_per_LSB;
+    sample->temperature = ((float)raw[3] / 340.0f) + 36.53f;
+    sample->gyro.x = raw[4] * session->gyro_dps_per_LSB;
+    sample->gyro.y = raw[5] * session->gyro_dps_per_LSB;
+    sample->gyro.z = raw[6] * session->gyro_dps_per_LSB;
+}
+
+static bool check_kernels(const byte* frames, size_t frame_count, const mpu6050_session_t* session) {
+    float accel_x[frame_count], gyro_z[frame_count], temperature[frame_count];
+    int16_t accel_y_q15[frame_count], gyro_x_q15[frame_count];
+    // only some channels, which also exercises the skipped ones
+    mpu6050_channels_f32 f32_out = {.accel = {accel_x, NULL, NULL}, .gyro = {NULL, NULL, gyro_z}, .temperature = temperature};
+    mpu6050_channels_q15 q15_out = {.accel = {NULL, accel_y_q15, NULL}, .gyro = {gyro_x_q15, NULL, NULL}, .temperature = NULL};
+    mpu6050_batch_to_f32(frames, frame_count, session, &f32_out);
+    mpu6050_batch_to_q15(frames, frame_count, &q15_out);
+    for (size_t i = 0; i < frame_count; i++) {
+        bench_sample_t expected;
+        const byte* frame = &frames[i * MPU6050_FIFO_FRAME_SIZE];
+        convert_per_sample(frame, session, &expected);
+        int16_t expected_accel_y = (int16_t)((frame[2] << 8) | frame[3]);
+        int16_t expected_gyro_x = (int16_t)((frame[8] << 8) | frame[9]);
+        if (accel_x[i] != expected.accel.x || gyro_z[i] != expected.gyro.z ||
+            fabsf(temperature[i] - expected.temperature) > BENCH_TEMPERATURE_TOLERANCE ||
+            accel_y_q15[i] != expected_accel_y || gyro_x_q15[i] != expected_gyro_x) {
+            printf("kernel output differs from the per sample conversion at frame %zu\n", i);
+            return false;
+        }
+    }
+    printf("kernel outputs match the per sample conversion\n");
+    return true;
+}
+
+static void print_rate(const char* name, size_t frame_count, size_t bursts, double seconds, double baseline_seconds) {
+    double samples = (double)frame_count * bursts;
+    printf("%-22s %8.1f M samples/s  %6.2f ns/sample  %5.2fx\n", name, samples / seconds / 1e6,
+           seconds * 1e9 / samples, baseline_seconds / seconds);
+}
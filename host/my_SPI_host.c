@@ -0,0 +1,131 @@
+#include "my_SPI_host.h"
+
+#define SPI_HOST_DEFAULT_MAX_HZ 4000000
+
+static SPI_device_t devices[SPI_MAX_ATTACHED_DEVICES];
+static size_t device_count = 0;
+
+static sd_emulator_t* emulator_global = NULL;
+static gpio_num_t emulator_cs_global = GPIO_NUM_NC;
+
+static uint64_t time_ns_global = 0;
+static uint64_t bytes_transferred_global = 0;
+static uint32_t max_Hz_global = SPI_HOST_DEFAULT_MAX_HZ;
+static uint32_t current_Hz_global = SPI_HOST_DEFAULT_MAX_HZ;
+
+static byte get_device_index_from_cs(gpio_num_t cs);
+
+void SPI_host_set_max_frequency_Hz(uint32_t max_Hz) {
+    max_Hz_global = max_Hz;
+    if (current_Hz_global > max_Hz_global) current_Hz_global = max_Hz_global;
+}
+
+void SPI_host_attach_sd_emulator(gpio_num_t cs, sd_emulator_t* emu) {
+    emulator_global = emu;
+    emulator_cs_global = cs;
+}
+
+uint64_t SPI_host_get_time_ns(void) {
+    return time_ns_global;
+}
+
+void SPI_host_advance_time_us(uint64_t us) {
+    time_ns_global += us * 1000;
+}
+
+uint64_t SPI_host_get_bytes_transferred(void) {
+    return bytes_transferred_global;
+}
+
+uint64_t esp_rtc_get_time_us(void) {
+    return time_ns_global / 1000;
+}
+
+void esp_rom_delay_us(uint32_t us) {
+    time_ns_global += (uint64_t)us * 1000;
+}
+
+void SPI_cs_low(gpio_num_t CS) {
+    if (emulator_global && CS == emulator_cs_global) sd_emu_select(emulator_global, true);
+}
+
+void SPI_cs_high(gpio_num_t CS) {
+    if (emulator_global && CS == emulator_cs_global) sd_emu_select(emulator_global, false);
+}
+
+void SPI_attach_device(gpio_num_t cs, SPI_MODE mode) {
+    if (device_count >= SPI_MAX_ATTACHED_DEVICES) {
+        printf("Too many devices attached\n");
+        return;
+    }
+    // re-attaching is harmless here: the host tool re-runs SD_card_init() after power cycles
+    if (get_device_index_from_cs(cs) != 255) return;
+    SPI_device_t* dev = &devices[device_count++];
+    dev->cs_pin = cs;
+    dev->mode = mode;
+}
+
+bool SPI_init(void) {
+    if (device_count == 0) {
+        printf("Error: cannot start SPI without any attached devices!\n");
+        return false;
+    }
+    current_Hz_global = max_Hz_global;
+    return true;
+}
+
+byte SPI_transfer_byte(byte data, SPI_MODE mode) {
+    (void)mode;
+    time_ns_global += 8000000000ULL / current_Hz_global;
+    bytes_transferred_global++;
+    if (!emulator_global) return 0xFF;
+    return sd_emu_exchange(emulator_global, data, time_ns_global);
+}
+
+void SPI_transfer_block(const byte* tx_buffer, byte* rx_buffer, size_t number_of_bytes, SPI_MODE mode) {
+    for (size_t i = 0; i < number_of_bytes; i++) {
+        byte in = SPI_transfer_byte(tx_buffer ? tx_buffer[i] : 0xFF, mode);
+        if (rx_buffer) rx_buffer[i] = in;
+    }
+}
+
+void SPI_transmit_to_slave(const byte* tx_buffer, size_t number_of_bytes, SPI_MODE mode) {
+    SPI_transfer_block(tx_buffer, NULL, number_of_bytes, mode);
+}
+
+void SPI_receive_from_slave(byte* rx_buffer, size_t number_of_bytes, SPI_MODE mode) {
+    SPI_transfer_block(NULL, rx_buffer, number_of_bytes, mode);
+}
+
+// MOSI only matters between bytes, and the emulator only looks at whole bytes
+void SPI_set_mosi(bool mosi_logic_level) {
+    (void)mosi_logic_level;
+}
+
+bool SPI_wait_for_value(byte target_value, byte dummy_value, size_t max_iterations, SPI_MODE mode) {
+    for (size_t i = 0; i < max_iterations; i++) {
+        if (SPI_transfer_byte(dummy_value, mode) == target_value) return true;
+    }
+    return false;
+}
+
+size_t SPI_get_clock_speed_Hz(void) {
+    return current_Hz_global;
+}
+
+size_t SPI_get_max_frequency(void) {
+    return max_Hz_global;
+}
+
+void SPI_set_frequency(uint16_t desired_frequency_kHz) {
+    uint32_t Hz = (uint32_t)desired_frequency_kHz * 1000;
+    if (Hz == 0) return;
+    current_Hz_global = (Hz < max_Hz_global) ? Hz : max_Hz_global;
+}
+
+static byte get_device_index_from_cs(gpio_num_t cs) {
+    for (size_t i = 0; i < device_count; i++) {
+        if (devices[i].cs_pin == cs) return (byte)i;
+    }
+    return 255;
+}
@@ -0,0 +1,25 @@
+#ifndef MY_SPI_HOST_H
+#define MY_SPI_HOST_H
+#include "my_SPI.h"
+#include "sd_emulator.h"
+/*
+Host implementation of the my_SPI.h API (build with -DSPI_HOST_EMULATION).
+
+Instead of toggling GPIOs every byte is handed to the emulated device selected by its chip
+select pin. Time is emulated too: every byte advances the clock by 8 SPI clock periods at the
+current frequency and esp_rom_delay_us() advances it by the delay, so esp_rtc_get_time_us()
+(and every timing statistic of the driver) reports what the bus would take on the target,
+independent of how fast the host runs.
+*/
+
+// the bus speed SPI_get_max_frequency() reports. Defaults to 4 MHz, about what bit-banging reaches
+void SPI_host_set_max_frequency_Hz(uint32_t max_Hz);
+// puts an emulated SD card on the bus behind chip select cs
+void SPI_host_attach_sd_emulator(gpio_num_t cs, sd_emulator_t* emu);
+uint64_t SPI_host_get_time_ns(void);
+// time spent outside of the bus (e.g. the rest of the main loop)
+void SPI_host_advance_time_us(uint64_t us);
+// bytes clocked over the bus since start
+uint64_t SPI_host_get_bytes_transferred(void);
+
+#endif /* MY_SPI_HOST_H */
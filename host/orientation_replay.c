@@ -0,0 +1,352 @@
+/*
+Host replay of the fixed point orientation filters (main/orientation.c).
+
+    orientation_replay                                   check against a known motion
+    orientation_replay write <file.csv> [seconds]        write that motion as a recording
+    orientation_replay <file.csv> [rate_hz] [accel_g] [gyro_dps]
+
+A recording is one sample per line as raw counts in the mpu6050_raw_frame order:
+ax,ay,az,temperature,gx,gy,gz (lines starting with # are skipped), taken at rate_hz with
+the given full scale ranges (default 1000 Hz, 8 g, 1000 deg/s like main.c). The replay
+prints the complementary and Madgwick angles ten times per recorded second and the time
+each filter takes per sample.
+
+Without arguments it generates a 1 kHz recording of a known motion (roll and pitch swings
+with a steady turn, accelerometer and gyro noise, a few shocks) and compares both filters
+with the true angles, and the fixed point Madgwick with the same filter in double. Exits
+with 1 if an error is over its limit.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "orientation.h"
+
+#define REPLAY_RATE_HZ 1000
+#define REPLAY_SECONDS 60
+#define REPLAY_ACCEL_RANGE_G 8
+#define REPLAY_GYRO_RANGE_DPS 1000
+#define REPLAY_TIME_CONSTANT_S 1.0f
+#define REPLAY_BETA 0.05f
+// the first seconds are skipped in the error: the complementary yaw starts at 0
+#define REPLAY_SETTLE_S 2.0
+#define REPLAY_ACCEL_NOISE_G 0.004
+#define REPLAY_GYRO_NOISE_DPS 0.05
+// limits of the check, degrees
+#define REPLAY_MADGWICK_RMS_LIMIT 0.5
+#define REPLAY_COMPLEMENTARY_RMS_LIMIT 0.5
+#define REPLAY_FIXED_VS_DOUBLE_LIMIT 0.02
+
+typedef struct {
+    double q[4];
+    double beta;
+    double dt;
+} reference_madgwick_t;
+
+static double now_s(void);
+static void fill_session(mpu6050_session_t* session, unsigned rate_hz, unsigned accel_g, unsigned gyro_dps);
+static double gaussian(void);
+static size_t synthesize(mpu6050_raw_frame** frames, double seconds, double** truth);
+static bool write_recording(const char* path, const mpu6050_raw_frame* frames, size_t count);
+static size_t read_recording(const char* path, mpu6050_raw_frame** frames);
+static void reference_update(reference_madgwick_t* filter, const mpu6050_session_t* session, const mpu6050_raw_frame* frame);
+static double wrap_180(double angle);
+static int check(void);
+static void time_filters(const mpu6050_session_t* session, const mpu6050_raw_frame* frames, size_t count);
+
+int main(int argc, char** argv) {
+    if (argc == 1) return check();
+    if (strcmp(argv[1], "write") == 0) {
+        if (argc < 3) {
+            printf("usage: orientation_replay write <file.csv> [seconds]\n");
+            return 2;
+        }
+        mpu6050_raw_frame* frames;
+        double* truth;
+        size_t count = synthesize(&frames, argc > 3 ? atof(argv[3]) : REPLAY_SECONDS, &truth);
+        bool written = write_recording(argv[2], frames, count);
+        free(frames);
+        free(truth);
+        return written ? 0 : 1;
+    }
+    mpu6050_raw_frame* frames;
+    size_t count = read_recording(argv[1], &frames);
+    if (count == 0) return 1;
+    mpu6050_session_t session;
+    fill_session(&session, argc > 2 ? atoi(argv[2]) : REPLAY_RATE_HZ, argc > 3 ? atoi(argv[3]) : REPLAY_ACCEL_RANGE_G,
+                 argc > 4 ? atoi(argv[4]) : REPLAY_GYRO_RANGE_DPS);
+
+    orientation_complementary_t complementary;
+    orientation_madgwick_t madgwick;
+    orientation_complementary_init(&complementary, &session, REPLAY_TIME_CONSTANT_S);
+    orientation_madgwick_init(&madgwick, &session, REPLAY_BETA);
+    printf("#   time   complementary roll pitch yaw       madgwick roll pitch yaw\n");
+    size_t print_interval = session.sample_rate_hz / 10 > 0 ? session.sample_rate_hz / 10 : 1;
+    for (size_t i = 0; i < count; i++) {
+        orientation_complementary_update(&complementary, &frames[i]);
+        orientation_madgwick_update(&madgwick, &frames[i]);
+        if ((i + 1) % print_interval != 0) continue;
+        orientation_euler_t c, m;
+        orientation_complementary_get_euler(&complementary, &c);
+        orientation_madgwick_get_euler(&madgwick, &m);
+        printf("%8.2f   %8.2f %8.2f %8.2f      %8.2f %8.2f %8.2f\n", (double)(i + 1) / session.sample_rate_hz,
+               orientation_deg_to_float(c.roll), orientation_deg_to_float(c.pitch), orientation_deg_to_float(c.yaw),
+               orientation_deg_to_float(m.roll), orientation_deg_to_float(m.pitch), orientation_deg_to_float(m.yaw));
+    }
+    printf("# %zu samples, accelerometer rejected %llu (complementary) %llu (madgwick)\n", count,
+           (unsigned long long)complementary.stats.accel_rejected, (unsigned long long)madgwick.stats.accel_rejected);
+    time_filters(&session, frames, count);
+    free(frames);
+    return 0;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void fill_session(mpu6050_session_t* session, unsigned rate_hz, unsigned accel_g, unsigned gyro_dps) {
+    *session = (mpu6050_session_t){
+        .channels = MPU6050_CHANNEL_ALL,
+        .sample_rate_hz = (uint16_t)rate_hz,
+        .accel_g_per_LSB = accel_g / 32768.0f,
+        .gyro_dps_per_LSB = gyro_dps / 32768.0f
+    };
+}
+
+static double gaussian(void) {
+    double u = (rand() + 1.0) / (RAND_MAX + 2.0), v = (rand() + 1.0) / (RAND_MAX + 2.0);
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+/*
+roll and pitch swings with a steady turn, as Euler angles (truth: 3 per sample, degrees).
+The gyro reads the body rates that belong to the Euler rates, the accelerometer gravity
+turned into the sensor frame; a 3 g shock every 10 s lasts 20 ms
+*/
+static size_t synthesize(mpu6050_raw_frame** frames, double seconds, double** truth) {
+    size_t count = (size_t)(seconds * REPLAY_RATE_HZ);
+    *frames = calloc(count, sizeof(mpu6050_raw_frame));
+    *truth = malloc(3 * count * sizeof(double));
+    if (!*frames || !*truth) {
+        printf("could not allocate the recording\n");
+        exit(1);
+    }
+    srand(1);
+    const double d = M_PI / 180;
+    double counts_per_g = 32768.0 / REPLAY_ACCEL_RANGE_G, counts_per_dps = 32768.0 / REPLAY_GYRO_RANGE_DPS;
+    for (size_t i = 0; i < count; i++) {
+        double t = (double)i / REPLAY_RATE_HZ;
+        double roll = 30 * sin(2 * M_PI * 0.5 * t), pitch = 20 * sin(2 * M_PI * 0.3 * t + 1), yaw = wrap_180(15 * t);
+        double roll_rate = 30 * 2 * M_PI * 0.5 * cos(2 * M_PI * 0.5 * t), pitch_rate = 20 * 2 * M_PI * 0.3 * cos(2 * M_PI * 0.3 * t + 1);
+        double yaw_rate = 15;
+        double sr = sin(roll * d), cr = cos(roll * d), sp = sin(pitch * d), cp = cos(pitch * d);
+        double gyro[3] = {
+            roll_rate - yaw_rate * sp,
+            pitch_rate * cr + yaw_rate * cp * sr,
+            -pitch_rate * sr + yaw_rate * cp * cr
+        };
+        double accel[3] = {-sp, cp * sr, cp * cr};
+        if (i % (10 * REPLAY_RATE_HZ) < REPLAY_RATE_HZ / 50 && i > REPLAY_RATE_HZ) accel[0] += 3;
+        mpu6050_raw_frame* frame = &(*frames)[i];
+        for (int axis = 0; axis < 3; axis++) {
+            frame->accel[axis] = (int16_t)lround((accel[axis] + REPLAY_ACCEL_NOISE_G * gaussian()) * counts_per_g);
+            frame->gyro[axis] = (int16_t)lround((gyro[axis] + REPLAY_GYRO_NOISE_DPS * gaussian()) * counts_per_dps);
+        }
+        (*truth)[3 * i] = roll;
+        (*truth)[3 * i + 1] = pitch;
+        (*truth)[3 * i + 2] = yaw;
+    }
+    return count;
+}
+
+static bool write_recording(const char* path, const mpu6050_raw_frame* frames, size_t count) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        printf("could not create %s\n", path);
+        return false;
+    }
+    fprintf(file, "# ax,ay,az,temperature,gx,gy,gz raw counts, %d Hz, %d g, %d deg/s\n", REPLAY_RATE_HZ,
+            REPLAY_ACCEL_RANGE_G, REPLAY_GYRO_RANGE_DPS);
+    for (size_t i = 0; i < count; i++) {
+        const mpu6050_raw_frame* f = &frames[i];
+        fprintf(file, "%d,%d,%d,%d,%d,%d,%d\n", f->accel[0], f->accel[1], f->accel[2], f->temperature, f->gyro[0], f->gyro[1], f->gyro[2]);
+    }
+    fclose(file);
+    printf("wrote %zu samples to %s\n", count, path);
+    return true;
+}
+
+static size_t read_recording(const char* path, mpu6050_raw_frame** frames) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        printf("could not open %s\n", path);
+        return 0;
+    }
+    size_t count = 0, capacity = 4096;
+    *frames = malloc(capacity * sizeof(mpu6050_raw_frame));
+    char line[256];
+    while (*frames && fgets(line, sizeof(line), file)) {
+        int v[7];
+        if (line[0] == '#' || sscanf(line, "%d,%d,%d,%d,%d,%d,%d", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6]) != 7) continue;
+        if (count == capacity) {
+            capacity *= 2;
+            *frames = realloc(*frames, capacity * sizeof(mpu6050_raw_frame));
+            if (!*frames) break;
+        }
+        mpu6050_raw_frame* frame = &(*frames)[count++];
+        for (int axis = 0; axis < 3; axis++) {
+            frame->accel[axis] = (int16_t)v[axis];
+            frame->gyro[axis] = (int16_t)v[4 + axis];
+        }
+        frame->temperature = (int16_t)v[3];
+    }
+    fclose(file);
+    if (!*frames) {
+        printf("could not allocate the recording\n");
+        return 0;
+    }
+    if (count == 0) printf("no samples in %s\n", path);
+    return count;
+}
+
+// the same filter in double, including the gate and the alignment on the first sample
+static void reference_update(reference_madgwick_t* filter, const mpu6050_session_t* session, const mpu6050_raw_frame* frame) {
+    double* q = filter->q;
+    double g[3], a[3], n = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        g[axis] = frame->gyro[axis] * (double)session->gyro_dps_per_LSB * M_PI / 180;
+        a[axis] = frame->accel[axis] * (double)session->accel_g_per_LSB;
+        n += a[axis] * a[axis];
+    }
+    double dq[4] = {
+        0.5 * (-q[1] * g[0] - q[2] * g[1] - q[3] * g[2]),
+        0.5 * (q[0] * g[0] + q[2] * g[2] - q[3] * g[1]),
+        0.5 * (q[0] * g[1] - q[1] * g[2] + q[3] * g[0]),
+        0.5 * (q[0] * g[2] + q[1] * g[1] - q[2] * g[0])
+    };
+    bool usable = n >= ORIENTATION_ACCEL_GATE_MIN_G * ORIENTATION_ACCEL_GATE_MIN_G && n <= ORIENTATION_ACCEL_GATE_MAX_G * ORIENTATION_ACCEL_GATE_MAX_G;
+    if (usable) {
+        n = sqrt(n);
+        for (int axis = 0; axis < 3; axis++) a[axis] /= n;
+        if (filter->beta < 0) {
+            double tilt[4] = {1 + a[2], a[1], -a[0], 0}, length = 0;
+            for (int i = 0; i < 4; i++) length += tilt[i] * tilt[i];
+            for (int i = 0; i < 4; i++) q[i] = tilt[i] / sqrt(length);
+            filter->beta = -filter->beta;
+            return;
+        }
+        double f[3] = {
+            2 * (q[1] * q[3] - q[0] * q[2]) - a[0],
+            2 * (q[0] * q[1] + q[2] * q[3]) - a[1],
+            1 - 2 * (q[1] * q[1] + q[2] * q[2]) - a[2]
+        };
+        double s[4] = {
+            -2 * q[2] * f[0] + 2 * q[1] * f[1],
+            2 * q[3] * f[0] + 2 * q[0] * f[1] - 4 * q[1] * f[2],
+            -2 * q[0] * f[0] + 2 * q[3] * f[1] - 4 * q[2] * f[2],
+            2 * q[1] * f[0] + 2 * q[2] * f[1]
+        };
+        double length = sqrt(s[0] * s[0] + s[1] * s[1] + s[2] * s[2] + s[3] * s[3]);
+        if (length > 0) {
+            for (int i = 0; i < 4; i++) dq[i] -= filter->beta * s[i] / length;
+        }
+    }
+    double length = 0;
+    for (int i = 0; i < 4; i++) {
+        q[i] += dq[i] * filter->dt;
+        length += q[i] * q[i];
+    }
+    for (int i = 0; i < 4; i++) q[i] /= sqrt(length);
+}
+
+static double wrap_180(double angle) {
+    angle = fmod(angle, 360);
+    if (angle > 180) return angle - 360;
+    if (angle <= -180) return angle + 360;
+    return angle;
+}
+
+static int check(void) {
+    mpu6050_raw_frame* frames;
+    double* truth;
+    size_t count = synthesize(&frames, REPLAY_SECONDS, &truth);
+    mpu6050_session_t session;
+    fill_session(&session, REPLAY_RATE_HZ, REPLAY_ACCEL_RANGE_G, REPLAY_GYRO_RANGE_DPS);
+
+    orientation_complementary_t complementary;
+    orientation_madgwick_t madgwick;
+    orientation_complementary_init(&complementary, &session, REPLAY_TIME_CONSTANT_S);
+    orientation_madgwick_init(&madgwick, &session, REPLAY_BETA);
+    // a negative beta marks the reference as not aligned yet
+    reference_madgwick_t reference = {.q = {1, 0, 0, 0}, .beta = -REPLAY_BETA, .dt = 1.0 / REPLAY_RATE_HZ};
+
+    // per filter (complementary, madgwick, fixed vs double) and angle: sum of squares and max
+    double squares[3][3] = {{0}}, max_error[3][3] = {{0}};
+    size_t compared = 0;
+    for (size_t i = 0; i < count; i++) {
+        orientation_complementary_update(&complementary, &frames[i]);
+        orientation_madgwick_update(&madgwick, &frames[i]);
+        reference_update(&reference, &session, &frames[i]);
+        if ((double)i / REPLAY_RATE_HZ < REPLAY_SETTLE_S) continue;
+        orientation_euler_t c, m;
+        orientation_complementary_get_euler(&complementary, &c);
+        orientation_madgwick_get_euler(&madgwick, &m);
+        const double* q = reference.q;
+        double r[3] = {
+            atan2(2 * (q[0] * q[1] + q[2] * q[3]), 1 - 2 * (q[1] * q[1] + q[2] * q[2])) * 180 / M_PI,
+            asin(fmax(-1, fmin(1, 2 * (q[0] * q[2] - q[3] * q[1])))) * 180 / M_PI,
+            atan2(2 * (q[0] * q[3] + q[1] * q[2]), 1 - 2 * (q[2] * q[2] + q[3] * q[3])) * 180 / M_PI
+        };
+        int32_t fixed_c[3] = {c.roll, c.pitch, c.yaw}, fixed_m[3] = {m.roll, m.pitch, m.yaw};
+        for (int angle = 0; angle < 3; angle++) {
+            double errors[3] = {
+                wrap_180(orientation_deg_to_float(fixed_c[angle]) - truth[3 * i + angle]),
+                wrap_180(orientation_deg_to_float(fixed_m[angle]) - truth[3 * i + angle]),
+                wrap_180(orientation_deg_to_float(fixed_m[angle]) - r[angle])
+            };
+            for (int filter = 0; filter < 3; filter++) {
+                squares[filter][angle] += errors[filter] * errors[filter];
+                if (fabs(errors[filter]) > max_error[filter][angle]) max_error[filter][angle] = fabs(errors[filter]);
+            }
+        }
+        compared++;
+    }
+    const char* names[3] = {"complementary vs truth", "madgwick vs truth     ", "madgwick fixed vs double"};
+    const double limits[3] = {REPLAY_COMPLEMENTARY_RMS_LIMIT, REPLAY_MADGWICK_RMS_LIMIT, REPLAY_FIXED_VS_DOUBLE_LIMIT};
+    bool passed = true;
+    printf("%zu samples at %d Hz, errors in degrees after %.0f s (RMS / max): roll, pitch, yaw\n", count, REPLAY_RATE_HZ, REPLAY_SETTLE_S);
+    for (int filter = 0; filter < 3; filter++) {
+        printf("%s", names[filter]);
+        for (int angle = 0; angle < 3; angle++) {
+            double rms = sqrt(squares[filter][angle] / compared);
+            printf("   %6.3f / %6.3f", rms, max_error[filter][angle]);
+            if (rms > limits[filter]) passed = false;
+        }
+        printf("   (limit %.2f RMS)\n", limits[filter]);
+    }
+    time_filters(&session, frames, count);
+    printf("%s\n", passed ? "PASSED" : "FAILED");
+    free(frames);
+    free(truth);
+    return passed ? 0 : 1;
+}
+
+static void time_filters(const mpu6050_session_t* session, const mpu6050_raw_frame* frames, size_t count) {
+    orientation_complementary_t complementary;
+    orientation_madgwick_t madgwick;
+    orientation_complementary_init(&complementary, session, REPLAY_TIME_CONSTANT_S);
+    orientation_madgwick_init(&madgwick, session, REPLAY_BETA);
+    double start = now_s();
+    for (size_t i = 0; i < count; i++) orientation_complementary_update(&complementary, &frames[i]);
+    double complementary_s = now_s() - start;
+    start = now_s();
+    for (size_t i = 0; i < count; i++) orientation_madgwick_update(&madgwick, &frames[i]);
+    double madgwick_s = now_s() - start;
+    // keeps the loops from being optimized away
+    volatile int32_t sink = complementary.stats.samples + madgwick.q.w;
+    (void)sink;
+    printf("per sample on this host: complementary %.0f ns, madgwick %.0f ns\n", complementary_s / count * 1e9, madgwick_s / count * 1e9);
+}
@@ -0,0 +1,232 @@
+/*
+Host round trip of the lossless sample compression (main/rice_codec.c).
+
+    rice_codec_test                 generated recordings
+    rice_codec_test <file.csv>      a recording (the format of orientation_replay)
+
+Every recording goes through the encoder into records of SD_LOG_MAX_RECORD_LENGTH (480)
+bytes, with a flush every RICE_TEST_FLUSH_INTERVAL samples like main.c's log flushes, and
+every record is decoded again and compared with the input. The generated ones at 1 kHz,
+8 g and 1000 deg/s:
+- rest: gravity and sensor noise
+- vibration: a 25 Hz machine with harmonics on all axes, 0.3 g, plus noise
+- motion: slow swings of about 30 degrees per second with a shock every 2 s
+- noise: uniformly random full scale counts (does not compress), with jumps in the index
+
+Prints the compression ratio (raw 14 byte frames against the records) and the encode and
+decode time per sample. Exits with 1 if a sample does not come back exactly or a sensor
+recording compresses less than RICE_TEST_MIN_RATIO.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "rice_codec.h"
+
+#define RICE_TEST_RATE_HZ 1000
+#define RICE_TEST_SECONDS 60
+#define RICE_TEST_RECORD_LENGTH 480     // SD_LOG_MAX_RECORD_LENGTH
+#define RICE_TEST_FLUSH_INTERVAL 1000
+#define RICE_TEST_MIN_RATIO 2.0
+#define RICE_TEST_COUNTS_PER_G 4096.0
+#define RICE_TEST_COUNTS_PER_DPS 32.768
+
+typedef enum {
+    RECORDING_REST,
+    RECORDING_VIBRATION,
+    RECORDING_MOTION,
+    RECORDING_NOISE
+} RECORDING;
+
+static const char* recording_names[] = {"rest", "vibration", "motion", "noise"};
+
+static rice_encoder_t encoder;
+
+static double now_s(void);
+static double gaussian(void);
+static size_t generate(RECORDING recording, mpu6050_raw_frame** frames, uint32_t** indices);
+static size_t read_recording(const char* path, mpu6050_raw_frame** frames, uint32_t** indices);
+static bool round_trip(const char* name, const mpu6050_raw_frame* frames, const uint32_t* indices, size_t count, double* ratio);
+
+int main(int argc, char** argv) {
+    mpu6050_raw_frame* frames;
+    uint32_t* indices;
+    double ratio;
+    if (argc > 1) {
+        size_t count = read_recording(argv[1], &frames, &indices);
+        if (count == 0) return 1;
+        bool passed = round_trip(argv[1], frames, indices, count, &ratio);
+        free(frames);
+        free(indices);
+        return passed ? 0 : 1;
+    }
+    bool passed = true;
+    for (RECORDING recording = RECORDING_REST; recording <= RECORDING_NOISE; recording++) {
+        size_t count = generate(recording, &frames, &indices);
+        bool lossless = round_trip(recording_names[recording], frames, indices, count, &ratio);
+        passed = passed && lossless && (recording == RECORDING_NOISE || ratio >= RICE_TEST_MIN_RATIO);
+        free(frames);
+        free(indices);
+    }
+    printf("%s\n", passed ? "PASSED" : "FAILED");
+    return passed ? 0 : 1;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double gaussian(void) {
+    double u = (rand() + 1.0) / (RAND_MAX + 2.0), v = (rand() + 1.0) / (RAND_MAX + 2.0);
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+static size_t generate(RECORDING recording, mpu6050_raw_frame** frames, uint32_t** indices) {
+    size_t count = RICE_TEST_SECONDS * RICE_TEST_RATE_HZ;
+    *frames = malloc(count * sizeof(mpu6050_raw_frame));
+    *indices = malloc(count * sizeof(uint32_t));
+    if (!*frames || !*indices) {
+        printf("could not allocate the recording\n");
+        exit(1);
+    }
+    srand(1);
+    uint32_t index = 0;
+    for (size_t i = 0; i < count; i++) {
+        double t = (double)i / RICE_TEST_RATE_HZ;
+        double accel[3] = {0, 0, 1}, gyro[3] = {0.3, -0.2, 0.1};   // g, deg/s (gyro offsets)
+        if (recording == RECORDING_VIBRATION) {
+            for (int axis = 0; axis < 3; axis++) {
+                for (int harmonic = 1; harmonic <= 3; harmonic++) {
+                    accel[axis] += 0.3 / harmonic * sin(2 * M_PI * 25 * harmonic * t + axis + harmonic);
+                }
+                gyro[axis] += 5 * sin(2 * M_PI * 25 * t + axis);
+            }
+        } else if (recording == RECORDING_MOTION) {
+            double roll = 0.5 * sin(2 * M_PI * 0.5 * t), pitch = 0.35 * sin(2 * M_PI * 0.3 * t + 1);
+            accel[0] = -sin(pitch);
+            accel[1] = cos(pitch) * sin(roll);
+            accel[2] = cos(pitch) * cos(roll);
+            gyro[0] += 30 * 2 * M_PI * 0.5 * cos(2 * M_PI * 0.5 * t);
+            gyro[1] += 20 * 2 * M_PI * 0.3 * cos(2 * M_PI * 0.3 * t + 1);
+            if (i % (2 * RICE_TEST_RATE_HZ) < RICE_TEST_RATE_HZ / 50) accel[0] += 3;
+        }
+        mpu6050_raw_frame* frame = &(*frames)[i];
+        for (int axis = 0; axis < 3; axis++) {
+            // MPU6050 noise at a 1 kHz rate: about 4 mg and 0.05 deg/s RMS
+            frame->accel[axis] = (int16_t)lround((accel[axis] + 0.004 * gaussian()) * RICE_TEST_COUNTS_PER_G);
+            frame->gyro[axis] = (int16_t)lround((gyro[axis] + 0.05 * gaussian()) * RICE_TEST_COUNTS_PER_DPS);
+        }
+        // 25 C, drifting slowly, read 1 in 1000 samples like main.c
+        frame->temperature = (int16_t)(-2500 + (i / RICE_TEST_RATE_HZ) % 3);
+        if (recording == RECORDING_NOISE) {
+            memset(frame, 0, sizeof(*frame));
+            for (size_t b = 0; b < sizeof(*frame); b++) ((uint8_t*)frame)[b] = (uint8_t)rand();
+            // missed samples now and then
+            if (rand() % 500 == 0) index += 1 + rand() % 5;
+        }
+        (*indices)[i] = index++;
+    }
+    return count;
+}
+
+static size_t read_recording(const char* path, mpu6050_raw_frame** frames, uint32_t** indices) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        printf("could not open %s\n", path);
+        return 0;
+    }
+    size_t count = 0, capacity = 4096;
+    *frames = malloc(capacity * sizeof(mpu6050_raw_frame));
+    char line[256];
+    while (*frames && fgets(line, sizeof(line), file)) {
+        int v[7];
+        if (line[0] == '#' || sscanf(line, "%d,%d,%d,%d,%d,%d,%d", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6]) != 7) continue;
+        if (count == capacity) {
+            capacity *= 2;
+            *frames = realloc(*frames, capacity * sizeof(mpu6050_raw_frame));
+            if (!*frames) break;
+        }
+        mpu6050_raw_frame* frame = &(*frames)[count++];
+        for (int axis = 0; axis < 3; axis++) {
+            frame->accel[axis] = (int16_t)v[axis];
+            frame->gyro[axis] = (int16_t)v[4 + axis];
+        }
+        frame->temperature = (int16_t)v[3];
+    }
+    fclose(file);
+    *indices = *frames ? malloc(count * sizeof(uint32_t)) : NULL;
+    if (!*frames || (count > 0 && !*indices)) {
+        printf("could not allocate the recording\n");
+        return 0;
+    }
+    for (size_t i = 0; i < count; i++) (*indices)[i] = (uint32_t)i;
+    if (count == 0) printf("no samples in %s\n", path);
+    return count;
+}
+
+/*
+encodes the recording into records kept in memory (timed on their own), then decodes them
+(timed) and compares every sample with its index
+*/
+static bool round_trip(const char* name, const mpu6050_raw_frame* frames, const uint32_t* indices, size_t count, double* ratio) {
+    uint8_t* stream = malloc(count * sizeof(mpu6050_raw_frame) + count + RICE_TEST_RECORD_LENGTH);
+    mpu6050_raw_frame* decoded = malloc(RICE_TEST_RECORD_LENGTH * 8 * sizeof(mpu6050_raw_frame));
+    if (!stream || !decoded || !rice_encoder_init(&encoder, RICE_TEST_RECORD_LENGTH)) {
+        printf("could not set up the round trip\n");
+        exit(1);
+    }
+    // records one after the other, each behind its uint16 length
+    size_t stream_length = 0;
+    const uint8_t* data;
+    uint16_t length;
+    double start = now_s();
+    for (size_t i = 0; i < count; i++) {
+        rice_encoder_add(&encoder, &frames[i], indices[i]);
+        if ((i + 1) % RICE_TEST_FLUSH_INTERVAL == 0) rice_encoder_flush(&encoder);
+        while (rice_encoder_next_record(&encoder, &data, &length)) {
+            memcpy(stream + stream_length, &length, sizeof(length));
+            memcpy(stream + stream_length + sizeof(length), data, length);
+            stream_length += sizeof(length) + length;
+        }
+    }
+    rice_encoder_flush(&encoder);
+    while (rice_encoder_next_record(&encoder, &data, &length)) {
+        memcpy(stream + stream_length, &length, sizeof(length));
+        memcpy(stream + stream_length + sizeof(length), data, length);
+        stream_length += sizeof(length) + length;
+    }
+    double encode_s = now_s() - start;
+
+    size_t checked = 0, wrong = 0, largest = 0;
+    double decode_s = 0;
+    for (size_t position = 0; position < stream_length;) {
+        memcpy(&length, stream + position, sizeof(length));
+        if (length > largest) largest = length;
+        uint32_t first_index;
+        size_t frame_count;
+        start = now_s();
+        bool valid = rice_decode(stream + position + sizeof(length), length, decoded, RICE_TEST_RECORD_LENGTH * 8,
+                                 &first_index, &frame_count);
+        decode_s += now_s() - start;
+        position += sizeof(length) + length;
+        if (!valid) {
+            wrong++;
+            continue;
+        }
+        for (size_t i = 0; i < frame_count && checked < count; i++, checked++) {
+            if (indices[checked] != first_index + i || memcmp(&decoded[i], &frames[checked], sizeof(mpu6050_raw_frame))) wrong++;
+        }
+    }
+    const rice_stats_t* stats = rice_encoder_get_stats(&encoder);
+    *ratio = (double)count * sizeof(mpu6050_raw_frame) / stats->encoded_bytes;
+    bool lossless = wrong == 0 && checked == count && largest <= RICE_TEST_RECORD_LENGTH;
+    printf("%-10s %8zu samples %6lu records %5.2f x   %6.1f / %6.1f ns per sample encode / decode   %s\n", name, count,
+           (unsigned long)stats->records, *ratio, encode_s * 1e9 / count, decode_s * 1e9 / count,
+           lossless ? "lossless" : "MISMATCH");
+    free(stream);
+    free(decoded);
+    return lossless;
+}
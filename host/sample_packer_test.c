@@ -0,0 +1,145 @@
+/*
+Host round trip of the sample packing (main/sample_packer.c), with the same unpacker the
+firmware has.
+
+    sample_packer_test [bits ax,ay,az,t,gx,gy,gz]
+
+Packs random full scale frames (with the extremes of every channel and jumps in the index)
+into records of SD_LOG_MAX_RECORD_LENGTH (480) bytes, unpacks every record and checks that
+each channel came back within half a step of 2^(16 - bits) counts (a whole step just below
+full scale, where the rounding saturates), and that channels left out come back as 0. The
+default bits are main.c's LOG_PACKED_BITS, then every width from 10 to 16 bits on all
+channels. Prints the size against raw frames and the time per sample. Exits with 1 on any
+error.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sample_packer.h"
+
+#define PACKER_TEST_SAMPLES 200000
+#define PACKER_TEST_RECORD_LENGTH 480   // SD_LOG_MAX_RECORD_LENGTH
+#define PACKER_TEST_MAX_FRAMES 512
+
+static const uint8_t default_bits[SAMPLE_PACKER_CHANNELS] = {12, 12, 12, 10, 14, 14, 14};
+
+static sample_packer_t packer;
+
+static double now_s(void);
+static bool round_trip(const uint8_t* bits, const mpu6050_raw_frame* frames, const uint32_t* indices, size_t count);
+
+int main(int argc, char** argv) {
+    uint8_t bits[SAMPLE_PACKER_CHANNELS];
+    memcpy(bits, default_bits, sizeof(bits));
+    if (argc > 1) {
+        unsigned b[SAMPLE_PACKER_CHANNELS];
+        if (sscanf(argv[1], "%u,%u,%u,%u,%u,%u,%u", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5], &b[6]) != SAMPLE_PACKER_CHANNELS) {
+            printf("usage: sample_packer_test [bits ax,ay,az,t,gx,gy,gz]\n");
+            return 2;
+        }
+        for (int c = 0; c < SAMPLE_PACKER_CHANNELS; c++) bits[c] = (uint8_t)b[c];
+    }
+    mpu6050_raw_frame* frames = malloc(PACKER_TEST_SAMPLES * sizeof(mpu6050_raw_frame));
+    uint32_t* indices = malloc(PACKER_TEST_SAMPLES * sizeof(uint32_t));
+    if (!frames || !indices) {
+        printf("could not allocate the samples\n");
+        return 1;
+    }
+    srand(1);
+    uint32_t index = 0;
+    for (size_t i = 0; i < PACKER_TEST_SAMPLES; i++) {
+        int16_t values[SAMPLE_PACKER_CHANNELS];
+        for (int c = 0; c < SAMPLE_PACKER_CHANNELS; c++) values[c] = (int16_t)(rand() & 0xFFFF);
+        if (i % 1000 == 0) {
+            for (int c = 0; c < SAMPLE_PACKER_CHANNELS; c++) values[c] = c % 2 ? INT16_MAX : INT16_MIN;
+        }
+        memcpy(&frames[i], values, sizeof(values));
+        if (rand() % 5000 == 0) index += 1 + rand() % 10;
+        indices[i] = index++;
+    }
+    bool passed = round_trip(bits, frames, indices, PACKER_TEST_SAMPLES);
+    if (argc == 1) {
+        for (uint8_t width = SAMPLE_PACKER_MIN_BITS; width <= 16; width++) {
+            memset(bits, width, sizeof(bits));
+            passed = round_trip(bits, frames, indices, PACKER_TEST_SAMPLES) && passed;
+        }
+    }
+    printf("%s\n", passed ? "PASSED" : "FAILED");
+    free(frames);
+    free(indices);
+    return passed ? 0 : 1;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// packs into records kept in memory (timed on their own), then unpacks and checks them (timed)
+static bool round_trip(const uint8_t* bits, const mpu6050_raw_frame* frames, const uint32_t* indices, size_t count) {
+    if (!sample_packer_init(&packer, bits, PACKER_TEST_RECORD_LENGTH)) return false;
+    // records one after the other, each behind its uint16 length
+    uint8_t* stream = malloc(count * sizeof(mpu6050_raw_frame) * 2);
+    mpu6050_raw_frame* unpacked = malloc(PACKER_TEST_MAX_FRAMES * sizeof(mpu6050_raw_frame));
+    if (!stream || !unpacked) {
+        printf("could not allocate the records\n");
+        exit(1);
+    }
+    size_t stream_length = 0;
+    const uint8_t* data;
+    uint16_t length;
+    double start = now_s();
+    for (size_t i = 0; i <= count; i++) {
+        if (i < count) sample_packer_add(&packer, &frames[i], indices[i]);
+        else sample_packer_flush(&packer);
+        if (!sample_packer_next_record(&packer, &data, &length)) continue;
+        memcpy(stream + stream_length, &length, sizeof(length));
+        memcpy(stream + stream_length + sizeof(length), data, length);
+        stream_length += sizeof(length) + length;
+    }
+    double pack_s = now_s() - start;
+
+    size_t checked = 0, wrong = 0;
+    int32_t worst = 0;
+    double unpack_s = 0;
+    for (size_t position = 0; position < stream_length;) {
+        memcpy(&length, stream + position, sizeof(length));
+        uint32_t first_index;
+        size_t frame_count;
+        start = now_s();
+        bool valid = sample_packer_unpack(stream + position + sizeof(length), length, unpacked, PACKER_TEST_MAX_FRAMES,
+                                          &first_index, &frame_count);
+        unpack_s += now_s() - start;
+        position += sizeof(length) + length;
+        if (!valid || length > PACKER_TEST_RECORD_LENGTH) {
+            wrong++;
+            continue;
+        }
+        for (size_t i = 0; i < frame_count && checked < count; i++, checked++) {
+            int16_t in[SAMPLE_PACKER_CHANNELS], out[SAMPLE_PACKER_CHANNELS];
+            memcpy(in, &frames[checked], sizeof(in));
+            memcpy(out, &unpacked[i], sizeof(out));
+            if (indices[checked] != first_index + i) wrong++;
+            for (int c = 0; c < SAMPLE_PACKER_CHANNELS; c++) {
+                if (bits[c] == 0) {
+                    if (out[c] != 0) wrong++;
+                    continue;
+                }
+                int32_t step = 1 << (16 - bits[c]), error = abs(in[c] - out[c]);
+                if (error > worst) worst = error;
+                if (2 * error > step && !(in[c] > INT16_MAX - step && error < step)) wrong++;
+            }
+        }
+    }
+    const sample_packer_stats_t* stats = sample_packer_get_stats(&packer);
+    printf("bits %2u,%2u,%2u,%2u,%2u,%2u,%2u: %5lu records, %.3f of raw, worst error %5ld counts, "
+           "%5.1f / %5.1f ns per sample pack / unpack  %s\n",
+           bits[0], bits[1], bits[2], bits[3], bits[4], bits[5], bits[6], (unsigned long)stats->records,
+           (double)stats->packed_bytes / (count * sizeof(mpu6050_raw_frame)), (long)worst, pack_s * 1e9 / count,
+           unpack_s * 1e9 / count, wrong == 0 && checked == count ? "ok" : "WRONG");
+    free(stream);
+    free(unpacked);
+    return wrong == 0 && checked == count;
+}
@@ -0,0 +1,628 @@
+#include "sd_emulator.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+// R1 bits
+#define R1_IDLE              0x01
+#define R1_ERASE_RESET       0x02
+#define R1_ILLEGAL_COMMAND   0x04
+#define R1_COMMAND_CRC_ERROR 0x08
+#define R1_ERASE_SEQUENCE    0x10
+#define R1_ADDRESS_ERROR     0x20
+#define R1_PARAMETER_ERROR   0x40
+
+#define START_BLOCK_TOKEN        0xFE
+#define START_MULTI_WRITE_TOKEN  0xFC
+#define STOP_MULTI_WRITE_TOKEN   0xFD
+
+// data response tokens: xxx0sss1
+#define DATA_ACCEPTED    0xE5
+#define DATA_CRC_ERROR   0xEB
+#define DATA_WRITE_ERROR 0xED
+
+// OCR: 2.7-3.6 V window, busy bit (set once init is done), CCS (block addressing)
+#define OCR_VOLTAGE_WINDOW 0x00FF8000U
+#define OCR_POWER_UP_DONE  0x80000000U
+#define OCR_CCS            0x40000000U
+
+static uint8_t crc7(const uint8_t* data, size_t length);
+static uint16_t crc16(const uint8_t* data, size_t length);
+static void set_register_bits(uint8_t* reg, size_t reg_bytes, unsigned msb, unsigned lsb, uint32_t value);
+static uint32_t next_random(sd_emulator_t* emu);
+static uint64_t latency_ns(sd_emulator_t* emu, uint64_t latency_us);
+static void queue_response(sd_emulator_t* emu, const uint8_t* bytes, size_t length, bool ncr_gap);
+static void queue_data_packet(sd_emulator_t* emu, const uint8_t* data, size_t length, uint64_t ready_ns);
+static bool load_read_block(sd_emulator_t* emu, uint64_t now_ns);
+static uint8_t next_output(sd_emulator_t* emu, uint64_t now_ns);
+static void receive_byte(sd_emulator_t* emu, uint8_t mosi, uint64_t now_ns);
+static void execute_command(sd_emulator_t* emu, uint64_t now_ns);
+static void finish_write(sd_emulator_t* emu, uint64_t now_ns);
+static void program_block(sd_emulator_t* emu, uint32_t block, const uint8_t* data, uint64_t now_ns);
+static void erase_blocks(sd_emulator_t* emu, uint64_t now_ns);
+static void build_csd(const sd_emulator_t* emu, uint8_t* csd);
+static void build_cid(const sd_emulator_t* emu, uint8_t* cid);
+static void build_sd_status(const sd_emulator_t* emu, uint8_t* status);
+static void set_erased(sd_emulator_t* emu, uint32_t block, bool erased);
+static bool is_erased(const sd_emulator_t* emu, uint32_t block);
+
+void sd_emu_default_latency(sd_emu_latency_t* latency) {
+    latency->read_latency_us = 300;
+    latency->program_latency_us = 900;
+    latency->erased_program_latency_us = 250;
+    latency->au_switch_latency_us = 5000;
+    latency->stall_interval_blocks = 2048;
+    latency->stall_latency_us = 40000;
+    latency->erase_latency_us = 2000;
+    latency->erase_latency_per_au_us = 1500;
+    latency->stop_latency_us = 500;
+    latency->jitter_us = 50;
+    latency->init_polls = 3;
+}
+
+bool sd_emu_create_image(const char* path, uint32_t size_MB) {
+    FILE* image = fopen(path, "wb");
+    if (!image) {
+        printf("Could not create %s\n", path);
+        return false;
+    }
+    static uint8_t zeros[64 * 1024];
+    bool success = true;
+    for (uint32_t i = 0; i < size_MB * 16 && success; i++) {
+        success = fwrite(zeros, sizeof(zeros), 1, image) == 1;
+    }
+    if (fclose(image) != 0) success = false;
+    if (!success) printf("Could not write %s\n", path);
+    return success;
+}
+
+bool sd_emu_open(sd_emulator_t* emu, const char* image_path, const sd_emu_latency_t* latency, uint32_t au_size_code) {
+    memset(emu, 0, sizeof(*emu));
+    if (au_size_code < 1 || au_size_code > 9) {
+        printf("AU size code must be 1 (16 KB) to 9 (4 MB)\n");
+        return false;
+    }
+    emu->image = fopen(image_path, "r+b");
+    if (!emu->image) {
+        printf("Could not open %s\n", image_path);
+        return false;
+    }
+    fseeko(emu->image, 0, SEEK_END);
+    off_t size = ftello(emu->image);
+    // CSD v2 counts capacity in 512 KB units
+    if (size <= 0 || size % (512 * 1024) != 0 || size / SD_EMU_BLOCK_SIZE > UINT32_MAX) {
+        printf("%s: size must be a non-zero multiple of 512 KB\n", image_path);
+        fclose(emu->image);
+        emu->image = NULL;
+        return false;
+    }
+    emu->capacity_blocks = (uint32_t)(size / SD_EMU_BLOCK_SIZE);
+    emu->au_blocks = (16 * 1024 / SD_EMU_BLOCK_SIZE) << (au_size_code - 1);
+    emu->erased_map = calloc(emu->capacity_blocks / 8 + 1, 1);
+    if (!emu->erased_map) {
+        printf("Malloc call failed\n");
+        fclose(emu->image);
+        emu->image = NULL;
+        return false;
+    }
+    if (latency) {
+        emu->latency = *latency;
+    } else {
+        sd_emu_default_latency(&emu->latency);
+    }
+    emu->random_state = 0x9E3779B97F4A7C15ULL;
+    emu->last_write_au = UINT32_MAX;
+    sd_emu_power_cycle(emu);
+    return true;
+}
+
+void sd_emu_close(sd_emulator_t* emu) {
+    if (emu->image) fclose(emu->image);
+    free(emu->erased_map);
+    emu->image = NULL;
+    emu->erased_map = NULL;
+}
+
+void sd_emu_power_cut_after(sd_emulator_t* emu, uint32_t blocks_from_now) {
+    emu->power_cut_countdown = blocks_from_now;
+}
+
+void sd_emu_power_cycle(sd_emulator_t* emu) {
+    emu->powered = true;
+    emu->spi_mode = false;
+    emu->idle = true;
+    emu->app_command = false;
+    emu->crc_enabled = false;
+    emu->init_polls_seen = 0;
+    emu->state = SD_EMU_STATE_COMMAND;
+    emu->busy_until_ns = 0;
+    emu->command_length = 0;
+    emu->response_length = emu->response_position = 0;
+    emu->data_out_length = emu->data_out_position = 0;
+    emu->data_in_length = 0;
+    emu->multi_read = emu->multi_write = false;
+    emu->erase_first_set = emu->erase_last_set = false;
+    emu->power_cut_countdown = 0;
+    if (emu->image) fflush(emu->image);
+}
+
+bool sd_emu_is_powered(const sd_emulator_t* emu) {
+    return emu->powered;
+}
+
+void sd_emu_select(sd_emulator_t* emu, bool selected) {
+    if (emu->selected && !selected) {
+        // a command or data block cut short by CS is lost
+        emu->command_length = 0;
+        emu->response_length = emu->response_position = 0;
+        if (emu->state == SD_EMU_STATE_RECEIVE_DATA) emu->state = SD_EMU_STATE_WAIT_DATA_TOKEN;
+        if (emu->state == SD_EMU_STATE_SEND_DATA) {
+            emu->state = SD_EMU_STATE_COMMAND;
+            emu->data_out_length = emu->data_out_position = 0;
+            emu->multi_read = false;
+        }
+    }
+    emu->selected = selected;
+}
+
+uint8_t sd_emu_exchange(sd_emulator_t* emu, uint8_t mosi, uint64_t now_ns) {
+    // a deselected or unpowered card leaves MISO to the pull-up
+    if (!emu->powered || !emu->selected) return 0xFF;
+    // full duplex: what goes out was decided before this byte came in
+    uint8_t miso = next_output(emu, now_ns);
+    receive_byte(emu, mosi, now_ns);
+    return miso;
+}
+
+void sd_emu_print_stats(const sd_emulator_t* emu) {
+    const sd_emu_stats_t* s = &emu->stats;
+    printf("Emulated card: %llu commands (%llu illegal, %llu CRC errors), %llu blocks read, %llu written, "
+           "%llu erases (%llu blocks), busy %llu us total, max %llu us\n",
+           (unsigned long long)s->commands, (unsigned long long)s->illegal_commands,
+           (unsigned long long)s->crc_errors, (unsigned long long)s->blocks_read,
+           (unsigned long long)s->blocks_written, (unsigned long long)s->erases,
+           (unsigned long long)s->blocks_erased, (unsigned long long)s->busy_us,
+           (unsigned long long)s->max_busy_us);
+}
+
+static uint8_t next_output(sd_emulator_t* emu, uint64_t now_ns) {
+    if (emu->response_position < emu->response_length) {
+        return emu->response[emu->response_position++];
+    }
+    if (emu->state == SD_EMU_STATE_SEND_DATA && emu->data_out_length) {
+        if (now_ns < emu->data_ready_ns) return 0xFF; // still fetching
+        uint8_t out = emu->data_out[emu->data_out_position++];
+        if (emu->data_out_position == emu->data_out_length) {
+            emu->data_out_length = emu->data_out_position = 0;
+            // CMD18 streams blocks until CMD12
+            if (!emu->multi_read || (++emu->read_block, !load_read_block(emu, now_ns))) {
+                emu->multi_read = false;
+                emu->state = SD_EMU_STATE_COMMAND;
+            }
+        }
+        return out;
+    }
+    // busy: MISO held low
+    if (now_ns < emu->busy_until_ns) return 0x00;
+    return 0xFF;
+}
+
+static void receive_byte(sd_emulator_t* emu, uint8_t mosi, uint64_t now_ns) {
+    switch (emu->state) {
+        case SD_EMU_STATE_WAIT_DATA_TOKEN:
+            if (now_ns < emu->busy_until_ns) return;
+            if ((!emu->multi_write && mosi == START_BLOCK_TOKEN) ||
+                (emu->multi_write && mosi == START_MULTI_WRITE_TOKEN)) {
+                emu->state = SD_EMU_STATE_RECEIVE_DATA;
+                emu->data_in_length = 0;
+            } else if (emu->multi_write && mosi == STOP_MULTI_WRITE_TOKEN) {
+                emu->multi_write = false;
+                emu->state = SD_EMU_STATE_COMMAND;
+                emu->busy_until_ns = now_ns + latency_ns(emu, emu->latency.stop_latency_us);
+            }
+            return;
+        case SD_EMU_STATE_RECEIVE_DATA:
+            emu->data_in[emu->data_in_length++] = mosi;
+            if (emu->data_in_length == sizeof(emu->data_in)) finish_write(emu, now_ns);
+            return;
+        case SD_EMU_STATE_SEND_DATA:
+        case SD_EMU_STATE_COMMAND:
+            // commands start with 01xxxxxx. 0xFF (idle MOSI) never matches
+            if (emu->command_length == 0 && (mosi & 0xC0) != 0x40) return;
+            emu->command[emu->command_length++] = mosi;
+            if (emu->command_length == sizeof(emu->command)) {
+                emu->command_length = 0;
+                execute_command(emu, now_ns);
+            }
+            return;
+    }
+}
+
+static void execute_command(sd_emulator_t* emu, uint64_t now_ns) {
+    const uint8_t* command = emu->command;
+    uint8_t index = command[0] & 0x3F;
+    uint32_t arg = ((uint32_t)command[1] << 24) | ((uint32_t)command[2] << 16) |
+                   ((uint32_t)command[3] << 8) | command[4];
+    bool app_command = emu->app_command;
+    emu->app_command = false;
+
+    // the card only enters SPI mode on a CMD0 with CS asserted
+    if (!emu->spi_mode) {
+        if (index != 0) return;
+        emu->spi_mode = true;
+    }
+    // while streaming a CMD18 only CMD12 (and reset) are looked at
+    if (emu->state == SD_EMU_STATE_SEND_DATA && index != 12 && index != 0) return;
+    emu->stats.commands++;
+
+    uint8_t r1 = emu->idle ? R1_IDLE : 0;
+    // CMD0 and CMD8 always carry a valid CRC, everything else only once CMD59 enabled checking
+    if ((emu->crc_enabled || index == 0 || index == 8) && command[5] != ((crc7(command, 5) << 1) | 1)) {
+        emu->stats.crc_errors++;
+        r1 |= R1_COMMAND_CRC_ERROR;
+        queue_response(emu, &r1, 1, true);
+        return;
+    }
+    if (emu->idle && index != 0 && index != 8 && index != 55 && index != 58 && index != 59 &&
+        !(app_command && index == 41)) {
+        emu->stats.illegal_commands++;
+        r1 |= R1_ILLEGAL_COMMAND;
+        queue_response(emu, &r1, 1, true);
+        return;
+    }
+
+    uint8_t response[5];
+    uint8_t reg[64];
+    switch (index) {
+        case 0: // GO_IDLE_STATE
+            emu->idle = true;
+            emu->init_polls_seen = 0;
+            emu->crc_enabled = false;
+            emu->multi_read = emu->multi_write = false;
+            emu->data_out_length = emu->data_out_position = 0;
+            emu->state = SD_EMU_STATE_COMMAND;
+            r1 = R1_IDLE;
+            queue_response(emu, &r1, 1, true);
+            return;
+        case 8: // SEND_IF_COND: R7 echoes the voltage and check pattern
+            response[0] = r1;
+            response[1] = 0;
+            response[2] = 0;
+            response[3] = (arg >> 8) & 0x0F;
+            response[4] = arg & 0xFF;
+            queue_response(emu, response, 5, true);
+            return;
+        case 9: // SEND_CSD
+        case 10: // SEND_CID
+            if (index == 9) {
+                build_csd(emu, reg);
+            } else {
+                build_cid(emu, reg);
+            }
+            queue_response(emu, &r1, 1, true);
+            queue_data_packet(emu, reg, 16, now_ns);
+            return;
+        case 12: // STOP_TRANSMISSION: a stuff byte, then R1b
+            emu->multi_read = false;
+            emu->data_out_length = emu->data_out_position = 0;
+            emu->state = SD_EMU_STATE_COMMAND;
+            response[0] = 0xFF;
+            response[1] = r1;
+            queue_response(emu, response, 2, true);
+            emu->busy_until_ns = now_ns + latency_ns(emu, emu->latency.stop_latency_us);
+            return;
+        case 13: // SEND_STATUS (R2), ACMD13 SD_STATUS (R2 + data)
+            response[0] = r1;
+            response[1] = 0;
+            queue_response(emu, response, 2, true);
+            if (app_command) {
+                build_sd_status(emu, reg);
+                queue_data_packet(emu, reg, 64, now_ns);
+            }
+            return;
+        case 16: // SET_BLOCKLEN: SDHC blocks are always 512 bytes
+            if (arg != SD_EMU_BLOCK_SIZE) r1 |= R1_PARAMETER_ERROR;
+            queue_response(emu, &r1, 1, true);
+            return;
+        case 17: // READ_SINGLE_BLOCK
+        case 18: // READ_MULTIPLE_BLOCK
+            if (arg >= emu->capacity_blocks) {
+                r1 |= R1_PARAMETER_ERROR;
+                queue_response(emu, &r1, 1, true);
+                return;
+            }
+            queue_response(emu, &r1, 1, true);
+            emu->read_block = arg;
+            emu->multi_read = (index == 18);
+            load_read_block(emu, now_ns);
+            return;
+        case 23: // ACMD23 SET_WR_BLK_ERASE_COUNT is only a hint; plain CMD23 is not supported in SPI mode
+            if (!app_command) {
+                emu->stats.illegal_commands++;
+                r1 |= R1_ILLEGAL_COMMAND;
+            }
+            queue_response(emu, &r1, 1, true);
+            return;
+        case 24: // WRITE_BLOCK
+        case 25: // WRITE_MULTIPLE_BLOCK
+            if (arg >= emu->capacity_blocks) {
+                r1 |= R1_PARAMETER_ERROR;
+                queue_response(emu, &r1, 1, true);
+                return;
+            }
+            queue_response(emu, &r1, 1, true);
+            emu->write_block = arg;
+            emu->multi_write = (index == 25);
+            emu->state = SD_EMU_STATE_WAIT_DATA_TOKEN;
+            return;
+        case 32: // ERASE_WR_BLK_START_ADDR
+        case 33: // ERASE_WR_BLK_END_ADDR
+            if (arg >= emu->capacity_blocks) {
+                r1 |= R1_PARAMETER_ERROR;
+            } else if (index == 32) {
+                emu->erase_first_block = arg;
+                emu->erase_first_set = true;
+                emu->erase_last_set = false;
+            } else if (!emu->erase_first_set) {
+                r1 |= R1_ERASE_SEQUENCE;
+            } else {
+                emu->erase_last_block = arg;
+                emu->erase_last_set = true;
+            }
+            queue_response(emu, &r1, 1, true);
+            return;
+        case 38: // ERASE: R1b
+            if (!emu->erase_first_set || !emu->erase_last_set || emu->erase_last_block < emu->erase_first_block) {
+                r1 |= R1_ERASE_SEQUENCE;
+                emu->erase_first_set = emu->erase_last_set = false;
+                queue_response(emu, &r1, 1, true);
+                return;
+            }
+            queue_response(emu, &r1, 1, true);
+            erase_blocks(emu, now_ns);
+            return;
+        case 41: // ACMD41 SD_SEND_OP_COND: the card needs a few polls to power up
+            if (++emu->init_polls_seen >= emu->latency.init_polls) emu->idle = false;
+            r1 = emu->idle ? R1_IDLE : 0;
+            queue_response(emu, &r1, 1, true);
+            return;
+        case 55: // APP_CMD
+            emu->app_command = true;
+            queue_response(emu, &r1, 1, true);
+            return;
+        case 58: { // READ_OCR: R3
+            uint32_t ocr = OCR_VOLTAGE_WINDOW;
+            if (!emu->idle) ocr |= OCR_POWER_UP_DONE | OCR_CCS;
+            response[0] = r1;
+            response[1] = ocr >> 24;
+            response[2] = (ocr >> 16) & 0xFF;
+            response[3] = (ocr >> 8) & 0xFF;
+            response[4] = ocr & 0xFF;
+            queue_response(emu, response, 5, true);
+            return;
+        }
+        case 59: // CRC_ON_OFF
+            emu->crc_enabled = arg & 0x1;
+            queue_response(emu, &r1, 1, true);
+            return;
+        default:
+            emu->stats.illegal_commands++;
+            r1 |= R1_ILLEGAL_COMMAND;
+            queue_response(emu, &r1, 1, true);
+            return;
+    }
+}
+
+// a complete data block (+ CRC16) arrived for CMD24/25
+static void finish_write(sd_emulator_t* emu, uint64_t now_ns) {
+    uint8_t data_response = DATA_ACCEPTED;
+    uint16_t crc = ((uint16_t)emu->data_in[SD_EMU_BLOCK_SIZE] << 8) | emu->data_in[SD_EMU_BLOCK_SIZE + 1];
+    if (emu->crc_enabled && crc != crc16(emu->data_in, SD_EMU_BLOCK_SIZE)) {
+        emu->stats.crc_errors++;
+        data_response = DATA_CRC_ERROR;
+    } else if (emu->write_block >= emu->capacity_blocks) {
+        data_response = DATA_WRITE_ERROR;
+    } else {
+        program_block(emu, emu->write_block, emu->data_in, now_ns);
+        emu->write_block++;
+    }
+    // the data response follows the CRC directly, without an NCR gap
+    queue_response(emu, &data_response, 1, false);
+    // after an error in a CMD25 the host still has to send the stop token
+    emu->state = emu->multi_write ? SD_EMU_STATE_WAIT_DATA_TOKEN : SD_EMU_STATE_COMMAND;
+}
+
+static void program_block(sd_emulator_t* emu, uint32_t block, const uint8_t* data, uint64_t now_ns) {
+    off_t offset = (off_t)block * SD_EMU_BLOCK_SIZE;
+    if (emu->power_cut_countdown && --emu->power_cut_countdown == 0) {
+        // power lost mid program: only the first half of the block changed
+        fseeko(emu->image, offset, SEEK_SET);
+        fwrite(data, SD_EMU_BLOCK_SIZE / 2, 1, emu->image);
+        fflush(emu->image);
+        set_erased(emu, block, false);
+        emu->powered = false;
+        return;
+    }
+    fseeko(emu->image, offset, SEEK_SET);
+    if (fwrite(data, SD_EMU_BLOCK_SIZE, 1, emu->image) != 1) {
+        printf("Image write of block %lu failed\n", (unsigned long)block);
+    }
+
+    uint64_t busy_us;
+    if (is_erased(emu, block)) {
+        busy_us = emu->latency.erased_program_latency_us;
+    } else {
+        busy_us = emu->latency.program_latency_us;
+        // opening a new AU that was not erased in advance costs an internal erase/merge
+        if (block / emu->au_blocks != emu->last_write_au) busy_us += emu->latency.au_switch_latency_us;
+    }
+    emu->last_write_au = block / emu->au_blocks;
+    set_erased(emu, block, false);
+    emu->stats.blocks_written++;
+    if (emu->latency.stall_interval_blocks && emu->stats.blocks_written % emu->latency.stall_interval_blocks == 0) {
+        busy_us += emu->latency.stall_latency_us;
+    }
+    uint64_t busy_ns = latency_ns(emu, busy_us);
+    emu->busy_until_ns = now_ns + busy_ns;
+    emu->stats.busy_us += busy_ns / 1000;
+    if (busy_ns / 1000 > emu->stats.max_busy_us) emu->stats.max_busy_us = busy_ns / 1000;
+}
+
+// erased blocks read back as zeros (DATA_STAT_AFTER_ERASE = 0 in the CSD)
+static void erase_blocks(sd_emulator_t* emu, uint64_t now_ns) {
+    static const uint8_t zeros[SD_EMU_BLOCK_SIZE];
+    uint32_t first = emu->erase_first_block;
+    uint32_t last = emu->erase_last_block;
+    emu->erase_first_set = emu->erase_last_set = false;
+
+    for (uint32_t block = first; block <= last; block++) {
+        if (!is_erased(emu, block)) {
+            fseeko(emu->image, (off_t)block * SD_EMU_BLOCK_SIZE, SEEK_SET);
+            fwrite(zeros, sizeof(zeros), 1, emu->image);
+            set_erased(emu, block, true);
+        }
+    }
+    uint32_t aus = last / emu->au_blocks - first / emu->au_blocks + 1;
+    uint64_t busy_ns = latency_ns(emu, emu->latency.erase_latency_us + (uint64_t)aus * emu->latency.erase_latency_per_au_us);
+    emu->busy_until_ns = now_ns + busy_ns;
+    emu->stats.erases++;
+    emu->stats.blocks_erased += last - first + 1;
+    emu->stats.busy_us += busy_ns / 1000;
+    if (busy_ns / 1000 > emu->stats.max_busy_us) emu->stats.max_busy_us = busy_ns / 1000;
+}
+
+// queues the next CMD17/18 block. Returns false past the end of the card
+static bool load_read_block(sd_emulator_t* emu, uint64_t now_ns) {
+    if (emu->read_block >= emu->capacity_blocks) return false;
+    uint8_t block[SD_EMU_BLOCK_SIZE];
+    fseeko(emu->image, (off_t)emu->read_block * SD_EMU_BLOCK_SIZE, SEEK_SET);
+    if (fread(block, sizeof(block), 1, emu->image) != 1) memset(block, 0, sizeof(block));
+    emu->stats.blocks_read++;
+    queue_data_packet(emu, block, sizeof(block), now_ns + latency_ns(emu, emu->latency.read_latency_us));
+    return true;
+}
+
+static void queue_data_packet(sd_emulator_t* emu, const uint8_t* data, size_t length, uint64_t ready_ns) {
+    uint16_t crc = crc16(data, length);
+    emu->data_out[0] = START_BLOCK_TOKEN;
+    memcpy(&emu->data_out[1], data, length);
+    emu->data_out[1 + length] = crc >> 8;
+    emu->data_out[2 + length] = crc & 0xFF;
+    emu->data_out_length = (uint16_t)(length + 3);
+    emu->data_out_position = 0;
+    emu->data_ready_ns = ready_ns;
+    emu->state = SD_EMU_STATE_SEND_DATA;
+}
+
+// responses appear after an NCR gap of one byte (the spec allows 1-8)
+static void queue_response(sd_emulator_t* emu, const uint8_t* bytes, size_t length, bool ncr_gap) {
+    emu->response_length = 0;
+    emu->response_position = 0;
+    if (ncr_gap) emu->response[emu->response_length++] = 0xFF;
+    memcpy(&emu->response[emu->response_length], bytes, length);
+    emu->response_length += (uint8_t)length;
+}
+
+static uint64_t latency_ns(sd_emulator_t* emu, uint64_t latency_us) {
+    if (emu->latency.jitter_us) latency_us += next_random(emu) % (emu->latency.jitter_us + 1);
+    return latency_us * 1000;
+}
+
+// xorshift64: deterministic jitter for repeatable runs
+static uint32_t next_random(sd_emulator_t* emu) {
+    uint64_t x = emu->random_state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    emu->random_state = x;
+    return (uint32_t)(x >> 32);
+}
+
+static void set_erased(sd_emulator_t* emu, uint32_t block, bool erased) {
+    if (erased) {
+        emu->erased_map[block / 8] |= 1U << (block % 8);
+    } else {
+        emu->erased_map[block / 8] &= ~(1U << (block % 8));
+    }
+}
+
+static bool is_erased(const sd_emulator_t* emu, uint32_t block) {
+    return (emu->erased_map[block / 8] >> (block % 8)) & 0x1;
+}
+
+static void build_csd(const sd_emulator_t* emu, uint8_t* csd) {
+    memset(csd, 0, 16);
+    set_register_bits(csd, 16, 127, 126, 1);        // CSD_STRUCTURE: version 2.0
+    set_register_bits(csd, 16, 119, 112, 0x0E);     // TAAC: 1 ms
+    set_register_bits(csd, 16, 103, 96, 0x32);      // TRAN_SPEED: 25 MHz
+    set_register_bits(csd, 16, 95, 84, 0x5B5);      // CCC
+    set_register_bits(csd, 16, 83, 80, 9);          // READ_BL_LEN: 512
+    set_register_bits(csd, 16, 69, 48, emu->capacity_blocks / 1024 - 1); // C_SIZE
+    set_register_bits(csd, 16, 46, 46, 1);          // ERASE_BLK_EN
+    set_register_bits(csd, 16, 45, 39, 0x7F);       // SECTOR_SIZE: 64 KB
+    set_register_bits(csd, 16, 28, 26, 2);          // R2W_FACTOR: x4
+    set_register_bits(csd, 16, 25, 22, 9);          // WRITE_BL_LEN: 512
+    csd[15] = (crc7(csd, 15) << 1) | 1;
+}
+
+static void build_cid(const sd_emulator_t* emu, uint8_t* cid) {
+    (void)emu;
+    memset(cid, 0, 16);
+    cid[0] = 0x45;                                  // MID
+    memcpy(&cid[1], "EM", 2);                       // OID
+    memcpy(&cid[3], "SDEMU", 5);                    // PNM
+    cid[8] = 0x10;                                  // PRV 1.0
+    set_register_bits(cid, 16, 55, 24, 0x00C0FFEE); // PSN
+    set_register_bits(cid, 16, 19, 12, 24);         // MDT year - 2000
+    set_register_bits(cid, 16, 11, 8, 1);           // MDT month
+    cid[15] = (crc7(cid, 15) << 1) | 1;
+}
+
+static void build_sd_status(const sd_emulator_t* emu, uint8_t* status) {
+    memset(status, 0, 64);
+    unsigned au_size_code = 1;
+    while ((16U * 1024 / SD_EMU_BLOCK_SIZE) << (au_size_code - 1) < emu->au_blocks) au_size_code++;
+    uint32_t erase_s = (emu->latency.erase_latency_us + emu->latency.erase_latency_per_au_us) / 1000000 + 1;
+    set_register_bits(status, 64, 447, 440, 2);     // SPEED_CLASS: class 4
+    set_register_bits(status, 64, 431, 428, au_size_code);
+    set_register_bits(status, 64, 423, 408, 1);     // ERASE_SIZE: AUs per ERASE_TIMEOUT
+    set_register_bits(status, 64, 407, 402, erase_s > 63 ? 63 : erase_s);
+    set_register_bits(status, 64, 401, 400, 1);     // ERASE_OFFSET
+}
+
+// the inverse of get_register_bits() in SD_card_SPI.c
+static void set_register_bits(uint8_t* reg, size_t reg_bytes, unsigned msb, unsigned lsb, uint32_t value) {
+    for (unsigned bit = lsb; bit <= msb; bit++, value >>= 1) {
+        uint8_t* b = &reg[reg_bytes - 1 - (bit / 8)];
+        if (value & 0x1) {
+            *b |= 1U << (bit % 8);
+        } else {
+            *b &= ~(1U << (bit % 8));
+        }
+    }
+}
+
+// CRC7 (x^7 + x^3 + 1) of commands and the CSD/CID
+static uint8_t crc7(const uint8_t* data, size_t length) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < length; i++) {
+        for (int bit = 7; bit >= 0; bit--) {
+            uint8_t in = ((data[i] >> bit) & 0x1) ^ ((crc >> 6) & 0x1);
+            crc = (crc << 1) & 0x7F;
+            if (in) crc ^= 0x09;
+        }
+    }
+    return crc;
+}
+
+// CRC16-CCITT (x^16 + x^12 + x^5 + 1) of data blocks
+static uint16_t crc16(const uint8_t* data, size_t length) {
+    uint16_t crc = 0;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
@@ -0,0 +1,132 @@
+#ifndef SD_EMULATOR_H
+#define SD_EMULATOR_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+/*
+Host-side emulation of an SDHC card in SPI mode, backed by an image file.
+
+The emulator is fed one byte at a time exactly like the card's DI/DO pins: every byte the
+SPI layer clocks out goes in, the byte the card drives on MISO comes back. my_SPI_host.c
+implements the my_SPI.h API on top of it, so SD_card_SPI.c and SD_log.c run unmodified
+on Linux (see the README for the build command).
+
+Implemented: CMD0/8/9/10/12/13/16/17/18/24/25/32/33/38/55/58/59 and ACMD13/23/41,
+R1/R1b/R2/R3/R7 responses with the 1 byte NCR gap, start/stop tokens, data responses,
+busy signalling, command CRC7 (always for CMD0/CMD8, for everything once CMD59 turns
+CRC checking on) and data CRC16.
+
+Time is passed in by the caller (the emulated bus clock), so latencies are deterministic:
+the card keeps MISO low while now < busy end, and the data token of a read only appears
+once the read latency has passed.
+*/
+
+#define SD_EMU_BLOCK_SIZE 512
+
+// all in microseconds. Whatever applies is added up per block
+typedef struct {
+    uint32_t read_latency_us;           // command to data token (CMD17/18, per block)
+    uint32_t program_latency_us;        // busy after a block written over old data
+    uint32_t erased_program_latency_us; // busy after a block written to an erased location
+    uint32_t au_switch_latency_us;      // extra busy when a write leaves the AU of the previous write
+    uint32_t stall_interval_blocks;     // every Nth block written adds stall_latency_us (0 = never)
+    uint32_t stall_latency_us;          // e.g. internal garbage collection
+    uint32_t erase_latency_us;          // fixed busy of an erase (CMD38)
+    uint32_t erase_latency_per_au_us;   // plus this much per AU touched
+    uint32_t stop_latency_us;           // busy after the CMD25 stop token or CMD12
+    uint32_t jitter_us;                 // uniform random 0..jitter_us added to every busy/read latency
+    uint32_t init_polls;                // ACMD41 polls before the card leaves the idle state
+} sd_emu_latency_t;
+
+typedef struct {
+    uint64_t commands;
+    uint64_t illegal_commands;
+    uint64_t crc_errors;
+    uint64_t blocks_read;
+    uint64_t blocks_written;
+    uint64_t erases;
+    uint64_t blocks_erased;
+    uint64_t busy_us;                   // total busy time programmed/erasing
+    uint64_t max_busy_us;
+} sd_emu_stats_t;
+
+typedef enum {
+    SD_EMU_STATE_COMMAND,           // waiting for / receiving a command
+    SD_EMU_STATE_WAIT_DATA_TOKEN,   // CMD24/25 accepted, waiting for 0xFE / 0xFC / 0xFD
+    SD_EMU_STATE_RECEIVE_DATA,      // receiving a data block + CRC16
+    SD_EMU_STATE_SEND_DATA          // CMD17/18 and register reads
+} SD_EMU_STATE;
+
+typedef struct {
+    FILE* image;
+    uint32_t capacity_blocks;
+    uint32_t au_blocks;             // reported in the SD Status, used by the latency model
+    sd_emu_latency_t latency;
+    sd_emu_stats_t stats;
+
+    bool powered;
+    bool selected;                  // chip select asserted
+    bool spi_mode;                  // CMD0 with CS low seen
+    bool idle;                      // in the idle state until ACMD41 completes
+    bool app_command;               // previous command was CMD55
+    bool crc_enabled;               // CMD59
+    uint32_t init_polls_seen;
+    SD_EMU_STATE state;
+    uint64_t busy_until_ns;
+
+    uint8_t command[6];
+    uint8_t command_length;
+    uint8_t response[8];            // queued response bytes (NCR gap included)
+    uint8_t response_length;
+    uint8_t response_position;
+
+    // reads: token + data + CRC16, shown once data_ready_ns has passed
+    uint8_t data_out[1 + SD_EMU_BLOCK_SIZE + 2];
+    uint16_t data_out_length;
+    uint16_t data_out_position;
+    uint64_t data_ready_ns;
+    bool multi_read;
+    uint32_t read_block;
+
+    // writes: data + CRC16
+    uint8_t data_in[SD_EMU_BLOCK_SIZE + 2];
+    uint16_t data_in_length;
+    bool multi_write;
+    uint32_t write_block;
+    uint32_t last_write_au;
+
+    uint32_t erase_first_block;
+    uint32_t erase_last_block;
+    bool erase_first_set;
+    bool erase_last_set;
+    uint8_t* erased_map;            // one bit per block, set while the block is erased
+
+    uint32_t power_cut_countdown;   // 0 = off
+    uint64_t random_state;
+} sd_emulator_t;
+
+// the defaults roughly follow a class 4 card
+void sd_emu_default_latency(sd_emu_latency_t* latency);
+// creates (or resizes) a zero filled image file
+bool sd_emu_create_image(const char* path, uint32_t size_MB);
+// opens an image file. Its size must be a multiple of 512 KB (the CSD v2 capacity granularity)
+bool sd_emu_open(sd_emulator_t* emu, const char* image_path, const sd_emu_latency_t* latency, uint32_t au_size_code);
+void sd_emu_close(sd_emulator_t* emu);
+
+// chip select. Deselecting aborts a partially received command or data block
+void sd_emu_select(sd_emulator_t* emu, bool selected);
+// one full duplex byte: mosi is what the host clocks out, the return value is MISO
+uint8_t sd_emu_exchange(sd_emulator_t* emu, uint8_t mosi, uint64_t now_ns);
+
+/*
+power loss: the blocks_from_now'th block programmed from now on is torn (only its first half
+reaches the image) and the card stops responding until sd_emu_power_cycle()
+*/
+void sd_emu_power_cut_after(sd_emulator_t* emu, uint32_t blocks_from_now);
+// power comes back: the card needs the full init sequence again. The image is kept
+void sd_emu_power_cycle(sd_emulator_t* emu);
+bool sd_emu_is_powered(const sd_emulator_t* emu);
+
+void sd_emu_print_stats(const sd_emulator_t* emu);
+
+#endif /* SD_EMULATOR_H */
@@ -0,0 +1,352 @@
+/*
+Runs the SD card driver and the log on Linux against an emulated card (sd_emulator.h).
+
+    sd_host create   <image> <size MB>
+    sd_host info     <image>
+    sd_host log      <image> <records>           append samples the way main.c does (mounts or formats)
+    sd_host mount    <image>                     recover the log and print what was found
+    sd_host powercut <image> <records> <block>   lose power while programming the block'th block, then recover
+    sd_host bench    <image> <records>           fresh log with and without pre-erase, one summary line each
+
+options (after the arguments):
+    --spi-khz N  --au-code N  --period-us N  --flush N  --no-preerase  --linear  --seed N
+    --read-us N  --program-us N  --erased-us N  --au-switch-us N  --stall-every N  --stall-us N
+    --erase-us N  --erase-au-us N  --stop-us N  --jitter-us N
+
+All times printed are emulated bus time, except the host CPU time per record which measures
+the driver (and the emulator) itself.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "my_SPI_host.h"
+#include "SD_card_SPI.h"
+#include "SD_log.h"
+
+// same layout as main.c
+#define HOST_SD_CS              GPIO_NUM_5
+#define HOST_LOG_START_BLOCK    8192
+
+typedef struct {
+    sd_emu_latency_t latency;
+    uint32_t spi_kHz;
+    uint32_t au_size_code;
+    uint32_t period_us;         // sample period of the emulated main loop
+    uint32_t flush_interval;    // records per SD_log_flush()
+    bool preerase;
+    SD_LOG_MODE mode;
+    uint64_t seed;
+} host_options_t;
+
+typedef struct {
+    uint32_t records;
+    uint32_t records_durable;   // records covered by the last successful flush
+    uint64_t elapsed_us;
+    uint64_t max_loop_us;       // longest append (+ flush) the sensor loop waited for
+    uint32_t overruns;          // loops that took longer than the sample period
+    uint64_t bus_bytes;         // bytes clocked over SPI
+    double cpu_ns_per_record;
+} host_run_t;
+
+static sd_emulator_t emulator_global;
+
+static void print_usage(void);
+static bool parse_options(int argc, char** argv, host_options_t* options);
+static bool card_power_up(const char* image, const host_options_t* options);
+static bool log_open(const host_options_t* options, bool format);
+static bool log_samples(const host_options_t* options, uint32_t first_record, uint32_t records, host_run_t* run);
+static bool verify_log(uint32_t* records_found);
+static void print_run(const char* name, const host_run_t* run);
+static double cpu_time_ns(void);
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        print_usage();
+        return 2;
+    }
+    const char* command = argv[1];
+    const char* image = argv[2];
+    host_options_t options;
+    if (!parse_options(argc, argv, &options)) {
+        print_usage();
+        return 2;
+    }
+
+    if (strcmp(command, "create") == 0 && argc >= 4) {
+        return sd_emu_create_image(image, (uint32_t)strtoul(argv[3], NULL, 0)) ? 0 : 1;
+    }
+    if (strcmp(command, "info") == 0) {
+        if (!card_power_up(image, &options)) return 1;
+        SD_print_card_info();
+        sd_emu_close(&emulator_global);
+        return 0;
+    }
+    if (strcmp(command, "mount") == 0) {
+        if (!card_power_up(image, &options) || !SD_log_mount(HOST_LOG_START_BLOCK)) return 1;
+        const SD_log_recovery_t* recovery = SD_log_get_recovery_info();
+        printf("Recovered %lu sectors (oldest %lu) with %lu block reads, torn sector discarded: %d\n",
+               (unsigned long)recovery->valid_sectors, (unsigned long)recovery->oldest_sequence,
+               (unsigned long)recovery->blocks_read, (int)recovery->torn_sector_discarded);
+        uint32_t records = 0;
+        bool valid = verify_log(&records);
+        printf("%lu records, %s\n", (unsigned long)records, valid ? "all consecutive" : "GAP OR CORRUPTION");
+        sd_emu_close(&emulator_global);
+        return valid ? 0 : 1;
+    }
+    if (strcmp(command, "log") == 0 && argc >= 4) {
+        host_run_t run;
+        uint32_t records = (uint32_t)strtoul(argv[3], NULL, 0);
+        if (!card_power_up(image, &options) || !log_open(&options, false)) return 1;
+        // continue the sample numbering of the records already on the card
+        uint32_t first_record = 0;
+        if (SD_log_get_next_sequence() != 0 && !verify_log(&first_record)) return 1;
+        SD_reset_timing_stats();
+        bool success = log_samples(&options, first_record, records, &run) && SD_log_close();
+        print_run("log", &run);
+        SD_print_timing_stats();
+        sd_emu_print_stats(&emulator_global);
+        sd_emu_close(&emulator_global);
+        return success ? 0 : 1;
+    }
+    if (strcmp(command, "powercut") == 0 && argc >= 5) {
+        host_run_t run;
+        uint32_t records = (uint32_t)strtoul(argv[3], NULL, 0);
+        uint32_t cut_block = (uint32_t)strtoul(argv[4], NULL, 0);
+        if (!card_power_up(image, &options) || !log_open(&options, true)) return 1;
+        sd_emu_power_cut_after(&emulator_global, cut_block);
+        log_samples(&options, 0, records, &run);
+        if (sd_emu_is_powered(&emulator_global)) {
+            printf("Power was not cut: only %lu blocks written\n", (unsigned long)emulator_global.stats.blocks_written);
+            return 1;
+        }
+        printf("Power cut after %lu records, %lu of them flushed\n",
+               (unsigned long)run.records, (unsigned long)run.records_durable);
+        sd_emu_close(&emulator_global);
+
+        // reboot: the card needs a full init, the log is recovered from what reached the image
+        if (!card_power_up(image, &options) || !SD_log_mount(HOST_LOG_START_BLOCK)) return 1;
+        const SD_log_recovery_t* recovery = SD_log_get_recovery_info();
+        uint32_t records_found = 0;
+        bool valid = verify_log(&records_found);
+        printf("Recovered %lu sectors with %lu block reads, torn sector discarded: %d, %lu records\n",
+               (unsigned long)recovery->valid_sectors, (unsigned long)recovery->blocks_read,
+               (int)recovery->torn_sector_discarded, (unsigned long)records_found);
+        // everything that was flushed must be back, and nothing past what was appended
+        bool passed = valid && records_found >= run.records_durable && records_found <= run.records;
+        printf("%s\n", passed ? "PASS" : "FAIL");
+        sd_emu_close(&emulator_global);
+        return passed ? 0 : 1;
+    }
+    if (strcmp(command, "bench") == 0 && argc >= 4) {
+        uint32_t records = (uint32_t)strtoul(argv[3], NULL, 0);
+        bool success = true;
+        for (int preerase = 0; preerase <= 1 && success; preerase++) {
+            host_run_t run;
+            host_options_t bench_options = options;
+            bench_options.preerase = preerase;
+            success = card_power_up(image, &bench_options) && log_open(&bench_options, true);
+            if (!success) break;
+            SD_reset_timing_stats();
+            success = log_samples(&bench_options, 0, records, &run) && SD_log_close();
+            print_run(preerase ? "pre-erase on " : "pre-erase off", &run);
+            SD_print_timing_stats();
+            sd_emu_close(&emulator_global);
+        }
+        return success ? 0 : 1;
+    }
+    print_usage();
+    return 2;
+}
+
+static void print_usage(void) {
+    printf("usage: sd_host create|info|log|mount|powercut|bench <image> [args] [options]\n"
+           "see the top of host/sd_host.c\n");
+}
+
+static bool parse_options(int argc, char** argv, host_options_t* options) {
+    sd_emu_default_latency(&options->latency);
+    options->spi_kHz = 4000;
+    options->au_size_code = 7; // 1 MB
+    options->period_us = 50000; // main.c runs at 20 Hz
+    options->flush_interval = 100;
+    options->preerase = true;
+    options->mode = SD_LOG_MODE_CIRCULAR;
+    options->seed = 1;
+
+    struct {
+        const char* name;
+        uint32_t* value;
+    } numeric[] = {
+        {"--spi-khz", &options->spi_kHz},
+        {"--au-code", &options->au_size_code},
+        {"--period-us", &options->period_us},
+        {"--flush", &options->flush_interval},
+        {"--read-us", &options->latency.read_latency_us},
+        {"--program-us", &options->latency.program_latency_us},
+        {"--erased-us", &options->latency.erased_program_latency_us},
+        {"--au-switch-us", &options->latency.au_switch_latency_us},
+        {"--stall-every", &options->latency.stall_interval_blocks},
+        {"--stall-us", &options->latency.stall_latency_us},
+        {"--erase-us", &options->latency.erase_latency_us},
+        {"--erase-au-us", &options->latency.erase_latency_per_au_us},
+        {"--stop-us", &options->latency.stop_latency_us},
+        {"--jitter-us", &options->latency.jitter_us},
+    };
+    for (int i = 3; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) continue; // positional
+        if (strcmp(argv[i], "--no-preerase") == 0) {
+            options->preerase = false;
+            continue;
+        }
+        if (strcmp(argv[i], "--linear") == 0) {
+            options->mode = SD_LOG_MODE_LINEAR;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            printf("%s needs a value\n", argv[i]);
+            return false;
+        }
+        if (strcmp(argv[i], "--seed") == 0) {
+            options->seed = strtoull(argv[++i], NULL, 0);
+            continue;
+        }
+        bool known = false;
+        for (size_t j = 0; j < sizeof(numeric) / sizeof(numeric[0]); j++) {
+            if (strcmp(argv[i], numeric[j].name) == 0) {
+                *numeric[j].value = (uint32_t)strtoul(argv[++i], NULL, 0);
+                known = true;
+                break;
+            }
+        }
+        if (!known) {
+            printf("Unknown option %s\n", argv[i]);
+            return false;
+        }
+    }
+    if (options->flush_interval == 0 || options->spi_kHz == 0 || options->seed == 0) {
+        printf("--flush, --spi-khz and --seed must be non zero\n");
+        return false;
+    }
+    return true;
+}
+
+// opens the image as a freshly powered card and runs the driver's init sequence on it
+static bool card_power_up(const char* image, const host_options_t* options) {
+    if (!sd_emu_open(&emulator_global, image, &options->latency, options->au_size_code)) return false;
+    emulator_global.random_state = options->seed;
+    SPI_host_set_max_frequency_Hz(options->spi_kHz * 1000);
+    SPI_host_attach_sd_emulator(HOST_SD_CS, &emulator_global);
+    if (!SD_card_init(HOST_SD_CS)) {
+        printf("Could not init the emulated SD card\n");
+        sd_emu_close(&emulator_global);
+        return false;
+    }
+    return true;
+}
+
+static bool log_open(const host_options_t* options, bool format) {
+    if (!format && SD_log_mount(HOST_LOG_START_BLOCK)) return true;
+    if (!SD_log_format(HOST_LOG_START_BLOCK, SD_get_card_info()->capacity_blocks, options->mode)) {
+        printf("Could not format the log\n");
+        return false;
+    }
+    return true;
+}
+
+/*
+the main.c loop without the sensors: one MPU6050 sized record per sample period, a flush every
+flush_interval records and the rest of the period handed to SD_log_idle().
+Sample n holds n in its first float so verify_log() can check the records come back in order
+*/
+static bool log_samples(const host_options_t* options, uint32_t first_record, uint32_t records, host_run_t* run) {
+    memset(run, 0, sizeof(*run));
+    uint64_t start_us = esp_rtc_get_time_us();
+    uint64_t start_bus_bytes = SPI_host_get_bytes_transferred();
+    double start_cpu_ns = cpu_time_ns();
+    double idle_cpu_ns = 0;
+    bool success = true;
+    for (uint32_t i = 0; i < records; i++) {
+        uint64_t loop_start_us = esp_rtc_get_time_us();
+        uint32_t n = first_record + i;
+        float sample[7] = {(float)n, 0.01f * (n % 100), 1.0f, 0.5f, -0.5f, 0.25f, 25.0f};
+        if (!SD_log_append(SD_LOG_RECORD_MPU6050_SAMPLE, sample, sizeof(sample))) {
+            success = false;
+            break;
+        }
+        run->records++;
+        if (run->records % options->flush_interval == 0) {
+            if (!SD_log_flush()) {
+                success = false;
+                break;
+            }
+            run->records_durable = run->records;
+        }
+        uint64_t busy_us = esp_rtc_get_time_us() - loop_start_us;
+        if (busy_us > run->max_loop_us) run->max_loop_us = busy_us;
+        if (busy_us > options->period_us) run->overruns++;
+
+        int64_t idle_us = (int64_t)options->period_us - (int64_t)busy_us;
+        if (options->preerase && idle_us > 0) {
+            uint64_t idle_start_us = esp_rtc_get_time_us();
+            double idle_start_cpu_ns = cpu_time_ns();
+            SD_log_idle((uint32_t)idle_us);
+            idle_cpu_ns += cpu_time_ns() - idle_start_cpu_ns;
+            idle_us -= esp_rtc_get_time_us() - idle_start_us;
+        }
+        if (idle_us > 0) SPI_host_advance_time_us(idle_us);
+    }
+    run->elapsed_us = esp_rtc_get_time_us() - start_us;
+    run->bus_bytes = SPI_host_get_bytes_transferred() - start_bus_bytes;
+    if (run->records) run->cpu_ns_per_record = (cpu_time_ns() - start_cpu_ns - idle_cpu_ns) / run->records;
+    return success;
+}
+
+// walks every retained record and checks the sample numbers are consecutive
+static bool verify_log(uint32_t* records_found) {
+    static byte sector[SD_BLOCK_SIZE];
+    bool first = true;
+    uint32_t expected = 0;
+    *records_found = 0;
+    for (uint32_t seq = SD_log_get_oldest_sequence(); seq < SD_log_get_next_sequence(); seq++) {
+        if (!SD_log_read_sector(seq, sector)) {
+            printf("Sector %lu is missing\n", (unsigned long)seq);
+            return false;
+        }
+        uint16_t offset = 0;
+        SD_log_record_header_t header;
+        const byte* data;
+        while (SD_log_next_record(sector, &offset, &header, &data)) {
+            if (header.type != SD_LOG_RECORD_MPU6050_SAMPLE) continue;
+            float sample[7];
+            memcpy(sample, data, sizeof(sample));
+            uint32_t n = (uint32_t)sample[0];
+            // a wrapped circular log starts part way through the samples
+            if (!first && n != expected) {
+                printf("Sector %lu: expected sample %lu, found %lu\n",
+                       (unsigned long)seq, (unsigned long)expected, (unsigned long)n);
+                return false;
+            }
+            first = false;
+            expected = n + 1;
+        }
+    }
+    *records_found = expected;
+    return true;
+}
+
+static void print_run(const char* name, const host_run_t* run) {
+    double seconds = run->elapsed_us / 1e6;
+    double payload_bytes = (double)run->records * (7 * sizeof(float) + sizeof(SD_log_record_header_t));
+    printf("%s: %lu records in %.2f s emulated, longest loop %llu us, %lu overruns, "
+           "%.1f KB/s payload, %.2f bus bytes per payload byte, %.0f ns host CPU per record\n",
+           name, (unsigned long)run->records, seconds, (unsigned long long)run->max_loop_us,
+           (unsigned long)run->overruns, seconds > 0 ? payload_bytes / 1024 / seconds : 0.0,
+           payload_bytes > 0 ? run->bus_bytes / payload_bytes : 0.0,
+           run->cpu_ns_per_record);
+}
+
+static double cpu_time_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
@@ -0,0 +1,129 @@
+/*
+Host check of the vibration velocity stage (main/velocity.c).
+
+    velocity_bench [sample rate Hz]
+
+Feeds sines of a known velocity (10 mm/s RMS on x, 4.5 on y, 1.8 on z, on top of gravity
+on z and noise) at frequencies across the band through the stage at +-8 g and compares
+the window RMS with what the filters should pass: the velocity times the magnitude of the
+Butterworth high-pass and low-pass, the integrator and its leak at that frequency. Within
+the band that must hold to VELOCITY_BENCH_TOLERANCE; the noise floor (noise only) and
+the time per sample are printed too. Exits with 1 on any error.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "velocity.h"
+
+#define BENCH_DEFAULT_RATE_HZ 1000
+#define BENCH_SECONDS 12
+#define BENCH_G_PER_LSB (1.0 / 4096)    // +-8 g
+#define BENCH_GRAVITY_COUNTS 4096
+#define BENCH_NOISE_COUNTS 16           // about 4 mg peak
+#define VELOCITY_BENCH_TOLERANCE 0.03   // relative, plus the noise floor
+#define BENCH_PI 3.14159265358979
+
+static const velocity_config_t bench_config = {.low_hz = 10, .high_hz = 1000, .window_ms = 1000};
+static const double bench_frequencies_hz[] = {5, 8, 10, 12, 16, 25, 40, 80, 120, 160, 250, 320, 400, 450};
+static const double bench_rms_mm_s[VELOCITY_AXES] = {10.0, 4.5, 1.8};
+
+static velocity_t velocity;
+
+static double now_s(void);
+static double expected_gain(double frequency_hz, double high_hz, double rate_hz);
+static bool run(uint16_t rate_hz, double frequency_hz, double* rms, double* ns_per_sample);
+
+int main(int argc, char** argv) {
+    uint16_t rate_hz = argc > 1 ? (uint16_t)atoi(argv[1]) : BENCH_DEFAULT_RATE_HZ;
+    double high_hz = bench_config.high_hz < 0.45 * rate_hz ? bench_config.high_hz : 0.45 * rate_hz;
+    double floor[VELOCITY_AXES], ns;
+    if (!run(rate_hz, 0, floor, &ns)) return 1;
+    printf("%u Hz, band %u to %.0f Hz, noise floor %.3f %.3f %.3f mm/s, %.1f ns per sample\n", (unsigned)rate_hz,
+           (unsigned)bench_config.low_hz, high_hz, floor[0], floor[1], floor[2], ns);
+    printf("    Hz   gain   x mm/s (want)      y mm/s (want)      z mm/s (want)\n");
+    bool passed = true;
+    for (size_t f = 0; f < sizeof(bench_frequencies_hz) / sizeof(bench_frequencies_hz[0]); f++) {
+        double frequency_hz = bench_frequencies_hz[f];
+        if (frequency_hz >= rate_hz / 2.0) continue;
+        double rms[VELOCITY_AXES];
+        if (!run(rate_hz, frequency_hz, rms, &ns)) return 1;
+        double gain = expected_gain(frequency_hz, high_hz, rate_hz);
+        bool in_band = frequency_hz >= bench_config.low_hz && frequency_hz <= high_hz;
+        printf("%6.0f  %5.3f", frequency_hz, gain);
+        for (int axis = 0; axis < VELOCITY_AXES; axis++) {
+            double want = bench_rms_mm_s[axis] * gain;
+            // the noise adds in quadrature; 0.01 mm/s steps in the record
+            double allowed = VELOCITY_BENCH_TOLERANCE * want + floor[axis] + 0.01;
+            bool ok = fabs(rms[axis] - sqrt(want * want + floor[axis] * floor[axis])) <= allowed;
+            if (in_band && !ok) passed = false;
+            printf("   %7.3f (%7.3f)%s", rms[axis], want, ok ? " " : in_band ? "!" : "~");
+        }
+        printf("\n");
+    }
+    printf("%s\n", passed ? "PASSED" : "FAILED");
+    return passed ? 0 : 1;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+the analog prototypes: 2nd order Butterworth high-pass and low-pass, the leak a 1st order
+high-pass on the velocity; the integrator against a true integral
+*/
+static double expected_gain(double frequency_hz, double high_hz, double rate_hz) {
+    // the bilinear transform maps frequencies through tan
+    double w = tan(BENCH_PI * frequency_hz / rate_hz);
+    double low = tan(BENCH_PI * bench_config.low_hz / rate_hz), high = tan(BENCH_PI * high_hz / rate_hz);
+    double high_pass = 1.0 / sqrt(1.0 + pow(low / w, 4)), low_pass = 1.0 / sqrt(1.0 + pow(w / high, 4));
+    double leak = 1.0 / sqrt(1.0 + pow(tan(BENCH_PI * bench_config.low_hz / 4.0 / rate_hz) / w, 2));
+    double phase = 2 * BENCH_PI * frequency_hz / rate_hz;
+    double real = 1 + cos(phase) / 7, imaginary = -sin(phase) / 7;
+    // (7/8) |1 + z^-1 / 7| / |1 - z^-1| = (7/8) |..| / (2 sin(phase / 2)), against 1 / phase
+    double integrator = 7.0 / 8 * sqrt(real * real + imaginary * imaginary) / (2 * sin(phase / 2)) * phase;
+    return high_pass * low_pass * leak * integrator;
+}
+
+/*
+the last window of BENCH_SECONDS of a sine at frequency_hz (0: noise only) per axis, in
+mm/s, and the time per sample over all of it
+*/
+static bool run(uint16_t rate_hz, double frequency_hz, double* rms, double* ns_per_sample) {
+    mpu6050_session_t session = {.sample_rate_hz = rate_hz, .accel_g_per_LSB = (float)BENCH_G_PER_LSB};
+    if (!velocity_init(&velocity, &bench_config, &session)) return false;
+    size_t count = (size_t)BENCH_SECONDS * rate_hz;
+    mpu6050_raw_frame* frames = malloc(count * sizeof(mpu6050_raw_frame));
+    if (!frames) {
+        printf("could not allocate the samples\n");
+        exit(1);
+    }
+    srand(1);
+    for (size_t i = 0; i < count; i++) {
+        int16_t values[7] = {0};
+        for (int axis = 0; axis < VELOCITY_AXES; axis++) {
+            // a velocity of v RMS at f is an acceleration of v sqrt(2) 2 pi f peak
+            double peak_g = frequency_hz > 0 ? bench_rms_mm_s[axis] * sqrt(2.0) * 2 * BENCH_PI * frequency_hz / 9806.65 : 0;
+            double counts = peak_g / BENCH_G_PER_LSB * sin(2 * BENCH_PI * frequency_hz * i / rate_hz + axis);
+            counts += (axis == 2 ? BENCH_GRAVITY_COUNTS : 0) + rand() % (2 * BENCH_NOISE_COUNTS + 1) - BENCH_NOISE_COUNTS;
+            values[axis] = (int16_t)lround(counts);
+        }
+        memcpy(&frames[i], values, sizeof(values));
+    }
+    double start = now_s();
+    bool window = false;
+    for (size_t i = 0; i < count; i++) window = velocity_add(&velocity, &frames[i], (uint32_t)i) || window;
+    *ns_per_sample = (now_s() - start) * 1e9 / count;
+    free(frames);
+    if (!window) {
+        printf("no window completed\n");
+        return false;
+    }
+    const velocity_record_t* record = velocity_get_record(&velocity);
+    for (int axis = 0; axis < VELOCITY_AXES; axis++) rms[axis] = record->rms[axis] / 100.0;
+    return true;
+}
@@ -48,6 +48,18 @@ static void build_sd_command(byte cmd, const byte *args, byte *out_cmd);
 static void print_response(const byte* response, size_t length);
 static void print_r1_response_flags(byte r1);
 static bool verify_voltage_and_version(gpio_num_t SD_card_chip_select);
+static byte SD_command_hold_cs(byte cmd, uint32_t arg);
+static bool SD_wait_ready(uint32_t timeout_us);
+static bool SD_read_data_packet(byte* data, size_t length);
+static bool SD_read_register(byte cmd, bool app_cmd, byte* data, size_t length);
+static bool SD_read_card_registers(void);
+static uint32_t get_register_bits(const byte* reg, size_t reg_bytes, unsigned msb, unsigned lsb);
+static inline uint32_t SD_block_address(uint32_t block_num);
+static bool SD_wait_write_busy(void);
+static bool SD_erase_start(uint32_t first_block, uint32_t last_block);
+static bool SD_erase_check_done(void);
+static bool SD_finish_background_erase(void);
+static void record_latency(uint32_t* histogram, uint32_t latency_us);
 
 typedef enum {
     BYTE_ADDRESSING,
@@ -57,6 +69,38 @@ typedef enum {
 
 static ADDRESSING_MODE addressing_mode_global = UNKNOWN_ADDRESSING;
 static gpio_num_t SD_CS_global = GPIO_NUM_NC; // chip select for SD card
+static SD_card_info_t card_info_global;
+
+// data tokens and data response
+#define SD_START_BLOCK_TOKEN        0xFE // CMD17/18/24 and register reads
+#define SD_START_MULTI_WRITE_TOKEN  0xFC // CMD25
+#define SD_STOP_MULTI_WRITE_TOKEN   0xFD
+#define SD_DATA_RESPONSE_MASK       0x1F
+#define SD_DATA_ACCEPTED            0x05
+
+// the SD spec allows up to 250 ms of busy after a block write (SDHC)
+#define SD_WRITE_TIMEOUT_US         250000
+#define SD_READ_TIMEOUT_US          100000
+// erases can take seconds (see ERASE_TIMEOUT in the SD Status)
+#define SD_ERASE_TIMEOUT_US         10000000
+// the first background erase is only attempted with at least this much idle time
+#define SD_PREERASE_PROBE_BUDGET_US 20000
+// ACMD23 pre-erase count: 23 bits
+#define SD_ACMD23_MAX_BLOCKS        0x7FFFFF
+// longest the poll busy-waits for its erase; the caller gets the CPU back, the card keeps erasing
+#define SD_PREERASE_MAX_WAIT_US     5000
+
+static SD_erase_stats_t erase_stats_global;
+static SD_write_stats_t write_stats_global;
+
+// background pre-erase state
+static uint32_t preerase_region_start_global = 0;
+static uint32_t preerase_region_end_global = 0;
+static uint32_t preerase_lookahead_global = 0;
+static uint32_t preerase_write_pointer_global = 0;
+static uint32_t erased_until_global = 0;    // [write pointer, erased_until_global) is erased
+static bool erase_in_progress_global = false;
+static uint64_t erase_start_us_global = 0;
 
 /*
 initialize the SPI mode of the SD card
@@ -113,27 +157,39 @@ bool SD_card_init(gpio_num_t SD_card_chip_select) {
     SPI_set_mosi(1);
 
     // determine if SDSC (byte addressing) or SDXC by reading OCR
+    // response is R1 followed by the 32 bit OCR. Bit 30 of the OCR (CCS) is set for SDHC/SDXC
     byte* response_arr = SD_send_command_r3(58, NULL, true);
     if (response_arr == NULL) {
         printf("SD card did not respond\n");
         return false;
     }
-    if (response_arr[0] == 0) {
-        // SDSC
-        printf("SDSC with byte addressing\n");
-        addressing_mode_global = BYTE_ADDRESSING;
-    } else if (response_arr[0] == 0x40) {
+    if (response_arr[0] != 0) {
+        free(response_arr);
+        printf("Error with CMD58 command\n");
+        return false;
+    }
+    if (response_arr[1] & 0x40) {
         // SDXC/SDHC
-        printf("SDSC / SDHC with block addressing\n");
+        printf("SDXC / SDHC with block addressing\n");
         addressing_mode_global = BLOCK_ADDRESSING;
     } else {
-        free(response_arr);
-        printf("Error with CRC58 command\n");
-        return false;
+        // SDSC
+        printf("SDSC with byte addressing\n");
+        addressing_mode_global = BYTE_ADDRESSING;
     }
     free(response_arr);
     SD_CS_global = SD_card_chip_select;
     SPI_cs_high(SD_CS_global);
+
+    if (!SD_read_card_registers()) {
+        printf("Could not read card registers\n");
+        return false;
+    }
+    // never clock faster than the card reports it can handle
+    if (card_info_global.tran_speed_kbps != 0 &&
+        card_info_global.tran_speed_kbps * 1000 < SPI_get_max_frequency()) {
+        SPI_set_frequency((uint16_t)card_info_global.tran_speed_kbps);
+    }
     return true;
 }
 
@@ -185,24 +241,24 @@ static byte SD_send_command_r1(byte cmd, const byte *args, bool done) {
     return 0xFF; // timeout
 }
 
-// reads 4 bytes (32 bits) of the response. Caller must free returned array
+// reads 5 bytes (R1 + 32 bit OCR) of the response. Caller must free returned array
 static byte* SD_send_command_r3(byte cmd, const byte *args, bool done) {
     SPI_set_mosi(1);
-    byte tx[6 + 8 + 4];   // command + up to 8 dummy + read 4 bytes = 18
-    byte rx[6 + 8 + 4];   // readback buffer
+    byte tx[6 + 8 + 5];   // command + up to 8 dummy + read 5 bytes = 19
+    byte rx[6 + 8 + 5];   // readback buffer
 
     build_sd_command(cmd, args, tx);
 
     // Fill trailing dummy bytes to poll response
-    for (int i = 6; i < 18; i++) tx[i] = 0xFF;
+    for (int i = 6; i < 19; i++) tx[i] = 0xFF;
 
     // Perform one contiguous transfer with CS active
     SPI_cs_low(SD_CS_global);
     SPI_transfer_block(tx, rx, sizeof(tx), MODE_0);
     if (done) { SPI_cs_high(SD_CS_global); }
     int start = 0;
-    // Skip first 6 (echo of command), look at the next 8 + 4 for response start
-    for (int i = 6; i < 18; i++) {
+    // Skip first 6 (echo of command), look at the next 8 + 5 for response start
+    for (int i = 6; i < 14; i++) {
         if (rx[i] != 0xFF) {
             start = i;
             break;
@@ -212,12 +268,12 @@ static byte* SD_send_command_r3(byte cmd, const byte *args, bool done) {
         // all 0xFF
         return NULL;
     }
-    byte* response = malloc(4);
+    byte* response = malloc(5);
     if (!response) {
         printf("Malloc call failed\n");
         return NULL;
     }
-    for (int i = 0; i < 4; i++) {
+    for (int i = 0; i < 5; i++) {
         response[i] = rx[start + i];
     }
     return response;
@@ -313,6 +369,7 @@ static bool verify_voltage_and_version(gpio_num_t SD_card_chip_select) {
 
 // reads a block of size 512 bytes
 bool SD_read_block(uint32_t block_num, byte* block_data) {
+    if (!SD_finish_background_erase()) return false;
     uint32_t addr = (addressing_mode_global == BLOCK_ADDRESSING)
                     ? block_num
                     : block_num * 512;
@@ -367,6 +424,490 @@ bool SD_read_block(uint32_t block_num, byte* block_data) {
     return true;
 }
 
+static inline uint32_t SD_block_address(uint32_t block_num) {
+    return (addressing_mode_global == BLOCK_ADDRESSING) ? block_num : block_num * SD_BLOCK_SIZE;
+}
+
+/*
+Sends a command and polls for the R1 response WITHOUT releasing chip select,
+so the caller can continue with the data phase. Returns 0xFF on timeout.
+*/
+static byte SD_command_hold_cs(byte cmd, uint32_t arg) {
+    byte args[4] = {
+        (arg >> 24) & 0xFF,
+        (arg >> 16) & 0xFF,
+        (arg >> 8) & 0xFF,
+        arg & 0xFF
+    };
+    byte tx[6];
+    build_sd_command(cmd, args, tx);
+
+    SPI_set_mosi(1);
+    SPI_cs_low(SD_CS_global);
+    SPI_transmit_to_slave(tx, sizeof(tx), MODE_0);
+
+    byte r1 = 0xFF;
+    for (int attempts = 0; attempts < 8; attempts++) {
+        r1 = SPI_transfer_byte(0xFF, MODE_0);
+        if (!(r1 & 0x80)) break; // MSB of R1 is always 0
+    }
+    return r1;
+}
+
+// the card holds MISO low while it is busy programming/erasing. CS must already be low
+static bool SD_wait_ready(uint32_t timeout_us) {
+    uint64_t start = esp_rtc_get_time_us();
+    while (SPI_transfer_byte(0xFF, MODE_0) != 0xFF) {
+        if (esp_rtc_get_time_us() - start > timeout_us) {
+            printf("Timeout waiting for SD card busy\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+// waits for the start block token then reads length bytes and the (ignored) 16 bit CRC
+static bool SD_read_data_packet(byte* data, size_t length) {
+    uint64_t start = esp_rtc_get_time_us();
+    byte token;
+    do {
+        token = SPI_transfer_byte(0xFF, MODE_0);
+        if (esp_rtc_get_time_us() - start > SD_READ_TIMEOUT_US) {
+            printf("Timeout waiting for data token\n");
+            return false;
+        }
+    } while (token == 0xFF);
+    if (token != SD_START_BLOCK_TOKEN) {
+        printf("Bad data token: %x\n", token);
+        return false;
+    }
+    SPI_receive_from_slave(data, length, MODE_0);
+    SPI_transfer_byte(0xFF, MODE_0);
+    SPI_transfer_byte(0xFF, MODE_0);
+    return true;
+}
+
+// reads a register that is returned as a data packet (CSD, CID, SD Status)
+static bool SD_read_register(byte cmd, bool app_cmd, byte* data, size_t length) {
+    if (app_cmd) {
+        byte r1 = SD_send_command_r1(55, NULL, true);
+        if (r1 > 0x01) {
+            printf("CMD55 failed with response %x!\n", r1);
+            return false;
+        }
+    }
+    byte r1 = SD_command_hold_cs(cmd, 0);
+    if (app_cmd && r1 == 0) {
+        // ACMD13 responds with R2 -- discard the second status byte
+        r1 = SPI_transfer_byte(0xFF, MODE_0);
+    }
+    if (r1 != 0) {
+        SPI_cs_high(SD_CS_global);
+        printf("CMD%d failed with response %x\n", cmd, r1);
+        return false;
+    }
+    bool success = SD_read_data_packet(data, length);
+    SPI_cs_high(SD_CS_global);
+    SPI_transfer_byte(0xFF, MODE_0); // 8 extra clocks to let the card finish
+    return success;
+}
+
+/*
+Extracts bits [msb:lsb] from a big endian register (byte 0 holds the most significant bits),
+using the bit numbering of the SD specification.
+*/
+static uint32_t get_register_bits(const byte* reg, size_t reg_bytes, unsigned msb, unsigned lsb) {
+    uint32_t value = 0;
+    for (int bit = (int)msb; bit >= (int)lsb; bit--) {
+        byte b = reg[reg_bytes - 1 - (bit / 8)];
+        value = (value << 1) | ((b >> (bit % 8)) & 0x1);
+    }
+    return value;
+}
+
+static bool SD_read_card_registers(void) {
+    byte csd[16], cid[16], status[64];
+    SD_card_info_t* info = &card_info_global;
+    memset(info, 0, sizeof(*info));
+
+    if (!SD_read_register(9, false, csd, sizeof(csd))) return false;
+    if (!SD_read_register(10, false, cid, sizeof(cid))) return false;
+
+    // CSD -- layout depends on CSD_STRUCTURE
+    info->csd_version = get_register_bits(csd, 16, 127, 126) + 1;
+    if (info->csd_version == 1) {
+        uint32_t read_bl_len = get_register_bits(csd, 16, 83, 80);
+        uint32_t c_size = get_register_bits(csd, 16, 73, 62);
+        uint32_t c_size_mult = get_register_bits(csd, 16, 49, 47);
+        uint64_t bytes = (uint64_t)(c_size + 1) << (c_size_mult + 2 + read_bl_len);
+        info->capacity_blocks = (uint32_t)(bytes / SD_BLOCK_SIZE);
+    } else {
+        // capacity = (C_SIZE + 1) * 512 KB
+        uint32_t c_size = get_register_bits(csd, 16, 69, 48);
+        info->capacity_blocks = (c_size + 1) * 1024;
+    }
+    // TRAN_SPEED: time value (x10) * rate unit (100 kbit/s, 1, 10, 100 Mbit/s)
+    static const uint16_t time_value_x10[16] = {0, 10, 12, 13, 15, 20, 25, 30, 35, 40, 45, 50, 55, 60, 70, 80};
+    static const uint16_t rate_unit_kbps_div10[4] = {10, 100, 1000, 10000};
+    uint32_t tran_speed = get_register_bits(csd, 16, 103, 96);
+    if ((tran_speed & 0x7) < 4) {
+        info->tran_speed_kbps = time_value_x10[(tran_speed >> 3) & 0xF] * rate_unit_kbps_div10[tran_speed & 0x7];
+    }
+    info->r2w_factor = get_register_bits(csd, 16, 28, 26);
+    info->write_block_length = 1U << get_register_bits(csd, 16, 25, 22);
+    info->write_block_partial = get_register_bits(csd, 16, 21, 21);
+    info->erase_sector_blocks = get_register_bits(csd, 16, 45, 39) + 1;
+
+    // CID
+    info->manufacturer_id = get_register_bits(cid, 16, 127, 120);
+    info->oem_id[0] = cid[1];
+    info->oem_id[1] = cid[2];
+    info->oem_id[2] = '\0';
+    memcpy(info->product_name, &cid[3], 5);
+    info->product_name[5] = '\0';
+    info->product_revision = get_register_bits(cid, 16, 63, 56);
+    info->serial_number = get_register_bits(cid, 16, 55, 24);
+    info->manufacture_year = 2000 + get_register_bits(cid, 16, 19, 12);
+    info->manufacture_month = get_register_bits(cid, 16, 11, 8);
+
+    // SD Status (ACMD13). Some older cards do not support it, so it is not fatal
+    if (SD_read_register(13, true, status, sizeof(status))) {
+        static const byte speed_classes[5] = {0, 2, 4, 6, 10};
+        uint32_t speed_class = get_register_bits(status, 64, 447, 440);
+        info->speed_class = (speed_class < 5) ? speed_classes[speed_class] : 0;
+
+        // AU_SIZE: 1 = 16 KB doubling up to 9 = 4 MB, then 8/12/16/24/32/64 MB
+        static const uint16_t large_au_MB[6] = {8, 12, 16, 24, 32, 64};
+        uint32_t au_size = get_register_bits(status, 64, 431, 428);
+        if (au_size >= 1 && au_size <= 9) {
+            info->au_size_blocks = (16 * 1024 / SD_BLOCK_SIZE) << (au_size - 1);
+        } else if (au_size > 9) {
+            info->au_size_blocks = (uint32_t)large_au_MB[au_size - 10] * (1024 * 1024 / SD_BLOCK_SIZE);
+        }
+        info->erase_size_au = get_register_bits(status, 64, 423, 408);
+        info->erase_timeout_s = get_register_bits(status, 64, 407, 402);
+        info->erase_offset_s = get_register_bits(status, 64, 401, 400);
+    }
+    // fall back to the erase sector size when the card does not report an AU
+    if (info->au_size_blocks == 0) {
+        info->au_size_blocks = info->erase_sector_blocks;
+    }
+    return true;
+}
+
+const SD_card_info_t* SD_get_card_info(void) {
+    return &card_info_global;
+}
+
+void SD_print_card_info(void) {
+    const SD_card_info_t* info = &card_info_global;
+    printf("SD card: MID %02x OEM %s product %s rev %d.%d SN %08lx (%02d/%d)\n",
+           info->manufacturer_id, info->oem_id, info->product_name,
+           info->product_revision >> 4, info->product_revision & 0xF,
+           (unsigned long)info->serial_number, info->manufacture_month, info->manufacture_year);
+    printf("CSD v%d, %lu blocks (%lu MB), TRAN_SPEED %lu kbit/s, write block %d bytes (partial %d), R2W x%d\n",
+           info->csd_version, (unsigned long)info->capacity_blocks,
+           (unsigned long)(info->capacity_blocks / 2048), (unsigned long)info->tran_speed_kbps,
+           info->write_block_length, (int)info->write_block_partial, 1 << info->r2w_factor);
+    printf("Speed class %d, AU %lu blocks (%lu KB), erase %d AU per %d s + %d s\n",
+           info->speed_class, (unsigned long)info->au_size_blocks,
+           (unsigned long)(info->au_size_blocks / 2), info->erase_size_au,
+           info->erase_timeout_s, info->erase_offset_s);
+}
+
+uint32_t SD_blocks_to_au_boundary(uint32_t block_num) {
+    uint32_t au = card_info_global.au_size_blocks;
+    if (au == 0) return 1;
+    return au - (block_num % au);
+}
+
+// writes a single block of 512 bytes (CMD24)
+bool SD_write_block(uint32_t block_num, const byte* block_data) {
+    if (!block_data) {
+        printf("passed NULL pointer to SD_write_block\n");
+        return false;
+    }
+    if (!SD_finish_background_erase()) return false;
+    byte r1 = SD_command_hold_cs(24, SD_block_address(block_num));
+    if (r1 != 0) {
+        SPI_cs_high(SD_CS_global);
+        printf("CMD24 failed with response %x\n", r1);
+        return false;
+    }
+    SPI_transfer_byte(0xFF, MODE_0); // at least one byte gap before the token
+    SPI_transfer_byte(SD_START_BLOCK_TOKEN, MODE_0);
+    SPI_transmit_to_slave(block_data, SD_BLOCK_SIZE, MODE_0);
+    // CRC is ignored in SPI mode
+    SPI_transfer_byte(0xFF, MODE_0);
+    SPI_transfer_byte(0xFF, MODE_0);
+
+    byte data_response = SPI_transfer_byte(0xFF, MODE_0);
+    if ((data_response & SD_DATA_RESPONSE_MASK) != SD_DATA_ACCEPTED) {
+        SPI_cs_high(SD_CS_global);
+        printf("Write of block %lu rejected: %x\n", (unsigned long)block_num, data_response);
+        return false;
+    }
+    bool success = SD_wait_write_busy();
+    SPI_cs_high(SD_CS_global);
+    return success;
+}
+
+/*
+writes number_of_blocks consecutive blocks with one CMD25.
+ACMD23 tells the card how many blocks are coming so it can pre-erase them
+*/
+bool SD_write_blocks(uint32_t start_block, const byte* data, uint32_t number_of_blocks) {
+    if (!data) {
+        printf("passed NULL pointer to SD_write_blocks\n");
+        return false;
+    }
+    if (number_of_blocks == 0) return true;
+    if (number_of_blocks == 1) return SD_write_block(start_block, data);
+    if (!SD_finish_background_erase()) return false;
+
+    // the count is bits 22:0 of the argument: a longer write just goes without the hint
+    if (number_of_blocks <= SD_ACMD23_MAX_BLOCKS && SD_send_command_r1(55, NULL, true) <= 0x01) {
+        byte args[4] = {
+            0,
+            (number_of_blocks >> 16) & 0x7F,
+            (number_of_blocks >> 8) & 0xFF,
+            number_of_blocks & 0xFF
+        };
+        SD_send_command_r1(23, args, true); // a hint only, failure is harmless
+    }
+
+    byte r1 = SD_command_hold_cs(25, SD_block_address(start_block));
+    if (r1 != 0) {
+        SPI_cs_high(SD_CS_global);
+        printf("CMD25 failed with response %x\n", r1);
+        return false;
+    }
+    bool success = true;
+    for (uint32_t i = 0; i < number_of_blocks; i++) {
+        SPI_transfer_byte(0xFF, MODE_0);
+        SPI_transfer_byte(SD_START_MULTI_WRITE_TOKEN, MODE_0);
+        SPI_transmit_to_slave(&data[i * SD_BLOCK_SIZE], SD_BLOCK_SIZE, MODE_0);
+        SPI_transfer_byte(0xFF, MODE_0);
+        SPI_transfer_byte(0xFF, MODE_0);
+
+        byte data_response = SPI_transfer_byte(0xFF, MODE_0);
+        if ((data_response & SD_DATA_RESPONSE_MASK) != SD_DATA_ACCEPTED) {
+            printf("Write of block %lu rejected: %x\n", (unsigned long)(start_block + i), data_response);
+            success = false;
+            break;
+        }
+        if (!SD_wait_write_busy()) {
+            success = false;
+            break;
+        }
+    }
+    // the stop token is required even after an error to leave the receive-data state
+    SPI_transfer_byte(SD_STOP_MULTI_WRITE_TOKEN, MODE_0);
+    SPI_transfer_byte(0xFF, MODE_0);
+    if (!SD_wait_ready(SD_WRITE_TIMEOUT_US)) success = false;
+    SPI_cs_high(SD_CS_global);
+    return success;
+}
+
+// waits out the programming busy time after a data block and records it
+static bool SD_wait_write_busy(void) {
+    uint64_t start = esp_rtc_get_time_us();
+    bool success = SD_wait_ready(SD_WRITE_TIMEOUT_US);
+    uint32_t busy_us = (uint32_t)(esp_rtc_get_time_us() - start);
+    write_stats_global.blocks_written++;
+    if (busy_us > write_stats_global.max_busy_us) write_stats_global.max_busy_us = busy_us;
+    record_latency(write_stats_global.busy_histogram, busy_us);
+    return success;
+}
+
+static void record_latency(uint32_t* histogram, uint32_t latency_us) {
+    int bucket = 0;
+    while (latency_us > 1 && bucket < SD_LATENCY_BUCKETS - 1) {
+        latency_us >>= 1;
+        bucket++;
+    }
+    histogram[bucket]++;
+}
+
+// issues CMD32/33/38 and returns as soon as the card accepted the erase, while it is still busy
+static bool SD_erase_start(uint32_t first_block, uint32_t last_block) {
+    byte r1 = SD_command_hold_cs(32, SD_block_address(first_block));
+    SPI_cs_high(SD_CS_global);
+    if (r1 != 0) {
+        printf("CMD32 failed with response %x\n", r1);
+        return false;
+    }
+    r1 = SD_command_hold_cs(33, SD_block_address(last_block));
+    SPI_cs_high(SD_CS_global);
+    if (r1 != 0) {
+        printf("CMD33 failed with response %x\n", r1);
+        return false;
+    }
+    r1 = SD_command_hold_cs(38, 0);
+    // R1b: the card signals busy on MISO until the erase is done, even with CS released
+    SPI_cs_high(SD_CS_global);
+    if (r1 != 0) {
+        printf("CMD38 failed with response %x\n", r1);
+        return false;
+    }
+    erase_in_progress_global = true;
+    erase_start_us_global = esp_rtc_get_time_us();
+    erase_stats_global.erases_issued++;
+    erase_stats_global.blocks_erased += last_block - first_block + 1;
+    return true;
+}
+
+// one byte probe of the busy signal. Returns true (and records the timing) once the erase is done
+static bool SD_erase_check_done(void) {
+    if (!erase_in_progress_global) return true;
+    SPI_cs_low(SD_CS_global);
+    byte busy = SPI_transfer_byte(0xFF, MODE_0);
+    SPI_cs_high(SD_CS_global);
+    if (busy != 0xFF) return false;
+
+    uint32_t elapsed_us = (uint32_t)(esp_rtc_get_time_us() - erase_start_us_global);
+    erase_in_progress_global = false;
+    erase_stats_global.total_erase_us += elapsed_us;
+    if (elapsed_us > erase_stats_global.max_erase_us) erase_stats_global.max_erase_us = elapsed_us;
+    // decaying maximum: reacts to slow erases immediately, forgets them gradually
+    uint32_t decayed = erase_stats_global.estimate_us - erase_stats_global.estimate_us / 8;
+    erase_stats_global.estimate_us = (elapsed_us > decayed) ? elapsed_us : decayed;
+    return true;
+}
+
+// any other command has to wait until a background erase is done
+static bool SD_finish_background_erase(void) {
+    if (!erase_in_progress_global) return true;
+    uint64_t start = esp_rtc_get_time_us();
+    SPI_cs_low(SD_CS_global);
+    bool success = SD_wait_ready(SD_ERASE_TIMEOUT_US);
+    SPI_cs_high(SD_CS_global);
+    uint32_t delay_us = (uint32_t)(esp_rtc_get_time_us() - start);
+    uint32_t elapsed_us = (uint32_t)(esp_rtc_get_time_us() - erase_start_us_global);
+    erase_in_progress_global = false;
+    erase_stats_global.writes_delayed++;
+    if (delay_us > erase_stats_global.max_write_delay_us) erase_stats_global.max_write_delay_us = delay_us;
+    erase_stats_global.total_erase_us += elapsed_us;
+    if (elapsed_us > erase_stats_global.max_erase_us) erase_stats_global.max_erase_us = elapsed_us;
+    if (elapsed_us > erase_stats_global.estimate_us) erase_stats_global.estimate_us = elapsed_us;
+    return success;
+}
+
+bool SD_erase_blocks(uint32_t first_block, uint32_t last_block) {
+    if (last_block < first_block) return false;
+    if (!SD_finish_background_erase()) return false;
+    if (!SD_erase_start(first_block, last_block)) return false;
+    uint64_t start = esp_rtc_get_time_us();
+    while (!SD_erase_check_done()) {
+        if (esp_rtc_get_time_us() - start > SD_ERASE_TIMEOUT_US) {
+            printf("Timeout waiting for erase\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+void SD_preerase_configure(uint32_t region_start_block, uint32_t region_end_block, uint32_t lookahead_blocks) {
+    preerase_region_start_global = region_start_block;
+    preerase_region_end_global = region_end_block;
+    preerase_lookahead_global = lookahead_blocks;
+    preerase_write_pointer_global = region_start_block;
+    erased_until_global = region_start_block;
+}
+
+bool SD_preerase_poll(uint32_t write_pointer_block, uint32_t latency_budget_us) {
+    uint64_t start = esp_rtc_get_time_us();
+    if (!SD_erase_check_done()) return false; // previous erase still running
+    if (preerase_lookahead_global == 0 || write_pointer_block < preerase_region_start_global ||
+        write_pointer_block >= preerase_region_end_global) {
+        return false;
+    }
+    // the writer wrapped around or caught up: the erased window restarts at the write pointer
+    if (write_pointer_block < preerase_write_pointer_global || write_pointer_block > erased_until_global) {
+        erased_until_global = write_pointer_block;
+    }
+    preerase_write_pointer_global = write_pointer_block;
+    if (erased_until_global >= preerase_region_end_global ||
+        erased_until_global - write_pointer_block >= preerase_lookahead_global) {
+        return false;
+    }
+
+    // erase up to the next AU boundary: a partial AU first, whole AUs after that
+    uint32_t end = erased_until_global + SD_blocks_to_au_boundary(erased_until_global);
+    if (end > preerase_region_end_global) end = preerase_region_end_global;
+    uint32_t estimate = erase_stats_global.estimate_us;
+    if ((estimate == 0 && latency_budget_us < SD_PREERASE_PROBE_BUDGET_US) || estimate > latency_budget_us) {
+        erase_stats_global.skipped_over_budget++;
+        return false;
+    }
+    if (!SD_erase_start(erased_until_global, end - 1)) return false;
+    erased_until_global = end;
+
+    // spend the rest of the budget timing the erase. If it overruns it finishes in the background
+    while (!SD_erase_check_done()) {
+        uint64_t waited_us = esp_rtc_get_time_us() - start;
+        if (waited_us >= latency_budget_us) {
+            erase_stats_global.overran_budget++;
+            return true;
+        }
+        // SD_erase_pending() times the rest
+        if (waited_us >= SD_PREERASE_MAX_WAIT_US) return true;
+    }
+    erase_stats_global.completed_in_budget++;
+    return true;
+}
+
+bool SD_erase_pending(void) {
+    return !SD_erase_check_done();
+}
+
+uint32_t SD_preerase_get_erased_ahead(uint32_t write_pointer_block) {
+    if (write_pointer_block < preerase_write_pointer_global || write_pointer_block >= erased_until_global) {
+        return 0;
+    }
+    return erased_until_global - write_pointer_block;
+}
+
+const SD_erase_stats_t* SD_get_erase_stats(void) {
+    return &erase_stats_global;
+}
+
+const SD_write_stats_t* SD_get_write_stats(void) {
+    return &write_stats_global;
+}
+
+void SD_reset_timing_stats(void) {
+    uint32_t estimate = erase_stats_global.estimate_us;
+    memset(&erase_stats_global, 0, sizeof(erase_stats_global));
+    memset(&write_stats_global, 0, sizeof(write_stats_global));
+    erase_stats_global.estimate_us = estimate;
+}
+
+void SD_print_timing_stats(void) {
+    const SD_write_stats_t* w = &write_stats_global;
+    const SD_erase_stats_t* e = &erase_stats_global;
+    // percentiles from the histogram are reported as the upper edge of their bucket
+    uint32_t p50 = 0, p99 = 0, seen = 0;
+    for (int i = 0; i < SD_LATENCY_BUCKETS; i++) {
+        seen += w->busy_histogram[i];
+        if (!p50 && seen * 2 >= w->blocks_written) p50 = 2U << i;
+        if (!p99 && seen * 100 >= w->blocks_written * 99) p99 = 2U << i;
+    }
+    printf("Write busy: %lu blocks, p50 < %lu us, p99 < %lu us, max %lu us\n",
+           (unsigned long)w->blocks_written, (unsigned long)p50, (unsigned long)p99, (unsigned long)w->max_busy_us);
+    for (int i = 0; i < SD_LATENCY_BUCKETS; i++) {
+        if (w->busy_histogram[i]) printf("  < %7lu us: %lu\n", (unsigned long)(2U << i), (unsigned long)w->busy_histogram[i]);
+    }
+    printf("Pre-erase: %lu erases (%lu blocks), %lu in budget, %lu overran, %lu skipped, max %lu us, "
+           "avg %lu us, estimate %lu us, %lu writes delayed (max %lu us)\n",
+           (unsigned long)e->erases_issued, (unsigned long)e->blocks_erased,
+           (unsigned long)e->completed_in_budget, (unsigned long)e->overran_budget,
+           (unsigned long)e->skipped_over_budget, (unsigned long)e->max_erase_us,
+           (unsigned long)(e->erases_issued ? e->total_erase_us / e->erases_issued : 0),
+           (unsigned long)e->estimate_us, (unsigned long)e->writes_delayed,
+           (unsigned long)e->max_write_delay_us);
+}
+
 static byte sd_get_response()
 {
     byte response = SPI_transfer_byte(0xFF, MODE_0);
@@ -9,6 +9,108 @@ SD card protocol is used for SD cards and is NOT explained in the datasheet
 Uses SPI mode 0 or 3 (0 is easier)
 */
 
+#define SD_BLOCK_SIZE 512
+
+/*
+Information parsed from the card registers during SD_card_init():
+CSD (CMD9) -- capacity, transfer speed, write block parameters
+CID (CMD10) -- manufacturer and product identification
+SD Status (ACMD13) -- speed class, Allocation Unit (AU) size and erase timing
+
+The AU is the unit the card's controller manages internally. Sequential writes
+that start on an AU boundary and fill whole AUs get the best sustained speed.
+*/
+typedef struct {
+    // CSD register
+    byte csd_version;                // 1 = SDSC, 2 = SDHC/SDXC
+    uint32_t capacity_blocks;        // number of 512 byte blocks
+    uint32_t tran_speed_kbps;        // max data transfer rate (TRAN_SPEED)
+    uint16_t write_block_length;     // WRITE_BL_LEN in bytes
+    bool write_block_partial;        // WRITE_BL_PARTIAL
+    byte r2w_factor;                 // write time = read access time * 2^r2w_factor
+    uint32_t erase_sector_blocks;    // smallest erasable unit (SECTOR_SIZE) in blocks
+    // CID register
+    byte manufacturer_id;
+    char oem_id[3];                  // 2 ASCII characters + NUL
+    char product_name[6];            // 5 ASCII characters + NUL
+    byte product_revision;           // BCD n.m
+    uint32_t serial_number;
+    uint16_t manufacture_year;
+    byte manufacture_month;
+    // SD Status
+    byte speed_class;                // 0, 2, 4, 6 or 10 (MB/s). 0 if not reported
+    uint32_t au_size_blocks;         // Allocation Unit in blocks
+    uint16_t erase_size_au;          // number of AUs erased in erase_timeout_s
+    byte erase_timeout_s;
+    byte erase_offset_s;
+} SD_card_info_t;
+
+/*
+Erase and write timing statistics. Latencies are bucketed by powers of two:
+bucket i counts waits of [2^i, 2^(i+1)) us (bucket 0 also holds waits under 1 us)
+*/
+#define SD_LATENCY_BUCKETS 21 // up to ~2 s
+
+typedef struct {
+    uint32_t erases_issued;
+    uint32_t blocks_erased;
+    uint32_t completed_in_budget;    // finished while the scheduler was still allowed to wait
+    uint32_t overran_budget;         // still busy when the budget ran out, finished in the background
+    uint32_t skipped_over_budget;    // not started because the estimate exceeded the budget
+    uint32_t max_erase_us;
+    uint64_t total_erase_us;         // of erases whose duration was measured exactly
+    uint32_t estimate_us;            // current per-erase estimate used for scheduling
+    uint32_t writes_delayed;         // reads/writes that had to wait for a background erase
+    uint32_t max_write_delay_us;
+} SD_erase_stats_t;
+
+typedef struct {
+    uint32_t blocks_written;
+    uint32_t max_busy_us;            // longest programming busy time of a single block
+    uint32_t busy_histogram[SD_LATENCY_BUCKETS];
+} SD_write_stats_t;
+
 bool SD_card_init(gpio_num_t SD_card_chip_select);
 bool SD_read_block(uint32_t block_num, byte* block_data);
+bool SD_write_block(uint32_t block_num, const byte* block_data);
+// multi-block write (CMD25) of number_of_blocks * 512 bytes starting at start_block
+bool SD_write_blocks(uint32_t start_block, const byte* data, uint32_t number_of_blocks);
+
+// valid after a successful SD_card_init()
+const SD_card_info_t* SD_get_card_info(void);
+void SD_print_card_info(void);
+// number of blocks from block_num up to (not including) the next AU boundary
+uint32_t SD_blocks_to_au_boundary(uint32_t block_num);
+
+// erases blocks first_block..last_block (inclusive) with CMD32/33/38 and waits until done
+bool SD_erase_blocks(uint32_t first_block, uint32_t last_block);
+
+/*
+Background pre-erase scheduler.
+Erasing on demand makes the card stall in the middle of a write. Instead, during idle
+periods, the blocks ahead of the write pointer are erased up to lookahead_blocks ahead
+(whole AUs once aligned), so the card has ready-to-program space when the data arrives.
+
+SD_preerase_poll() is called while idle with the time that can be spent before the next
+write may be needed. An erase is only started when its estimated duration fits the budget
+(the estimate is the decaying maximum of measured erase times). The poll waits for the
+erase within the budget, but no more than a few ms, to time it; an erase still running
+then finishes in the background and the next read/write waits for it. Poll
+SD_erase_pending() now and then meanwhile, so it is timed when it ends, not much later.
+
+The scheduler never erases past region_end_block, so a circular log only starts erasing
+its next lap after it has wrapped.
+*/
+void SD_preerase_configure(uint32_t region_start_block, uint32_t region_end_block, uint32_t lookahead_blocks);
+// returns true if an erase was started
+bool SD_preerase_poll(uint32_t write_pointer_block, uint32_t latency_budget_us);
+// true while a background erase is still running; records its timing once it is done
+bool SD_erase_pending(void);
+// number of erased blocks starting at write_pointer_block
+uint32_t SD_preerase_get_erased_ahead(uint32_t write_pointer_block);
+
+const SD_erase_stats_t* SD_get_erase_stats(void);
+const SD_write_stats_t* SD_get_write_stats(void);
+void SD_reset_timing_stats(void);
+void SD_print_timing_stats(void);
 #endif /* SD_CARD_SPI_H */
\ No newline at end of file
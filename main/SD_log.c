@@ -0,0 +1,471 @@
+#include "SD_log.h"
+#include <stdlib.h>
+#include <string.h>
+
+static SD_log_superblock_t superblock_global;
+static uint32_t superblock_block_global = 0;
+static int superblock_copy_global = 0;          // which copy holds superblock_global
+static uint32_t capacity_global = 0;            // sectors in the data region
+static SD_log_recovery_t recovery_global;
+
+static byte* run_buffer_global = NULL;
+static uint32_t run_capacity_blocks_global = 0; // size of run_buffer_global in blocks
+static uint32_t run_first_sequence_global = 0;  // sequence of the sector in run_buffer_global[0]
+static uint32_t run_limit_blocks_global = 0;    // blocks the current run may hold before it must be written
+static size_t run_bytes_global = 0;             // bytes of sealed sectors in the current run
+static uint32_t next_sequence_global = 0;       // sequence number of the sector being filled
+static uint16_t open_used_global = 0;           // payload bytes used in the sector being filled
+static uint32_t oldest_sequence_global = 0;
+static int64_t time_offset_us_global = 0;       // log time = esp_rtc_get_time_us() + offset
+
+static byte scratch_block_global[SD_BLOCK_SIZE]; // for reads during format/mount/search
+
+static uint32_t crc32(const byte* data, size_t length);
+static void seal_block_crc(byte* block);
+static bool block_crc_is_valid(const byte* block);
+static bool superblock_is_valid(const byte* block);
+static bool sector_is_valid(const byte* sector, uint32_t sequence);
+static bool read_valid_sector(uint32_t sequence);
+static uint32_t find_lap_frontier(uint32_t lap_base);
+static bool SD_log_write_superblock(uint32_t lap_base_sequence);
+static bool SD_log_allocate_run_buffer(void);
+static void SD_log_start_run(uint32_t first_sequence);
+static bool SD_log_write_run(uint32_t number_of_blocks);
+static bool SD_log_seal_sector(void);
+static inline uint32_t sequence_to_block(uint32_t sequence);
+
+bool SD_log_format(uint32_t start_block, uint32_t end_block, SD_LOG_MODE mode) {
+    const SD_card_info_t* info = SD_get_card_info();
+    if (end_block > info->capacity_blocks) end_block = info->capacity_blocks;
+    if (start_block + SD_LOG_SUPERBLOCK_COPIES >= end_block) {
+        printf("Invalid log region %lu - %lu\n", (unsigned long)start_block, (unsigned long)end_block);
+        return false;
+    }
+    /*
+    pick an epoch no sector already on the card can have: one past the old superblocks',
+    or if those are gone, one past whatever log left its first sector behind
+    */
+    uint32_t epoch = (uint32_t)esp_rtc_get_time_us();
+    uint32_t generation = 0;
+    bool found_superblock = false;
+    for (int copy = 0; copy < SD_LOG_SUPERBLOCK_COPIES; copy++) {
+        if (SD_read_block(start_block + copy, scratch_block_global) && superblock_is_valid(scratch_block_global)) {
+            const SD_log_superblock_t* old = (const SD_log_superblock_t*)scratch_block_global;
+            if (!found_superblock || old->epoch >= epoch) epoch = old->epoch + 1;
+            if (old->generation >= generation) generation = old->generation + 1;
+            found_superblock = true;
+        }
+    }
+    if (!found_superblock && SD_read_block(start_block + SD_LOG_SUPERBLOCK_COPIES, scratch_block_global) &&
+        block_crc_is_valid(scratch_block_global)) {
+        epoch = ((const SD_log_sector_header_t*)scratch_block_global)->epoch + 1;
+    }
+
+    superblock_global = (SD_log_superblock_t){
+        .magic = SD_LOG_SUPERBLOCK_MAGIC,
+        .version = SD_LOG_VERSION,
+        .mode = mode,
+        .epoch = epoch,
+        .generation = generation,
+        .data_start_block = start_block + SD_LOG_SUPERBLOCK_COPIES,
+        .data_end_block = end_block,
+        .lap_base_sequence = 0
+    };
+    superblock_block_global = start_block;
+    capacity_global = end_block - superblock_global.data_start_block;
+    // write both copies so no stale copy with a higher generation is left behind
+    superblock_copy_global = 1;
+    if (!SD_log_write_superblock(0) || !SD_log_write_superblock(0)) {
+        printf("Could not write log superblock\n");
+        return false;
+    }
+    memset(&recovery_global, 0, sizeof(recovery_global));
+
+    if (!SD_log_allocate_run_buffer()) return false;
+    next_sequence_global = 0;
+    oldest_sequence_global = 0;
+    open_used_global = 0;
+    time_offset_us_global = 0;
+    SD_log_start_run(0);
+    printf("Formatted %s log epoch %lu, %lu data blocks\n",
+           mode == SD_LOG_MODE_CIRCULAR ? "circular" : "linear",
+           (unsigned long)epoch, (unsigned long)capacity_global);
+    return true;
+}
+
+bool SD_log_mount(uint32_t start_block) {
+    // the valid copy with the highest generation is current
+    bool found_superblock = false;
+    for (int copy = 0; copy < SD_LOG_SUPERBLOCK_COPIES; copy++) {
+        if (!SD_read_block(start_block + copy, scratch_block_global) || !superblock_is_valid(scratch_block_global)) {
+            continue;
+        }
+        const SD_log_superblock_t* sb = (const SD_log_superblock_t*)scratch_block_global;
+        if (!found_superblock || sb->generation > superblock_global.generation) {
+            superblock_global = *sb;
+            superblock_copy_global = copy;
+            found_superblock = true;
+        }
+    }
+    if (!found_superblock) {
+        printf("No valid log superblock at block %lu\n", (unsigned long)start_block);
+        return false;
+    }
+    superblock_block_global = start_block;
+    capacity_global = superblock_global.data_end_block - superblock_global.data_start_block;
+    memset(&recovery_global, 0, sizeof(recovery_global));
+
+    /*
+    the superblock's lap base is updated before a lap is touched, so the writer is either in
+    that lap or, if it had not reached slot 0 yet, still at the end of the previous one
+    */
+    uint32_t lap_base = superblock_global.lap_base_sequence;
+    uint32_t frontier = find_lap_frontier(lap_base);
+    uint32_t next_sequence = lap_base + frontier;
+    if (frontier == 0 && lap_base >= capacity_global) {
+        next_sequence = lap_base - capacity_global + find_lap_frontier(lap_base - capacity_global);
+    }
+    recovery_global.valid_sectors = next_sequence;
+
+    // a sector of this log at the frontier with a bad CRC was torn by a power loss
+    if (superblock_global.mode == SD_LOG_MODE_CIRCULAR || next_sequence < capacity_global) {
+        recovery_global.blocks_read++;
+        if (SD_read_block(sequence_to_block(next_sequence), scratch_block_global)) {
+            const SD_log_sector_header_t* header = (const SD_log_sector_header_t*)scratch_block_global;
+            if (header->magic == SD_LOG_SECTOR_MAGIC && header->epoch == superblock_global.epoch &&
+                header->sequence == next_sequence && !block_crc_is_valid(scratch_block_global)) {
+                recovery_global.torn_sector_discarded = true;
+            }
+        }
+    }
+
+    // once wrapped, the oldest retained sector is the first valid one after the frontier
+    uint32_t low = 0;
+    if (next_sequence > capacity_global) {
+        low = next_sequence - capacity_global;
+        uint32_t high = next_sequence;
+        while (low < high) {
+            uint32_t mid = low + (high - low) / 2;
+            if (read_valid_sector(mid)) {
+                high = mid;
+            } else {
+                low = mid + 1;
+            }
+        }
+    }
+    oldest_sequence_global = low;
+    recovery_global.oldest_sequence = low;
+
+    // continue log time from the newest sector so it never runs backwards after a power cycle
+    time_offset_us_global = 0;
+    if (next_sequence > oldest_sequence_global && read_valid_sector(next_sequence - 1)) {
+        int64_t last_commit = ((const SD_log_sector_header_t*)scratch_block_global)->commit_time_us;
+        int64_t now = (int64_t)esp_rtc_get_time_us();
+        if (last_commit >= now) time_offset_us_global = last_commit - now + 1;
+    }
+
+    if (!SD_log_allocate_run_buffer()) return false;
+    next_sequence_global = next_sequence;
+    open_used_global = 0;
+    SD_log_start_run(next_sequence);
+    printf("Mounted log epoch %lu: sectors %lu - %lu in %lu reads%s\n",
+           (unsigned long)superblock_global.epoch, (unsigned long)oldest_sequence_global,
+           (unsigned long)next_sequence, (unsigned long)recovery_global.blocks_read,
+           recovery_global.torn_sector_discarded ? ", torn sector discarded" : "");
+    return true;
+}
+
+bool SD_log_append(SD_LOG_RECORD_TYPE type, const void* data, uint16_t length) {
+    if (!run_buffer_global) {
+        printf("SD log is not mounted\n");
+        return false;
+    }
+    if ((length && !data) || length > SD_LOG_MAX_RECORD_LENGTH) {
+        printf("Invalid SD log record (length %u)\n", length);
+        return false;
+    }
+    size_t record_size = sizeof(SD_log_record_header_t) + length;
+    if (open_used_global + record_size > SD_LOG_SECTOR_PAYLOAD) {
+        if (!SD_log_seal_sector()) return false;
+    }
+    if (run_limit_blocks_global == 0) {
+        printf("SD log region is full\n");
+        return false;
+    }
+    byte* payload = &run_buffer_global[run_bytes_global + sizeof(SD_log_sector_header_t)];
+    SD_log_record_header_t header = {.type = type, .reserved = 0, .length = length};
+    memcpy(&payload[open_used_global], &header, sizeof(header));
+    if (length) memcpy(&payload[open_used_global + sizeof(header)], data, length);
+    open_used_global += record_size;
+    return true;
+}
+
+bool SD_log_flush(void) {
+    if (!run_buffer_global) return false;
+    if (!SD_log_seal_sector()) return false;
+    if (run_bytes_global == 0) return true;
+    return SD_log_write_run(run_bytes_global / SD_BLOCK_SIZE);
+}
+
+bool SD_log_close(void) {
+    bool success = SD_log_flush();
+    free(run_buffer_global);
+    run_buffer_global = NULL;
+    return success;
+}
+
+bool SD_log_idle(uint32_t latency_budget_us) {
+    if (!run_buffer_global || run_limit_blocks_global == 0) return false;
+    uint32_t write_pointer = sequence_to_block(run_first_sequence_global);
+    bool started = SD_preerase_poll(write_pointer, latency_budget_us);
+    // erased slots ahead of the writer held the oldest sectors of a wrapped log
+    uint32_t erased_end = run_first_sequence_global + SD_preerase_get_erased_ahead(write_pointer);
+    if (erased_end > capacity_global && erased_end - capacity_global > oldest_sequence_global) {
+        oldest_sequence_global = erased_end - capacity_global;
+    }
+    return started;
+}
+
+bool SD_log_read_sector(uint32_t sequence, byte* sector) {
+    if (!sector || sequence < oldest_sequence_global || sequence >= next_sequence_global) return false;
+    if (run_buffer_global && sequence >= run_first_sequence_global) {
+        // sealed but still waiting in RAM for its run to be written
+        memcpy(sector, &run_buffer_global[(sequence - run_first_sequence_global) * SD_BLOCK_SIZE], SD_BLOCK_SIZE);
+        return true;
+    }
+    if (!SD_read_block(sequence_to_block(sequence), sector)) return false;
+    return sector_is_valid(sector, sequence);
+}
+
+bool SD_log_next_record(const byte* sector, uint16_t* offset, SD_log_record_header_t* header, const byte** data) {
+    if (!sector || !offset || !header || !data) return false;
+    const SD_log_sector_header_t* sector_header = (const SD_log_sector_header_t*)sector;
+    const byte* payload = &sector[sizeof(SD_log_sector_header_t)];
+    if (*offset + sizeof(SD_log_record_header_t) > sector_header->used_bytes) return false;
+    memcpy(header, &payload[*offset], sizeof(*header));
+    if (header->type == SD_LOG_RECORD_INVALID ||
+        *offset + sizeof(*header) + header->length > sector_header->used_bytes) {
+        return false;
+    }
+    *data = &payload[*offset + sizeof(*header)];
+    *offset += sizeof(*header) + header->length;
+    return true;
+}
+
+bool SD_log_find_time(int64_t log_time_us, uint32_t* sequence) {
+    if (!sequence) return false;
+    // commit times increase with the sequence number, so the first sector at or after log_time_us can be bisected
+    uint32_t low = oldest_sequence_global;
+    uint32_t high = next_sequence_global;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (!SD_log_read_sector(mid, scratch_block_global)) {
+            // unreadable sectors are treated as older so the search still terminates
+            low = mid + 1;
+            continue;
+        }
+        const SD_log_sector_header_t* header = (const SD_log_sector_header_t*)scratch_block_global;
+        if (header->commit_time_us >= log_time_us) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    *sequence = low;
+    return low < next_sequence_global;
+}
+
+int64_t SD_log_get_time_us(void) {
+    return (int64_t)esp_rtc_get_time_us() + time_offset_us_global;
+}
+
+uint32_t SD_log_get_next_sequence(void) {
+    return next_sequence_global;
+}
+
+uint32_t SD_log_get_oldest_sequence(void) {
+    return oldest_sequence_global;
+}
+
+uint32_t SD_log_get_capacity(void) {
+    return capacity_global;
+}
+
+uint32_t SD_log_get_run_blocks(void) {
+    return run_capacity_blocks_global;
+}
+
+const SD_log_recovery_t* SD_log_get_recovery_info(void) {
+    return &recovery_global;
+}
+
+static inline uint32_t sequence_to_block(uint32_t sequence) {
+    return superblock_global.data_start_block + sequence % capacity_global;
+}
+
+// reads a sector into scratch_block_global and checks it is the given sector of this log
+static bool read_valid_sector(uint32_t sequence) {
+    recovery_global.blocks_read++;
+    return SD_read_block(sequence_to_block(sequence), scratch_block_global) &&
+           sector_is_valid(scratch_block_global, sequence);
+}
+
+/*
+slots of the lap starting at lap_base hold lap_base + slot for a prefix of the region.
+returns the length of that prefix -- every slot before it is valid, the one at it is not
+*/
+static uint32_t find_lap_frontier(uint32_t lap_base) {
+    uint32_t low = 0;
+    uint32_t high = capacity_global;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (read_valid_sector(lap_base + mid)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// writes the copy not currently in use so a torn write leaves the current copy intact
+static bool SD_log_write_superblock(uint32_t lap_base_sequence) {
+    int copy = (superblock_copy_global + 1) % SD_LOG_SUPERBLOCK_COPIES;
+    SD_log_superblock_t sb = superblock_global;
+    sb.generation++;
+    sb.lap_base_sequence = lap_base_sequence;
+    memset(scratch_block_global, 0, SD_BLOCK_SIZE);
+    memcpy(scratch_block_global, &sb, sizeof(sb));
+    seal_block_crc(scratch_block_global);
+    if (!SD_write_block(superblock_block_global + copy, scratch_block_global)) return false;
+    superblock_global = sb;
+    superblock_copy_global = copy;
+    return true;
+}
+
+// largest power of two that divides the AU, capped by the RAM budget. Also restarts pre-erase for the region
+static bool SD_log_allocate_run_buffer(void) {
+    const SD_card_info_t* info = SD_get_card_info();
+    uint32_t run_blocks = 1;
+    while (run_blocks * 2 <= SD_LOG_MAX_RUN_BLOCKS && info->au_size_blocks % (run_blocks * 2) == 0) {
+        run_blocks *= 2;
+    }
+    free(run_buffer_global);
+    run_buffer_global = malloc(run_blocks * SD_BLOCK_SIZE);
+    if (!run_buffer_global) {
+        printf("Could not allocate %lu byte log buffer\n", (unsigned long)(run_blocks * SD_BLOCK_SIZE));
+        return false;
+    }
+    run_capacity_blocks_global = run_blocks;
+    // pre-erased slots are lost from the log: whole AUs within a small share of it, or none
+    uint32_t lookahead = SD_LOG_PREERASE_AUS * info->au_size_blocks;
+    uint32_t cap = info->au_size_blocks > 0 ? capacity_global / SD_LOG_PREERASE_MAX_SHARE / info->au_size_blocks * info->au_size_blocks : 0;
+    if (lookahead > cap) lookahead = cap;
+    if (lookahead == 0) printf("Log region too small to pre-erase ahead of the writer\n");
+    SD_preerase_configure(superblock_global.data_start_block, superblock_global.data_end_block, lookahead);
+    return true;
+}
+
+/*
+the first run after first_sequence only goes up to the next AU aligned run boundary.
+runs also stop at the end of the data region, where a circular log wraps to slot 0
+*/
+static void SD_log_start_run(uint32_t first_sequence) {
+    run_first_sequence_global = first_sequence;
+    run_bytes_global = 0;
+    if (superblock_global.mode != SD_LOG_MODE_CIRCULAR && first_sequence >= capacity_global) {
+        run_limit_blocks_global = 0; // linear log is full
+        return;
+    }
+    uint32_t start_block = sequence_to_block(first_sequence);
+    uint32_t limit = run_capacity_blocks_global - (start_block % run_capacity_blocks_global);
+    uint32_t to_au = SD_blocks_to_au_boundary(start_block);
+    uint32_t to_end = superblock_global.data_end_block - start_block;
+    if (limit > to_au) limit = to_au;
+    if (limit > to_end) limit = to_end;
+    run_limit_blocks_global = limit;
+}
+
+static bool SD_log_write_run(uint32_t number_of_blocks) {
+    // the superblock has to announce a new lap before any of its slots is overwritten
+    uint32_t lap_base = run_first_sequence_global - run_first_sequence_global % capacity_global;
+    if (lap_base > superblock_global.lap_base_sequence && !SD_log_write_superblock(lap_base)) {
+        printf("Could not update log superblock for lap %lu\n", (unsigned long)lap_base);
+        return false;
+    }
+    uint32_t start_block = sequence_to_block(run_first_sequence_global);
+    if (!SD_write_blocks(start_block, run_buffer_global, number_of_blocks)) {
+        printf("SD log write of %lu blocks at %lu failed\n",
+               (unsigned long)number_of_blocks, (unsigned long)start_block);
+        return false;
+    }
+    uint32_t end_sequence = run_first_sequence_global + number_of_blocks;
+    if (end_sequence > capacity_global && end_sequence - capacity_global > oldest_sequence_global) {
+        oldest_sequence_global = end_sequence - capacity_global;
+    }
+    SD_log_start_run(end_sequence);
+    return true;
+}
+
+// closes the sector being filled: header, zero padding and CRC. Writes the run once it is full
+static bool SD_log_seal_sector(void) {
+    if (open_used_global == 0) return true;
+    byte* sector = &run_buffer_global[run_bytes_global];
+    SD_log_sector_header_t header = {
+        .magic = SD_LOG_SECTOR_MAGIC,
+        .epoch = superblock_global.epoch,
+        .sequence = next_sequence_global,
+        .used_bytes = open_used_global,
+        .reserved = 0,
+        .commit_time_us = SD_log_get_time_us()
+    };
+    memcpy(sector, &header, sizeof(header));
+    memset(&sector[sizeof(header) + open_used_global], 0, SD_LOG_SECTOR_PAYLOAD - open_used_global);
+    seal_block_crc(sector);
+
+    run_bytes_global += SD_BLOCK_SIZE;
+    next_sequence_global++;
+    open_used_global = 0;
+    if (run_bytes_global == run_limit_blocks_global * SD_BLOCK_SIZE) {
+        return SD_log_write_run(run_limit_blocks_global);
+    }
+    return true;
+}
+
+static bool superblock_is_valid(const byte* block) {
+    const SD_log_superblock_t* sb = (const SD_log_superblock_t*)block;
+    return sb->magic == SD_LOG_SUPERBLOCK_MAGIC && sb->version == SD_LOG_VERSION &&
+           sb->data_start_block < sb->data_end_block && block_crc_is_valid(block);
+}
+
+static bool sector_is_valid(const byte* sector, uint32_t sequence) {
+    const SD_log_sector_header_t* header = (const SD_log_sector_header_t*)sector;
+    return header->magic == SD_LOG_SECTOR_MAGIC && header->epoch == superblock_global.epoch &&
+           header->sequence == sequence && header->used_bytes <= SD_LOG_SECTOR_PAYLOAD &&
+           block_crc_is_valid(sector);
+}
+
+static void seal_block_crc(byte* block) {
+    uint32_t crc = crc32(block, SD_LOG_CRC_OFFSET);
+    memcpy(&block[SD_LOG_CRC_OFFSET], &crc, sizeof(crc));
+}
+
+static bool block_crc_is_valid(const byte* block) {
+    uint32_t stored;
+    memcpy(&stored, &block[SD_LOG_CRC_OFFSET], sizeof(stored));
+    return stored == crc32(block, SD_LOG_CRC_OFFSET);
+}
+
+// CRC-32 (IEEE 802.3), one nibble at a time to keep the table small
+static uint32_t crc32(const byte* data, size_t length) {
+    static const uint32_t nibble_table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc = nibble_table[(crc ^ data[i]) & 0xF] ^ (crc >> 4);
+        crc = nibble_table[(crc ^ (data[i] >> 4)) & 0xF] ^ (crc >> 4);
+    }
+    return ~crc;
+}
@@ -0,0 +1,203 @@
+#ifndef SD_LOG_H
+#define SD_LOG_H
+#include "SD_card_SPI.h"
+/*
+Power-fail-safe sequential data logger on top of the raw SD block layer.
+
+Layout of a log region:
+blocks start_block, +1   two superblock copies (magic, epoch, mode, lap base) + CRC32
+blocks start_block + 2.. data sectors
+
+Every data sector is self describing: a header with the log epoch and a sequence
+number (increasing by one per sector, never reused) and a CRC32 over the whole
+sector. Records never span sectors, so every valid sector can be decoded on its own.
+
+Sector n of the log is written to slot n % capacity of the data region and every
+sector is written exactly once. After a power loss the valid sectors of the current
+pass over the region therefore form a prefix, and SD_log_mount() finds the end of
+that prefix (the write frontier) with a binary search: O(log n) block reads instead
+of a scan. A torn sector (power lost while it was programmed) fails its CRC, so it is
+treated as the frontier and overwritten when appending resumes.
+
+Linear mode stops when the region is full. Circular mode wraps around and overwrites
+the oldest sectors in order, always keeping the newest capacity sectors (a flight
+recorder). Each pass over the region is a lap; before any sector of a new lap is
+touched the superblock is updated with the sequence number the lap starts at (the
+lap base), so recovery always knows which sequence to expect in every slot. The two
+superblock copies are written alternately so a torn superblock update never loses
+the log.
+
+The epoch changes with every SD_log_format() so sectors left over from an older
+log on the same card are never mistaken for part of the current one.
+
+Every sector records the log time it was sealed at. Log time is esp_rtc_get_time_us()
+shifted at mount so it continues from the last sector on the card: it only moves
+forward, across reboots and power losses, so sectors can be found by time with a
+binary search as well (SD_log_find_time()).
+
+Appended data is collected in RAM and written with multi-block (CMD25) runs.
+Runs never cross an Allocation Unit boundary: after the first (possibly short) run
+every run starts on an AU boundary and AUs are filled front to back, which is the
+access pattern SD cards sustain their rated speed class on.
+The run buffer is the largest power of two number of blocks that divides the AU
+size and is no larger than SD_LOG_MAX_RUN_BLOCKS, so whole runs tile each AU exactly.
+
+SD_log_idle() hands idle time to the background pre-erase scheduler (see SD_card_SPI.h)
+so the AUs ahead of the write pointer are erased before the data arrives. In a circular
+log that erases the oldest sectors early: the lookahead is lost from the retained log, so
+a wrapped log keeps capacity minus up to the lookahead. The erased slots always directly
+follow the write frontier, so recovery is unaffected. The lookahead is SD_LOG_PREERASE_AUS
+AUs, but never more than 1/SD_LOG_PREERASE_MAX_SHARE of the region in whole AUs; a region
+too small for one AU under that cap is not pre-erased at all.
+*/
+
+#define SD_LOG_MAX_RUN_BLOCKS 32 // 16 KB of RAM
+// how far ahead of the write pointer SD_log_idle() lets the card pre-erase
+#define SD_LOG_PREERASE_AUS   2
+// at most this fraction of the region (1/8), which the circular log gives up for it
+#define SD_LOG_PREERASE_MAX_SHARE 8
+
+#define SD_LOG_SECTOR_MAGIC     0x474C4453 // "SDLG"
+#define SD_LOG_SUPERBLOCK_MAGIC 0x42534453 // "SDSB"
+#define SD_LOG_VERSION          2
+#define SD_LOG_SUPERBLOCK_COPIES 2
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t epoch;
+    uint32_t sequence;        // index of this sector in the log
+    uint16_t used_bytes;      // payload bytes holding records
+    uint16_t reserved;
+    int64_t commit_time_us;   // log time when the sector was sealed
+} SD_log_sector_header_t;
+
+typedef enum {
+    SD_LOG_MODE_LINEAR = 0,   // stop when the region is full
+    SD_LOG_MODE_CIRCULAR = 1  // overwrite the oldest sectors, keep the newest
+} SD_LOG_MODE;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t mode;            // SD_LOG_MODE
+    uint32_t epoch;
+    uint32_t generation;      // the valid copy with the highest generation is current
+    uint32_t data_start_block;
+    uint32_t data_end_block;  // first block past the data region
+    uint32_t lap_base_sequence; // sequence number of slot 0 in the current lap
+} SD_log_superblock_t;
+
+// the last 4 bytes of every sector and of the superblock hold a CRC32 of the rest
+#define SD_LOG_CRC_OFFSET       (SD_BLOCK_SIZE - sizeof(uint32_t))
+#define SD_LOG_SECTOR_PAYLOAD   (SD_LOG_CRC_OFFSET - sizeof(SD_log_sector_header_t))
+
+// every record inside a sector payload starts with this header
+typedef struct __attribute__((packed)) {
+    uint8_t type;
+    uint8_t reserved;
+    uint16_t length;          // payload bytes following this header
+} SD_log_record_header_t;
+
+#define SD_LOG_MAX_RECORD_LENGTH (SD_LOG_SECTOR_PAYLOAD - sizeof(SD_log_record_header_t))
+
+typedef enum {
+    SD_LOG_RECORD_INVALID = 0,
+    SD_LOG_RECORD_TEXT = 1,           // free form ASCII
+    SD_LOG_RECORD_MPU6050_SAMPLE = 2, // accel xyz (g), gyro xyz (deg/s), temperature (C) as floats
+    SD_LOG_RECORD_MPU6050_TIMED_SAMPLE = 3, // int64 log time (us) of the data-ready interrupt, then a MPU6050_SAMPLE
+    SD_LOG_RECORD_MPU6050_SESSION = 4,      // mpu6050_session_t: ranges, rate and scales for the raw records that follow
+    SD_LOG_RECORD_MPU6050_RAW_SAMPLES = 5,  // one or more mpu6050_raw_frame (7 int16 counts, little endian)
+    SD_LOG_RECORD_MPU6050_TIMED_RAW_SAMPLE = 6, // int64 log time (us) of the data-ready interrupt, then one mpu6050_raw_frame
+    // int64 log time (us) of the leader's data-ready interrupt, int32 follower sample time minus that (us),
+    // then the leader's and the follower's mpu6050_raw_frame. The session records carry the addresses
+    SD_LOG_RECORD_MPU6050_TIMED_RAW_PAIR = 7,
+    SD_LOG_RECORD_SEGMENT_START = 8,  // int64 log time (us) the motion started, uint32 segment number
+    SD_LOG_RECORD_SEGMENT_END = 9,    // int64 log time (us), uint32 segment number, uint32 samples logged in it
+    // uint32 index of the first sample, then consecutive mpu6050_raw_frame. Times come from the anchors
+    SD_LOG_RECORD_MPU6050_INDEXED_RAW_SAMPLES = 10,
+    // uint32 sample index, int64 log time (us) that sample was taken, float sample rate (Hz) fitted over the recent anchors
+    SD_LOG_RECORD_SAMPLE_CLOCK_ANCHOR = 11,
+    // int64 log time (us), uint32 index of the first sample at the new rate, uint16 rate (Hz), uint8 DLPF,
+    // uint8 tier, float RMS (mg) of the window that caused the change. A SESSION record follows
+    SD_LOG_RECORD_MPU6050_RATE_CHANGE = 12,
+    // uint32 sample index, uint8 filter (0 complementary, 1 Madgwick), int32 roll, pitch, heading (Q16 degrees)
+    SD_LOG_RECORD_ORIENTATION = 13,
+    // uint8 stream (0 fastest), uint16 input samples per output, uint16 filter delay (input samples), uint32 index
+    // of the input sample the first output was computed at, then consecutive outputs as mpu6050_raw_frame
+    SD_LOG_RECORD_MPU6050_DECIMATED_SAMPLES = 14,
+    // uint32 index of the first sample in the window, uint32 samples, then per channel in mpu6050_raw_frame
+    // order: float mean, float standard deviation, int16 min, int16 max (raw counts)
+    SD_LOG_RECORD_MPU6050_WINDOW_SUMMARY = 15,
+    // uint32 index of the first sample of the first window, uint16 windows averaged, uint8 axis (accel x/y/z),
+    // uint8 log2 points, uint16 first bin, uint16 bins, float peak bin power (counts^2), then one uint8 per bin:
+    // 0.5 dB steps below the peak (spectrum.h). Bins are sample rate / points apart
+    SD_LOG_RECORD_MPU6050_SPECTRUM = 16,
+    // uint32 index of the first sample of the block, uint16 samples, uint8 targets, then per target:
+    // float frequency (Hz), float amplitude (counts) of accel x, y, z (goertzel.h)
+    SD_LOG_RECORD_MPU6050_TONES = 17,
+    // uint32 index of the first sample, uint16 samples, mpu6050_raw_frame reference, then the samples as
+    // Rice coded deltas of each channel (rice_codec.h; rice_decode() turns them back into mpu6050_raw_frame)
+    SD_LOG_RECORD_MPU6050_RICE_SAMPLES = 18,
+    // uint32 index of the first sample, uint16 samples, uint8 bits kept of each channel, then the samples packed
+    // back to back at those bits (sample_packer.h; sample_packer_unpack() turns them back into mpu6050_raw_frame)
+    SD_LOG_RECORD_MPU6050_PACKED_SAMPLES = 19,
+    // uint8 level, uint8 entries, uint32 sequence of the sector with the latest record of each of 4 levels, then
+    // entries of uint32 first index, uint32 samples, int16 min[7], max[7], mean[7] (rollup.h)
+    SD_LOG_RECORD_MPU6050_ROLLUP = 20,
+    // capture_event_record_t: a triggered event (capture.h), its EVENT_SAMPLES records follow
+    SD_LOG_RECORD_MPU6050_EVENT = 21,
+    // uint32 event, uint32 index of the first sample, uint16 samples, then mpu6050_raw_frame samples
+    SD_LOG_RECORD_MPU6050_EVENT_SAMPLES = 22,
+    // velocity_record_t: vibration velocity RMS of one window in 0.01 mm/s (velocity.h)
+    SD_LOG_RECORD_MPU6050_VELOCITY = 23
+} SD_LOG_RECORD_TYPE;
+
+// what SD_log_mount() found
+typedef struct {
+    uint32_t valid_sectors;       // sectors recovered (= next sequence number)
+    uint32_t oldest_sequence;     // first sector still retained
+    uint32_t blocks_read;         // reads needed to find the frontier
+    bool torn_sector_discarded;   // the sector at the frontier belonged to this log but failed its CRC
+} SD_log_recovery_t;
+
+// start a new, empty log in [start_block, end_block). The superblocks go in the first two blocks
+bool SD_log_format(uint32_t start_block, uint32_t end_block, SD_LOG_MODE mode);
+// open the log whose superblocks are at start_block and resume appending after the last valid sector
+bool SD_log_mount(uint32_t start_block);
+// appends one record. Records never span sectors (length <= SD_LOG_MAX_RECORD_LENGTH)
+bool SD_log_append(SD_LOG_RECORD_TYPE type, const void* data, uint16_t length);
+// seals the partially filled sector and writes everything buffered to the card
+bool SD_log_flush(void);
+// flushes and frees the run buffer
+bool SD_log_close(void);
+/*
+call while idle with the time until the log may next need to write (e.g. the next flush).
+pre-erases ahead of the write pointer within that budget. Returns true if an erase was started
+*/
+bool SD_log_idle(uint32_t latency_budget_us);
+
+// reads the sector with the given sequence number. Fails if it is not a valid, retained sector of this log
+bool SD_log_read_sector(uint32_t sequence, byte* sector);
+/*
+iterates the records of a sector read with SD_log_read_sector(). Start with *offset = 0.
+returns false when there are no more records
+*/
+bool SD_log_next_record(const byte* sector, uint16_t* offset, SD_log_record_header_t* header, const byte** data);
+/*
+finds the first retained sector sealed at or after log_time_us with a binary search over the
+sector commit times. Returns false if every retained sector is older
+*/
+bool SD_log_find_time(int64_t log_time_us, uint32_t* sequence);
+// current log time (monotonic across reboots, see above)
+int64_t SD_log_get_time_us(void);
+// sequence number the next sealed sector will get
+uint32_t SD_log_get_next_sequence(void);
+// oldest sequence number still on the card. Grows once a circular log wraps
+uint32_t SD_log_get_oldest_sequence(void);
+// number of sectors the data region holds
+uint32_t SD_log_get_capacity(void);
+// size of one write run in blocks (valid after format/mount)
+uint32_t SD_log_get_run_blocks(void);
+const SD_log_recovery_t* SD_log_get_recovery_info(void);
+
+#endif /* SD_LOG_H */
@@ -0,0 +1,128 @@
+#include "adaptive_rate.h"
+#include <string.h>
+#include <math.h>
+
+// helpers not to be used outside of this file
+static bool switch_tier(adaptive_rate_t* controller, size_t tier);
+static float window_rms_mg(const adaptive_rate_t* controller);
+static void window_reset(adaptive_rate_t* controller);
+
+bool adaptive_rate_init(adaptive_rate_t* controller, mpu6050_t* dev, const adaptive_rate_tier_t* tiers,
+                        size_t tier_count, size_t initial_tier, uint32_t window_ms, uint32_t down_hold_windows) {
+    if (!controller || !dev || !tiers) {
+        printf("passed NULL pointer to adaptive_rate_init() function\n");
+        return false;
+    }
+    if (tier_count == 0 || tier_count > ADAPTIVE_RATE_MAX_TIERS || initial_tier >= tier_count || window_ms == 0) {
+        printf("adaptive rate: invalid tiers / window\n");
+        return false;
+    }
+    for (size_t t = 0; t + 1 < tier_count; t++) {
+        // without a gap between the two thresholds a signal at the threshold would toggle tiers
+        if (tiers[t + 1].sample_rate_hz <= tiers[t].sample_rate_hz || tiers[t + 1].down_rms_mg >= tiers[t].up_rms_mg) {
+            printf("adaptive rate: tier %u and %u overlap\n", (unsigned)t, (unsigned)(t + 1));
+            return false;
+        }
+    }
+    memset(controller, 0, sizeof(*controller));
+    controller->dev = dev;
+    memcpy(controller->tiers, tiers, tier_count * sizeof(adaptive_rate_tier_t));
+    controller->tier_count = tier_count;
+    controller->window_ms = window_ms;
+    controller->down_hold_windows = down_hold_windows;
+    return switch_tier(controller, initial_tier);
+}
+
+bool adaptive_rate_update(adaptive_rate_t* controller, const mpu6050_raw_frame* frames, size_t frame_count, bool* changed) {
+    if (!controller || !frames || !changed) {
+        printf("passed NULL pointer to adaptive_rate_update() function\n");
+        return false;
+    }
+    *changed = false;
+    controller->stats.samples[controller->tier] += frame_count;
+    for (size_t i = 0; i < frame_count; i++) {
+        for (int axis = 0; axis < 3; axis++) {
+            int32_t count = frames[i].accel[axis];
+            controller->sum[axis] += count;
+            controller->sum_squares[axis] += count * count;
+        }
+        if (++controller->samples_in_window < controller->window_samples) continue;
+
+        float rms_mg = window_rms_mg(controller);
+        controller->last_rms_mg = rms_mg;
+        if (rms_mg > controller->stats.max_rms_mg) controller->stats.max_rms_mg = rms_mg;
+        window_reset(controller);
+        size_t tier = controller->tier;
+        // up: as far as needed at once
+        while (tier + 1 < controller->tier_count && rms_mg > controller->tiers[tier].up_rms_mg) tier++;
+        if (tier > controller->tier) {
+            controller->stats.changes_up++;
+        } else if (tier > 0 && rms_mg < controller->tiers[tier].down_rms_mg) {
+            // down: one tier, and only after a quiet stretch
+            if (++controller->quiet_windows < controller->down_hold_windows) continue;
+            tier--;
+            controller->stats.changes_down++;
+        } else {
+            controller->quiet_windows = 0;
+            continue;
+        }
+        if (!switch_tier(controller, tier)) return false;
+        *changed = true;
+        return true;
+    }
+    return true;
+}
+
+// DLPF first: the sample rate divider depends on it
+static bool switch_tier(adaptive_rate_t* controller, size_t tier) {
+    const adaptive_rate_tier_t* settings = &controller->tiers[tier];
+    if (!mpu6050_set_DLPF_frequency(controller->dev, settings->DLPF)) return false;
+    if (!mpu6050_set_sample_rate(controller->dev, settings->sample_rate_hz)) return false;
+    controller->tier = tier;
+    controller->quiet_windows = 0;
+    uint32_t window_samples = mpu6050_get_session(controller->dev)->sample_rate_hz * controller->window_ms / 1000;
+    controller->window_samples = window_samples > 0 ? window_samples : 1;
+    window_reset(controller);
+    return true;
+}
+
+// sum of the per axis variances = squared RMS of the acceleration around its window mean
+static float window_rms_mg(const adaptive_rate_t* controller) {
+    double n = controller->samples_in_window;
+    double variance = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        double mean = controller->sum[axis] / n;
+        variance += controller->sum_squares[axis] / n - mean * mean;
+    }
+    if (variance < 0) variance = 0;
+    return (float)(sqrt(variance) * mpu6050_get_session(controller->dev)->accel_g_per_LSB * 1000.0);
+}
+
+static void window_reset(adaptive_rate_t* controller) {
+    controller->samples_in_window = 0;
+    memset(controller->sum, 0, sizeof(controller->sum));
+    memset(controller->sum_squares, 0, sizeof(controller->sum_squares));
+}
+
+size_t adaptive_rate_get_tier(const adaptive_rate_t* controller) {
+    return controller->tier;
+}
+
+float adaptive_rate_get_last_rms_mg(const adaptive_rate_t* controller) {
+    return controller->last_rms_mg;
+}
+
+const adaptive_rate_stats_t* adaptive_rate_get_stats(const adaptive_rate_t* controller) {
+    return &controller->stats;
+}
+
+void adaptive_rate_print_stats(const adaptive_rate_t* controller) {
+    const adaptive_rate_stats_t* stats = &controller->stats;
+    printf("Adaptive rate: tier %u (%u Hz), %lu up / %lu down, last window %.1f mg max %.1f mg, samples per tier:",
+           (unsigned)controller->tier, (unsigned)controller->tiers[controller->tier].sample_rate_hz,
+           (unsigned long)stats->changes_up, (unsigned long)stats->changes_down, controller->last_rms_mg, stats->max_rms_mg);
+    for (size_t t = 0; t < controller->tier_count; t++) {
+        printf(" %llu", (unsigned long long)stats->samples[t]);
+    }
+    printf("\n");
+}
@@ -0,0 +1,76 @@
+#ifndef ADAPTIVE_RATE_H
+#define ADAPTIVE_RATE_H
+#include "mpu6050_I2C.h"
+/*
+Activity adaptive sample rate and DLPF for the MPU6050.
+
+The caller configures a few tiers, slowest first, each a sample rate with a matching DLPF
+(cutoff below half the rate, so the slow tiers do not alias). Every sample that is read
+goes through adaptive_rate_update(), which measures the signal energy over short windows:
+the RMS of the acceleration around its window mean, summed over the axes, in mg. Gravity
+and a constant tilt are in the mean and do not count.
+
+- a window above the current tier's up_rms_mg switches up right away, straight to the
+  lowest tier whose up_rms_mg the window stays under (an impact must not be filtered away)
+- down_hold_windows windows in a row below down_rms_mg switch down one tier
+
+Keeping down_rms_mg of a tier well below up_rms_mg of the tier under it is the hysteresis
+that stops the controller from toggling on a signal that sits near one threshold.
+
+Bus, CPU and log load scale with the rate, so they follow the signal content. The caller
+is told about every change so it can log it (the new session, where sample numbering
+restarts).
+*/
+
+#define ADAPTIVE_RATE_MAX_TIERS 6
+
+typedef struct {
+    uint16_t sample_rate_hz;
+    MPU6050_DLPF_FREQ DLPF;
+    float up_rms_mg;        // a window above this moves to a faster tier (ignored on the fastest)
+    float down_rms_mg;      // windows below this move to the slower tier (ignored on the slowest)
+} adaptive_rate_tier_t;
+
+typedef struct {
+    uint32_t changes_up;
+    uint32_t changes_down;
+    uint64_t samples[ADAPTIVE_RATE_MAX_TIERS];   // samples taken in each tier
+    float max_rms_mg;
+} adaptive_rate_stats_t;
+
+typedef struct {
+    mpu6050_t* dev;
+    adaptive_rate_tier_t tiers[ADAPTIVE_RATE_MAX_TIERS];
+    size_t tier_count;
+    size_t tier;
+    uint32_t window_ms;
+    uint32_t down_hold_windows;
+    // current window: per axis sum and sum of squares of the acceleration counts
+    uint32_t window_samples;
+    uint32_t samples_in_window;
+    int64_t sum[3];
+    int64_t sum_squares[3];
+    uint32_t quiet_windows;
+    float last_rms_mg;
+    adaptive_rate_stats_t stats;
+} adaptive_rate_t;
+
+/*
+copies the tiers (slowest first) and switches dev to initial_tier. window_ms is the
+energy window, down_hold_windows how many quiet windows it takes to step down
+*/
+bool adaptive_rate_init(adaptive_rate_t* controller, mpu6050_t* dev, const adaptive_rate_tier_t* tiers,
+                        size_t tier_count, size_t initial_tier, uint32_t window_ms, uint32_t down_hold_windows);
+/*
+feeds samples in the order they were taken. *changed is set if the tier was switched: the
+sensor runs at the new rate and DLPF from then on, and the rest of frames (taken at the
+old rate) is not counted towards the first window of the new tier
+*/
+bool adaptive_rate_update(adaptive_rate_t* controller, const mpu6050_raw_frame* frames, size_t frame_count, bool* changed);
+size_t adaptive_rate_get_tier(const adaptive_rate_t* controller);
+// RMS of the window that caused the last change (or the last full window)
+float adaptive_rate_get_last_rms_mg(const adaptive_rate_t* controller);
+const adaptive_rate_stats_t* adaptive_rate_get_stats(const adaptive_rate_t* controller);
+void adaptive_rate_print_stats(const adaptive_rate_t* controller);
+
+#endif /* ADAPTIVE_RATE_H */
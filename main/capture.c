@@ -0,0 +1,213 @@
+#include "capture.h"
+#include "fixed_math.h"
+#include <string.h>
+
+// helpers not to be used outside of this file
+static bool apply_session(capture_t* capture, const mpu6050_session_t* session);
+static uint64_t threshold_squared(float counts);
+static uint32_t magnitude_squared(const mpu6050_raw_frame* frame);
+static void open_event(capture_t* capture, uint32_t trigger_frame, uint8_t onsets);
+static void close_event(capture_t* capture, bool cut);
+static void restart_windows(capture_t* capture);
+
+bool capture_init(capture_t* capture, const capture_config_t* config, const mpu6050_session_t* session) {
+    if (!capture || !config || !session) {
+        printf("passed NULL pointer to capture_init() function\n");
+        return false;
+    }
+    if ((config->triggers & (CAPTURE_TRIGGER_MAGNITUDE | CAPTURE_TRIGGER_SLOPE | CAPTURE_TRIGGER_FREE_FALL)) == 0) {
+        printf("capture: no trigger enabled\n");
+        return false;
+    }
+    memset(capture, 0, sizeof(*capture));
+    capture->config = *config;
+    return apply_session(capture, session);
+}
+
+bool capture_set_session(capture_t* capture, const mpu6050_session_t* session) {
+    if (capture->state == CAPTURE_POST) close_event(capture, true);
+    restart_windows(capture);
+    return apply_session(capture, session);
+}
+
+// the thresholds and windows in counts and samples
+static bool apply_session(capture_t* capture, const mpu6050_session_t* session) {
+    const capture_config_t* config = &capture->config;
+    uint32_t rate_hz = session->sample_rate_hz;
+    uint32_t pre_frames = config->pre_ms * rate_hz / 1000, post_frames = config->post_ms * rate_hz / 1000;
+    if (rate_hz == 0 || !(session->accel_g_per_LSB > 0) || pre_frames + 1 + post_frames > CAPTURE_MAX_FRAMES / 2) {
+        printf("capture: %u + %u ms at %lu Hz do not fit %u frames\n", (unsigned)config->pre_ms, (unsigned)config->post_ms,
+               (unsigned long)rate_hz, (unsigned)(CAPTURE_MAX_FRAMES / 2));
+        return false;
+    }
+    float counts_per_mg = 0.001f / session->accel_g_per_LSB;
+    capture->magnitude_squared = threshold_squared(config->magnitude_mg * counts_per_mg);
+    // a sample period apart
+    capture->slope_squared = threshold_squared(config->slope_mg_per_ms * 1000.0f / rate_hz * counts_per_mg);
+    capture->free_fall_squared = threshold_squared(config->free_fall_mg * counts_per_mg);
+    capture->free_fall_samples = config->free_fall_ms * rate_hz / 1000;
+    if (capture->free_fall_samples == 0) capture->free_fall_samples = 1;
+    capture->pre_frames = pre_frames;
+    capture->post_frames = post_frames;
+    return true;
+}
+
+static uint64_t threshold_squared(float counts) {
+    uint64_t rounded = (uint64_t)(counts + 0.5f);
+    return rounded * rounded;
+}
+
+static uint32_t magnitude_squared(const mpu6050_raw_frame* frame) {
+    int32_t x = frame->accel[0], y = frame->accel[1], z = frame->accel[2];
+    // at most 3 * 2^30
+    return (uint32_t)(x * x) + (uint32_t)(y * y) + (uint32_t)(z * z);
+}
+
+bool capture_add(capture_t* capture, const mpu6050_raw_frame* frame, uint32_t sample_index) {
+    if (capture->started && sample_index != capture->next_index) {
+        // the frames on both sides of the hole are not one signal
+        capture->stats.restarts++;
+        if (capture->state == CAPTURE_POST) close_event(capture, true);
+        restart_windows(capture);
+    }
+    if (!capture->started || sample_index != capture->next_index) capture->index_offset = sample_index - capture->written;
+    capture->started = true;
+    capture->next_index = sample_index + 1;
+
+    if (capture->state == CAPTURE_WRITING) {
+        // the slot about to be written still holds a frame of the event nobody took yet
+        while (capture->taken < capture->event.frames &&
+               capture->written - (capture->event_start + capture->taken) >= CAPTURE_MAX_FRAMES) {
+            capture->taken++;
+            capture->stats.overwritten_frames++;
+        }
+        if (capture->event_record_taken && capture->taken == capture->event.frames) capture->state = CAPTURE_ARMED;
+    }
+    uint32_t frame_number = capture->written++;
+    capture->frames[frame_number % CAPTURE_MAX_FRAMES] = *frame;
+
+    uint32_t squared = magnitude_squared(frame);
+    uint8_t conditions = 0;
+    if ((capture->config.triggers & CAPTURE_TRIGGER_MAGNITUDE) && squared > capture->magnitude_squared) {
+        conditions |= CAPTURE_TRIGGER_MAGNITUDE;
+    }
+    if ((capture->config.triggers & CAPTURE_TRIGGER_SLOPE) && capture->has_previous) {
+        uint64_t slope = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            int32_t step = frame->accel[axis] - capture->previous[axis];
+            slope += (uint64_t)((int64_t)step * step);
+        }
+        if (slope > capture->slope_squared) conditions |= CAPTURE_TRIGGER_SLOPE;
+    }
+    capture->below_free_fall = squared < capture->free_fall_squared ? capture->below_free_fall + 1 : 0;
+    if ((capture->config.triggers & CAPTURE_TRIGGER_FREE_FALL) && capture->below_free_fall >= capture->free_fall_samples) {
+        conditions |= CAPTURE_TRIGGER_FREE_FALL;
+    }
+    uint8_t onsets = conditions & ~capture->active;
+    capture->active = conditions;
+    memcpy(capture->previous, frame->accel, sizeof(capture->previous));
+    capture->has_previous = true;
+    if (onsets) capture->stats.triggers++;
+
+    if (capture->state == CAPTURE_POST) {
+        if (squared > capture->peak_squared) capture->peak_squared = squared;
+        if (squared < capture->lowest_squared) capture->lowest_squared = squared;
+        if (onsets) {
+            // a bounce: part of this event
+            capture->event.retriggers++;
+            capture->event.triggers_seen |= onsets;
+            capture->stats.retriggers++;
+        }
+        if (--capture->post_left == 0) close_event(capture, false);
+    } else if (onsets) {
+        if (capture->state == CAPTURE_ARMED) open_event(capture, frame_number, onsets);
+        else capture->stats.missed_triggers++;
+    }
+    return capture->state == CAPTURE_WRITING;
+}
+
+// starts an event at the trigger frame with what the ring holds of the pre-trigger window
+static void open_event(capture_t* capture, uint32_t trigger_frame, uint8_t onsets) {
+    uint32_t start = trigger_frame - capture->history_start > capture->pre_frames ? trigger_frame - capture->pre_frames
+                                                                                 : capture->history_start;
+    capture->stats.events++;
+    memset(&capture->event, 0, sizeof(capture->event));
+    capture->event.event = capture->stats.events;
+    capture->event.trigger = onsets & -onsets;
+    capture->event.triggers_seen = onsets;
+    capture->event.first_index = start + capture->index_offset;
+    capture->event.pre_frames = (uint16_t)(trigger_frame - start);
+    capture->event_start = start;
+    capture->peak_squared = 0;
+    capture->lowest_squared = UINT32_MAX;
+    for (uint32_t f = start; f <= trigger_frame; f++) {
+        uint32_t squared = magnitude_squared(&capture->frames[f % CAPTURE_MAX_FRAMES]);
+        if (squared > capture->peak_squared) capture->peak_squared = squared;
+        if (squared < capture->lowest_squared) capture->lowest_squared = squared;
+    }
+    capture->state = CAPTURE_POST;
+    capture->post_left = capture->post_frames;
+    if (capture->post_left == 0) close_event(capture, false);
+}
+
+// the event is complete (or cut short): it goes out, the next pre-trigger window starts after it
+static void close_event(capture_t* capture, bool cut) {
+    capture->event_end = capture->written;
+    capture->event.frames = (uint16_t)(capture->event_end - capture->event_start);
+    capture->event.peak_counts = (uint16_t)fixed_sqrt32(capture->peak_squared);
+    capture->event.lowest_counts = (uint16_t)fixed_sqrt32(capture->lowest_squared);
+    if (cut) capture->stats.cut_events++;
+    capture->history_start = capture->event_end;
+    capture->event_record_taken = false;
+    capture->taken = 0;
+    capture->state = CAPTURE_WRITING;
+}
+
+static void restart_windows(capture_t* capture) {
+    capture->history_start = capture->written;
+    capture->active = 0;
+    capture->below_free_fall = 0;
+    capture->has_previous = false;
+}
+
+bool capture_next_record(capture_t* capture, CAPTURE_RECORD* kind, const void** data, uint16_t* length) {
+    if (capture->state != CAPTURE_WRITING) return false;
+    capture->stats.records++;
+    if (!capture->event_record_taken) {
+        capture->event_record_taken = true;
+        capture->record.event = capture->event;
+        *kind = CAPTURE_RECORD_EVENT;
+        *data = &capture->record.event;
+        *length = sizeof(capture->record.event);
+        if (capture->taken == capture->event.frames) capture->state = CAPTURE_ARMED;
+        return true;
+    }
+    capture_samples_record_t* record = &capture->record.samples;
+    uint32_t count = capture->event.frames - capture->taken;
+    if (count > CAPTURE_FRAMES_PER_RECORD) count = CAPTURE_FRAMES_PER_RECORD;
+    record->event = capture->event.event;
+    record->first_index = capture->event.first_index + capture->taken;
+    record->frame_count = (uint16_t)count;
+    for (uint32_t i = 0; i < count; i++) {
+        record->frames[i] = capture->frames[(capture->event_start + capture->taken + i) % CAPTURE_MAX_FRAMES];
+    }
+    capture->taken += count;
+    if (capture->taken == capture->event.frames) capture->state = CAPTURE_ARMED;
+    *kind = CAPTURE_RECORD_SAMPLES;
+    *data = record;
+    *length = (uint16_t)(CAPTURE_SAMPLES_HEADER_LENGTH + count * sizeof(mpu6050_raw_frame));
+    return true;
+}
+
+const capture_stats_t* capture_get_stats(const capture_t* capture) {
+    return &capture->stats;
+}
+
+void capture_print_stats(const capture_t* capture) {
+    const capture_stats_t* stats = &capture->stats;
+    printf("Capture: %lu events (%lu cut short), %lu triggers, %lu retriggers, %lu missed, %lu frames overwritten, "
+           "%lu records, %lu restarts\n",
+           (unsigned long)stats->events, (unsigned long)stats->cut_events, (unsigned long)stats->triggers,
+           (unsigned long)stats->retriggers, (unsigned long)stats->missed_triggers,
+           (unsigned long)stats->overwritten_frames, (unsigned long)stats->records, (unsigned long)stats->restarts);
+}
@@ -0,0 +1,151 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+#include "mpu6050_I2C.h"
+/*
+Triggered capture of short shock events (drops, impacts), like an oscilloscope: the raw
+frames of the last pre_ms are kept in a RAM ring, and when a trigger fires the frames
+before it and post_ms after it go to the log as one event. Nothing else needs to be
+logged at full rate to catch them.
+
+Triggers, on the acceleration vector in raw counts (the thresholds are converted from mg
+with the session scale once, so a sample costs a few multiplies and compares):
+
+- CAPTURE_TRIGGER_MAGNITUDE: |a| above magnitude_mg (an impact)
+- CAPTURE_TRIGGER_SLOPE: |a - previous a| above slope_mg_per_ms times the sample period
+  (a sharp edge, even if it stays below the magnitude)
+- CAPTURE_TRIGGER_FREE_FALL: |a| below free_fall_mg for free_fall_ms in a row (a drop;
+  the pre-trigger frames hold the start of the fall)
+
+A trigger fires when a condition starts to hold, not on every sample it holds for. One
+that fires within the post window of an event belongs to that event (a bounce); one that
+fires while an event is still being written out is missed (counted, not captured). An
+event is armed again right after its last record is taken, with the frames since its end
+as the next pre-trigger window.
+
+An event comes out of capture_next_record() as a CAPTURE_RECORD_EVENT record (what
+triggered, where, the peak and the lowest |a|), then CAPTURE_RECORD_SAMPLES records of
+raw frames (CAPTURE_FRAMES_PER_RECORD each), each small enough for a log sector. The ring
+has room for the samples that arrive while they are being written, as long as the caller
+takes the records faster than the samples come in; frames overwritten before they were
+taken are counted and missing from the samples records (their first index shows the hole).
+
+Samples are fed with their sample index; a jump in the index ends the post window early
+and starts the pre-trigger window over, since the frames around it are not one signal.
+*/
+
+#define CAPTURE_MAX_FRAMES 2048             // ring, pre + trigger + post at most half of it
+#define CAPTURE_MAX_RECORD_LENGTH 480       // SD_LOG_MAX_RECORD_LENGTH
+
+typedef enum {
+    CAPTURE_TRIGGER_MAGNITUDE = 0x01,
+    CAPTURE_TRIGGER_SLOPE     = 0x02,
+    CAPTURE_TRIGGER_FREE_FALL = 0x04
+} CAPTURE_TRIGGER;
+
+typedef enum {
+    CAPTURE_RECORD_EVENT = 0,
+    CAPTURE_RECORD_SAMPLES = 1
+} CAPTURE_RECORD;
+
+typedef struct {
+    uint8_t triggers;               // CAPTURE_TRIGGER mask
+    uint16_t magnitude_mg;
+    uint16_t slope_mg_per_ms;
+    uint16_t free_fall_mg;
+    uint16_t free_fall_ms;
+    uint16_t pre_ms;
+    uint16_t post_ms;
+} capture_config_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t event;
+    uint8_t trigger;                // CAPTURE_TRIGGER that opened the event
+    uint8_t triggers_seen;          // CAPTURE_TRIGGER mask of every trigger in it
+    uint16_t retriggers;            // triggers within the post window
+    uint32_t first_index;           // sample index of the first frame
+    uint16_t frames;
+    uint16_t pre_frames;            // the trigger frame is first_index + pre_frames
+    uint16_t peak_counts;           // largest |a| in the event
+    uint16_t lowest_counts;         // smallest |a| in the event
+} capture_event_record_t;
+
+#define CAPTURE_SAMPLES_HEADER_LENGTH (2 * sizeof(uint32_t) + sizeof(uint16_t))
+#define CAPTURE_FRAMES_PER_RECORD ((CAPTURE_MAX_RECORD_LENGTH - CAPTURE_SAMPLES_HEADER_LENGTH) / sizeof(mpu6050_raw_frame))
+
+typedef struct __attribute__((packed)) {
+    uint32_t event;
+    uint32_t first_index;
+    uint16_t frame_count;
+    mpu6050_raw_frame frames[CAPTURE_FRAMES_PER_RECORD];
+} capture_samples_record_t;
+
+typedef struct {
+    uint32_t events;
+    uint32_t triggers;              // all of them, captured or not
+    uint32_t retriggers;
+    uint32_t missed_triggers;       // while an event was being written out
+    uint32_t cut_events;            // post window ended early by a jump in the index or a new session
+    uint32_t overwritten_frames;    // of an event, before its record was taken
+    uint32_t records;
+    uint32_t restarts;              // jumps in the input index
+} capture_stats_t;
+
+typedef enum {
+    CAPTURE_ARMED = 0,
+    CAPTURE_POST,                   // triggered, collecting the post window
+    CAPTURE_WRITING                 // the event goes out record by record
+} CAPTURE_STATE;
+
+typedef struct {
+    capture_config_t config;
+    // thresholds in counts (squared), from the config and the session
+    uint64_t magnitude_squared;
+    uint64_t slope_squared;
+    uint64_t free_fall_squared;
+    uint32_t free_fall_samples;
+    uint32_t pre_frames;
+    uint32_t post_frames;
+    // ring: frame number n (counted from the start) is at frames[n % CAPTURE_MAX_FRAMES]
+    mpu6050_raw_frame frames[CAPTURE_MAX_FRAMES];
+    uint32_t written;
+    uint32_t history_start;         // oldest frame that may be in a pre-trigger window
+    uint32_t index_offset;          // sample index of frame n is n + index_offset
+    bool started;
+    uint32_t next_index;
+    // trigger conditions at the previous sample
+    int16_t previous[3];
+    bool has_previous;
+    uint8_t active;                 // CAPTURE_TRIGGER mask
+    uint32_t below_free_fall;       // samples in a row
+    // the event being collected or written
+    CAPTURE_STATE state;
+    capture_event_record_t event;
+    uint32_t event_start;           // frame numbers
+    uint32_t event_end;
+    uint32_t post_left;
+    uint32_t peak_squared;
+    uint32_t lowest_squared;
+    bool event_record_taken;
+    uint32_t taken;                 // frames of the event in records so far
+    union {
+        capture_event_record_t event;
+        capture_samples_record_t samples;
+    } record;
+    capture_stats_t stats;
+} capture_t;
+
+// session: the scale of the counts and the sample rate the windows are converted with
+bool capture_init(capture_t* capture, const capture_config_t* config, const mpu6050_session_t* session);
+// a new sample rate or range: ends the post window and the pre-trigger window, the event in writing goes on
+bool capture_set_session(capture_t* capture, const mpu6050_session_t* session);
+// adds one sample; returns true if a record is ready
+bool capture_add(capture_t* capture, const mpu6050_raw_frame* frame, uint32_t sample_index);
+/*
+takes the next record of a completed event, the event record first: log the first length
+bytes. Valid until the next call. Returns false if there is none
+*/
+bool capture_next_record(capture_t* capture, CAPTURE_RECORD* kind, const void** data, uint16_t* length);
+const capture_stats_t* capture_get_stats(const capture_t* capture);
+void capture_print_stats(const capture_t* capture);
+
+#endif /* CAPTURE_H */
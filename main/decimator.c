@@ -0,0 +1,191 @@
+#include "decimator.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define DECIMATOR_PI 3.14159265358979
+// cutoff of each stage as a fraction of its output rate (0.5 would be the output Nyquist frequency)
+#define DECIMATOR_CUTOFF 0.4
+
+// helpers not to be used outside of this file
+static bool design_stage(decimator_stage_t* stage);
+static void stage_restart(decimator_stage_t* stage, const mpu6050_raw_frame* frame);
+static void stage_store(decimator_stage_t* stage, const mpu6050_raw_frame* frame);
+static void stage_output(const decimator_stage_t* stage, mpu6050_raw_frame* frame);
+
+bool decimator_init(decimator_t* decimator, uint16_t input_rate_hz, const uint16_t* output_rates_hz,
+                    size_t stage_count, uint16_t taps_per_factor) {
+    if (!decimator || !output_rates_hz) {
+        printf("passed NULL pointer to decimator_init() function\n");
+        return false;
+    }
+    if (stage_count == 0 || stage_count > DECIMATOR_MAX_STAGES || taps_per_factor == 0) {
+        printf("decimator: invalid stages / taps\n");
+        return false;
+    }
+    memset(decimator, 0, sizeof(*decimator));
+    decimator->input_rate_hz = input_rate_hz;
+    decimator->stage_count = stage_count;
+    uint16_t rate_hz = input_rate_hz;
+    uint32_t total_factor = 1;
+    for (size_t s = 0; s < stage_count; s++) {
+        decimator_stage_t* stage = &decimator->stages[s];
+        if (output_rates_hz[s] == 0 || output_rates_hz[s] >= rate_hz || rate_hz % output_rates_hz[s] != 0) {
+            printf("decimator: %u Hz is not a fraction of %u Hz\n", (unsigned)output_rates_hz[s], (unsigned)rate_hz);
+            return false;
+        }
+        stage->factor = rate_hz / output_rates_hz[s];
+        total_factor *= stage->factor;
+        stage->total_factor = total_factor;
+        stage->rate_hz = output_rates_hz[s];
+        stage->taps = stage->factor * taps_per_factor + 1;
+        if (stage->taps > DECIMATOR_MAX_TAPS) {
+            printf("decimator: %u taps for stage %u, at most %d\n", (unsigned)stage->taps, (unsigned)s, DECIMATOR_MAX_TAPS);
+            return false;
+        }
+        if (!design_stage(stage)) return false;
+        rate_hz = output_rates_hz[s];
+    }
+    return true;
+}
+
+/*
+Hamming windowed sinc with its cutoff at DECIMATOR_CUTOFF of the output rate. The sum is
+made exactly 32768 (the rounding error goes to the centre tap) so a constant, like gravity
+on an axis, passes unchanged
+*/
+static bool design_stage(decimator_stage_t* stage) {
+    double cutoff = DECIMATOR_CUTOFF / stage->factor;   // cycles per input sample
+    double centre = (stage->taps - 1) / 2.0;
+    double h[DECIMATOR_MAX_TAPS], sum = 0;
+    for (int k = 0; k < stage->taps; k++) {
+        double t = k - centre;
+        double sinc = t == 0 ? 2 * cutoff : sin(2 * DECIMATOR_PI * cutoff * t) / (DECIMATOR_PI * t);
+        h[k] = sinc * (0.54 - 0.46 * cos(2 * DECIMATOR_PI * k / (stage->taps - 1)));
+        sum += h[k];
+    }
+    int32_t q15_sum = 0, absolute_sum = 0;
+    for (int k = 0; k < stage->taps; k++) {
+        stage->coefficients[k] = (int16_t)lround(h[k] / sum * 32768);
+        q15_sum += stage->coefficients[k];
+    }
+    stage->coefficients[stage->taps / 2] += (int16_t)(32768 - q15_sum);
+    for (int k = 0; k < stage->taps; k++) absolute_sum += abs(stage->coefficients[k]);
+    // the dot product of int16 inputs stays within int32 while the coefficients sum to less than 2 in magnitude
+    if (absolute_sum >= 65536) {
+        printf("decimator: stage coefficients too large (%ld)\n", (long)absolute_sum);
+        return false;
+    }
+    return true;
+}
+
+bool decimator_push(decimator_t* decimator, const mpu6050_raw_frame* frames, size_t frame_count, uint32_t first_index,
+                    decimator_output_t* outputs, size_t max_outputs, size_t* output_count) {
+    if (!decimator || !frames || !outputs || !output_count) {
+        printf("passed NULL pointer to decimator_push() function\n");
+        return false;
+    }
+    *output_count = 0;
+    for (size_t i = 0; i < frame_count; i++) {
+        uint32_t index = first_index + (uint32_t)i;
+        if (!decimator->started || index != decimator->next_index) {
+            // samples are missing: the history no longer matches the signal
+            if (decimator->started) decimator->stats.restarts++;
+            decimator->started = true;
+            for (size_t s = 0; s < decimator->stage_count; s++) decimator->stages[s].primed = false;
+        }
+        decimator->next_index = index + 1;
+        decimator->stats.inputs++;
+        // the output of a stage is the input of the next
+        mpu6050_raw_frame sample = frames[i];
+        for (size_t s = 0; s < decimator->stage_count; s++) {
+            decimator_stage_t* stage = &decimator->stages[s];
+            if (stage->primed) {
+                stage_store(stage, &sample);
+            } else {
+                stage_restart(stage, &sample);
+            }
+            if ((index + 1) % stage->total_factor != 0) break;
+            if (*output_count == max_outputs) {
+                printf("decimator: more than %u outputs\n", (unsigned)max_outputs);
+                return false;
+            }
+            stage_output(stage, &sample);
+            decimator->stats.outputs[s]++;
+            decimator->stats.multiplies += stage->taps * DECIMATOR_CHANNELS;
+            outputs[(*output_count)++] = (decimator_output_t){.stage = (uint8_t)s, .sample_index = index, .frame = sample};
+        }
+    }
+    return true;
+}
+
+// a full history of the first sample, so the output starts at its value instead of ramping up from 0
+static void stage_restart(decimator_stage_t* stage, const mpu6050_raw_frame* frame) {
+    int16_t values[DECIMATOR_CHANNELS];
+    memcpy(values, frame, sizeof(values));
+    for (int c = 0; c < DECIMATOR_CHANNELS; c++) {
+        for (int k = 0; k < 2 * stage->taps; k++) stage->history[c][k] = values[c];
+    }
+    stage->position = 0;
+    stage->primed = true;
+}
+
+static void stage_store(decimator_stage_t* stage, const mpu6050_raw_frame* frame) {
+    int16_t values[DECIMATOR_CHANNELS];
+    memcpy(values, frame, sizeof(values));
+    stage->position = stage->position + 1 == stage->taps ? 0 : stage->position + 1;
+    for (int c = 0; c < DECIMATOR_CHANNELS; c++) {
+        stage->history[c][stage->position] = values[c];
+        stage->history[c][stage->position + stage->taps] = values[c];
+    }
+}
+
+// the newest taps inputs are history[position + 1 .. position + taps]; the filter is symmetric, so the order does not matter
+static void stage_output(const decimator_stage_t* stage, mpu6050_raw_frame* frame) {
+    int16_t values[DECIMATOR_CHANNELS];
+    for (int c = 0; c < DECIMATOR_CHANNELS; c++) {
+        const int16_t* x = &stage->history[c][stage->position + 1];
+        int32_t sum = 1 << 14;
+        for (int k = 0; k < stage->taps; k++) sum += (int32_t)stage->coefficients[k] * x[k];
+        sum >>= 15;
+        values[c] = (int16_t)(sum > INT16_MAX ? INT16_MAX : (sum < INT16_MIN ? INT16_MIN : sum));
+    }
+    memcpy(frame, values, sizeof(values));
+}
+
+uint16_t decimator_get_rate_hz(const decimator_t* decimator, size_t stage) {
+    return decimator->stages[stage].rate_hz;
+}
+
+uint32_t decimator_get_total_factor(const decimator_t* decimator, size_t stage) {
+    return decimator->stages[stage].total_factor;
+}
+
+// half the taps of every stage up to this one, each in the input spacing of its stage
+uint32_t decimator_get_delay_samples(const decimator_t* decimator, size_t stage) {
+    uint32_t delay = 0;
+    for (size_t s = 0; s <= stage; s++) {
+        const decimator_stage_t* current = &decimator->stages[s];
+        delay += (current->taps - 1) / 2 * (current->total_factor / current->factor);
+    }
+    return delay;
+}
+
+const decimator_stats_t* decimator_get_stats(const decimator_t* decimator) {
+    return &decimator->stats;
+}
+
+void decimator_print_stats(const decimator_t* decimator) {
+    const decimator_stats_t* stats = &decimator->stats;
+    // what filtering every input of every stage would have cost
+    uint64_t direct = 0;
+    printf("Decimator: %llu samples at %u Hz ->", (unsigned long long)stats->inputs, (unsigned)decimator->input_rate_hz);
+    for (size_t s = 0; s < decimator->stage_count; s++) {
+        uint64_t stage_inputs = s == 0 ? stats->inputs : stats->outputs[s - 1];
+        direct += stage_inputs * decimator->stages[s].taps * DECIMATOR_CHANNELS;
+        printf(" %u Hz: %llu", (unsigned)decimator->stages[s].rate_hz, (unsigned long long)stats->outputs[s]);
+    }
+    printf(", %.1f multiplies per sample (%.1f without decimating in the filter), %lu restarts\n",
+           stats->inputs > 0 ? (double)stats->multiplies / stats->inputs : 0.0,
+           stats->inputs > 0 ? (double)direct / stats->inputs : 0.0, (unsigned long)stats->restarts);
+}
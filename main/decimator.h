@@ -0,0 +1,83 @@
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+#include "mpu6050_I2C.h"
+/*
+Polyphase FIR decimation of raw MPU6050 frames into slower streams (e.g. 1 kHz to 100 Hz
+and 10 Hz) for long term trends.
+
+The stages run in a cascade: each takes the output of the one before and decimates it by
+an integer factor, so the 10 Hz stage only filters 100 Hz samples. Each stage is a linear
+phase low pass (Hamming windowed sinc, Q15 coefficients, cutoff at 40% of its output
+rate) over a circular history of its inputs. Only the outputs that are kept are computed:
+an input is just stored, and every factor-th input one dot product over the history makes
+an output (what a polyphase filter bank does, one branch per kept output). That is
+taps / factor multiplies per input and channel instead of taps.
+
+Outputs land on a fixed grid of the input sample index: stage s outputs at the inputs whose
+index + 1 is a multiple of the product of the factors up to s, and carries that index. The
+filter delays the signal by decimator_get_delay_samples() input samples, so the output
+describes the signal around index - delay. A jump in the input index (missed samples, a
+FIFO overflow, a new motion segment) restarts the history from the first new sample.
+*/
+
+#define DECIMATOR_MAX_STAGES 3
+#define DECIMATOR_MAX_TAPS 96
+#define DECIMATOR_CHANNELS 7    // all fields of mpu6050_raw_frame
+
+typedef struct {
+    uint8_t stage;              // stream: 0 is the first (fastest) output
+    uint32_t sample_index;      // index of the input sample the output was computed at
+    mpu6050_raw_frame frame;
+} decimator_output_t;
+
+typedef struct {
+    uint16_t factor;            // inputs of this stage per output
+    uint32_t total_factor;      // input samples of the decimator per output
+    uint16_t taps;
+    uint16_t rate_hz;
+    int16_t coefficients[DECIMATOR_MAX_TAPS];   // Q15, sum 32768
+    // every input is stored twice, taps apart, so the newest taps inputs are always contiguous
+    int16_t history[DECIMATOR_CHANNELS][2 * DECIMATOR_MAX_TAPS];
+    uint16_t position;          // where the newest input was stored
+    bool primed;
+} decimator_stage_t;
+
+typedef struct {
+    uint64_t inputs;
+    uint64_t outputs[DECIMATOR_MAX_STAGES];
+    uint64_t multiplies;        // multiply accumulates of all stages
+    uint32_t restarts;          // jumps in the input index
+} decimator_stats_t;
+
+typedef struct {
+    decimator_stage_t stages[DECIMATOR_MAX_STAGES];
+    size_t stage_count;
+    uint16_t input_rate_hz;
+    uint32_t next_index;
+    bool started;
+    decimator_stats_t stats;
+} decimator_t;
+
+/*
+output_rates_hz: one per stage, fastest first; each must divide the rate before it.
+Each stage gets factor * taps_per_factor + 1 taps (odd, so the delay is whole samples):
+more taps make a sharper cutoff
+*/
+bool decimator_init(decimator_t* decimator, uint16_t input_rate_hz, const uint16_t* output_rates_hz,
+                    size_t stage_count, uint16_t taps_per_factor);
+/*
+feeds frame_count consecutive samples, frames[0] with index first_index, and stores the
+outputs they complete in outputs (in order, stages interleaved). Fails if there are more
+than max_outputs; one output per stage per decimation factor of frames is enough
+*/
+bool decimator_push(decimator_t* decimator, const mpu6050_raw_frame* frames, size_t frame_count, uint32_t first_index,
+                    decimator_output_t* outputs, size_t max_outputs, size_t* output_count);
+uint16_t decimator_get_rate_hz(const decimator_t* decimator, size_t stage);
+// input samples per output of the stage
+uint32_t decimator_get_total_factor(const decimator_t* decimator, size_t stage);
+// group delay of the stage's output in input samples
+uint32_t decimator_get_delay_samples(const decimator_t* decimator, size_t stage);
+const decimator_stats_t* decimator_get_stats(const decimator_t* decimator);
+void decimator_print_stats(const decimator_t* decimator);
+
+#endif /* DECIMATOR_H */
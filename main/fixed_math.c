@@ -0,0 +1,170 @@
+#include "fixed_math.h"
+#include <stdbool.h>
+
+#define DEG_90 (90 * FIXED_DEG_ONE)
+#define DEG_180 (180 * FIXED_DEG_ONE)
+#define ATAN_SEGMENT_BITS 7     // Q15 ratio: 256 segments of 128
+
+// atan(i / 256) in Q16 degrees
+static const int32_t atan_table[257] = {
+    0, 14668, 29335, 44001, 58666, 73329, 87990, 102648,
+    117304, 131955, 146603, 161246, 175884, 190517, 205144, 219765,
+    234379, 248986, 263585, 278177, 292760, 307334, 321899, 336454,
+    350999, 365534, 380058, 394570, 409070, 423558, 438034, 452496,
+    466945, 481380, 495801, 510207, 524598, 538973, 553333, 567676,
+    582003, 596312, 610605, 624879, 639135, 653372, 667591, 681790,
+    695970, 710129, 724268, 738387, 752484, 766560, 780613, 794645,
+    808654, 822641, 836604, 850544, 864460, 878352, 892219, 906062,
+    919879, 933671, 947438, 961178, 974893, 988580, 1002241, 1015875,
+    1029481, 1043060, 1056611, 1070133, 1083627, 1097092, 1110529, 1123936,
+    1137313, 1150661, 1163979, 1177267, 1190524, 1203751, 1216947, 1230111,
+    1243245, 1256347, 1269417, 1282455, 1295461, 1308435, 1321376, 1334285,
+    1347161, 1360004, 1372813, 1385590, 1398332, 1411041, 1423717, 1436358,
+    1448965, 1461538, 1474076, 1486580, 1499049, 1511483, 1523882, 1536246,
+    1548575, 1560868, 1573127, 1585349, 1597536, 1609687, 1621803, 1633882,
+    1645926, 1657933, 1669904, 1681839, 1693738, 1705600, 1717426, 1729215,
+    1740967, 1752683, 1764362, 1776004, 1787610, 1799179, 1810710, 1822205,
+    1833663, 1845084, 1856467, 1867814, 1879123, 1890396, 1901631, 1912829,
+    1923990, 1935113, 1946200, 1957249, 1968261, 1979236, 1990173, 2001074,
+    2011937, 2022763, 2033552, 2044303, 2055018, 2065695, 2076336, 2086939,
+    2097505, 2108034, 2118526, 2128981, 2139399, 2149780, 2160125, 2170432,
+    2180703, 2190937, 2201134, 2211295, 2221419, 2231507, 2241558, 2251572,
+    2261551, 2271492, 2281398, 2291267, 2301101, 2310898, 2320659, 2330384,
+    2340074, 2349727, 2359345, 2368927, 2378474, 2387985, 2397460, 2406901,
+    2416306, 2425675, 2435010, 2444310, 2453574, 2462804, 2471999, 2481159,
+    2490285, 2499376, 2508433, 2517455, 2526443, 2535397, 2544317, 2553203,
+    2562055, 2570873, 2579658, 2588409, 2597126, 2605811, 2614461, 2623079,
+    2631664, 2640215, 2648734, 2657220, 2665673, 2674093, 2682482, 2690837,
+    2699161, 2707452, 2715711, 2723939, 2732134, 2740298, 2748430, 2756531,
+    2764600, 2772638, 2780644, 2788620, 2796564, 2804478, 2812361, 2820213,
+    2828035, 2835826, 2843587, 2851318, 2859019, 2866690, 2874330, 2881941,
+    2889523, 2897075, 2904597, 2912090, 2919554, 2926989, 2934395, 2941772,
+    2949120
+};
+
+// 2^31 / sqrt(m) at the middle of [i, i + 1) / 64, for i = 64 .. 255 (m in [1, 4))
+static const uint32_t inv_sqrt_table[192] = {
+    2139143874, 2122751726, 2106730729, 2091067086, 2075747707, 2060760163,
+    2046092644, 2031733922, 2017673311, 2003900636, 1990406202, 1977180765,
+    1964215505, 1951502003, 1939032214, 1926798450, 1914793358, 1903009903,
+    1891441346, 1880081235, 1868923385, 1857961863, 1847190978, 1836605270,
+    1826199490, 1815968600, 1805907755, 1796012296, 1786277740, 1776699774,
+    1767274245, 1757997150, 1748864636, 1739872984, 1731018611, 1722298059,
+    1713707990, 1705245183, 1696906526, 1688689013, 1680589738, 1672605894,
+    1664734763, 1656973720, 1649320221, 1641771805, 1634326089, 1626980766,
+    1619733600, 1612582423, 1605525136, 1598559701, 1591684144, 1584896547,
+    1578195052, 1571577853, 1565043197, 1558589383, 1552214758, 1545917715,
+    1539696693, 1533550174, 1527476684, 1521474788, 1515543090, 1509680232,
+    1503884893, 1498155787, 1492491662, 1486891298, 1481353508, 1475877137,
+    1470461055, 1465104167, 1459805400, 1454563712, 1449378085, 1444247527,
+    1439171070, 1434147770, 1429176706, 1424256978, 1419387709, 1414568043,
+    1409797142, 1405074190, 1400398389, 1395768961, 1391185142, 1386646190,
+    1382151377, 1377699992, 1373291341, 1368924744, 1364599536, 1360315069,
+    1356070705, 1351865825, 1347699819, 1343572091, 1339482060, 1335429155,
+    1331412818, 1327432501, 1323487671, 1319577802, 1315702382, 1311860907,
+    1308052885, 1304277832, 1300535277, 1296824755, 1293145812, 1289498003,
+    1285880891, 1282294047, 1278737053, 1275209495, 1271710972, 1268241085,
+    1264799448, 1261385678, 1257999402, 1254640252, 1251307868, 1248001897,
+    1244721991, 1241467811, 1238239020, 1235035292, 1231856302, 1228701736,
+    1225571280, 1222464631, 1219381487, 1216321553, 1213284541, 1210270165,
+    1207278145, 1204308207, 1201360079, 1198433497, 1195528200, 1192643930,
+    1189780435, 1186937467, 1184114781, 1181312139, 1178529303, 1175766042,
+    1173022127, 1170297333, 1167591440, 1164904229, 1162235487, 1159585004,
+    1156952571, 1154337986, 1151741047, 1149161556, 1146599320, 1144054146,
+    1141525847, 1139014236, 1136519130, 1134040351, 1131577719, 1129131062,
+    1126700207, 1124284984, 1121885226, 1119500771, 1117131454, 1114777118,
+    1112437604, 1110112758, 1107802427, 1105506461, 1103224711, 1100957032,
+    1098703280, 1096463311, 1094236988, 1092024170, 1089824724, 1087638513,
+    1085465407, 1083305275, 1081157988, 1079023419, 1076901444, 1074791939
+};
+
+// helpers not to be used outside of this file
+static uint32_t inv_sqrt_normalized(uint32_t m);
+
+int32_t fixed_atan2(int32_t y, int32_t x) {
+    uint32_t ax = x < 0 ? 0u - (uint32_t)x : (uint32_t)x;
+    uint32_t ay = y < 0 ? 0u - (uint32_t)y : (uint32_t)y;
+    if ((ax | ay) == 0) return 0;
+    // first octant: the smaller over the larger
+    bool swapped = ay > ax;
+    uint32_t numerator = swapped ? ax : ay;
+    uint32_t denominator = swapped ? ay : ax;
+    int shift = 16 - __builtin_clz(denominator);
+    if (shift > 0) {
+        numerator >>= shift;
+        denominator >>= shift;
+    }
+    uint32_t ratio = ((numerator << 15) + denominator / 2) / denominator;
+    uint32_t segment = ratio >> ATAN_SEGMENT_BITS;
+    uint32_t fraction = ratio & ((1 << ATAN_SEGMENT_BITS) - 1);
+    int32_t angle = atan_table[segment];
+    if (fraction != 0) {
+        angle += ((atan_table[segment + 1] - angle) * (int32_t)fraction + (1 << (ATAN_SEGMENT_BITS - 1))) >> ATAN_SEGMENT_BITS;
+    }
+    if (swapped) angle = DEG_90 - angle;
+    if (x < 0) angle = DEG_180 - angle;
+    return y < 0 ? -angle : angle;
+}
+
+uint32_t fixed_sqrt32(uint32_t x) {
+    return fixed_sqrt64(x);
+}
+
+/*
+sqrt(m * 2^shift) = m / sqrt(m) * 2^(shift / 2) from the inverse square root, which is
+within a few units of the root for any x; the last steps make it exactly the floor
+*/
+uint32_t fixed_sqrt64(uint64_t x) {
+    if (x == 0) return 0;
+    int shift = (63 - __builtin_clzll(x)) - 31;
+    shift += shift & 1;
+    uint32_t m = (uint32_t)(shift >= 0 ? x >> shift : x << -shift);
+    // m / sqrt(m / 2^30) is sqrt(m) * 2^15
+    uint64_t root = ((uint64_t)m * inv_sqrt_normalized(m)) >> 31;
+    int exponent = shift / 2 - 15;
+    root = exponent >= 0 ? root << exponent : root >> -exponent;
+    if (root > UINT32_MAX) root = UINT32_MAX;
+    while (root * root > x) root--;
+    while (root < UINT32_MAX && (root + 1) * (root + 1) <= x) root++;
+    return (uint32_t)root;
+}
+
+uint32_t fixed_sqrt_q16(uint32_t x) {
+    return fixed_sqrt64((uint64_t)x << 16);
+}
+
+/*
+x = m * 2^shift with shift even and m in [2^30, 2^32), so 1 / sqrt(x) is
+1 / sqrt(m / 2^30) * 2^-15 * 2^(-shift / 2)
+*/
+uint64_t fixed_inv_sqrt64(uint64_t x, int fraction_bits) {
+    if (x == 0) return 0;
+    int shift = (63 - __builtin_clzll(x)) - 31;
+    shift += shift & 1;
+    uint32_t m = (uint32_t)(shift >= 0 ? x >> shift : x << -shift);
+    uint64_t inverse = inv_sqrt_normalized(m);
+    // inverse is Q31
+    int exponent = fraction_bits - 46 - shift / 2;
+    if (exponent >= 0) return inverse << exponent;
+    return exponent < -32 ? 0 : (inverse + ((uint64_t)1 << (-exponent - 1))) >> -exponent;
+}
+
+uint32_t fixed_inv_sqrt_q16(uint32_t x) {
+    if (x == 0) return UINT32_MAX;
+    // 1 / sqrt(x / 2^16) * 2^16 = 2^24 / sqrt(x)
+    return (uint32_t)fixed_inv_sqrt64(x, 24);
+}
+
+/*
+1 / sqrt(m / 2^30) in Q31 for m in [2^30, 2^32): a table guess within 0.2%, then two
+Newton steps y = y (3 - m y^2) / 2, each squaring the relative error
+*/
+static uint32_t inv_sqrt_normalized(uint32_t m) {
+    uint64_t y = inv_sqrt_table[(m >> 24) - 64];
+    for (int i = 0; i < 2; i++) {
+        uint64_t y_squared = (y * y) >> 31;                 // Q31
+        uint64_t m_y_squared = ((uint64_t)m * y_squared) >> 30;  // Q31, about 1
+        y = (y * (((uint64_t)3 << 31) - m_y_squared)) >> 32;
+    }
+    return (uint32_t)y;
+}
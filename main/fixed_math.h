@@ -0,0 +1,39 @@
+#ifndef FIXED_MATH_H
+#define FIXED_MATH_H
+#include <stdint.h>
+/*
+Integer replacements for atan2f, sqrtf and 1 / sqrtf in the per sample paths. On the
+ESP32 all three are library routines (the FPU only has seed steps for divide and square
+root), and so is a 64 bit division.
+
+- fixed_atan2: octant reduction to a ratio in [0, 1] (one 32 bit division), then a table
+  of 257 atan values with linear interpolation. Q16 degrees, (-180, 180]. Any int32
+  inputs; the larger one is cut to 16 bits, so the error is at most
+  FIXED_ATAN2_MAX_ERROR (0.003 degrees measured, from the ratio; the table and the
+  interpolation alone are within 0.0001)
+- fixed_sqrt32 / fixed_sqrt64: floor(sqrt(x)), exact: x times its inverse square root,
+  corrected by the few units it can be off. fixed_sqrt_q16 is the same for Q16 numbers
+- fixed_inv_sqrt64: 2^fraction_bits / sqrt(x) from a 192 entry table and two Newton steps,
+  no division. Relative error below FIXED_INV_SQRT_MAX_ERROR (2^-29) before the result
+  is rounded to fraction_bits. fixed_inv_sqrt_q16 is the same for Q16 numbers
+
+host/fixed_math_test.c checks these bounds against the C library over the whole input
+range and times every function against its float counterpart.
+*/
+
+#define FIXED_DEG_ONE (1 << 16)             // Q16 degrees, like orientation.h
+#define FIXED_ATAN2_MAX_ERROR 0.003         // degrees
+#define FIXED_INV_SQRT_MAX_ERROR 1.9e-9     // relative
+
+// angle of (x, y) in Q16 degrees, (-180, 180]; 0 for (0, 0)
+int32_t fixed_atan2(int32_t y, int32_t x);
+uint32_t fixed_sqrt32(uint32_t x);
+uint32_t fixed_sqrt64(uint64_t x);
+// square root of a Q16 number, in Q16 (floor)
+uint32_t fixed_sqrt_q16(uint32_t x);
+// 2^fraction_bits / sqrt(x), rounded; fraction_bits up to 62 as long as the result fits. 0 for x = 0
+uint64_t fixed_inv_sqrt64(uint64_t x, int fraction_bits);
+// 1 / sqrt of a Q16 number, in Q16; UINT32_MAX for 0
+uint32_t fixed_inv_sqrt_q16(uint32_t x);
+
+#endif /* FIXED_MATH_H */
@@ -0,0 +1,160 @@
+#include "goertzel.h"
+#include <string.h>
+#include <math.h>
+
+#define GOERTZEL_PI 3.14159265358979
+
+// helpers not to be used outside of this file
+static bool tune(goertzel_bank_t* bank, goertzel_target_t* target, float frequency_hz);
+static void finish_block(goertzel_bank_t* bank);
+static void start_block(goertzel_bank_t* bank);
+static int64_t multiply_q30(int32_t coefficient, int64_t state);
+
+bool goertzel_init(goertzel_bank_t* bank, uint16_t sample_rate_hz, uint16_t block_length,
+                   const float* frequencies_hz, size_t target_count) {
+    if (!bank || !frequencies_hz) {
+        printf("passed NULL pointer to goertzel_init() function\n");
+        return false;
+    }
+    if (block_length < GOERTZEL_MIN_BLOCK || block_length > GOERTZEL_MAX_BLOCK ||
+        target_count == 0 || target_count > GOERTZEL_MAX_TARGETS) {
+        printf("goertzel: %u samples per block / %u targets not supported\n", (unsigned)block_length, (unsigned)target_count);
+        return false;
+    }
+    memset(bank, 0, sizeof(*bank));
+    bank->sample_rate_hz = sample_rate_hz;
+    bank->block_length = block_length;
+    bank->target_count = target_count;
+    for (size_t t = 0; t < target_count; t++) {
+        if (!tune(bank, &bank->targets[t], frequencies_hz[t])) return false;
+    }
+    return true;
+}
+
+static bool tune(goertzel_bank_t* bank, goertzel_target_t* target, float frequency_hz) {
+    if (!(frequency_hz > 0) || frequency_hz >= bank->sample_rate_hz / 2.0f) {
+        printf("goertzel: %.2f Hz is not between 0 and %u Hz\n", frequency_hz, (unsigned)(bank->sample_rate_hz / 2));
+        return false;
+    }
+    target->frequency_hz = frequency_hz;
+    double coefficient = 2 * cos(2 * GOERTZEL_PI * frequency_hz / bank->sample_rate_hz) * (1 << 30);
+    // 2.0 itself would not fit, but only a frequency of 0 gets there
+    target->coefficient = (int32_t)(coefficient >= INT32_MAX ? INT32_MAX : lround(coefficient));
+    return true;
+}
+
+bool goertzel_set_target(goertzel_bank_t* bank, size_t target, float frequency_hz) {
+    if (target >= bank->target_count || !(frequency_hz > 0) || frequency_hz >= bank->sample_rate_hz / 2.0f) {
+        printf("goertzel: cannot set target %u to %.2f Hz\n", (unsigned)target, frequency_hz);
+        return false;
+    }
+    bank->targets[target].pending_hz = frequency_hz;
+    return true;
+}
+
+bool goertzel_add(goertzel_bank_t* bank, const mpu6050_raw_frame* frame, uint32_t sample_index) {
+    if (bank->count > 0 && sample_index != bank->next_index) {
+        // a block with a hole in it does not measure the frequency it was tuned to
+        bank->stats.restarts++;
+        bank->count = 0;
+    }
+    if (!bank->has_offset) {
+        for (int c = 0; c < GOERTZEL_CHANNELS; c++) bank->offset[c] = frame->accel[c];
+        bank->has_offset = true;
+    }
+    if (bank->count == 0) {
+        start_block(bank);
+        bank->block_first_index = sample_index;
+    }
+    for (int c = 0; c < GOERTZEL_CHANNELS; c++) {
+        int32_t x = frame->accel[c] - bank->offset[c];
+        bank->sum[c] += frame->accel[c];
+        for (size_t t = 0; t < bank->target_count; t++) {
+            goertzel_target_t* target = &bank->targets[t];
+            int64_t s = x + multiply_q30(target->coefficient, target->s1[c]) - target->s2[c];
+            target->s2[c] = target->s1[c];
+            target->s1[c] = s;
+        }
+    }
+    bank->next_index = sample_index + 1;
+    bank->stats.samples++;
+    if (++bank->count < bank->block_length) return false;
+    finish_block(bank);
+    bank->count = 0;
+    return true;
+}
+
+// clears the states and applies the retunes that came in during the last block
+static void start_block(goertzel_bank_t* bank) {
+    for (size_t t = 0; t < bank->target_count; t++) {
+        goertzel_target_t* target = &bank->targets[t];
+        if (target->pending_hz > 0) {
+            tune(bank, target, target->pending_hz);
+            target->pending_hz = 0;
+            bank->stats.retunes++;
+        }
+        memset(target->s1, 0, sizeof(target->s1));
+        memset(target->s2, 0, sizeof(target->s2));
+    }
+    memset(bank->sum, 0, sizeof(bank->sum));
+}
+
+/*
+|X|^2 = s1^2 + s2^2 - 2 cos(w) s1 s2 is the DFT of the block at the target frequency
+(any frequency, not only bins); a sine of amplitude A there gives |X| = A * N / 2
+*/
+static void finish_block(goertzel_bank_t* bank) {
+    double scale = 2.0 / bank->block_length;
+    for (size_t t = 0; t < bank->target_count; t++) {
+        const goertzel_target_t* target = &bank->targets[t];
+        double coefficient = target->coefficient / (double)(1 << 30);
+        for (int c = 0; c < GOERTZEL_CHANNELS; c++) {
+            double s1 = (double)target->s1[c], s2 = (double)target->s2[c];
+            double power = s1 * s1 + s2 * s2 - coefficient * s1 * s2;
+            bank->last_amplitude[t][c] = (float)(sqrt(power > 0 ? power : 0) * scale);
+        }
+        bank->last_frequency_hz[t] = target->frequency_hz;
+    }
+    bank->last_first_index = bank->block_first_index;
+    // the mean of this block is the offset of the next: gravity out before it can leak into the targets
+    for (int c = 0; c < GOERTZEL_CHANNELS; c++) {
+        int64_t sum = bank->sum[c];
+        bank->offset[c] = (int32_t)((sum >= 0 ? sum + bank->block_length / 2 : sum - bank->block_length / 2) / bank->block_length);
+    }
+    bank->stats.blocks++;
+}
+
+/*
+(coefficient * state) >> 30 without overflowing 64 bits: the state is split at bit 15, so
+both products stay within 2^31 * 2^32 for any state below 2^47 (a full block of full scale
+samples at the lowest target stays under 2^40)
+*/
+static int64_t multiply_q30(int32_t coefficient, int64_t state) {
+    int64_t high = state >> 15;
+    int32_t low = (int32_t)(state & 0x7FFF);
+    return ((int64_t)coefficient * high + (((int64_t)coefficient * low) >> 15)) >> 15;
+}
+
+size_t goertzel_get_target_count(const goertzel_bank_t* bank) {
+    return bank->target_count;
+}
+
+uint16_t goertzel_get_block_length(const goertzel_bank_t* bank) {
+    return bank->block_length;
+}
+
+uint32_t goertzel_get_first_index(const goertzel_bank_t* bank) {
+    return bank->last_first_index;
+}
+
+float goertzel_get_frequency_hz(const goertzel_bank_t* bank, size_t target) {
+    return bank->last_frequency_hz[target];
+}
+
+float goertzel_get_amplitude(const goertzel_bank_t* bank, size_t target, int channel) {
+    return bank->last_amplitude[target][channel];
+}
+
+const goertzel_stats_t* goertzel_get_stats(const goertzel_bank_t* bank) {
+    return &bank->stats;
+}
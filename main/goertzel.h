@@ -0,0 +1,84 @@
+#ifndef GOERTZEL_H
+#define GOERTZEL_H
+#include "mpu6050_I2C.h"
+/*
+A bank of Goertzel filters: the amplitude of a few chosen frequencies of the accelerometer
+axes (e.g. a shaft rate and its harmonics), block by block, for when a full spectrum
+would be wasted work.
+
+Every sample runs one step of the recurrence s = x + 2 cos(w) s1 - s2 per target and axis
+(one multiply); at the end of a block of block_length samples the amplitude of each target
+comes from the last two states. The targets can be any frequency below half the sample
+rate, not only FFT bins, and can be changed while running: a new frequency applies from
+the next block.
+
+- the coefficients are Q30 and the states int64, so a block of GOERTZEL_MAX_BLOCK full
+  scale samples at a target cannot overflow
+- the block is not windowed, so a constant would leak into every target. Gravity is
+  removed first: each block subtracts the mean of the block before (the first block the
+  first sample), which also keeps the states small
+- the amplitude of a sine of A counts at a target is A; its frequency resolution is about
+  sample rate / block_length
+
+Samples are fed with their sample index; a jump in the index (missed samples, a FIFO
+overflow) starts the current block over.
+*/
+
+#define GOERTZEL_MAX_TARGETS 8
+#define GOERTZEL_CHANNELS 3         // accel x, y, z
+#define GOERTZEL_MIN_BLOCK 16
+#define GOERTZEL_MAX_BLOCK 4096
+
+typedef struct {
+    float frequency_hz;
+    int32_t coefficient;        // Q30 2 cos(2 pi frequency / sample rate)
+    int64_t s1[GOERTZEL_CHANNELS];
+    int64_t s2[GOERTZEL_CHANNELS];
+    float pending_hz;           // applied at the start of the next block, 0 if none
+} goertzel_target_t;
+
+typedef struct {
+    uint64_t samples;
+    uint32_t blocks;
+    uint32_t restarts;          // jumps in the input index
+    uint32_t retunes;           // target frequency changes applied
+} goertzel_stats_t;
+
+typedef struct {
+    uint16_t sample_rate_hz;
+    uint16_t block_length;
+    size_t target_count;
+    goertzel_target_t targets[GOERTZEL_MAX_TARGETS];
+    int32_t offset[GOERTZEL_CHANNELS];  // removed from the samples of this block
+    int64_t sum[GOERTZEL_CHANNELS];     // of this block, for the offset of the next
+    bool has_offset;
+    uint16_t count;             // samples in this block
+    uint32_t next_index;
+    uint32_t block_first_index;
+    // the last completed block
+    uint32_t last_first_index;
+    float last_frequency_hz[GOERTZEL_MAX_TARGETS];
+    float last_amplitude[GOERTZEL_MAX_TARGETS][GOERTZEL_CHANNELS];
+    goertzel_stats_t stats;
+} goertzel_bank_t;
+
+/*
+block_length: samples per block, GOERTZEL_MIN_BLOCK to GOERTZEL_MAX_BLOCK. frequencies_hz:
+target_count targets (1 to GOERTZEL_MAX_TARGETS), each above 0 and below sample_rate_hz / 2.
+Call again for a new sample rate (starts over)
+*/
+bool goertzel_init(goertzel_bank_t* bank, uint16_t sample_rate_hz, uint16_t block_length,
+                   const float* frequencies_hz, size_t target_count);
+// retunes one target; the running block finishes at the old frequency
+bool goertzel_set_target(goertzel_bank_t* bank, size_t target, float frequency_hz);
+// adds one sample; returns true if it completed a block, whose amplitudes are then in goertzel_get_amplitude()
+bool goertzel_add(goertzel_bank_t* bank, const mpu6050_raw_frame* frame, uint32_t sample_index);
+size_t goertzel_get_target_count(const goertzel_bank_t* bank);
+uint16_t goertzel_get_block_length(const goertzel_bank_t* bank);
+// of the last completed block: the sample index of its first sample, the frequency and the amplitude (counts) of a target
+uint32_t goertzel_get_first_index(const goertzel_bank_t* bank);
+float goertzel_get_frequency_hz(const goertzel_bank_t* bank, size_t target);
+float goertzel_get_amplitude(const goertzel_bank_t* bank, size_t target, int channel);
+const goertzel_stats_t* goertzel_get_stats(const goertzel_bank_t* bank);
+
+#endif /* GOERTZEL_H */
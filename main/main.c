@@ -1,5 +1,7 @@
 #include <stdio.h>
 #include <inttypes.h>
+#include <string.h>
+#include <math.h>
 #include "sdkconfig.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -7,12 +9,534 @@
 #include "esp_flash.h"
 #include "esp_system.h"
 #include "esp_rtc_time.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
 
 // custom libraries
 // #include "my_SPI.h"
 #include "ssd1306_I2C.h"
 #include "mpu6050_I2C.h"
 #include "SD_card_SPI.h"
+#include "SD_log.h"
+#include "motion_gate.h"
+#include "sample_clock.h"
+#include "adaptive_rate.h"
+#include "orientation.h"
+#include "decimator.h"
+#include "window_stats.h"
+#include "spectrum.h"
+#include "goertzel.h"
+#include "rollup.h"
+#include "capture.h"
+#include "velocity.h"
+#include "rice_codec.h"
+#include "sample_packer.h"
+
+// the card is used raw: the log superblocks live here and the log runs to the end of the card.
+// the log is circular, so once the card is full the oldest data is overwritten
+#define LOG_REGION_START_BLOCK 8192
+// seal and write the log this often so at most this much data is lost on power failure
+#define LOG_FLUSH_INTERVAL_LOOPS 100
+// set to 0 to compare write stall statistics without background pre-erase
+#define LOG_PREERASE_ENABLED 1
+#define LOG_STATS_INTERVAL_LOOPS 1000
+
+// the MPU_ switches below can also be set from the build (-DMPU_SPECTRUM=1); host/main_check.sh turns each of them on
+
+/*
+0: drain the MPU6050 FIFO when it is about half full, at most every MPU_FIFO_PASS_MAX_MS (gap
+free at 1 kHz, times only from the sample clock)
+1: one read per MPU6050 data-ready interrupt, timestamped in the ISR, at MPU_DATA_READY_RATE_HZ
+(the OLED is updated per interrupt too, which keeps that rate low)
+Either way samples are logged by sample index; their times come from the anchors (see sample_clock.h)
+*/
+#ifndef MPU_SAMPLING_DATA_READY
+#define MPU_SAMPLING_DATA_READY 0
+#endif
+#define MPU_INT_PIN GPIO_NUM_4
+// one sample (and one OLED page) per interrupt has to fit in a sample period
+#define MPU_DATA_READY_RATE_HZ 100
+#define MPU_DATA_READY_TIMEOUT_MS 100
+// channels that cross the bus; e.g. MPU6050_CHANNEL_ACCEL alone moves 6 of the 14 bytes per sample
+#ifndef MPU_CHANNELS
+#define MPU_CHANNELS MPU6050_CHANNEL_ALL
+#endif
+// the temperature only feeds the display, once a second is plenty
+#define MPU_TEMPERATURE_INTERVAL_MS 1000
+// longest FIFO pass at slow rates, 20 display refreshs/sec -- refresh_display() takes about 14 ms
+#define MPU_FIFO_PASS_MAX_MS 50
+/*
+1: a second MPU6050 (AD0 high, 0x69) on the same bus, read together with the first on every
+data-ready interrupt of the first (needs MPU_SAMPLING_DATA_READY). Its INT pin only measures
+how far apart the two samples of a pair were taken; GPIO_NUM_NC if it is not wired
+*/
+#ifndef MPU_DUAL_SENSORS
+#define MPU_DUAL_SENSORS 0
+#endif
+#define MPU_INT_PIN_2 GPIO_NUM_15
+// how often a sample's time is logged as a sample clock anchor
+#define MPU_ANCHOR_INTERVAL_MS 1000
+/*
+1: step the sample rate and DLPF between the tiers below with the signal energy (see
+adaptive_rate.h; not with MPU_DUAL_SENSORS). Every change is logged as a RATE_CHANGE record
+followed by the new session
+*/
+#ifndef MPU_ADAPTIVE_RATE
+#define MPU_ADAPTIVE_RATE 0
+#endif
+#define MPU_ADAPTIVE_WINDOW_MS 250
+// quiet windows before stepping down: 2 s
+#define MPU_ADAPTIVE_DOWN_HOLD_WINDOWS 8
+/*
+1: roll, pitch and heading from every sample (orientation.h; not with MPU_DUAL_SENSORS, and
+MPU_CHANNELS has to include accel and gyro). The display shows them instead of the raw
+axes, and they are logged as ORIENTATION records
+*/
+#ifndef MPU_ORIENTATION
+#define MPU_ORIENTATION 0
+#endif
+// 1: Madgwick filter, 0: complementary filter
+#ifndef MPU_ORIENTATION_MADGWICK
+#define MPU_ORIENTATION_MADGWICK 1
+#endif
+#define MPU_ORIENTATION_BETA 0.05f
+#define MPU_ORIENTATION_TIME_CONSTANT_S 1.0f
+#define MPU_ORIENTATION_LOG_INTERVAL_MS 100
+// a tenth of a 1 kHz sample period at 240 MHz; updates over it are counted
+#define MPU_ORIENTATION_CYCLE_BUDGET 24000
+/*
+1: low pass filter and decimate every sample into the slower streams below (decimator.h;
+not with MPU_DUAL_SENSORS or MPU_ADAPTIVE_RATE), each logged as DECIMATED_SAMPLES records
+of its own
+*/
+#ifndef MPU_DECIMATION
+#define MPU_DECIMATION 0
+#endif
+#define MPU_DECIMATION_TAPS_PER_FACTOR 8
+// 0: only the decimated streams (or captured events) go to the card, with the clock anchors that time them
+#ifndef MPU_LOG_FULL_RATE
+#define MPU_LOG_FULL_RATE 1
+#endif
+/*
+1: the full rate samples go to the card losslessly compressed (rice_codec.h: per channel
+deltas, Rice coded per block) as RICE_SAMPLES records instead of INDEXED_RAW_SAMPLES, about
+a third of the bytes and so of the sector writes for a sensor at rest or vibrating
+*/
+#ifndef MPU_LOG_COMPRESSED
+#define MPU_LOG_COMPRESSED 0
+#endif
+/*
+1: the full rate samples go to the card with only the top bits of each channel that are
+worth keeping (sample_packer.h, LOG_PACKED_BITS) as PACKED_SAMPLES records, not with
+MPU_LOG_COMPRESSED. Lossy below the noise: 12 bit accelerometer counts are 3.9 mg steps at
+8 g against about 4 mg of noise, 14 bit gyro counts 0.12 deg/s at 1000 deg/s
+*/
+#ifndef MPU_LOG_PACKED
+#define MPU_LOG_PACKED 0
+#endif
+/*
+1: statistics of every sample instead of single ones (window_stats.h; not with
+MPU_DUAL_SENSORS). The display shows the mean and peak to peak acceleration over the last
+MPU_STATS_SLIDING_MS (unless MPU_ORIENTATION has it), and a WINDOW_SUMMARY record with all
+channels goes in the log every MPU_STATS_SUMMARY_MS
+*/
+#ifndef MPU_WINDOW_STATS
+#define MPU_WINDOW_STATS 0
+#endif
+#define MPU_STATS_SLIDING_MS 500
+#define MPU_STATS_SUMMARY_MS 1000
+/*
+1: vibration spectra of the accelerometer axes (spectrum.h; not with MPU_DUAL_SENSORS):
+Hann windows of 2^MPU_SPECTRUM_LOG2_POINTS samples overlapping by half, MPU_SPECTRUM_AVERAGES
+of them averaged into one SPECTRUM record per axis. The CPU cycles of every window are
+measured and printed with the highest sample rate they would allow
+*/
+#ifndef MPU_SPECTRUM
+#define MPU_SPECTRUM 0
+#endif
+#define MPU_SPECTRUM_LOG2_POINTS 9
+#define MPU_SPECTRUM_AVERAGES 8
+/*
+1: amplitudes of a few known frequencies only (goertzel.h; not with MPU_DUAL_SENSORS): the
+shaft rate MPU_GOERTZEL_SHAFT_HZ and its harmonics up to MPU_GOERTZEL_HARMONICS (those below
+half the sample rate), one TONES record per block of MPU_GOERTZEL_BLOCK_MS. The cycles per
+sample are printed to compare with MPU_SPECTRUM
+*/
+#ifndef MPU_GOERTZEL
+#define MPU_GOERTZEL 0
+#endif
+#define MPU_GOERTZEL_SHAFT_HZ 24.5f
+#define MPU_GOERTZEL_HARMONICS 4
+#define MPU_GOERTZEL_BLOCK_MS 1000
+/*
+1: min/max/mean of every channel per second, minute and hour (rollup.h; not with
+MPU_DUAL_SENSORS), each level a stream of ROLLUP records of its own next to the samples,
+chained back through the sector sequences so a reader can draw a month from a few hundred
+sectors. A second is the current sample rate in samples; the levels above are
+rollup_factors entries of the one below
+*/
+#ifndef MPU_ROLLUP
+#define MPU_ROLLUP 0
+#endif
+/*
+1: triggered capture of shocks (capture.h; not with MPU_DUAL_SENSORS): the last
+MPU_CAPTURE_PRE_MS of samples stay in a RAM ring, and a trigger (capture_config) logs them
+and MPU_CAPTURE_POST_MS after it as an EVENT record and its EVENT_SAMPLES records. With
+MPU_LOG_FULL_RATE 0 that is all that is logged at full rate
+*/
+#ifndef MPU_CAPTURE
+#define MPU_CAPTURE 0
+#endif
+#define MPU_CAPTURE_PRE_MS 200
+#define MPU_CAPTURE_POST_MS 500
+/*
+1: vibration velocity RMS in mm/s (velocity.h; not with MPU_DUAL_SENSORS): the acceleration
+band limited to MPU_VELOCITY_LOW_HZ .. MPU_VELOCITY_HIGH_HZ (or 0.45 of the sample rate) and
+integrated, one VELOCITY record (RMS per axis and overall) per MPU_VELOCITY_WINDOW_MS. The
+cycles per sample are printed against the sample period
+*/
+#ifndef MPU_VELOCITY
+#define MPU_VELOCITY 0
+#endif
+#define MPU_VELOCITY_LOW_HZ 10
+#define MPU_VELOCITY_HIGH_HZ 1000
+#define MPU_VELOCITY_WINDOW_MS 1000
+
+static mpu6050_t imu_global;
+#if MPU_DUAL_SENSORS
+static mpu6050_t imu_2_global;
+static mpu6050_pair_t imu_pair_global;
+#endif
+
+/*
+1: FIFO sampling (MPU_SAMPLING_DATA_READY 0) only while there is motion. In between the MPU6050
+sits in low power mode and nothing is read, logged or displayed. Each stretch of motion is a
+log segment between SEGMENT_START and SEGMENT_END records
+*/
+#ifndef MPU_MOTION_GATED
+#define MPU_MOTION_GATED 0
+#endif
+#define MPU_MOTION_THRESHOLD_MG 60
+#define MPU_MOTION_DURATION_MS 5
+// the segment ends after this long without motion
+#define MPU_MOTION_QUIET_PERIOD_MS 3000
+// longest sleep while idle; bounds how stale the printed statistics get
+#define MPU_MOTION_IDLE_POLL_MS 10000
+/*
+while idle the card pre-erases one AU per pass, with a motion wait of one tick in between
+while an erase runs. The erase may hold up the first writes of the next segment this long
+*/
+#define MPU_MOTION_IDLE_ERASE_BUDGET_MS 50
+#define MPU_MOTION_IDLE_ERASE_POLL_MS 10
+
+// combinations the loops below do not handle fail here, rather than leaving a feature out
+#if MPU_DUAL_SENSORS && !MPU_SAMPLING_DATA_READY
+#error "MPU_DUAL_SENSORS needs MPU_SAMPLING_DATA_READY 1"
+#endif
+#if MPU_DUAL_SENSORS && (MPU_ADAPTIVE_RATE || MPU_ORIENTATION || MPU_DECIMATION || MPU_WINDOW_STATS || MPU_SPECTRUM || \
+                         MPU_GOERTZEL || MPU_ROLLUP || MPU_CAPTURE || MPU_VELOCITY)
+#error "MPU_DUAL_SENSORS only logs the sample pairs: no MPU_ADAPTIVE_RATE and no sample stages"
+#endif
+#if MPU_DUAL_SENSORS && (MPU_LOG_COMPRESSED || MPU_LOG_PACKED || !MPU_LOG_FULL_RATE)
+#error "MPU_DUAL_SENSORS logs every pair as it is (MPU_LOG_FULL_RATE 1, no MPU_LOG_COMPRESSED or MPU_LOG_PACKED)"
+#endif
+#if MPU_MOTION_GATED && MPU_SAMPLING_DATA_READY
+#error "MPU_MOTION_GATED needs FIFO sampling (MPU_SAMPLING_DATA_READY 0)"
+#endif
+#if MPU_DECIMATION && MPU_ADAPTIVE_RATE
+#error "MPU_DECIMATION needs a fixed sample rate (not with MPU_ADAPTIVE_RATE)"
+#endif
+#if MPU_LOG_COMPRESSED && MPU_LOG_PACKED
+#error "MPU_LOG_COMPRESSED and MPU_LOG_PACKED are two formats for the same samples: choose one"
+#endif
+#if (MPU_LOG_COMPRESSED || MPU_LOG_PACKED) && !MPU_LOG_FULL_RATE
+#error "MPU_LOG_COMPRESSED and MPU_LOG_PACKED apply to the full rate samples (MPU_LOG_FULL_RATE 1)"
+#endif
+#if MPU_ORIENTATION
+_Static_assert((MPU_CHANNELS & (MPU6050_CHANNEL_ACCEL | MPU6050_CHANNEL_GYRO)) == (MPU6050_CHANNEL_ACCEL | MPU6050_CHANNEL_GYRO),
+               "MPU_ORIENTATION needs accel and gyro in MPU_CHANNELS");
+#endif
+#if MPU_ADAPTIVE_RATE || MPU_SPECTRUM || MPU_GOERTZEL || MPU_CAPTURE || MPU_VELOCITY
+_Static_assert(MPU_CHANNELS & MPU6050_CHANNEL_ACCEL, "the acceleration stages need accel in MPU_CHANNELS");
+#endif
+
+#if !MPU_SAMPLING_DATA_READY
+// samples collected by the MPU6050 FIFO between two passes of the main loop
+static mpu6050_raw_frame fifo_frames_global[MPU6050_FIFO_MAX_FRAMES];
+#if MPU_MOTION_GATED
+static motion_gate_t motion_gate_global;
+#endif
+#endif
+#if !MPU_DUAL_SENSORS
+// pairs keep a timestamp each instead
+static sample_clock_t sample_clock_global;
+#endif
+#if MPU_ADAPTIVE_RATE
+// slowest first. Each DLPF cutoff stays below half its rate
+static const adaptive_rate_tier_t adaptive_rate_tiers[] = {
+#if MPU_SAMPLING_DATA_READY
+    // one read (and OLED line) per interrupt: MPU_DATA_READY_RATE_HZ is the ceiling
+    {.sample_rate_hz = 25,  .DLPF = MPU6050_DLPF_10_HZ, .up_rms_mg = 30.0f,  .down_rms_mg = 0.0f},
+    {.sample_rate_hz = 50,  .DLPF = MPU6050_DLPF_21_HZ, .up_rms_mg = 150.0f, .down_rms_mg = 15.0f},
+    {.sample_rate_hz = MPU_DATA_READY_RATE_HZ, .DLPF = MPU6050_DLPF_44_HZ, .up_rms_mg = 0.0f, .down_rms_mg = 80.0f}
+#else
+    {.sample_rate_hz = 100,  .DLPF = MPU6050_DLPF_44_HZ,  .up_rms_mg = 30.0f,  .down_rms_mg = 0.0f},
+    {.sample_rate_hz = 250,  .DLPF = MPU6050_DLPF_94_HZ,  .up_rms_mg = 150.0f, .down_rms_mg = 15.0f},
+    {.sample_rate_hz = 1000, .DLPF = MPU6050_DLPF_184_HZ, .up_rms_mg = 0.0f,   .down_rms_mg = 80.0f}
+#endif
+};
+#define ADAPTIVE_RATE_TIER_COUNT (sizeof(adaptive_rate_tiers) / sizeof(adaptive_rate_tiers[0]))
+static adaptive_rate_t adaptive_rate_global;
+#endif
+#if MPU_ORIENTATION
+#if MPU_ORIENTATION_MADGWICK
+static orientation_madgwick_t orientation_global;
+#else
+static orientation_complementary_t orientation_global;
+#endif
+// angles after the newest sample, for the display
+static orientation_euler_t orientation_euler_global;
+static uint32_t orientation_next_log_index_global;
+// CPU cycles per filter update
+static struct {
+    uint64_t total;
+    uint32_t max;
+    uint32_t over_budget;
+} orientation_cycles_global;
+#endif
+#if MPU_DECIMATION
+// fastest first, each a whole fraction of the one before
+static const uint16_t decimated_rates_hz[] = {
+#if MPU_SAMPLING_DATA_READY
+    10, 1
+#else
+    100, 10
+#endif
+};
+#define DECIMATED_STREAM_COUNT (sizeof(decimated_rates_hz) / sizeof(decimated_rates_hz[0]))
+static decimator_t decimator_global;
+// outputs of one pass: a full FIFO burst completes at most 8 per stream at 1 kHz in
+#define DECIMATOR_MAX_OUTPUTS 16
+static decimator_output_t decimator_outputs_global[DECIMATOR_MAX_OUTPUTS];
+// stream, factor, delay and first index; the decimated frames follow
+#define LOG_DECIMATED_HEADER_LENGTH 9
+#define LOG_DECIMATED_FRAMES_PER_RECORD ((SD_LOG_MAX_RECORD_LENGTH - LOG_DECIMATED_HEADER_LENGTH) / sizeof(mpu6050_raw_frame))
+// one record being filled per stream, flushed when full or when the stream jumps
+static struct __attribute__((packed)) {
+    uint8_t stream;
+    uint16_t factor;
+    uint16_t delay_samples;
+    uint32_t first_index;
+    mpu6050_raw_frame frames[LOG_DECIMATED_FRAMES_PER_RECORD];
+} decimated_records_global[DECIMATED_STREAM_COUNT];
+static size_t decimated_frames_global[DECIMATED_STREAM_COUNT];
+#endif
+#if MPU_WINDOW_STATS
+static window_stats_sliding_t stats_sliding_global;
+static window_stats_tumbling_t stats_tumbling_global;
+#endif
+#if MPU_SPECTRUM
+static spectrum_t spectrum_global;
+// CPU cycles per window (FFTs and accumulation)
+static struct {
+    uint64_t total;
+    uint32_t max;
+} spectrum_cycles_global;
+// first index, windows, axis, log2 points, first bin, bins and peak power; one byte per bin follows
+#define LOG_SPECTRUM_HEADER_LENGTH 16
+#define LOG_SPECTRUM_BINS_PER_RECORD (SD_LOG_MAX_RECORD_LENGTH - LOG_SPECTRUM_HEADER_LENGTH)
+static uint8_t spectrum_levels_global[SPECTRUM_MAX_BINS];
+#endif
+#if MPU_GOERTZEL
+static goertzel_bank_t goertzel_global;
+// CPU cycles per sample for the whole bank
+static struct {
+    uint64_t total;
+    uint32_t max;
+} goertzel_cycles_global;
+#endif
+#if MPU_ROLLUP
+static const uint32_t rollup_factors[] = {60, 60};
+static rollup_t rollup_global;
+// sequence of the sector holding the latest record of each level, ROLLUP_NO_SEQUENCE if none
+static uint32_t rollup_sequences_global[ROLLUP_MAX_LEVELS];
+#endif
+#if MPU_CAPTURE
+// an impact, a sharp edge, or a drop of 100 ms (about 5 cm)
+static const capture_config_t capture_config = {
+    .triggers = CAPTURE_TRIGGER_MAGNITUDE | CAPTURE_TRIGGER_SLOPE | CAPTURE_TRIGGER_FREE_FALL,
+    .magnitude_mg = 3000,
+    .slope_mg_per_ms = 500,
+    .free_fall_mg = 300,
+    .free_fall_ms = 100,
+    .pre_ms = MPU_CAPTURE_PRE_MS,
+    .post_ms = MPU_CAPTURE_POST_MS
+};
+static capture_t capture_global;
+#endif
+#if MPU_VELOCITY
+static const velocity_config_t velocity_config = {
+    .low_hz = MPU_VELOCITY_LOW_HZ,
+    .high_hz = MPU_VELOCITY_HIGH_HZ,
+    .window_ms = MPU_VELOCITY_WINDOW_MS
+};
+static velocity_t velocity_global;
+// CPU cycles per sample, all three axes
+static struct {
+    uint64_t total;
+    uint32_t max;
+} velocity_cycles_global;
+#endif
+#if MPU_LOG_COMPRESSED
+static rice_encoder_t rice_encoder_global;
+#elif MPU_LOG_PACKED
+// bits kept per channel in mpu6050_raw_frame order: accel, temperature (0.19 C steps), gyro
+static const uint8_t log_packed_bits[SAMPLE_PACKER_CHANNELS] = {12, 12, 12, 10, 14, 14, 14};
+static sample_packer_t sample_packer_global;
+#elif MPU_LOG_FULL_RATE
+// raw frames that fit in one INDEXED_RAW_SAMPLES record after the index
+#define LOG_INDEXED_FRAMES_PER_RECORD ((SD_LOG_MAX_RECORD_LENGTH - sizeof(uint32_t)) / sizeof(mpu6050_raw_frame))
+// consecutive samples collected until the record is full or the count jumps
+static struct {
+    uint32_t first_index;
+    mpu6050_raw_frame frames[LOG_INDEXED_FRAMES_PER_RECORD];
+} indexed_record_global;
+static size_t indexed_frames_global;
+#endif
+
+/*
+one step of the processing of the samples. The loops hand every sample to each stage in
+table order, frames[0] having first_index; a NULL hook means the stage has nothing to do there
+*/
+typedef struct {
+    const char* name;
+    bool (*start)(void);         // sets the stage up for the current session
+    bool (*rate_changed)(void);  // after a change of the sample rate (MPU_ADAPTIVE_RATE)
+    bool (*feed)(const mpu6050_raw_frame* frames, size_t frame_count, uint32_t first_index);
+    bool (*flush)(void);         // logs what the stage holds back, before the log is flushed
+    void (*print_stats)(void);
+} sample_stage_t;
+
+static bool log_mpu_sessions(void);
+#if MPU_LOG_FULL_RATE
+static bool log_indexed_frames(const mpu6050_raw_frame* frames, size_t frame_count, uint32_t first_index);
+static bool log_indexed_frame(uint32_t sample_index, const mpu6050_raw_frame* frame);
+static bool log_indexed_frames_flush(void);
+#endif
+#if MPU_LOG_COMPRESSED
+static bool log_compression_start(void);
+static bool log_rice_records(void);
+static void log_compression_print_stats(void);
+#elif MPU_LOG_PACKED
+static bool log_packing_start(void);
+static bool log_packed_records(void);
+static void log_packing_print_stats(void);
+#endif
+static bool sample_stages_start(void);
+#if MPU_ADAPTIVE_RATE
+static bool sample_stages_rate_changed(void);
+#endif
+#if !MPU_DUAL_SENSORS
+static bool sample_stages_feed(const mpu6050_raw_frame* frames, size_t frame_count, uint32_t first_index);
+#endif
+static bool sample_stages_flush(void);
+static void sample_stages_print_stats(void);
+#if !MPU_DUAL_SENSORS
+static bool log_clock_anchor(uint32_t sample_index, int64_t sample_time_us);
+#endif
+static bool log_flush(void);
+#if MPU_ADAPTIVE_RATE
+static bool adapt_sample_rate(const mpu6050_raw_frame* frames, size_t frame_count, uint32_t next_index, bool* changed);
+#endif
+#if MPU_MOTION_GATED
+static bool log_motion_segment(const motion_gate_t* gate, MOTION_GATE_EVENT event);
+#endif
+#if MPU_DECIMATION
+static bool decimation_start(void);
+static bool decimate(const mpu6050_raw_frame* frames, size_t frame_count, uint32_t first_index);
+static bool log_decimated_stream_flush(size_t stream);
+static bool log_decimated_streams_flush(void);
+static void decimation_print_stats(void);
+#endif
+#if MPU_WINDOW_STATS
+static bool window_stats_start(void);
+static bool window_stats_feed(const mpu6050_raw_frame* frames, size_t frame_count, uint32_t first_index);
+#endif
+#if MPU_SPECTRUM
+static bool spectrum_start(void);
+static bool spectrum_feed(const mpu6050_raw_frame* frames, size_t frame_count, uint32_t first_index);
+static bool log_spectrum(void);
+static void spectrum_print_stats(void);
+#endif
+#if MPU_GOERTZEL
+static bool goertzel_start(void);
+static bool goertzel_feed(const mpu6050_raw_frame* frames, size_t frame_count, uint32_t first_index);
+static void goertzel_print_stats(void);
+#endif
+#if MPU_ROLLUP
+static bool rollup_start(void);
+static bool rollup_rate_changed(void);
+static bool rollup_feed(const mpu6050_raw_frame* frames, size_t frame_count, uint32_t first_index);
+static bool log_rollup_records(void);
+static void rollup_levels_print_stats(void);
+#endif
+#if MPU_CAPTURE
+static bool capture_start(void);
+static bool capture_rate_changed(void);
+static bool capture_feed(const mpu6050_raw_frame* frames, size_t frame_count, uint32_t first_index);
+static void capture_events_print_stats(void);
+#endif
+#if MPU_VELOCITY
+static bool velocity_start(void);
+static bool velocity_rate_changed(void);
+static bool velocity_feed(const mpu6050_raw_frame* frames, size_t frame_count, uint32_t first_index);
+static void velocity_print_stats(void);
+#endif
+#if MPU_ORIENTATION
+static bool orientation_start(void);
+static bool orientation_rate_changed(void);
+static bool orientation_feed(const mpu6050_raw_frame* frames, size_t frame_count, uint32_t first_index);
+static void orientation_print_stats(void);
+#endif
+static bool display_sample_line(int line, const mpu6050_raw_frame* frame);
+
+// orientation last: the display shows the angles after the newest sample
+static const sample_stage_t sample_stages[] = {
+#if MPU_LOG_COMPRESSED
+    {"sample compression", log_compression_start, NULL, log_indexed_frames, log_indexed_frames_flush, log_compression_print_stats},
+#elif MPU_LOG_PACKED
+    {"sample packing", log_packing_start, NULL, log_indexed_frames, log_indexed_frames_flush, log_packing_print_stats},
+#elif MPU_LOG_FULL_RATE
+    {"full rate log", NULL, NULL, log_indexed_frames, log_indexed_frames_flush, NULL},
+#endif
+#if MPU_DECIMATION
+    {"decimator", decimation_start, NULL, decimate, log_decimated_streams_flush, decimation_print_stats},
+#endif
+#if MPU_WINDOW_STATS
+    // the windows are a time span: their lengths in samples change with the rate
+    {"window statistics", window_stats_start, window_stats_start, window_stats_feed, NULL, NULL},
+#endif
+#if MPU_SPECTRUM
+    // the bins are fractions of the sample rate: a spectrum cannot mix two rates
+    {"spectra", spectrum_start, spectrum_start, spectrum_feed, NULL, spectrum_print_stats},
+#endif
+#if MPU_GOERTZEL
+    {"Goertzel bank", goertzel_start, goertzel_start, goertzel_feed, NULL, goertzel_print_stats},
+#endif
+#if MPU_ROLLUP
+    {"rollups", rollup_start, rollup_rate_changed, rollup_feed, NULL, rollup_levels_print_stats},
+#endif
+#if MPU_CAPTURE
+    {"triggered capture", capture_start, capture_rate_changed, capture_feed, NULL, capture_events_print_stats},
+#endif
+#if MPU_VELOCITY
+    {"vibration velocity", velocity_start, velocity_rate_changed, velocity_feed, NULL, velocity_print_stats},
+#endif
+#if MPU_ORIENTATION
+    {"orientation", orientation_start, orientation_rate_changed, orientation_feed, NULL, orientation_print_stats},
+#endif
+    {.name = NULL} // end of the table, also the only entry when nothing is enabled
+};
 
 void app_main(void)
 {
@@ -28,9 +552,65 @@ void app_main(void)
         return;
     } else {
         printf("SD card init successful\n");
+        SD_print_card_info();
+    }
+    // resume the existing log after the last sector that made it to the card, or start a new one
+    if (!SD_log_mount(LOG_REGION_START_BLOCK) &&
+        !SD_log_format(LOG_REGION_START_BLOCK, SD_get_card_info()->capacity_blocks, SD_LOG_MODE_CIRCULAR)) {
+        printf("Could not open SD log\n");
+        return;
     }
     printf("OLED init success: %d\n", (int)ssd1306_init()); // could catch the value for checks
-    printf("MPU init success: %d\n", (int)mpu6050_init(MPU6050_RANGE_8_G, MPU6050_RANGE_1000_DEG)); // could catch the value for checks
+    printf("MPU init success: %d\n", (int)mpu6050_init(&imu_global, MPU6050_ADDRESS, MPU6050_RANGE_8_G, MPU6050_RANGE_1000_DEG)); // could catch the value for checks
+    if (!mpu6050_set_channels(&imu_global, MPU_CHANNELS, MPU_TEMPERATURE_INTERVAL_MS)) {
+        printf("Could not select MPU channels\n");
+        return;
+    }
+#if MPU_DUAL_SENSORS
+    // same settings on both so a pair always holds two samples of the same instant
+    printf("MPU 2 init success: %d\n", (int)mpu6050_init(&imu_2_global, MPU6050_ADDRESS_AD0_HIGH, MPU6050_RANGE_8_G, MPU6050_RANGE_1000_DEG));
+    if (!mpu6050_set_channels(&imu_2_global, MPU_CHANNELS, MPU_TEMPERATURE_INTERVAL_MS) ||
+        !mpu6050_set_sample_rate(&imu_global, MPU_DATA_READY_RATE_HZ) ||
+        !mpu6050_set_sample_rate(&imu_2_global, MPU_DATA_READY_RATE_HZ) ||
+        !mpu6050_pair_init(&imu_pair_global, &imu_global, MPU_INT_PIN, &imu_2_global, MPU_INT_PIN_2)) {
+        printf("Could not set up the MPU pair\n");
+        return;
+    }
+#elif MPU_SAMPLING_DATA_READY
+    // the sensor paces the loop: exactly one read per new sample
+    if (!mpu6050_set_sample_rate(&imu_global, MPU_DATA_READY_RATE_HZ) || !mpu6050_data_ready_enable(&imu_global, MPU_INT_PIN)) {
+        printf("Could not enable MPU data ready interrupt\n");
+        return;
+    }
+#elif MPU_MOTION_GATED
+    // starts idle; the FIFO only runs while there is motion
+    motion_gate_config_t gate_config = {
+        .int_pin = MPU_INT_PIN,
+        .threshold_mg = MPU_MOTION_THRESHOLD_MG,
+        .duration_ms = MPU_MOTION_DURATION_MS,
+        .quiet_period_ms = MPU_MOTION_QUIET_PERIOD_MS,
+        .idle_wake_freq = MPU6050_WAKE_5_HZ
+    };
+    if (!motion_gate_init(&motion_gate_global, &imu_global, &gate_config)) {
+        printf("Could not enable MPU motion detection\n");
+        return;
+    }
+#else
+    // buffer every 1 kHz sample in the sensor so none are lost while the loop is busy elsewhere
+    if (!mpu6050_fifo_enable(&imu_global)) {
+        printf("Could not enable MPU FIFO\n");
+        return;
+    }
+#endif
+#if MPU_ADAPTIVE_RATE
+    // starts fast and settles down once the signal turns out to be quiet
+    if (!adaptive_rate_init(&adaptive_rate_global, &imu_global, adaptive_rate_tiers, ADAPTIVE_RATE_TIER_COUNT,
+                            ADAPTIVE_RATE_TIER_COUNT - 1, MPU_ADAPTIVE_WINDOW_MS, MPU_ADAPTIVE_DOWN_HOLD_WINDOWS)) {
+        printf("Could not set up the adaptive sample rate\n");
+        return;
+    }
+#endif
+    if (!sample_stages_start()) return;
     // printf("Looking for OLED: %d\n", (int)I2C_find_device(SSD1306_ADDRESS));
     // printf("Looking for MPU: %d\n", (int)I2C_find_device(MPU6050_ADDRESS));
     
@@ -55,29 +635,861 @@ void app_main(void)
     for (int i = 0; i < 512; i++) {
         printf("%x ", block_data[i]);
     }
-    printf("Elapsed time transmitting %.0f bits with I2C bus: %lld us (%.3f sec)\n", bits, elapsed, (elapsed) / 1e6);
+    printf("Elapsed time transmitting %.0f bits with I2C bus: %" PRId64 " us (%.3f sec)\n", bits, elapsed, (elapsed) / 1e6);
     printf("Estimated I2C speed: %.4lf bits/sec\n", bits / (elapsed / 1e6));
 
-    mpu6050_xyz_data acceleration, gyro;
-    float temperature;
-    char disp_str[100] = "";
     free(block_data);
+    // samples are logged as raw counts; the scales to convert them go in the log first
+    if (!log_mpu_sessions()) {printf("SD LOG ERROR\n"); return;}
+    int loops = 0;
+#if !MPU_DUAL_SENSORS
+    // pairs keep a timestamp each: it carries the follower offset along
+    sample_clock_init(&sample_clock_global, mpu6050_get_session(&imu_global)->sample_rate_hz);
+    uint32_t anchor_interval_samples = mpu6050_get_session(&imu_global)->sample_rate_hz * MPU_ANCHOR_INTERVAL_MS / 1000;
+    uint32_t next_anchor_index = 0;
+#endif
+#if MPU_DUAL_SENSORS
+    while (1) {
+        int64_t sample_time_us;
+        int32_t follower_offset_us;
+        mpu6050_raw_frame frame, frame_2;
+        if (!mpu6050_pair_read_on_data_ready(&imu_pair_global, MPU_DATA_READY_TIMEOUT_MS, &frame, &frame_2,
+                                             &sample_time_us, &follower_offset_us)) {
+            printf("MPU ERROR\n");
+            return;
+        }
+        struct __attribute__((packed)) {
+            int64_t time_us;
+            int32_t follower_offset_us;
+            mpu6050_raw_frame frame;
+            mpu6050_raw_frame frame_2;
+        } record = {
+            .time_us = SD_log_get_time_us() - (esp_timer_get_time() - sample_time_us),
+            .follower_offset_us = follower_offset_us,
+            .frame = frame,
+            .frame_2 = frame_2
+        };
+        if (!SD_log_append(SD_LOG_RECORD_MPU6050_TIMED_RAW_PAIR, &record, sizeof(record))) {printf("SD LOG ERROR\n"); return;}
+        if (++loops % LOG_FLUSH_INTERVAL_LOOPS == 0 && !log_flush()) {printf("SD LOG ERROR\n"); return;}
+        // the display follows the first sensor
+        if (!display_sample_line(loops % 4, &frame)) {printf("OLED ERROR\n"); return;}
+        if (loops % LOG_STATS_INTERVAL_LOOPS == 0) {
+            mpu6050_print_data_ready_stats(&imu_global);
+            mpu6050_print_pair_stats(&imu_pair_global);
+            sample_stages_print_stats();
+            SD_print_timing_stats();
+        }
+        int64_t idle_us = 1000000 / MPU_DATA_READY_RATE_HZ - (esp_timer_get_time() - sample_time_us);
+        if (LOG_PREERASE_ENABLED && idle_us > 0) SD_log_idle((uint32_t)idle_us);
+    }
+#elif MPU_SAMPLING_DATA_READY
     while (1) {
-        if (!mpu6050_read_all(&acceleration, &gyro, &temperature)) {
+        int64_t sample_time_us;
+        mpu6050_raw_frame frame;
+        if (!mpu6050_read_on_data_ready(&imu_global, MPU_DATA_READY_TIMEOUT_MS, &frame, &sample_time_us)) {
             printf("MPU ERROR\n");
             return;
         }
-        snprintf(disp_str, sizeof(disp_str), "Temp: %02.1f C",temperature);
-        if (!ssd1306_write_string_size8x8p(disp_str, 0, 0, 0)) {printf("OLED ERROR\n"); return;}
-        snprintf(disp_str, sizeof(disp_str), "X: %+02.1f %+02.1f ", acceleration.x, gyro.x);
-        if (!ssd1306_write_string_size8x8p(disp_str, 0, 0, 2)) {printf("OLED ERROR\n"); return;}
-        snprintf(disp_str, sizeof(disp_str), "Y: %+02.1f %+02.1f ", acceleration.y, gyro.y);
-        if (!ssd1306_write_string_size8x8p(disp_str, 0, 0, 3)) {printf("OLED ERROR\n"); return;}
-        snprintf(disp_str, sizeof(disp_str), "Z: %+02.1f %+02.1f ", acceleration.z, gyro.z);
-        if (!ssd1306_write_string_size8x8p(disp_str, 0, 0, 4)) {printf("OLED ERROR\n"); return;}
+        const mpu6050_data_ready_stats_t* ready_stats = mpu6050_data_ready_get_stats(&imu_global);
+        // every interrupt is one sample of the sensor, read or missed
+        uint32_t sample_index = ready_stats->samples + ready_stats->missed - 1;
+        if (!sample_stages_feed(&frame, 1, sample_index)) {printf("SD LOG ERROR\n"); return;}
+        // the ISR time belongs to exactly this sample: a precise anchor
+        if ((int32_t)(sample_index - next_anchor_index) >= 0) {
+            if (!log_clock_anchor(sample_index, sample_time_us)) {printf("SD LOG ERROR\n"); return;}
+            next_anchor_index = sample_index + anchor_interval_samples;
+        }
+#if MPU_ADAPTIVE_RATE
+        bool rate_changed;
+        if (!adapt_sample_rate(&frame, 1, sample_index + 1, &rate_changed)) {printf("MPU ERROR\n"); return;}
+        if (rate_changed) {
+            // the clock starts over: anchor the first sample at the new rate
+            anchor_interval_samples = mpu6050_get_session(&imu_global)->sample_rate_hz * MPU_ANCHOR_INTERVAL_MS / 1000;
+            next_anchor_index = sample_index + 1;
+        }
+#endif
+        if (++loops % LOG_FLUSH_INTERVAL_LOOPS == 0 && !log_flush()) {printf("SD LOG ERROR\n"); return;}
+        // a whole refresh would span several samples: update one line per sample instead
+        if (!display_sample_line(loops % 4, &frame)) {printf("OLED ERROR\n"); return;}
+        if (loops % LOG_STATS_INTERVAL_LOOPS == 0) {
+            mpu6050_print_data_ready_stats(&imu_global);
+            sample_clock_print_stats(&sample_clock_global);
+#if MPU_ADAPTIVE_RATE
+            adaptive_rate_print_stats(&adaptive_rate_global);
+#endif
+            sample_stages_print_stats();
+            SD_print_timing_stats();
+        }
+        // whatever is left until the next interrupt can go to pre-erasing
+        int64_t idle_us = 1000000 / mpu6050_get_session(&imu_global)->sample_rate_hz - (esp_timer_get_time() - sample_time_us);
+        if (LOG_PREERASE_ENABLED && idle_us > 0) SD_log_idle((uint32_t)idle_us);
+    }
+#else
+    uint32_t fifo_next_index = 0;
+#if MPU_MOTION_GATED
+    uint32_t idle_poll_ms = MPU_MOTION_IDLE_POLL_MS;
+#endif
+    while (1) {
+#if MPU_MOTION_GATED
+        MOTION_GATE_EVENT event;
+        if (!motion_gate_poll(&motion_gate_global, idle_poll_ms, &event)) {
+            printf("MPU ERROR\n");
+            return;
+        }
+        if (event == MOTION_GATE_EVENT_SEGMENT_CLOSED) {
+            // the FIFO is already off: the samples since the last pass were quiet anyway
+            if (!log_motion_segment(&motion_gate_global, event)) {printf("SD LOG ERROR\n"); return;}
+            motion_gate_print_stats(&motion_gate_global);
+            SD_print_timing_stats();
+        } else if (event == MOTION_GATE_EVENT_SEGMENT_OPENED) {
+            if (!log_motion_segment(&motion_gate_global, event) || !log_mpu_sessions()) {printf("SD LOG ERROR\n"); return;}
+            // nothing was sampled while idle: continue the count from the time the segment started
+            uint32_t resumed_index = sample_clock_index_at(&sample_clock_global, motion_gate_get_transition_time_us(&motion_gate_global));
+            if ((int32_t)(resumed_index - fifo_next_index) > 0) fifo_next_index = resumed_index;
+        }
+        if (!motion_gate_is_active(&motion_gate_global)) {
+            // idle: no bus traffic and no writes, at most pre-erasing ahead of the next segment
+            bool erasing = LOG_PREERASE_ENABLED && (SD_log_idle(MPU_MOTION_IDLE_ERASE_BUDGET_MS * 1000) || SD_erase_pending());
+            // back to waiting for motion either way, only briefly if the erase still has to be timed
+            idle_poll_ms = erasing ? MPU_MOTION_IDLE_ERASE_POLL_MS : MPU_MOTION_IDLE_POLL_MS;
+            continue;
+        }
+#endif
+        size_t frames = 0;
+        uint32_t overflows = mpu6050_fifo_get_stats(&imu_global)->overflows;
+        int64_t drain_us = esp_timer_get_time();
+        if (!mpu6050_fifo_read_raw(&imu_global, fifo_frames_global, MPU6050_FIFO_MAX_FRAMES, &frames)) {
+            printf("MPU ERROR\n");
+            return;
+        }
+        if (mpu6050_fifo_get_stats(&imu_global)->overflows != overflows) {
+            // the reset threw away an unknown number of samples: continue the count from the clock
+            uint32_t resumed_index = sample_clock_index_at(&sample_clock_global, esp_timer_get_time());
+            if ((int32_t)(resumed_index - fifo_next_index) > 0) fifo_next_index = resumed_index;
+        }
+        // the whole drain goes through every stage of sample_stages, the full rate log first
+        if (!sample_stages_feed(fifo_frames_global, frames, fifo_next_index)) {printf("SD LOG ERROR\n"); return;}
+        /*
+        the newest sample drained was taken within one sample period before the FIFO count was
+        read (right after drain_us), so half a period before is its expected time. Not if the
+        FIFO held more than one burst: then the newest samples are still in it
+        */
+        if (frames > 0 && frames < MPU6050_FIFO_MAX_FRAMES && (int32_t)(fifo_next_index + frames - 1 - next_anchor_index) >= 0) {
+            int64_t anchor_us = drain_us - 500000 / mpu6050_get_session(&imu_global)->sample_rate_hz;
+            if (!log_clock_anchor(fifo_next_index + frames - 1, anchor_us)) {printf("SD LOG ERROR\n"); return;}
+            next_anchor_index = fifo_next_index + frames - 1 + anchor_interval_samples;
+        }
+        fifo_next_index += frames;
+#if MPU_ADAPTIVE_RATE
+        bool rate_changed;
+        if (!adapt_sample_rate(fifo_frames_global, frames, fifo_next_index, &rate_changed)) {printf("MPU ERROR\n"); return;}
+        if (rate_changed) {
+            // samples still in the FIFO count as the new rate; the anchor at the next drain corrects for it
+            anchor_interval_samples = mpu6050_get_session(&imu_global)->sample_rate_hz * MPU_ANCHOR_INTERVAL_MS / 1000;
+            next_anchor_index = fifo_next_index;
+        }
+#endif
+#if MPU_MOTION_GATED
+        motion_gate_add_frames(&motion_gate_global, frames);
+#endif
+        if (++loops % LOG_FLUSH_INTERVAL_LOOPS == 0 && !log_flush()) {printf("SD LOG ERROR\n"); return;}
+        // the display shows the newest sample (or the window statistics)
+        for (int line = 0; line < 4 && frames > 0; line++) {
+            if (!display_sample_line(line, &fifo_frames_global[frames - 1])) {printf("OLED ERROR\n"); return;}
+        }
         if (!ssd1306_refresh_display()) {printf("OLED ERROR\n"); return;}
-        // 20 refreshs/sec -- refresh_display() takes about 14 ms
-        vTaskDelay(pdMS_TO_TICKS(50 - (elapsed) / 1000));
+        if (loops % LOG_STATS_INTERVAL_LOOPS == 0) {
+            const mpu6050_fifo_stats_t* fifo_stats = mpu6050_fifo_get_stats(&imu_global);
+            printf("MPU FIFO: %lu samples in %lu bursts, %lu overflows\n", (unsigned long)fifo_stats->frames_read,
+                   (unsigned long)fifo_stats->bursts, (unsigned long)fifo_stats->overflows);
+#if MPU_MOTION_GATED
+            motion_gate_print_stats(&motion_gate_global);
+#endif
+#if MPU_ADAPTIVE_RATE
+            adaptive_rate_print_stats(&adaptive_rate_global);
+#endif
+            sample_stages_print_stats();
+            sample_clock_print_stats(&sample_clock_global);
+            SD_print_timing_stats();
+        }
+        // the next drain when the FIFO is about half full again (36 ms at 1 kHz), counted from this one
+        int64_t pass_us = (int64_t)MPU6050_FIFO_MAX_FRAMES / 2 * 1000000 / mpu6050_get_session(&imu_global)->sample_rate_hz;
+        if (pass_us > MPU_FIFO_PASS_MAX_MS * 1000) pass_us = MPU_FIFO_PASS_MAX_MS * 1000;
+        int64_t idle_us = pass_us - (esp_timer_get_time() - drain_us);
+        // hand the idle time to the card to pre-erase ahead of the log
+        if (LOG_PREERASE_ENABLED && idle_us > 0) {
+            SD_log_idle((uint32_t)idle_us);
+            idle_us = pass_us - (esp_timer_get_time() - drain_us);
+        }
+        if (idle_us > 0) vTaskDelay(pdMS_TO_TICKS(idle_us / 1000));
     }
+#endif
     return;
 }
+
+// pending samples, then the sector goes to the card, followed by the sessions so a wrapped circular log still has the scales
+static bool log_flush(void) {
+    return sample_stages_flush() && SD_log_flush() && log_mpu_sessions();
+}
+
+static bool sample_stages_start(void) {
+    for (const sample_stage_t* stage = sample_stages; stage->name != NULL; stage++) {
+        if (stage->start != NULL && !stage->start()) {
+            printf("Could not set up the %s\n", stage->name);
+            return false;
+        }
+    }
+    return true;
+}
+
+#if MPU_ADAPTIVE_RATE
+static bool sample_stages_rate_changed(void) {
+    for (const sample_stage_t* stage = sample_stages; stage->name != NULL; stage++) {
+        if (stage->rate_changed != NULL && !stage->rate_changed()) return false;
+    }
+    return true;
+}
+#endif
+
+#if !MPU_DUAL_SENSORS
+static bool sample_stages_feed(const mpu6050_raw_frame* frames, size_t frame_count, uint32_t first_index) {
+    for (const sample_stage_t* stage = sample_stages; stage->name != NULL; stage++) {
+        if (!stage->feed(frames, frame_count, first_index)) return false;
+    }
+    return true;
+}
+#endif
+
+static bool sample_stages_flush(void) {
+    for (const sample_stage_t* stage = sample_stages; stage->name != NULL; stage++) {
+        if (stage->flush != NULL && !stage->flush()) return false;
+    }
+    return true;
+}
+
+static void sample_stages_print_stats(void) {
+    for (const sample_stage_t* stage = sample_stages; stage->name != NULL; stage++) {
+        if (stage->print_stats != NULL) stage->print_stats();
+    }
+}
+
+#if MPU_LOG_FULL_RATE
+// every sample at full rate, numbered so their times can be rebuilt
+static bool log_indexed_frames(const mpu6050_raw_frame* frames, size_t frame_count, uint32_t first_index) {
+    for (size_t i = 0; i < frame_count; i++) {
+        if (!log_indexed_frame(first_index + (uint32_t)i, &frames[i])) return false;
+    }
+    return true;
+}
+
+// collects consecutive samples into one record; a jump in the index (missed samples) starts a new one
+static bool log_indexed_frame(uint32_t sample_index, const mpu6050_raw_frame* frame) {
+#if MPU_LOG_COMPRESSED
+    rice_encoder_add(&rice_encoder_global, frame, sample_index);
+    return log_rice_records();
+#elif MPU_LOG_PACKED
+    sample_packer_add(&sample_packer_global, frame, sample_index);
+    return log_packed_records();
+#else
+    if (indexed_frames_global > 0 &&
+        (indexed_frames_global == LOG_INDEXED_FRAMES_PER_RECORD ||
+         sample_index != indexed_record_global.first_index + indexed_frames_global)) {
+        if (!log_indexed_frames_flush()) return false;
+    }
+    if (indexed_frames_global == 0) indexed_record_global.first_index = sample_index;
+    indexed_record_global.frames[indexed_frames_global++] = *frame;
+    return true;
+#endif
+}
+
+static bool log_indexed_frames_flush(void) {
+#if MPU_LOG_COMPRESSED
+    rice_encoder_flush(&rice_encoder_global);
+    return log_rice_records();
+#elif MPU_LOG_PACKED
+    sample_packer_flush(&sample_packer_global);
+    return log_packed_records();
+#else
+    if (indexed_frames_global == 0) return true;
+    uint16_t length = (uint16_t)(sizeof(uint32_t) + indexed_frames_global * sizeof(mpu6050_raw_frame));
+    indexed_frames_global = 0;
+    return SD_log_append(SD_LOG_RECORD_MPU6050_INDEXED_RAW_SAMPLES, &indexed_record_global, length);
+#endif
+}
+#endif
+
+#if MPU_LOG_COMPRESSED
+static bool log_compression_start(void) {
+    return rice_encoder_init(&rice_encoder_global, SD_LOG_MAX_RECORD_LENGTH);
+}
+
+// the records the encoder has closed (up to two after a jump in the index)
+static bool log_rice_records(void) {
+    const uint8_t* data;
+    uint16_t length;
+    while (rice_encoder_next_record(&rice_encoder_global, &data, &length)) {
+        if (!SD_log_append(SD_LOG_RECORD_MPU6050_RICE_SAMPLES, data, length)) return false;
+    }
+    return true;
+}
+
+static void log_compression_print_stats(void) {
+    const rice_stats_t* stats = rice_encoder_get_stats(&rice_encoder_global);
+    printf("Compression: %llu samples in %lu records, %llu bytes (%.2f x raw), %lu restarts\n",
+           (unsigned long long)stats->frames, (unsigned long)stats->records, (unsigned long long)stats->encoded_bytes,
+           stats->encoded_bytes > 0 ? (double)stats->frames * sizeof(mpu6050_raw_frame) / stats->encoded_bytes : 0.0,
+           (unsigned long)stats->restarts);
+}
+#elif MPU_LOG_PACKED
+static bool log_packing_start(void) {
+    return sample_packer_init(&sample_packer_global, log_packed_bits, SD_LOG_MAX_RECORD_LENGTH);
+}
+
+static bool log_packed_records(void) {
+    const uint8_t* data;
+    uint16_t length;
+    if (!sample_packer_next_record(&sample_packer_global, &data, &length)) return true;
+    return SD_log_append(SD_LOG_RECORD_MPU6050_PACKED_SAMPLES, data, length);
+}
+
+static void log_packing_print_stats(void) {
+    const sample_packer_stats_t* stats = sample_packer_get_stats(&sample_packer_global);
+    printf("Packing: %llu samples in %lu records, %llu bytes (%.2f x raw), %lu restarts\n",
+           (unsigned long long)stats->frames, (unsigned long)stats->records, (unsigned long long)stats->packed_bytes,
+           stats->packed_bytes > 0 ? (double)stats->frames * sizeof(mpu6050_raw_frame) / stats->packed_bytes : 0.0,
+           (unsigned long)stats->restarts);
+}
+#endif
+
+#if !MPU_DUAL_SENSORS
+// sample_time_us (esp_timer clock) refits the sample clock and goes in the log as log time, with the fitted rate
+static bool log_clock_anchor(uint32_t sample_index, int64_t sample_time_us) {
+    sample_clock_add_anchor(&sample_clock_global, sample_index, sample_time_us);
+    struct __attribute__((packed)) {
+        uint32_t sample_index;
+        int64_t time_us;
+        float rate_hz;
+    } record = {
+        .sample_index = sample_index,
+        .time_us = SD_log_get_time_us() - (esp_timer_get_time() - sample_time_us),
+        .rate_hz = (float)sample_clock_get_rate_hz(&sample_clock_global)
+    };
+    return SD_log_append(SD_LOG_RECORD_SAMPLE_CLOCK_ANCHOR, &record, sizeof(record));
+}
+#endif
+
+#if MPU_DECIMATION
+static bool decimation_start(void) {
+    return decimator_init(&decimator_global, mpu6050_get_session(&imu_global)->sample_rate_hz, decimated_rates_hz,
+                          DECIMATED_STREAM_COUNT, MPU_DECIMATION_TAPS_PER_FACTOR);
+}
+
+// filters the samples (frames[0] has first_index) and adds the outputs to the record of their stream
+static bool decimate(const mpu6050_raw_frame* frames, size_t frame_count, uint32_t first_index) {
+    size_t outputs;
+    if (!decimator_push(&decimator_global, frames, frame_count, first_index, decimator_outputs_global,
+                        DECIMATOR_MAX_OUTPUTS, &outputs)) return false;
+    for (size_t i = 0; i < outputs; i++) {
+        const decimator_output_t* output = &decimator_outputs_global[i];
+        size_t stream = output->stage;
+        uint32_t factor = decimator_get_total_factor(&decimator_global, stream);
+        // outputs in one record are factor samples apart; a restart of the decimator breaks that
+        if (decimated_frames_global[stream] > 0 &&
+            (decimated_frames_global[stream] == LOG_DECIMATED_FRAMES_PER_RECORD ||
+             output->sample_index != decimated_records_global[stream].first_index + decimated_frames_global[stream] * factor)) {
+            if (!log_decimated_stream_flush(stream)) return false;
+        }
+        if (decimated_frames_global[stream] == 0) {
+            decimated_records_global[stream].stream = (uint8_t)stream;
+            decimated_records_global[stream].factor = (uint16_t)factor;
+            decimated_records_global[stream].delay_samples = (uint16_t)decimator_get_delay_samples(&decimator_global, stream);
+            decimated_records_global[stream].first_index = output->sample_index;
+        }
+        decimated_records_global[stream].frames[decimated_frames_global[stream]++] = output->frame;
+    }
+    return true;
+}
+
+static bool log_decimated_stream_flush(size_t stream) {
+    if (decimated_frames_global[stream] == 0) return true;
+    uint16_t length = (uint16_t)(LOG_DECIMATED_HEADER_LENGTH + decimated_frames_global[stream] * sizeof(mpu6050_raw_frame));
+    decimated_frames_global[stream] = 0;
+    return SD_log_append(SD_LOG_RECORD_MPU6050_DECIMATED_SAMPLES, &decimated_records_global[stream], length);
+}
+
+static bool log_decimated_streams_flush(void) {
+    for (size_t stream = 0; stream < DECIMATED_STREAM_COUNT; stream++) {
+        if (!log_decimated_stream_flush(stream)) return false;
+    }
+    return true;
+}
+
+static void decimation_print_stats(void) {
+    decimator_print_stats(&decimator_global);
+}
+#endif
+
+#if MPU_WINDOW_STATS
+// (re)sizes both windows for the current sample rate
+static bool window_stats_start(void) {
+    uint32_t rate_hz = mpu6050_get_session(&imu_global)->sample_rate_hz;
+    uint32_t sliding = rate_hz * MPU_STATS_SLIDING_MS / 1000;
+    uint32_t tumbling = rate_hz * MPU_STATS_SUMMARY_MS / 1000;
+    if (sliding > WINDOW_STATS_MAX_SLIDING) sliding = WINDOW_STATS_MAX_SLIDING;
+    if (tumbling > WINDOW_STATS_MAX_TUMBLING) tumbling = WINDOW_STATS_MAX_TUMBLING;
+    return window_stats_sliding_init(&stats_sliding_global, sliding > 0 ? sliding : 1) &&
+           window_stats_tumbling_init(&stats_tumbling_global, tumbling > 0 ? tumbling : 1);
+}
+
+// updates both windows (frames[0] has first_index) and logs a summary for every completed tumbling window
+static bool window_stats_feed(const mpu6050_raw_frame* frames, size_t frame_count, uint32_t first_index) {
+    for (size_t i = 0; i < frame_count; i++) {
+        window_stats_sliding_add(&stats_sliding_global, &frames[i], first_index + (uint32_t)i);
+        if (!window_stats_tumbling_add(&stats_tumbling_global, &frames[i], first_index + (uint32_t)i)) continue;
+        const window_stats_snapshot_t* snapshot = window_stats_tumbling_get_last(&stats_tumbling_global);
+        struct __attribute__((packed)) {
+            uint32_t first_index;
+            uint32_t count;
+            struct __attribute__((packed)) {
+                float mean;
+                float std_dev;
+                int16_t min;
+                int16_t max;
+            } channels[WINDOW_STATS_CHANNELS];
+        } record = {.first_index = snapshot->first_index, .count = snapshot->count};
+        for (int c = 0; c < WINDOW_STATS_CHANNELS; c++) {
+            record.channels[c].mean = snapshot->mean[c];
+            record.channels[c].std_dev = snapshot->std_dev[c];
+            record.channels[c].min = snapshot->min[c];
+            record.channels[c].max = snapshot->max[c];
+        }
+        if (!SD_log_append(SD_LOG_RECORD_MPU6050_WINDOW_SUMMARY, &record, sizeof(record))) return false;
+    }
+    return true;
+}
+#endif
+
+#if MPU_SPECTRUM
+static bool spectrum_start(void) {
+    return spectrum_init(&spectrum_global, MPU_SPECTRUM_LOG2_POINTS, MPU_SPECTRUM_AVERAGES);
+}
+
+// collects the samples (frames[0] has first_index), transforms every full window and logs every completed spectrum
+static bool spectrum_feed(const mpu6050_raw_frame* frames, size_t frame_count, uint32_t first_index) {
+    for (size_t i = 0; i < frame_count; i++) {
+        if (!spectrum_add(&spectrum_global, &frames[i], first_index + (uint32_t)i)) continue;
+        esp_cpu_cycle_count_t start = esp_cpu_get_cycle_count();
+        bool complete = spectrum_process(&spectrum_global);
+        uint32_t cycles = (uint32_t)(esp_cpu_get_cycle_count() - start);
+        spectrum_cycles_global.total += cycles;
+        if (cycles > spectrum_cycles_global.max) spectrum_cycles_global.max = cycles;
+        if (complete && !log_spectrum()) return false;
+    }
+    return true;
+}
+
+// one byte per bin (dB below the peak), split over as many records as the bins need
+static bool log_spectrum(void) {
+    uint16_t bins = spectrum_get_points(&spectrum_global) / 2 + 1;
+    struct __attribute__((packed)) {
+        uint32_t first_index;
+        uint16_t windows;
+        uint8_t axis;
+        uint8_t log2_points;
+        uint16_t first_bin;
+        uint16_t bin_count;
+        float peak_power;
+        uint8_t levels[LOG_SPECTRUM_BINS_PER_RECORD];
+    } record = {
+        .first_index = spectrum_get_first_index(&spectrum_global),
+        .windows = spectrum_get_windows(&spectrum_global),
+        .log2_points = MPU_SPECTRUM_LOG2_POINTS
+    };
+    for (int axis = 0; axis < SPECTRUM_CHANNELS; axis++) {
+        float peak_power;
+        spectrum_get_levels(&spectrum_global, axis, &peak_power, spectrum_levels_global);
+        record.axis = (uint8_t)axis;
+        record.peak_power = peak_power;
+        for (uint16_t first_bin = 0; first_bin < bins; first_bin += LOG_SPECTRUM_BINS_PER_RECORD) {
+            record.first_bin = first_bin;
+            uint16_t bins_left = (uint16_t)(bins - first_bin);
+            record.bin_count = bins_left < (uint16_t)LOG_SPECTRUM_BINS_PER_RECORD ? bins_left : (uint16_t)LOG_SPECTRUM_BINS_PER_RECORD;
+            memcpy(record.levels, &spectrum_levels_global[first_bin], record.bin_count);
+            if (!SD_log_append(SD_LOG_RECORD_MPU6050_SPECTRUM, &record, LOG_SPECTRUM_HEADER_LENGTH + record.bin_count)) return false;
+        }
+    }
+    return true;
+}
+
+// a window comes every points / 2 samples, so the mean cycles per window bound the sample rate the CPU could transform
+static void spectrum_print_stats(void) {
+    const spectrum_stats_t* stats = spectrum_get_stats(&spectrum_global);
+    uint16_t hop = spectrum_get_points(&spectrum_global) / 2;
+    double cycles_per_window = stats->windows > 0 ? (double)spectrum_cycles_global.total / stats->windows : 0.0;
+    printf("Spectrum: %llu windows of %u points, %lu spectra, %lu restarts, %.0f mean / %lu max cycles per window "
+           "(%.0f per sample), %.0f Hz at most with the whole CPU\n",
+           (unsigned long long)stats->windows, (unsigned)spectrum_get_points(&spectrum_global),
+           (unsigned long)stats->spectra, (unsigned long)stats->restarts, cycles_per_window,
+           (unsigned long)spectrum_cycles_global.max, cycles_per_window / hop,
+           cycles_per_window > 0 ? CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ * 1e6 * hop / cycles_per_window : 0.0);
+}
+#endif
+
+#if MPU_GOERTZEL
+// tunes the bank to the shaft harmonics the current sample rate can hold
+static bool goertzel_start(void) {
+    uint16_t rate_hz = mpu6050_get_session(&imu_global)->sample_rate_hz;
+    float targets_hz[GOERTZEL_MAX_TARGETS];
+    size_t target_count = 0;
+    for (int harmonic = 1; harmonic <= MPU_GOERTZEL_HARMONICS && target_count < GOERTZEL_MAX_TARGETS; harmonic++) {
+        if (harmonic * MPU_GOERTZEL_SHAFT_HZ < rate_hz / 2.0f) targets_hz[target_count++] = harmonic * MPU_GOERTZEL_SHAFT_HZ;
+    }
+    uint32_t block_length = (uint32_t)rate_hz * MPU_GOERTZEL_BLOCK_MS / 1000;
+    if (block_length > GOERTZEL_MAX_BLOCK) block_length = GOERTZEL_MAX_BLOCK;
+    return goertzel_init(&goertzel_global, rate_hz, (uint16_t)block_length, targets_hz, target_count);
+}
+
+// runs the bank over the samples (frames[0] has first_index), timing each, and logs every completed block
+static bool goertzel_feed(const mpu6050_raw_frame* frames, size_t frame_count, uint32_t first_index) {
+    for (size_t i = 0; i < frame_count; i++) {
+        esp_cpu_cycle_count_t start = esp_cpu_get_cycle_count();
+        bool complete = goertzel_add(&goertzel_global, &frames[i], first_index + (uint32_t)i);
+        uint32_t cycles = (uint32_t)(esp_cpu_get_cycle_count() - start);
+        goertzel_cycles_global.total += cycles;
+        if (cycles > goertzel_cycles_global.max) goertzel_cycles_global.max = cycles;
+        if (!complete) continue;
+        struct __attribute__((packed)) {
+            uint32_t first_index;
+            uint16_t block_length;
+            uint8_t target_count;
+            struct __attribute__((packed)) {
+                float frequency_hz;
+                float amplitude[GOERTZEL_CHANNELS];
+            } targets[GOERTZEL_MAX_TARGETS];
+        } record = {
+            .first_index = goertzel_get_first_index(&goertzel_global),
+            .block_length = goertzel_get_block_length(&goertzel_global),
+            .target_count = (uint8_t)goertzel_get_target_count(&goertzel_global)
+        };
+        for (size_t t = 0; t < record.target_count; t++) {
+            record.targets[t].frequency_hz = goertzel_get_frequency_hz(&goertzel_global, t);
+            for (int c = 0; c < GOERTZEL_CHANNELS; c++) record.targets[t].amplitude[c] = goertzel_get_amplitude(&goertzel_global, t, c);
+        }
+        // only the targets in use
+        uint16_t length = (uint16_t)(sizeof(record) - (GOERTZEL_MAX_TARGETS - record.target_count) * sizeof(record.targets[0]));
+        if (!SD_log_append(SD_LOG_RECORD_MPU6050_TONES, &record, length)) return false;
+    }
+    return true;
+}
+
+static void goertzel_print_stats(void) {
+    const goertzel_stats_t* stats = goertzel_get_stats(&goertzel_global);
+    printf("Goertzel: %lu blocks, %u targets, %lu restarts, %lu retunes, %.0f mean / %lu max cycles per sample\n",
+           (unsigned long)stats->blocks, (unsigned)goertzel_get_target_count(&goertzel_global),
+           (unsigned long)stats->restarts, (unsigned long)stats->retunes,
+           stats->samples > 0 ? (double)goertzel_cycles_global.total / stats->samples : 0.0,
+           (unsigned long)goertzel_cycles_global.max);
+}
+#endif
+
+#if MPU_ROLLUP
+static bool rollup_start(void) {
+    uint32_t spans[ROLLUP_MAX_LEVELS] = {mpu6050_get_session(&imu_global)->sample_rate_hz};
+    size_t level_count = 1 + sizeof(rollup_factors) / sizeof(rollup_factors[0]);
+    memcpy(&spans[1], rollup_factors, sizeof(rollup_factors));
+    for (size_t l = 0; l < ROLLUP_MAX_LEVELS; l++) rollup_sequences_global[l] = ROLLUP_NO_SEQUENCE;
+    return rollup_init(&rollup_global, spans, level_count);
+}
+
+// the entry so far ends here; a second of the new rate is the next one
+static bool rollup_rate_changed(void) {
+    return rollup_set_samples_per_entry(&rollup_global, mpu6050_get_session(&imu_global)->sample_rate_hz) && log_rollup_records();
+}
+
+// sums up the samples (frames[0] has first_index) and logs every completed record
+static bool rollup_feed(const mpu6050_raw_frame* frames, size_t frame_count, uint32_t first_index) {
+    for (size_t i = 0; i < frame_count; i++) {
+        // taken right away: a level fills its next record only entries later
+        if (rollup_add(&rollup_global, &frames[i], first_index + (uint32_t)i) && !log_rollup_records()) return false;
+    }
+    return true;
+}
+
+// each record points back to the latest one of every level, so a reader can follow one level alone
+static bool log_rollup_records(void) {
+    rollup_record_t* record;
+    uint16_t length;
+    while (rollup_next_record(&rollup_global, &record, &length)) {
+        memcpy(record->latest_sequence, rollup_sequences_global, sizeof(record->latest_sequence));
+        if (!SD_log_append(SD_LOG_RECORD_MPU6050_ROLLUP, record, length)) return false;
+        // the record went into the open sector (sealing the previous one if it did not fit)
+        rollup_sequences_global[record->level] = SD_log_get_next_sequence();
+    }
+    return true;
+}
+
+static void rollup_levels_print_stats(void) {
+    rollup_print_stats(&rollup_global);
+}
+#endif
+
+#if MPU_CAPTURE
+static bool capture_start(void) {
+    return capture_init(&capture_global, &capture_config, mpu6050_get_session(&imu_global));
+}
+
+// the thresholds and windows in samples change with the rate; an event cut here is still logged
+static bool capture_rate_changed(void) {
+    return capture_set_session(&capture_global, mpu6050_get_session(&imu_global));
+}
+
+/*
+runs the triggers over the samples (frames[0] has first_index) and logs a few records of a
+completed event per call: enough to stay ahead of the samples (a record holds
+CAPTURE_FRAMES_PER_RECORD), few enough that an event does not stall the loop for all of
+its sectors at once
+*/
+static bool capture_feed(const mpu6050_raw_frame* frames, size_t frame_count, uint32_t first_index) {
+    for (size_t i = 0; i < frame_count; i++) capture_add(&capture_global, &frames[i], first_index + (uint32_t)i);
+    size_t records = frame_count / CAPTURE_FRAMES_PER_RECORD + 2;
+    CAPTURE_RECORD kind;
+    const void* data;
+    uint16_t length;
+    while (records-- > 0 && capture_next_record(&capture_global, &kind, &data, &length)) {
+        SD_LOG_RECORD_TYPE type = kind == CAPTURE_RECORD_EVENT ? SD_LOG_RECORD_MPU6050_EVENT : SD_LOG_RECORD_MPU6050_EVENT_SAMPLES;
+        if (!SD_log_append(type, data, length)) return false;
+    }
+    return true;
+}
+
+static void capture_events_print_stats(void) {
+    capture_print_stats(&capture_global);
+}
+#endif
+
+#if MPU_VELOCITY
+static bool velocity_start(void) {
+    return velocity_init(&velocity_global, &velocity_config, mpu6050_get_session(&imu_global));
+}
+
+// the filters are designed for one rate: they start over and settle again
+static bool velocity_rate_changed(void) {
+    return velocity_set_session(&velocity_global, mpu6050_get_session(&imu_global));
+}
+
+// runs the velocity stage over the samples (frames[0] has first_index), timing each, and logs every completed window
+static bool velocity_feed(const mpu6050_raw_frame* frames, size_t frame_count, uint32_t first_index) {
+    for (size_t i = 0; i < frame_count; i++) {
+        esp_cpu_cycle_count_t start = esp_cpu_get_cycle_count();
+        bool complete = velocity_add(&velocity_global, &frames[i], first_index + (uint32_t)i);
+        uint32_t cycles = (uint32_t)(esp_cpu_get_cycle_count() - start);
+        velocity_cycles_global.total += cycles;
+        if (cycles > velocity_cycles_global.max) velocity_cycles_global.max = cycles;
+        if (complete && !SD_log_append(SD_LOG_RECORD_MPU6050_VELOCITY, velocity_get_record(&velocity_global),
+                                       sizeof(velocity_record_t))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// the cycles against the budget: a sample period at the current rate
+static void velocity_print_stats(void) {
+    const velocity_stats_t* stats = velocity_get_stats(&velocity_global);
+    const velocity_record_t* record = velocity_get_record(&velocity_global);
+    double cycles_per_sample = stats->samples > 0 ? (double)velocity_cycles_global.total / stats->samples : 0.0;
+    double budget = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ * 1e6 / mpu6050_get_session(&imu_global)->sample_rate_hz;
+    printf("Velocity: %lu windows, %lu restarts, last %.2f %.2f %.2f mm/s (%.2f overall), %.0f mean / %lu max cycles "
+           "per sample, %.1f%% of the sample period\n",
+           (unsigned long)stats->windows, (unsigned long)stats->restarts, record->rms[0] / 100.0, record->rms[1] / 100.0,
+           record->rms[2] / 100.0, record->overall / 100.0, cycles_per_sample, (unsigned long)velocity_cycles_global.max,
+           100.0 * cycles_per_sample / budget);
+}
+#endif
+
+#if MPU_ADAPTIVE_RATE
+/*
+feeds the controller. On a tier change the samples so far go out in their own record, then
+the change (next_index is the first sample at the new rate) and the new session are logged,
+and the sample clock starts over at the new nominal rate
+*/
+static bool adapt_sample_rate(const mpu6050_raw_frame* frames, size_t frame_count, uint32_t next_index, bool* changed) {
+    if (!adaptive_rate_update(&adaptive_rate_global, frames, frame_count, changed)) return false;
+    if (!*changed) return true;
+    const mpu6050_session_t* session = mpu6050_get_session(&imu_global);
+    struct __attribute__((packed)) {
+        int64_t time_us;
+        uint32_t first_sample_index;
+        uint16_t sample_rate_hz;
+        uint8_t DLPF;
+        uint8_t tier;
+        float window_rms_mg;
+    } record = {
+        .time_us = SD_log_get_time_us(),
+        .first_sample_index = next_index,
+        .sample_rate_hz = session->sample_rate_hz,
+        .DLPF = session->DLPF,
+        .tier = (uint8_t)adaptive_rate_get_tier(&adaptive_rate_global),
+        .window_rms_mg = adaptive_rate_get_last_rms_mg(&adaptive_rate_global)
+    };
+    sample_clock_init(&sample_clock_global, session->sample_rate_hz);
+    if (!sample_stages_rate_changed()) return false;
+    return sample_stages_flush() && SD_log_append(SD_LOG_RECORD_MPU6050_RATE_CHANGE, &record, sizeof(record)) &&
+           log_mpu_sessions();
+}
+#endif
+
+// one record per sensor; the address in each session tells them apart
+static bool log_mpu_sessions(void) {
+#if MPU_DUAL_SENSORS
+    if (!SD_log_append(SD_LOG_RECORD_MPU6050_SESSION, mpu6050_get_session(&imu_2_global), sizeof(mpu6050_session_t))) return false;
+#endif
+    return SD_log_append(SD_LOG_RECORD_MPU6050_SESSION, mpu6050_get_session(&imu_global), sizeof(mpu6050_session_t));
+}
+
+#if MPU_MOTION_GATED
+// SEGMENT_START when the gate opens; SEGMENT_END and a flush when it closes, so every closed segment is on the card
+static bool log_motion_segment(const motion_gate_t* gate, MOTION_GATE_EVENT event) {
+    // the transition time (esp_timer clock) moved into log time by its age
+    int64_t event_time_us = SD_log_get_time_us() - (esp_timer_get_time() - motion_gate_get_transition_time_us(gate));
+    if (event == MOTION_GATE_EVENT_SEGMENT_OPENED) {
+        struct __attribute__((packed)) {
+            int64_t time_us;
+            uint32_t segment;
+        } record = {.time_us = event_time_us, .segment = motion_gate_get_segment(gate)};
+        return SD_log_append(SD_LOG_RECORD_SEGMENT_START, &record, sizeof(record));
+    }
+    struct __attribute__((packed)) {
+        int64_t time_us;
+        uint32_t segment;
+        uint32_t samples;
+    } record = {.time_us = event_time_us, .segment = motion_gate_get_segment(gate), .samples = motion_gate_get_segment_frames(gate)};
+    return sample_stages_flush() && SD_log_append(SD_LOG_RECORD_SEGMENT_END, &record, sizeof(record)) && SD_log_flush();
+}
+#endif
+
+#if MPU_ORIENTATION
+static bool orientation_start(void) {
+#if MPU_ORIENTATION_MADGWICK
+    orientation_madgwick_init(&orientation_global, mpu6050_get_session(&imu_global), MPU_ORIENTATION_BETA);
+#else
+    orientation_complementary_init(&orientation_global, mpu6050_get_session(&imu_global), MPU_ORIENTATION_TIME_CONSTANT_S);
+#endif
+    return true;
+}
+
+// same angles, new time step
+static bool orientation_rate_changed(void) {
+#if MPU_ORIENTATION_MADGWICK
+    orientation_madgwick_set_session(&orientation_global, mpu6050_get_session(&imu_global));
+#else
+    orientation_complementary_set_session(&orientation_global, mpu6050_get_session(&imu_global));
+#endif
+    return true;
+}
+
+// runs the filter over the samples (first_index is the index of frames[0]), timing every update, and logs the angles every MPU_ORIENTATION_LOG_INTERVAL_MS
+static bool orientation_feed(const mpu6050_raw_frame* frames, size_t frame_count, uint32_t first_index) {
+    uint32_t log_interval = mpu6050_get_session(&imu_global)->sample_rate_hz * MPU_ORIENTATION_LOG_INTERVAL_MS / 1000;
+    for (size_t i = 0; i < frame_count; i++) {
+        esp_cpu_cycle_count_t start = esp_cpu_get_cycle_count();
+#if MPU_ORIENTATION_MADGWICK
+        orientation_madgwick_update(&orientation_global, &frames[i]);
+#else
+        orientation_complementary_update(&orientation_global, &frames[i]);
+#endif
+        uint32_t cycles = (uint32_t)(esp_cpu_get_cycle_count() - start);
+        orientation_cycles_global.total += cycles;
+        if (cycles > orientation_cycles_global.max) orientation_cycles_global.max = cycles;
+        if (cycles > MPU_ORIENTATION_CYCLE_BUDGET) orientation_cycles_global.over_budget++;
+        uint32_t sample_index = first_index + (uint32_t)i;
+        if ((int32_t)(sample_index - orientation_next_log_index_global) < 0 && i + 1 < frame_count) continue;
+#if MPU_ORIENTATION_MADGWICK
+        orientation_madgwick_get_euler(&orientation_global, &orientation_euler_global);
+#else
+        orientation_complementary_get_euler(&orientation_global, &orientation_euler_global);
+#endif
+        // the last sample only updates the display
+        if ((int32_t)(sample_index - orientation_next_log_index_global) < 0) continue;
+        orientation_next_log_index_global = sample_index + (log_interval > 0 ? log_interval : 1);
+        struct __attribute__((packed)) {
+            uint32_t sample_index;
+            uint8_t filter;
+            orientation_euler_t euler;
+        } record = {.sample_index = sample_index, .filter = MPU_ORIENTATION_MADGWICK, .euler = orientation_euler_global};
+        if (!SD_log_append(SD_LOG_RECORD_ORIENTATION, &record, sizeof(record))) return false;
+    }
+    return true;
+}
+
+static void orientation_print_stats(void) {
+#if MPU_ORIENTATION_MADGWICK
+    const orientation_stats_t* stats = orientation_madgwick_get_stats(&orientation_global);
+#else
+    const orientation_stats_t* stats = orientation_complementary_get_stats(&orientation_global);
+#endif
+    printf("Orientation: %llu samples (%llu without accelerometer correction), %.0f mean / %lu max cycles per update, budget %d (%lu over)\n",
+           (unsigned long long)stats->samples, (unsigned long long)stats->accel_rejected,
+           stats->samples > 0 ? (double)orientation_cycles_global.total / stats->samples : 0.0,
+           (unsigned long)orientation_cycles_global.max, MPU_ORIENTATION_CYCLE_BUDGET,
+           (unsigned long)orientation_cycles_global.over_budget);
+}
+#endif
+
+// line 0: temperature, lines 1-3: x/y/z acceleration and gyro (or roll, pitch and heading with MPU_ORIENTATION, or
+// window means and peak to peak with MPU_WINDOW_STATS). Writing a line refreshes its page
+static bool display_sample_line(int line, const mpu6050_raw_frame* frame) {
+    // the only place samples are converted to physical units
+    mpu6050_xyz_data acceleration_data, gyro_data;
+    const mpu6050_xyz_data* acceleration = &acceleration_data;
+    const mpu6050_xyz_data* gyro = &gyro_data;
+    float temperature;
+    mpu6050_raw_to_float(mpu6050_get_session(&imu_global), frame, &acceleration_data, &gyro_data, &temperature);
+    char disp_str[100] = "";
+#if MPU_ORIENTATION
+    // line 0 stays the temperature
+    const orientation_euler_t* euler = &orientation_euler_global;
+    if (line == 1) {
+        snprintf(disp_str, sizeof(disp_str), "Roll:  %+06.1f ", orientation_deg_to_float(euler->roll));
+        return ssd1306_write_string_size8x8p(disp_str, 0, 0, 2);
+    } else if (line == 2) {
+        snprintf(disp_str, sizeof(disp_str), "Pitch: %+06.1f ", orientation_deg_to_float(euler->pitch));
+        return ssd1306_write_string_size8x8p(disp_str, 0, 0, 3);
+    } else if (line > 2) {
+        snprintf(disp_str, sizeof(disp_str), "Head:  %+06.1f ", orientation_deg_to_float(euler->yaw));
+        return ssd1306_write_string_size8x8p(disp_str, 0, 0, 4);
+    }
+#elif MPU_WINDOW_STATS
+    // every sample of the sliding window instead of the newest: mean temperature, mean and peak to peak acceleration
+    window_stats_snapshot_t snapshot;
+    if (window_stats_sliding_snapshot(&stats_sliding_global, &snapshot)) {
+        const mpu6050_session_t* session = mpu6050_get_session(&imu_global);
+        int16_t mean_counts[WINDOW_STATS_CHANNELS];
+        mpu6050_raw_frame mean_frame;
+        for (int c = 0; c < WINDOW_STATS_CHANNELS; c++) mean_counts[c] = (int16_t)lroundf(snapshot.mean[c]);
+        memcpy(&mean_frame, mean_counts, sizeof(mean_frame));
+        mpu6050_raw_to_float(session, &mean_frame, &acceleration_data, &gyro_data, &temperature);
+        if (line > 0) {
+            int axis = line > 3 ? 2 : line - 1;
+            float mean_g = axis == 0 ? acceleration->x : (axis == 1 ? acceleration->y : acceleration->z);
+            float peak_to_peak_g = (snapshot.max[axis] - snapshot.min[axis]) * session->accel_g_per_LSB;
+            snprintf(disp_str, sizeof(disp_str), "%c %+5.2f pp %4.2f ", 'X' + axis, mean_g, peak_to_peak_g);
+            return ssd1306_write_string_size8x8p(disp_str, 0, 0, 2 + axis);
+        }
+    }
+#endif
+    switch (line) {
+        case 0:
+            snprintf(disp_str, sizeof(disp_str), "Temp: %02.1f C", temperature);
+            return ssd1306_write_string_size8x8p(disp_str, 0, 0, 0);
+        case 1:
+            snprintf(disp_str, sizeof(disp_str), "X: %+02.1f %+02.1f ", acceleration->x, gyro->x);
+            return ssd1306_write_string_size8x8p(disp_str, 0, 0, 2);
+        case 2:
+            snprintf(disp_str, sizeof(disp_str), "Y: %+02.1f %+02.1f ", acceleration->y, gyro->y);
+            return ssd1306_write_string_size8x8p(disp_str, 0, 0, 3);
+        default:
+            snprintf(disp_str, sizeof(disp_str), "Z: %+02.1f %+02.1f ", acceleration->z, gyro->z);
+            return ssd1306_write_string_size8x8p(disp_str, 0, 0, 4);
+    }
+}
@@ -0,0 +1,131 @@
+#include "motion_gate.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+// helpers not to be used outside of this file
+static bool enter_idle(motion_gate_t* gate, int64_t now_us);
+static bool enter_active(motion_gate_t* gate, int64_t now_us);
+static void account_state_time(motion_gate_t* gate, int64_t now_us);
+
+bool motion_gate_init(motion_gate_t* gate, mpu6050_t* dev, const motion_gate_config_t* config) {
+    if (!gate || !dev || !config) {
+        printf("passed NULL pointer to motion_gate_init() function\n");
+        return false;
+    }
+    if (config->quiet_period_ms == 0) {
+        printf("motion gate: quiet period must not be 0\n");
+        return false;
+    }
+    memset(gate, 0, sizeof(*gate));
+    gate->dev = dev;
+    gate->config = *config;
+    if (!mpu6050_motion_enable(dev, config->int_pin, config->threshold_mg, config->duration_ms)) return false;
+    int64_t now_us = esp_timer_get_time();
+    gate->state_since_us = now_us;
+    gate->state = MOTION_GATE_ACTIVE;
+    return enter_idle(gate, now_us);
+}
+
+bool motion_gate_poll(motion_gate_t* gate, uint32_t idle_timeout_ms, MOTION_GATE_EVENT* event) {
+    if (!gate || !event) {
+        printf("passed NULL pointer to motion_gate_poll() function\n");
+        return false;
+    }
+    *event = MOTION_GATE_EVENT_NONE;
+    bool motion;
+    if (gate->state == MOTION_GATE_IDLE) {
+        int64_t motion_us;
+        if (!mpu6050_wait_for_motion(gate->dev, idle_timeout_ms, &motion, &motion_us)) return false;
+        if (!motion) return true;
+        // the segment starts at the interrupt, not when the task got around to it
+        if (!enter_active(gate, motion_us)) return false;
+        *event = MOTION_GATE_EVENT_SEGMENT_OPENED;
+        return true;
+    }
+    if (!mpu6050_read_motion_status(gate->dev, &motion)) return false;
+    int64_t now_us = esp_timer_get_time();
+    if (motion) {
+        gate->last_motion_us = now_us;
+        return true;
+    }
+    if (now_us - gate->last_motion_us < (int64_t)gate->config.quiet_period_ms * 1000) return true;
+    if (!enter_idle(gate, now_us)) return false;
+    *event = MOTION_GATE_EVENT_SEGMENT_CLOSED;
+    return true;
+}
+
+// FIFO off, low power mode, and only a fresh motion interrupt wakes the task
+static bool enter_idle(motion_gate_t* gate, int64_t now_us) {
+    if (gate->state == MOTION_GATE_ACTIVE) {
+        int64_t segment_us = now_us - gate->state_since_us;
+        if (gate->stats.segments > 0 && segment_us > gate->stats.longest_segment_us) gate->stats.longest_segment_us = segment_us;
+    }
+    account_state_time(gate, now_us);
+    gate->state = MOTION_GATE_IDLE;
+    if (!mpu6050_fifo_disable(gate->dev)) return false;
+    if (!mpu6050_low_power_enter(gate->dev, gate->config.idle_wake_freq)) return false;
+    // the motion interrupt kept firing while active: drop those notifications and the flag
+    ulTaskNotifyTake(pdTRUE, 0);
+    bool motion;
+    return mpu6050_read_motion_status(gate->dev, &motion);
+}
+
+static bool enter_active(motion_gate_t* gate, int64_t now_us) {
+    account_state_time(gate, now_us);
+    gate->state = MOTION_GATE_ACTIVE;
+    gate->last_motion_us = now_us;
+    gate->segment = ++gate->stats.segments;
+    gate->segment_frames = 0;
+    if (!mpu6050_low_power_exit(gate->dev)) return false;
+    // starts the FIFO empty, so the segment holds only full rate samples
+    return mpu6050_fifo_enable(gate->dev);
+}
+
+static void account_state_time(motion_gate_t* gate, int64_t now_us) {
+    int64_t elapsed_us = now_us - gate->state_since_us;
+    if (gate->state == MOTION_GATE_ACTIVE) {
+        gate->stats.active_us += elapsed_us;
+    } else {
+        gate->stats.idle_us += elapsed_us;
+    }
+    gate->state_since_us = now_us;
+}
+
+void motion_gate_add_frames(motion_gate_t* gate, size_t frames) {
+    gate->segment_frames += frames;
+    gate->stats.frames += frames;
+}
+
+bool motion_gate_is_active(const motion_gate_t* gate) {
+    return gate->state == MOTION_GATE_ACTIVE;
+}
+
+uint32_t motion_gate_get_segment(const motion_gate_t* gate) {
+    return gate->segment;
+}
+
+uint32_t motion_gate_get_segment_frames(const motion_gate_t* gate) {
+    return gate->segment_frames;
+}
+
+int64_t motion_gate_get_transition_time_us(const motion_gate_t* gate) {
+    return gate->state_since_us;
+}
+
+const motion_gate_stats_t* motion_gate_get_stats(const motion_gate_t* gate) {
+    return &gate->stats;
+}
+
+void motion_gate_print_stats(const motion_gate_t* gate) {
+    const motion_gate_stats_t* stats = &gate->stats;
+    int64_t current_us = esp_timer_get_time() - gate->state_since_us;
+    int64_t active_us = stats->active_us + (gate->state == MOTION_GATE_ACTIVE ? current_us : 0);
+    int64_t idle_us = stats->idle_us + (gate->state == MOTION_GATE_IDLE ? current_us : 0);
+    int64_t total_us = active_us + idle_us;
+    printf("Motion gate: %s, %lu segments (longest %.1f s), %llu samples, active %.1f s idle %.1f s, duty cycle %.1f%%\n",
+           gate->state == MOTION_GATE_ACTIVE ? "active" : "idle", (unsigned long)stats->segments,
+           stats->longest_segment_us / 1e6, (unsigned long long)stats->frames, active_us / 1e6, idle_us / 1e6,
+           total_us > 0 ? 100.0 * active_us / total_us : 0.0);
+}
@@ -0,0 +1,79 @@
+#ifndef MOTION_GATE_H
+#define MOTION_GATE_H
+#include "mpu6050_I2C.h"
+/*
+Motion gated acquisition on top of the MPU6050 motion detection interrupt.
+
+IDLE: the sensor sits in low power cycle mode (accelerometer only, a few wake-ups per
+second) with the FIFO off, and the task sleeps on the motion interrupt. Nothing is read
+from the bus and nothing is logged.
+
+ACTIVE: motion woke the sensor up. It runs at the configured full rate with the FIFO on
+and every sample is logged; that stretch of samples is a segment. The motion flag is
+checked once per pass of the loop, and once no motion was seen for quiet_period_ms the
+segment is closed and the sensor goes back to IDLE.
+
+motion_gate_poll() reports the transitions so the caller can mark the segments in the
+log and flush. Duty cycle statistics (time spent in each state, segments) show how much
+logging the gate saved.
+*/
+
+typedef enum {
+    MOTION_GATE_IDLE = 0,
+    MOTION_GATE_ACTIVE = 1
+} MOTION_GATE_STATE;
+
+typedef enum {
+    MOTION_GATE_EVENT_NONE = 0,
+    MOTION_GATE_EVENT_SEGMENT_OPENED,   // motion: the FIFO is running, start logging
+    MOTION_GATE_EVENT_SEGMENT_CLOSED    // quiet for quiet_period_ms: back in low power mode
+} MOTION_GATE_EVENT;
+
+typedef struct {
+    gpio_num_t int_pin;             // GPIO wired to the MPU6050 INT pin
+    uint16_t threshold_mg;          // see mpu6050_motion_enable()
+    uint8_t duration_ms;
+    uint32_t quiet_period_ms;       // no motion for this long closes the segment
+    MPU6050_WAKE_FREQ idle_wake_freq;
+} motion_gate_config_t;
+
+typedef struct {
+    uint32_t segments;              // segments opened
+    uint64_t frames;                // samples logged in segments (motion_gate_add_frames())
+    int64_t active_us;              // time spent in each state, up to the last transition
+    int64_t idle_us;
+    int64_t longest_segment_us;
+} motion_gate_stats_t;
+
+typedef struct {
+    mpu6050_t* dev;
+    motion_gate_config_t config;
+    MOTION_GATE_STATE state;
+    int64_t state_since_us;         // esp_timer clock
+    int64_t last_motion_us;
+    uint32_t segment;               // number of the current / last segment
+    uint32_t segment_frames;
+    motion_gate_stats_t stats;
+} motion_gate_t;
+
+// arms motion detection on dev (set up with mpu6050_init() and a sample rate) and starts IDLE
+bool motion_gate_init(motion_gate_t* gate, mpu6050_t* dev, const motion_gate_config_t* config);
+/*
+call once per pass of the acquisition loop. IDLE: blocks for up to idle_timeout_ms waiting
+for motion. ACTIVE: checks the motion flag (one register read) and returns right away.
+*event receives the transition that happened, if any
+*/
+bool motion_gate_poll(motion_gate_t* gate, uint32_t idle_timeout_ms, MOTION_GATE_EVENT* event);
+// counts samples logged in the current segment
+void motion_gate_add_frames(motion_gate_t* gate, size_t frames);
+bool motion_gate_is_active(const motion_gate_t* gate);
+// number of the current segment (or the one just closed) and the samples logged in it
+uint32_t motion_gate_get_segment(const motion_gate_t* gate);
+uint32_t motion_gate_get_segment_frames(const motion_gate_t* gate);
+// esp_timer_get_time() of the last transition: the motion interrupt for SEGMENT_OPENED
+int64_t motion_gate_get_transition_time_us(const motion_gate_t* gate);
+const motion_gate_stats_t* motion_gate_get_stats(const motion_gate_t* gate);
+// segments, time in each state and the active duty cycle, including the current state
+void motion_gate_print_stats(const motion_gate_t* gate);
+
+#endif /* MOTION_GATE_H */
@@ -1,18 +1,56 @@
 #include "mpu6050_I2C.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
 
-// trackers for settings that would otherwise have to be read from registers (slow)
-MPU6050_GYROSCOPE_RANGE current_gyro_range;
-MPU6050_ACCELEROMETER_RANGE current_accel_range;
-MPU6050_DLPF_FREQ current_DLPF_val;
+// FIFO_EN
+#define MPU6050_FIFO_EN_TEMPERATURE  0x80
+#define MPU6050_FIFO_EN_GYRO_XYZ     0x70
+#define MPU6050_FIFO_EN_ACCEL        0x08
+// where each channel group sits in a full frame / after MPU6050_ACCEL_X_OUT_REG
+#define MPU6050_FRAME_ACCEL_OFFSET        0
+#define MPU6050_FRAME_TEMPERATURE_OFFSET  6
+#define MPU6050_FRAME_GYRO_OFFSET         8
+// USER_CTRL
+#define MPU6050_USER_CTRL_FIFO_EN    0x40
+#define MPU6050_USER_CTRL_FIFO_RESET 0x04
+// INT_ENABLE / INT_STATUS
+#define MPU6050_INT_MOTION           0x40
+#define MPU6050_INT_DATA_READY       0x01
+// INT_PIN_CFG: active high, push-pull, 50 us pulse, INT_STATUS cleared by any read
+#define MPU6050_INT_PIN_CFG_PULSE    0x10
+// ACCEL_CONFIG: high pass filter for motion detection, 5 Hz cutoff
+#define MPU6050_ACCEL_HPF_5_HZ       0x01
+// MOT_THR counts 2 mg per LSB, MOT_DUR 1 ms per LSB
+#define MPU6050_MOT_THR_MG_PER_LSB   2
+// PWR_MGMT_1
+#define MPU6050_PWR_MGMT_1_CLOCK_PLL 0x01
+#define MPU6050_PWR_MGMT_1_TEMP_DIS  0x08
+#define MPU6050_PWR_MGMT_1_CYCLE     0x20
+// PWR_MGMT_2: LP_WAKE_CTRL in bits 7:6, gyro standby bits
+#define MPU6050_PWR_MGMT_2_WAKE_SHIFT 6
+#define MPU6050_PWR_MGMT_2_STBY_GYRO 0x07
 
 // helpers not to be used outside of this file
-static inline bool mpu6050_write_to_register(byte register_to_write_to, byte value_to_write);
-static inline bool mpu6050_read_from_register(byte register_to_read, byte* register_value);
-static inline bool mpu6050_read_register_block(byte register_to_read, byte* register_values, byte number_of_registers);
+static inline bool mpu6050_write_to_register(mpu6050_t* dev, byte register_to_write_to, byte value_to_write);
+static inline bool mpu6050_read_from_register(mpu6050_t* dev, byte register_to_read, byte* register_value);
+static inline bool mpu6050_read_register_block(mpu6050_t* dev, byte register_to_read, byte* register_values, byte number_of_registers);
 static inline int16_t combine_bytes(byte high, byte low);
 static float get_temperature_centigrade(mpu6050_raw_data raw_temperature_reading);
-static inline float raw_accel_to_float(mpu6050_raw_data raw_accel);
-static inline float raw_gyro_to_float(mpu6050_raw_data raw_gyro);
+static byte burst_plan(mpu6050_t* dev, byte* first, byte* end);
+static void burst_finish(mpu6050_t* dev, byte channels, byte first, byte end, const byte* read_data, mpu6050_raw_frame* frame);
+static bool mpu6050_fifo_reset(mpu6050_t* dev);
+static bool mpu6050_fifo_write_channels(mpu6050_t* dev);
+static bool temperature_due(const mpu6050_t* dev);
+static bool read_temperature_if_due(mpu6050_t* dev);
+static void fifo_frame_expand(const mpu6050_t* dev, const byte* fifo_frame, mpu6050_raw_frame* raw);
+static bool mpu6050_set_interrupt_enable(mpu6050_t* dev, byte interrupt_mask, bool enable);
+static void mpu6050_data_ready_isr(void* arg);
+static bool int_pin_setup(mpu6050_t* dev, gpio_num_t int_pin, bool notify_task);
+static bool data_ready_setup(mpu6050_t* dev, gpio_num_t int_pin, bool notify_task);
+static bool data_ready_wait(mpu6050_t* dev, uint32_t timeout_ms, int64_t* timestamp_us);
+static void data_ready_read_done(mpu6050_t* dev, int64_t timestamp_us);
 
 /**
  * @brief Reset the MPU6050 device.
@@ -21,22 +59,34 @@ static inline float raw_gyro_to_float(mpu6050_raw_data raw_gyro);
  *
  * @return true if the reset command was sent, false otherwise.
  */
-static bool mpu6050_reset(void);
+static bool mpu6050_reset(mpu6050_t* dev);
+
+bool mpu6050_init(mpu6050_t* dev, byte address, MPU6050_ACCELEROMETER_RANGE accel_range, MPU6050_GYROSCOPE_RANGE gyro_range) {
+    if (!dev) {
+        printf("passed NULL pointer to mpu6050_init() function\n");
+        return false;
+    }
+    memset(dev, 0, sizeof(*dev));
+    dev->address = address;
+    dev->session.address = address;
+    dev->session.channels = MPU6050_CHANNEL_ALL;
+    dev->fifo_channels = MPU6050_CHANNEL_ALL;
+    dev->fifo_frame_size = MPU6050_FIFO_FRAME_SIZE;
+    dev->data_ready_pin = GPIO_NUM_NC;
 
-bool mpu6050_init(MPU6050_ACCELEROMETER_RANGE accel_range, MPU6050_GYROSCOPE_RANGE gyro_range) {
     I2C_init();
     // reset the sensor first
-    if (!mpu6050_reset()) return false;
-    if (!mpu6050_set_accel_range(accel_range)) return false;
-    if (!mpu6050_set_gyro_range(gyro_range)) return false;
+    if (!mpu6050_reset(dev)) return false;
+    if (!mpu6050_set_accel_range(dev, accel_range)) return false;
+    if (!mpu6050_set_gyro_range(dev, gyro_range)) return false;
     // Wake up and select PLL clock
-    if (!mpu6050_write_to_register(MPU6050_PWR_MGMT_1_REG, 0x01)) return false;
+    if (!mpu6050_write_to_register(dev, MPU6050_PWR_MGMT_1_REG, MPU6050_PWR_MGMT_1_CLOCK_PLL)) return false;
 
     // Set DLPF to ~44Hz
-    if (!mpu6050_set_DLPF_frequency(MPU6050_DLPF_44_HZ)) return false;
+    if (!mpu6050_set_DLPF_frequency(dev, MPU6050_DLPF_44_HZ)) return false;
 
     // Set sample rate divider to 0 -> 1kHz
-    if (!mpu6050_set_sample_rate(1000)) return false;
+    if (!mpu6050_set_sample_rate(dev, 1000)) return false;
     return true;
 }
 
@@ -45,47 +95,553 @@ gets acceleration, gyro, and temperature data.
 Retrieves the most recent values written. This is determined by the sample rate in register 25 (0x19)
 Acceleration and gyro will be scaled according to the ranges set. Temperature is in degrees centigrade.
 */
-bool mpu6050_read_all(mpu6050_xyz_data* accel, mpu6050_xyz_data* gyro, float* temperature) {
+bool mpu6050_read_all(mpu6050_t* dev, mpu6050_xyz_data* accel, mpu6050_xyz_data* gyro, float* temperature) {
 
     /*
-    xyz data is 2 bytes for each dimension (6 bytes) 
+    xyz data is 2 bytes for each dimension (6 bytes)
     we are reading xyz data for both acceleration and gyro (12 bytes)
     two addional bytes are needed for the temperature
     total = 14 bytes
     */
-    if (!accel || !gyro || !temperature) {
+    if (!dev || !accel || !gyro || !temperature) {
         printf("passed NULL pointer to mpu6050_read_all() function\n");
         return false;
     }
-    byte read_data[14] = {0};
-    if (!mpu6050_read_register_block(MPU6050_ACCEL_X_OUT_REG, read_data, sizeof(read_data))) return false;
-    mpu6050_raw_data a_x = combine_bytes(read_data[0], read_data[1]);
-    mpu6050_raw_data a_y = combine_bytes(read_data[2], read_data[3]);
-    mpu6050_raw_data a_z = combine_bytes(read_data[4], read_data[5]);  
+    byte read_data[MPU6050_FIFO_FRAME_SIZE];
+    if (!mpu6050_read_register_block(dev, MPU6050_ACCEL_X_OUT_REG, read_data, sizeof(read_data))) return false;
+    mpu6050_raw_frame frame;
+    mpu6050_frame_to_raw(read_data, &frame);
+    mpu6050_raw_to_float(&dev->session, &frame, accel, gyro, temperature);
+    return true;
+}
+
+bool mpu6050_read_raw(mpu6050_t* dev, mpu6050_raw_frame* frame) {
+    if (!dev || !frame) {
+        printf("passed NULL pointer to mpu6050_read_raw() function\n");
+        return false;
+    }
+    byte first, end;
+    byte channels = burst_plan(dev, &first, &end);
+    byte read_data[MPU6050_FIFO_FRAME_SIZE] = {0};
+    if (channels && !mpu6050_read_register_block(dev, MPU6050_ACCEL_X_OUT_REG + first, &read_data[first], end - first)) return false;
+    burst_finish(dev, channels, first, end, read_data, frame);
+    return true;
+}
+
+bool mpu6050_read_raw_pair(mpu6050_t* first, mpu6050_t* second, mpu6050_raw_frame* first_frame, mpu6050_raw_frame* second_frame) {
+    if (!first || !second || !first_frame || !second_frame) {
+        printf("passed NULL pointer to mpu6050_read_raw_pair() function\n");
+        return false;
+    }
+    mpu6050_t* devices[2] = {first, second};
+    mpu6050_raw_frame* frames[2] = {first_frame, second_frame};
+    byte read_data[2][MPU6050_FIFO_FRAME_SIZE] = {0};
+    byte channels[2], start[2], end[2];
+    I2C_read_request requests[2];
+    size_t request_count = 0;
+    for (int i = 0; i < 2; i++) {
+        channels[i] = burst_plan(devices[i], &start[i], &end[i]);
+        if (!channels[i]) continue;
+        requests[request_count++] = (I2C_read_request){
+            .slave_address = devices[i]->address,
+            .starting_register = MPU6050_ACCEL_X_OUT_REG + start[i],
+            .number_of_bytes_to_read = end[i] - start[i],
+            .read_bytes = &read_data[i][start[i]]
+        };
+    }
+    if (request_count && !I2C_read_sequence(requests, request_count)) return false;
+    for (int i = 0; i < 2; i++) {
+        burst_finish(devices[i], channels[i], start[i], end[i], read_data[i], frames[i]);
+    }
+    return true;
+}
+
+// channels this read has to fetch and the one burst [first, end) of frame bytes that covers them
+static byte burst_plan(mpu6050_t* dev, byte* first, byte* end) {
+    byte channels = dev->session.channels;
+    if ((channels & MPU6050_CHANNEL_TEMPERATURE) && !temperature_due(dev)) channels &= ~MPU6050_CHANNEL_TEMPERATURE;
+    // accel + gyro takes the temperature along for free
+    *first = (channels & MPU6050_CHANNEL_ACCEL) ? MPU6050_FRAME_ACCEL_OFFSET :
+             (channels & MPU6050_CHANNEL_TEMPERATURE) ? MPU6050_FRAME_TEMPERATURE_OFFSET : MPU6050_FRAME_GYRO_OFFSET;
+    *end = (channels & MPU6050_CHANNEL_GYRO) ? MPU6050_FIFO_FRAME_SIZE :
+           (channels & MPU6050_CHANNEL_TEMPERATURE) ? MPU6050_FRAME_GYRO_OFFSET : MPU6050_FRAME_TEMPERATURE_OFFSET;
+    return channels;
+}
+
+// read_data holds the burst at its frame offsets
+static void burst_finish(mpu6050_t* dev, byte channels, byte first, byte end, const byte* read_data, mpu6050_raw_frame* frame) {
+    memset(frame, 0, sizeof(*frame));
+    if (channels) {
+        mpu6050_raw_frame burst;
+        mpu6050_frame_to_raw(read_data, &burst);
+        if (channels & MPU6050_CHANNEL_ACCEL) memcpy(frame->accel, burst.accel, sizeof(frame->accel));
+        if (channels & MPU6050_CHANNEL_GYRO) memcpy(frame->gyro, burst.gyro, sizeof(frame->gyro));
+        if (first <= MPU6050_FRAME_TEMPERATURE_OFFSET && end >= MPU6050_FRAME_GYRO_OFFSET) {
+            dev->temperature = burst.temperature;
+            dev->temperature_due_us = esp_timer_get_time() + dev->temperature_interval_us;
+        }
+    }
+    if (dev->session.channels & MPU6050_CHANNEL_TEMPERATURE) frame->temperature = dev->temperature;
+}
+
+bool mpu6050_set_channels(mpu6050_t* dev, byte channels, uint32_t temperature_interval_ms) {
+    if (channels == 0 || (channels & ~MPU6050_CHANNEL_ALL)) {
+        printf("Invalid MPU6050 channel mask 0x%02X\n", channels);
+        return false;
+    }
+    dev->session.channels = channels;
+    dev->temperature_interval_us = (int64_t)temperature_interval_ms * 1000;
+    dev->temperature_due_us = 0; // read it with the next sample
+    // the FIFO only carries the temperature when every sample wants it
+    dev->fifo_channels = channels;
+    if (temperature_interval_ms > 0) dev->fifo_channels &= ~MPU6050_CHANNEL_TEMPERATURE;
+    dev->fifo_frame_size = ((dev->fifo_channels & MPU6050_CHANNEL_ACCEL) ? 6 : 0) +
+                           ((dev->fifo_channels & MPU6050_CHANNEL_TEMPERATURE) ? 2 : 0) +
+                           ((dev->fifo_channels & MPU6050_CHANNEL_GYRO) ? 6 : 0);
+    if (!dev->fifo_enabled) return true;
+    // frames already in the FIFO have the old layout
+    return mpu6050_fifo_write_channels(dev) && mpu6050_fifo_reset(dev);
+}
+
+byte mpu6050_get_channels(const mpu6050_t* dev) {
+    return dev->session.channels;
+}
+
+static bool temperature_due(const mpu6050_t* dev) {
+    return dev->temperature_interval_us == 0 || esp_timer_get_time() >= dev->temperature_due_us;
+}
+
+// the FIFO path reads a decimated temperature on its own: 2 bytes once per interval
+static bool read_temperature_if_due(mpu6050_t* dev) {
+    if (!(dev->session.channels & MPU6050_CHANNEL_TEMPERATURE) ||
+        (dev->fifo_channels & MPU6050_CHANNEL_TEMPERATURE) || !temperature_due(dev)) return true;
+    byte data[2];
+    if (!mpu6050_read_register_block(dev, MPU6050_TEMP_OUT_REG, data, sizeof(data))) return false;
+    dev->temperature = combine_bytes(data[0], data[1]);
+    dev->temperature_due_us = esp_timer_get_time() + dev->temperature_interval_us;
+    return true;
+}
+
+// 14 big endian bytes: accel xyz, temperature, gyro xyz (output register and FIFO frame layout)
+void mpu6050_frame_to_raw(const byte* frame, mpu6050_raw_frame* raw) {
+    raw->accel[0] = combine_bytes(frame[0], frame[1]);
+    raw->accel[1] = combine_bytes(frame[2], frame[3]);
+    raw->accel[2] = combine_bytes(frame[4], frame[5]);
+    raw->temperature = combine_bytes(frame[6], frame[7]);
+    raw->gyro[0] = combine_bytes(frame[8], frame[9]);
+    raw->gyro[1] = combine_bytes(frame[10], frame[11]);
+    raw->gyro[2] = combine_bytes(frame[12], frame[13]);
+}
+
+void mpu6050_raw_to_float(const mpu6050_session_t* session, const mpu6050_raw_frame* frame,
+                          mpu6050_xyz_data* accel, mpu6050_xyz_data* gyro, float* temperature) {
+    // the scales were computed by the range setters
+    const float accel_scale = session->accel_g_per_LSB;
+    const float gyro_scale = session->gyro_dps_per_LSB;
+    accel->x = frame->accel[0] * accel_scale;
+    accel->y = frame->accel[1] * accel_scale;
+    accel->z = frame->accel[2] * accel_scale;
+    *temperature = get_temperature_centigrade(frame->temperature);
+    gyro->x = frame->gyro[0] * gyro_scale;
+    gyro->y = frame->gyro[1] * gyro_scale;
+    gyro->z = frame->gyro[2] * gyro_scale;
+}
+
+const mpu6050_session_t* mpu6050_get_session(const mpu6050_t* dev) {
+    return &dev->session;
+}
+
+bool mpu6050_fifo_enable(mpu6050_t* dev) {
+    memset(&dev->fifo_stats, 0, sizeof(dev->fifo_stats));
+    if (!mpu6050_fifo_write_channels(dev)) return false;
+    // overflows show in the FIFO count; FIFO_OFLOW_EN stays off so it does not pulse a shared INT pin
+    if (!mpu6050_fifo_reset(dev)) return false;
+    dev->fifo_enabled = true;
+    return true;
+}
+
+bool mpu6050_fifo_disable(mpu6050_t* dev) {
+    dev->fifo_enabled = false;
+    if (!mpu6050_write_to_register(dev, MPU6050_USER_CTRL_REG, 0)) return false;
+    return mpu6050_write_to_register(dev, MPU6050_FIFO_EN_REG, 0);
+}
+
+static bool mpu6050_fifo_write_channels(mpu6050_t* dev) {
+    byte fifo_enable = 0;
+    if (dev->fifo_channels & MPU6050_CHANNEL_ACCEL) fifo_enable |= MPU6050_FIFO_EN_ACCEL;
+    if (dev->fifo_channels & MPU6050_CHANNEL_TEMPERATURE) fifo_enable |= MPU6050_FIFO_EN_TEMPERATURE;
+    if (dev->fifo_channels & MPU6050_CHANNEL_GYRO) fifo_enable |= MPU6050_FIFO_EN_GYRO_XYZ;
+    return mpu6050_write_to_register(dev, MPU6050_FIFO_EN_REG, fifo_enable);
+}
+
+size_t mpu6050_fifo_get_frame_size(const mpu6050_t* dev) {
+    return dev->fifo_frame_size;
+}
+
+// data-ready and motion share INT_ENABLE
+static bool mpu6050_set_interrupt_enable(mpu6050_t* dev, byte interrupt_mask, bool enable) {
+    byte value = enable ? (dev->interrupt_enable | interrupt_mask) : (dev->interrupt_enable & ~interrupt_mask);
+    if (!mpu6050_write_to_register(dev, MPU6050_INT_ENABLE_REG, value)) return false;
+    dev->interrupt_enable = value;
+    return true;
+}
+
+// empties the FIFO and restarts it on a frame boundary
+static bool mpu6050_fifo_reset(mpu6050_t* dev) {
+    if (!mpu6050_write_to_register(dev, MPU6050_USER_CTRL_REG, MPU6050_USER_CTRL_FIFO_RESET)) return false;
+    // no INT_STATUS read: nothing is latched for the FIFO, and it would clear a pending motion flag
+    return mpu6050_write_to_register(dev, MPU6050_USER_CTRL_REG, MPU6050_USER_CTRL_FIFO_EN);
+}
+
+bool mpu6050_fifo_get_count(mpu6050_t* dev, uint16_t* bytes) {
+    byte count[2];
+    if (!bytes) {
+        printf("passed NULL pointer to mpu6050_fifo_get_count()\n");
+        return false;
+    }
+    if (!mpu6050_read_register_block(dev, MPU6050_FIFO_COUNT_H_REG, count, sizeof(count))) return false;
+    *bytes = (uint16_t)((count[0] << 8) | count[1]);
+    return true;
+}
+
+bool mpu6050_fifo_read_frames(mpu6050_t* dev, byte* buffer, size_t max_frames, size_t* frames_read) {
+    if (!dev || !buffer || !frames_read) {
+        printf("passed NULL pointer to mpu6050_fifo_read_frames()\n");
+        return false;
+    }
+    *frames_read = 0;
+    uint16_t count;
+    if (!mpu6050_fifo_get_count(dev, &count)) return false;
+    /*
+    a full FIFO means the oldest bytes were overwritten. Unless the frame size divides 1024 a
+    frame was cut and the frame boundaries are lost. Checking the count catches this without
+    reading INT_STATUS every time or enabling the overflow interrupt
+    */
+    if (count >= MPU6050_FIFO_SIZE) {
+        dev->fifo_stats.overflows++;
+        return mpu6050_fifo_reset(dev);
+    }
+    // only a decimated temperature selected: nothing goes through the FIFO
+    if (dev->fifo_frame_size == 0) return true;
+    size_t frames = count / dev->fifo_frame_size;
+    if (frames > max_frames) frames = max_frames;
+    if (frames == 0) return true;
+    // FIFO_R_W does not auto increment, so a burst read keeps popping the FIFO
+    if (!I2C_read_many(dev->address, MPU6050_FIFO_R_W_REG, frames * dev->fifo_frame_size, buffer)) return false;
+    dev->fifo_stats.bursts++;
+    dev->fifo_stats.frames_read += frames;
+    *frames_read = frames;
+    return true;
+}
+
+bool mpu6050_fifo_read_raw(mpu6050_t* dev, mpu6050_raw_frame* frames, size_t max_frames, size_t* frames_read) {
+    _Static_assert(sizeof(mpu6050_raw_frame) == MPU6050_FIFO_FRAME_SIZE, "raw frames must match the FIFO frames");
+    if (!mpu6050_fifo_read_frames(dev, (byte*)frames, max_frames, frames_read)) return false;
+    if (!read_temperature_if_due(dev)) return false;
+    /*
+    expanded in place, last frame first: FIFO frames are never larger than raw frames, so
+    raw frame i only overwrites FIFO frames >= i, which are already done
+    */
+    const byte* fifo_frames = (const byte*)frames;
+    for (size_t i = *frames_read; i-- > 0;) {
+        byte fifo_frame[MPU6050_FIFO_FRAME_SIZE];
+        memcpy(fifo_frame, &fifo_frames[i * dev->fifo_frame_size], dev->fifo_frame_size);
+        fifo_frame_expand(dev, fifo_frame, &frames[i]);
+    }
+    return true;
+}
+
+// FIFO frames hold the FIFO channels in register order
+static void fifo_frame_expand(const mpu6050_t* dev, const byte* fifo_frame, mpu6050_raw_frame* raw) {
+    memset(raw, 0, sizeof(*raw));
+    if (dev->fifo_channels & MPU6050_CHANNEL_ACCEL) {
+        for (int axis = 0; axis < 3; axis++, fifo_frame += 2) raw->accel[axis] = combine_bytes(fifo_frame[0], fifo_frame[1]);
+    }
+    if (dev->fifo_channels & MPU6050_CHANNEL_TEMPERATURE) {
+        raw->temperature = combine_bytes(fifo_frame[0], fifo_frame[1]);
+        fifo_frame += 2;
+    } else if (dev->session.channels & MPU6050_CHANNEL_TEMPERATURE) {
+        raw->temperature = dev->temperature;
+    }
+    if (dev->fifo_channels & MPU6050_CHANNEL_GYRO) {
+        for (int axis = 0; axis < 3; axis++, fifo_frame += 2) raw->gyro[axis] = combine_bytes(fifo_frame[0], fifo_frame[1]);
+    }
+}
+
+void mpu6050_fifo_frame_to_float(const mpu6050_session_t* session, const byte* frame,
+                                 mpu6050_xyz_data* accel, mpu6050_xyz_data* gyro, float* temperature) {
+    mpu6050_raw_frame raw;
+    mpu6050_frame_to_raw(frame, &raw);
+    mpu6050_raw_to_float(session, &raw, accel, gyro, temperature);
+}
+
+const mpu6050_fifo_stats_t* mpu6050_fifo_get_stats(const mpu6050_t* dev) {
+    return &dev->fifo_stats;
+}
+
+// timestamp first: everything after it only adds latency
+static void IRAM_ATTR mpu6050_data_ready_isr(void* arg) {
+    mpu6050_t* dev = (mpu6050_t*)arg;
+    dev->isr_timestamp_us = (uint32_t)esp_timer_get_time();
+    if (!dev->data_ready_task) return;
+    BaseType_t higher_priority_task_woken = pdFALSE;
+    vTaskNotifyGiveFromISR((TaskHandle_t)dev->data_ready_task, &higher_priority_task_woken);
+    if (higher_priority_task_woken) portYIELD_FROM_ISR();
+}
+
+bool mpu6050_data_ready_enable(mpu6050_t* dev, gpio_num_t int_pin) {
+    if (!data_ready_setup(dev, int_pin, true)) return false;
+    // drop any notification left from before so the first wait gets a fresh sample
+    ulTaskNotifyTake(pdTRUE, 0);
+    return true;
+}
+
+static bool data_ready_setup(mpu6050_t* dev, gpio_num_t int_pin, bool notify_task) {
+    memset(&dev->data_ready_stats, 0, sizeof(dev->data_ready_stats));
+    dev->data_ready_stats.min_latency_us = UINT32_MAX;
+    dev->data_ready_stats.min_interval_us = UINT32_MAX;
+    if (!int_pin_setup(dev, int_pin, notify_task)) return false;
+    return mpu6050_set_interrupt_enable(dev, MPU6050_INT_DATA_READY, true);
+}
+
+// data-ready and motion share the INT pin and its ISR
+static bool int_pin_setup(mpu6050_t* dev, gpio_num_t int_pin, bool notify_task) {
+    dev->data_ready_task = notify_task ? xTaskGetCurrentTaskHandle() : NULL;
+    if (dev->data_ready_pin == int_pin) return true;
+    if (dev->data_ready_pin != GPIO_NUM_NC) gpio_isr_handler_remove(dev->data_ready_pin);
+    dev->data_ready_pin = int_pin;
+
+    gpio_reset_pin(int_pin);
+    gpio_set_direction(int_pin, GPIO_MODE_INPUT);
+    gpio_set_intr_type(int_pin, GPIO_INTR_POSEDGE);
+    // the service may already be installed by another driver (or the other sensor)
+    esp_err_t err = gpio_install_isr_service(ESP_INTR_FLAG_IRAM);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        printf("Could not install GPIO ISR service: %d\n", err);
+        return false;
+    }
+    if (gpio_isr_handler_add(int_pin, mpu6050_data_ready_isr, dev) != ESP_OK) {
+        printf("Could not add MPU6050 data ready ISR\n");
+        return false;
+    }
+    return mpu6050_write_to_register(dev, MPU6050_INT_PIN_CFG_REG, MPU6050_INT_PIN_CFG_PULSE);
+}
+
+bool mpu6050_data_ready_disable(mpu6050_t* dev) {
+    // the pin stays armed while motion detection still uses it
+    if (dev->data_ready_pin != GPIO_NUM_NC && !(dev->interrupt_enable & MPU6050_INT_MOTION)) {
+        gpio_isr_handler_remove(dev->data_ready_pin);
+        dev->data_ready_pin = GPIO_NUM_NC;
+        dev->data_ready_task = NULL;
+    }
+    return mpu6050_set_interrupt_enable(dev, MPU6050_INT_DATA_READY, false);
+}
+
+bool mpu6050_motion_enable(mpu6050_t* dev, gpio_num_t int_pin, uint16_t threshold_mg, uint8_t duration_ms) {
+    if (!dev) {
+        printf("passed NULL pointer to mpu6050_motion_enable() function\n");
+        return false;
+    }
+    uint32_t threshold = (threshold_mg + MPU6050_MOT_THR_MG_PER_LSB - 1) / MPU6050_MOT_THR_MG_PER_LSB;
+    if (threshold == 0 || threshold > 0xFF || duration_ms == 0) {
+        printf("Invalid motion threshold / duration!\n");
+        return false;
+    }
+    // motion is detected on the high passed acceleration, so gravity and slow tilt do not count
+    dev->accel_high_pass = MPU6050_ACCEL_HPF_5_HZ;
+    if (!mpu6050_set_accel_range(dev, dev->accel_range)) return false;
+    if (!mpu6050_write_to_register(dev, MPU6050_MOT_THR_REG, (byte)threshold)) return false;
+    if (!mpu6050_write_to_register(dev, MPU6050_MOT_DUR_REG, duration_ms)) return false;
+    if (!int_pin_setup(dev, int_pin, true)) return false;
+    if (!mpu6050_set_interrupt_enable(dev, MPU6050_INT_MOTION, true)) return false;
+    bool motion;
+    return mpu6050_read_motion_status(dev, &motion);
+}
+
+bool mpu6050_read_motion_status(mpu6050_t* dev, bool* motion) {
+    byte int_status;
+    if (!motion) {
+        printf("passed NULL pointer to mpu6050_read_motion_status() function\n");
+        return false;
+    }
+    if (!mpu6050_read_from_register(dev, MPU6050_INT_STATUS_REG, &int_status)) return false;
+    *motion = (int_status & MPU6050_INT_MOTION) != 0;
+    return true;
+}
+
+bool mpu6050_wait_for_motion(mpu6050_t* dev, uint32_t timeout_ms, bool* motion, int64_t* timestamp_us) {
+    if (!dev || !motion || !timestamp_us) {
+        printf("passed NULL pointer to mpu6050_wait_for_motion() function\n");
+        return false;
+    }
+    *motion = false;
+    if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout_ms)) == 0) return true;
+    int64_t now_us = esp_timer_get_time();
+    uint32_t age_us = (uint32_t)now_us - dev->isr_timestamp_us;
+    *timestamp_us = now_us - age_us;
+    // the pin also pulses for other enabled interrupts: only the status bit says it was motion
+    return mpu6050_read_motion_status(dev, motion);
+}
+
+bool mpu6050_low_power_enter(mpu6050_t* dev, MPU6050_WAKE_FREQ wake_freq) {
+    if ((unsigned)wake_freq > MPU6050_WAKE_40_HZ) {
+        printf("Invalid wake frequency!\n");
+        return false;
+    }
+    byte power_2 = (byte)(wake_freq << MPU6050_PWR_MGMT_2_WAKE_SHIFT) | MPU6050_PWR_MGMT_2_STBY_GYRO;
+    if (!mpu6050_write_to_register(dev, MPU6050_PWR_MGMT_2_REG, power_2)) return false;
+    // the PLL runs off the gyro, so cycle mode uses the internal oscillator
+    if (!mpu6050_write_to_register(dev, MPU6050_PWR_MGMT_1_REG, MPU6050_PWR_MGMT_1_CYCLE | MPU6050_PWR_MGMT_1_TEMP_DIS)) return false;
+    dev->low_power = true;
+    return true;
+}
+
+bool mpu6050_low_power_exit(mpu6050_t* dev) {
+    if (!mpu6050_write_to_register(dev, MPU6050_PWR_MGMT_1_REG, MPU6050_PWR_MGMT_1_CLOCK_PLL)) return false;
+    if (!mpu6050_write_to_register(dev, MPU6050_PWR_MGMT_2_REG, 0)) return false;
+    dev->low_power = false;
+    return true;
+}
+
+bool mpu6050_read_on_data_ready(mpu6050_t* dev, uint32_t timeout_ms, mpu6050_raw_frame* frame, int64_t* timestamp_us) {
+    if (!dev || !frame || !timestamp_us) {
+        printf("passed NULL pointer to mpu6050_read_on_data_ready() function\n");
+        return false;
+    }
+    if (!data_ready_wait(dev, timeout_ms, timestamp_us)) return false;
+    if (!mpu6050_read_raw(dev, frame)) return false;
+    data_ready_read_done(dev, *timestamp_us);
+    return true;
+}
+
+// blocks until the ISR notifies, then accounts the interrupt (count, latency, interval)
+static bool data_ready_wait(mpu6050_t* dev, uint32_t timeout_ms, int64_t* timestamp_us) {
+    // every interrupt since the last call adds one; more than one means samples were overwritten
+    uint32_t interrupts = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout_ms));
+    if (interrupts == 0) {
+        printf("Timeout waiting for MPU6050 data ready\n");
+        return false;
+    }
+    uint32_t isr_us = dev->isr_timestamp_us;
+    int64_t now_us = esp_timer_get_time();
+    // 32 bit differences survive the wrap of the ISR timestamp
+    uint32_t latency_us = (uint32_t)now_us - isr_us;
+    *timestamp_us = now_us - latency_us;
+
+    mpu6050_data_ready_stats_t* stats = &dev->data_ready_stats;
+    stats->missed += interrupts - 1;
+    if (stats->samples > 0 && interrupts == 1) {
+        uint32_t interval_us = isr_us - dev->last_isr_timestamp_us;
+        if (interval_us < stats->min_interval_us) stats->min_interval_us = interval_us;
+        if (interval_us > stats->max_interval_us) stats->max_interval_us = interval_us;
+    }
+    dev->last_isr_timestamp_us = isr_us;
+    stats->samples++;
+    stats->total_latency_us += latency_us;
+    if (latency_us < stats->min_latency_us) stats->min_latency_us = latency_us;
+    if (latency_us > stats->max_latency_us) stats->max_latency_us = latency_us;
+    return true;
+}
 
-    mpu6050_raw_data raw_temp = combine_bytes(read_data[6], read_data[7]);
+static void data_ready_read_done(mpu6050_t* dev, int64_t timestamp_us) {
+    uint32_t read_done_us = (uint32_t)(esp_timer_get_time() - timestamp_us);
+    if (read_done_us > dev->data_ready_stats.max_read_done_us) dev->data_ready_stats.max_read_done_us = read_done_us;
+}
 
-    mpu6050_raw_data g_x = combine_bytes(read_data[8], read_data[9]);
-    mpu6050_raw_data g_y = combine_bytes(read_data[10], read_data[11]);
-    mpu6050_raw_data g_z = combine_bytes(read_data[12], read_data[13]);
+const mpu6050_data_ready_stats_t* mpu6050_data_ready_get_stats(const mpu6050_t* dev) {
+    return &dev->data_ready_stats;
+}
 
-    accel->x = raw_accel_to_float(a_x);
-    accel->y = raw_accel_to_float(a_y);
-    accel->z = raw_accel_to_float(a_z);
+void mpu6050_print_data_ready_stats(const mpu6050_t* dev) {
+    const mpu6050_data_ready_stats_t* stats = &dev->data_ready_stats;
+    if (stats->samples == 0) {
+        printf("MPU 0x%02X data ready: no samples\n", dev->address);
+        return;
+    }
+    printf("MPU 0x%02X data ready: %lu samples, %lu missed, latency mean %lu us min %lu max %lu (jitter %lu us), "
+           "read done within %lu us, interval %lu - %lu us\n", dev->address,
+           (unsigned long)stats->samples, (unsigned long)stats->missed,
+           (unsigned long)(stats->total_latency_us / stats->samples),
+           (unsigned long)stats->min_latency_us, (unsigned long)stats->max_latency_us,
+           (unsigned long)(stats->max_latency_us - stats->min_latency_us),
+           (unsigned long)stats->max_read_done_us,
+           (unsigned long)(stats->min_interval_us == UINT32_MAX ? 0 : stats->min_interval_us),
+           (unsigned long)stats->max_interval_us);
+}
 
-    *temperature = get_temperature_centigrade(raw_temp);
+bool mpu6050_pair_init(mpu6050_pair_t* pair, mpu6050_t* leader, gpio_num_t leader_int_pin,
+                       mpu6050_t* follower, gpio_num_t follower_int_pin) {
+    if (!pair || !leader || !follower) {
+        printf("passed NULL pointer to mpu6050_pair_init() function\n");
+        return false;
+    }
+    if (leader->session.sample_rate_hz != follower->session.sample_rate_hz || leader->DLPF != follower->DLPF) {
+        printf("MPU6050 pair: sample rate / DLPF differ (%u Hz vs %u Hz), samples will not line up\n",
+               leader->session.sample_rate_hz, follower->session.sample_rate_hz);
+    }
+    memset(pair, 0, sizeof(*pair));
+    pair->leader = leader;
+    pair->follower = follower;
+    pair->stats.min_skew_us = INT32_MAX;
+    pair->stats.max_skew_us = INT32_MIN;
+    // only the leader wakes the task; two notifiers would mix up the missed sample count
+    if (follower_int_pin != GPIO_NUM_NC && !data_ready_setup(follower, follower_int_pin, false)) return false;
+    return mpu6050_data_ready_enable(leader, leader_int_pin);
+}
 
-    gyro->x = raw_gyro_to_float(g_x);
-    gyro->y = raw_gyro_to_float(g_y);
-    gyro->z = raw_gyro_to_float(g_z);
+bool mpu6050_pair_read_on_data_ready(mpu6050_pair_t* pair, uint32_t timeout_ms,
+                                     mpu6050_raw_frame* leader_frame, mpu6050_raw_frame* follower_frame,
+                                     int64_t* timestamp_us, int32_t* follower_offset_us) {
+    if (!pair || !timestamp_us || !follower_offset_us) {
+        printf("passed NULL pointer to mpu6050_pair_read_on_data_ready() function\n");
+        return false;
+    }
+    mpu6050_t* follower = pair->follower;
+    if (!data_ready_wait(pair->leader, timeout_ms, timestamp_us)) return false;
+    // the follower's registers hold the sample of its latest interrupt before the read
+    uint32_t follower_isr_us = follower->isr_timestamp_us;
+    int64_t read_start_us = esp_timer_get_time();
+    if (!mpu6050_read_raw_pair(pair->leader, follower, leader_frame, follower_frame)) return false;
+    uint32_t read_us = (uint32_t)(esp_timer_get_time() - read_start_us);
+    data_ready_read_done(pair->leader, *timestamp_us);
 
+    mpu6050_pair_stats_t* stats = &pair->stats;
+    stats->pairs++;
+    if (read_us > stats->max_read_us) stats->max_read_us = read_us;
+    *follower_offset_us = 0;
+    if (follower->data_ready_pin == GPIO_NUM_NC) return true;
+    if (follower_isr_us == follower->last_isr_timestamp_us) stats->follower_repeats++;
+    follower->last_isr_timestamp_us = follower_isr_us;
+    // 32 bit difference, like the ISR timestamps themselves
+    int32_t skew_us = (int32_t)(follower_isr_us - (uint32_t)*timestamp_us);
+    *follower_offset_us = skew_us;
+    stats->total_skew_us += skew_us;
+    if (skew_us < stats->min_skew_us) stats->min_skew_us = skew_us;
+    if (skew_us > stats->max_skew_us) stats->max_skew_us = skew_us;
     return true;
 }
 
+void mpu6050_print_pair_stats(const mpu6050_pair_t* pair) {
+    const mpu6050_pair_stats_t* stats = &pair->stats;
+    if (stats->pairs == 0) {
+        printf("MPU pair: no samples\n");
+        return;
+    }
+    if (pair->follower->data_ready_pin == GPIO_NUM_NC) {
+        printf("MPU pair: %lu pairs, bus session max %lu us, skew unknown (no follower INT pin)\n",
+               (unsigned long)stats->pairs, (unsigned long)stats->max_read_us);
+        return;
+    }
+    printf("MPU pair: %lu pairs, %lu follower repeats, skew mean %ld us min %ld max %ld, bus session max %lu us\n",
+           (unsigned long)stats->pairs, (unsigned long)stats->follower_repeats,
+           (long)(stats->total_skew_us / stats->pairs), (long)stats->min_skew_us, (long)stats->max_skew_us,
+           (unsigned long)stats->max_read_us);
+}
+
 // resets all internal registers to default state
-static bool mpu6050_reset(void) {
+static bool mpu6050_reset(mpu6050_t* dev) {
     // set the MSB of the power register to 1
-    bool status = mpu6050_write_to_register(MPU6050_PWR_MGMT_1_REG, 0x80);
+    bool status = mpu6050_write_to_register(dev, MPU6050_PWR_MGMT_1_REG, 0x80);
     // important: wait for the reset to complete
     // trying to use the sensor write away will NACK
     // trying to use vTaskDelay() here won't work so use esp_rom_delay_us()
@@ -93,30 +649,50 @@ static bool mpu6050_reset(void) {
     return status;
 }
 
-bool mpu6050_set_gyro_range(MPU6050_GYROSCOPE_RANGE gyro_range) {
-    if (!mpu6050_write_to_register(MPU6050_GYRO_CONFIG_REG, gyro_range << 3)) return false;
-    current_gyro_range = gyro_range;
+bool mpu6050_set_gyro_range(mpu6050_t* dev, MPU6050_GYROSCOPE_RANGE gyro_range) {
+    // LSBs per deg/s for each range
+    static const float LSBs_per_degree_per_second[] = {131.0f, 65.5f, 32.8f, 16.4f};
+    if ((unsigned)gyro_range > MPU6050_RANGE_2000_DEG) {
+        printf("Invalid gyro range!\n");
+        return false;
+    }
+    if (!mpu6050_write_to_register(dev, MPU6050_GYRO_CONFIG_REG, gyro_range << 3)) return false;
+    dev->gyro_range = gyro_range;
+    // computed once here so converting a sample is a multiply per axis
+    dev->session.gyro_range = gyro_range;
+    dev->session.gyro_dps_per_LSB = 1.0f / LSBs_per_degree_per_second[gyro_range];
     return true;
 }
 
-bool mpu6050_set_accel_range(MPU6050_ACCELEROMETER_RANGE accel_range) {
-    if (!mpu6050_write_to_register(MPU6050_ACCEL_CONFIG_REG, accel_range << 3)) return false;
-    current_accel_range = accel_range;
+bool mpu6050_set_accel_range(mpu6050_t* dev, MPU6050_ACCELEROMETER_RANGE accel_range) {
+    // LSBs per g for each range
+    static const float LSBs_per_g[] = {16384.0f, 8192.0f, 4096.0f, 2048.0f};
+    if ((unsigned)accel_range > MPU6050_RANGE_16_G) {
+        printf("Invalid accel range!\n");
+        return false;
+    }
+    if (!mpu6050_write_to_register(dev, MPU6050_ACCEL_CONFIG_REG, (accel_range << 3) | dev->accel_high_pass)) return false;
+    dev->accel_range = accel_range;
+    dev->session.accel_range = accel_range;
+    dev->session.accel_g_per_LSB = 1.0f / LSBs_per_g[accel_range];
     return true;
 }
 
-bool mpu6050_set_DLPF_frequency(MPU6050_DLPF_FREQ freq) {
+bool mpu6050_set_DLPF_frequency(mpu6050_t* dev, MPU6050_DLPF_FREQ freq) {
     // bottom 3 bits of the register control DLPF
-    if (!mpu6050_write_to_register(MPU6050_CONFIGURATION_REG, freq)) return false;
-    current_DLPF_val = freq;
+    if (!mpu6050_write_to_register(dev, MPU6050_CONFIGURATION_REG, freq)) return false;
+    dev->DLPF = freq;
+    dev->session.DLPF = freq;
     return true;
 }
 
-bool mpu6050_set_sample_rate(uint32_t sample_rate_hz) {
-    uint32_t gyro_out = (current_DLPF_val == 0 || current_DLPF_val == MPU6050_DLPF_DISABLED) ? 8000U : 1000U;
+bool mpu6050_set_sample_rate(mpu6050_t* dev, uint32_t sample_rate_hz) {
+    uint32_t gyro_out = (dev->DLPF == 0 || dev->DLPF == MPU6050_DLPF_DISABLED) ? 8000U : 1000U;
     if (sample_rate_hz == 0 || sample_rate_hz > gyro_out) return false;
     uint8_t sample_rate_div = (uint8_t)((gyro_out / sample_rate_hz) - 1);
-    return mpu6050_write_to_register(MPU6050_SMPLRT_DIV_REG, sample_rate_div);
+    if (!mpu6050_write_to_register(dev, MPU6050_SMPLRT_DIV_REG, sample_rate_div)) return false;
+    dev->session.sample_rate_hz = (uint16_t)(gyro_out / (1U + sample_rate_div));
+    return true;
 }
 
 
@@ -133,70 +709,18 @@ static inline float get_temperature_centigrade(mpu6050_raw_data raw_temperature_
     return ((float)raw_temperature_reading / 340.0f) + 36.53f;
 }
 
-// converts a single dimension raw reading to float
-static inline float raw_accel_to_float(mpu6050_raw_data raw_accel) {
-    
-    float raw_LSBs_per_g;
-    switch (current_accel_range) {
-        case MPU6050_RANGE_2_G:
-            raw_LSBs_per_g = 16384.0;
-            break;
-        case MPU6050_RANGE_4_G:
-            raw_LSBs_per_g = 8192.0;
-            break;
-        case MPU6050_RANGE_8_G:
-            raw_LSBs_per_g = 4096.0;
-            break;
-        case MPU6050_RANGE_16_G:
-            raw_LSBs_per_g = 2048.0;
-            break;
-        default:
-            printf("Invalid accel range!\n");
-            raw_LSBs_per_g = 16384.0;
-            break;        
-    }
-    // convert to gs
-    return ((float)raw_accel) / raw_LSBs_per_g;
-}
-
-static inline bool mpu6050_write_to_register(byte register_to_write_to, byte value_to_write) {
+static inline bool mpu6050_write_to_register(mpu6050_t* dev, byte register_to_write_to, byte value_to_write) {
     // send register we want to write to, then the value. Make sure the register can be written to
     byte transmission[2] = {register_to_write_to, value_to_write};
-    return I2C_send_byte_stream(MPU6050_ADDRESS, transmission, 2, WRITE, true, true);
+    return I2C_send_byte_stream(dev->address, transmission, 2, WRITE, true, true);
 }
 
 // wrapper for I2C_read_one() function
-static inline bool mpu6050_read_from_register(byte register_to_read, byte* register_value) {
-    return I2C_read_one(MPU6050_ADDRESS, register_to_read, register_value);
+static inline bool mpu6050_read_from_register(mpu6050_t* dev, byte register_to_read, byte* register_value) {
+    return I2C_read_one(dev->address, register_to_read, register_value);
 }
 
 // wrapper for I2C_read_many() function
-static inline bool mpu6050_read_register_block(byte starting_register, byte* register_values, byte number_of_registers) {
-    return I2C_read_many(MPU6050_ADDRESS, starting_register, number_of_registers, register_values);
-}
-
-// converts a single dimension raw reading to float
-static inline float raw_gyro_to_float(mpu6050_raw_data raw_gyro) {
-    
-    float raw_LSBs_per_degree_per_second;
-    switch (current_gyro_range) {
-        case MPU6050_RANGE_250_DEG:
-            raw_LSBs_per_degree_per_second = 131.0;
-            break;
-        case MPU6050_RANGE_500_DEG:
-            raw_LSBs_per_degree_per_second = 65.5;
-            break;
-        case MPU6050_RANGE_1000_DEG:
-            raw_LSBs_per_degree_per_second = 32.8;
-            break;
-        case MPU6050_RANGE_2000_DEG:
-            raw_LSBs_per_degree_per_second = 16.4;
-            break;
-        default:
-            printf("Invalid gyro range!\n");
-            raw_LSBs_per_degree_per_second = 131.0;
-            break;
-    }
-    // convert to degrees per second
-    return (float)(raw_gyro / raw_LSBs_per_degree_per_second);
+static inline bool mpu6050_read_register_block(mpu6050_t* dev, byte starting_register, byte* register_values, byte number_of_registers) {
+    return I2C_read_many(dev->address, starting_register, number_of_registers, register_values);
 }
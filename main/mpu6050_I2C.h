@@ -3,7 +3,8 @@
 
 #include "my_I2C.h"
 #include "esp_rom_sys.h"
-#define MPU6050_ADDRESS 0x68 // I2C address for the MPU6050
+#define MPU6050_ADDRESS 0x68 // I2C address for the MPU6050 (AD0 low)
+#define MPU6050_ADDRESS_AD0_HIGH 0x69 // second sensor on the same bus
 
 /*
 Registers of interest on the MPU6050 -- see datasheet.
@@ -14,6 +15,8 @@ For example, 0x3B holds X-out high bits, 0x3C holds X-out low bits.
 #define MPU6050_CONFIGURATION_REG  0x1A
 #define MPU6050_GYRO_CONFIG_REG    0x1B
 #define MPU6050_ACCEL_CONFIG_REG   0x1C
+#define MPU6050_MOT_THR_REG        0x1F
+#define MPU6050_MOT_DUR_REG        0x20
 
 #define MPU6050_ACCEL_X_OUT_REG    0x3B
 #define MPU6050_ACCEL_Y_OUT_REG    0x3D
@@ -23,8 +26,23 @@ For example, 0x3B holds X-out high bits, 0x3C holds X-out low bits.
 #define MPU6050_GYRO_Y_OUT_REG     0x45
 #define MPU6050_GYRO_Z_OUT_REG     0x47
 
+#define MPU6050_FIFO_EN_REG        0x23
+#define MPU6050_INT_PIN_CFG_REG    0x37
+#define MPU6050_INT_ENABLE_REG     0x38
+#define MPU6050_INT_STATUS_REG     0x3A
+#define MPU6050_USER_CTRL_REG      0x6A
 #define MPU6050_PWR_MGMT_1_REG     0x6B
 #define MPU6050_PWR_MGMT_2_REG     0x6C
+#define MPU6050_FIFO_COUNT_H_REG   0x72
+#define MPU6050_FIFO_R_W_REG       0x74
+
+/*
+FIFO mode: with accel, temperature and gyro enabled every sample is pushed into the
+1024 byte FIFO as one 14 byte frame, in the same order as registers 0x3B - 0x48.
+*/
+#define MPU6050_FIFO_SIZE          1024
+#define MPU6050_FIFO_FRAME_SIZE    14
+#define MPU6050_FIFO_MAX_FRAMES    (MPU6050_FIFO_SIZE / MPU6050_FIFO_FRAME_SIZE)
 
 typedef int16_t mpu6050_raw_data;
 
@@ -64,11 +82,6 @@ typedef enum {
     MPU6050_DLPF_DISABLED = 7
 } MPU6050_DLPF_FREQ;
 
-/* Current configuration trackers — updated when setters are called. */
-extern MPU6050_GYROSCOPE_RANGE current_gyro_range;
-extern MPU6050_ACCELEROMETER_RANGE current_accel_range;
-extern MPU6050_DLPF_FREQ current_DLPF_val;
-
 /**
  * Convenience struct for storing X/Y/Z sensor data in floating-point form.
  */
@@ -78,38 +91,174 @@ typedef struct {
     float z;
 } mpu6050_xyz_data;
 
+/**
+ * Sample rate of the accelerometer in low power cycle mode (LP_WAKE_CTRL in PWR_MGMT_2).
+ */
+typedef enum {
+    MPU6050_WAKE_1_25_HZ = 0,
+    MPU6050_WAKE_5_HZ    = 1,
+    MPU6050_WAKE_20_HZ   = 2,
+    MPU6050_WAKE_40_HZ   = 3
+} MPU6050_WAKE_FREQ;
+
+/**
+ * Channel groups for mpu6050_set_channels(). Each group is a run of output registers
+ * (accel 6 bytes, temperature 2, gyro 6) and a set of FIFO_EN bits.
+ */
+typedef enum {
+    MPU6050_CHANNEL_ACCEL       = 0x01,
+    MPU6050_CHANNEL_TEMPERATURE = 0x02,
+    MPU6050_CHANNEL_GYRO        = 0x04,
+    MPU6050_CHANNEL_ALL         = 0x07
+} MPU6050_CHANNEL;
+
+/**
+ * One sample exactly as the sensor reports it, in the register / FIFO order, as native
+ * int16 counts. 14 bytes, like a FIFO frame. Convert with mpu6050_raw_to_float() only
+ * where physical units are needed.
+ */
+typedef struct {
+    mpu6050_raw_data accel[3];
+    mpu6050_raw_data temperature;
+    mpu6050_raw_data gyro[3];
+} mpu6050_raw_frame;
+
+/**
+ * Everything needed to turn raw counts into physical units. Kept up to date by the
+ * range, DLPF and sample rate setters (the scales are computed there, not per sample),
+ * and meant to be logged next to raw samples.
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t accel_range;        // MPU6050_ACCELEROMETER_RANGE
+    uint8_t gyro_range;         // MPU6050_GYROSCOPE_RANGE
+    uint8_t DLPF;               // MPU6050_DLPF_FREQ
+    uint8_t channels;           // MPU6050_CHANNEL mask; the other fields of logged frames are 0
+    uint16_t sample_rate_hz;    // actual rate after the divider
+    uint8_t address;            // I2C address of the sensor these samples came from
+    uint8_t reserved;
+    float accel_g_per_LSB;
+    float gyro_dps_per_LSB;
+} mpu6050_session_t;
+
+/**
+ * Counters kept by the FIFO functions.
+ */
+typedef struct {
+    uint32_t frames_read;
+    uint32_t bursts;        // FIFO data bursts (one I2C transaction each)
+    uint32_t overflows;     // times the FIFO filled up and had to be reset (data was lost)
+} mpu6050_fifo_stats_t;
+
+/**
+ * Timing of data-ready interrupt driven reads (see mpu6050_read_on_data_ready()).
+ * Latencies are measured from the interrupt timestamp taken in the ISR.
+ */
+typedef struct {
+    uint32_t samples;           // interrupts serviced with a read
+    uint32_t missed;            // interrupts that came before the previous one was serviced
+    uint32_t min_latency_us;    // interrupt to the start of the read (task wake-up)
+    uint32_t max_latency_us;
+    uint64_t total_latency_us;
+    uint32_t max_read_done_us;  // interrupt to the end of the read
+    uint32_t min_interval_us;   // between consecutive interrupts (the sensor's sample clock)
+    uint32_t max_interval_us;
+} mpu6050_data_ready_stats_t;
+
+/**
+ * One sensor. Everything the driver tracks about a sensor lives here, so several of them
+ * (0x68 and 0x69) can share the bus. Filled in by mpu6050_init(); treat the fields as
+ * read only.
+ */
+typedef struct {
+    byte address;
+    // trackers for settings that would otherwise have to be read from registers (slow)
+    MPU6050_GYROSCOPE_RANGE gyro_range;
+    MPU6050_ACCELEROMETER_RANGE accel_range;
+    MPU6050_DLPF_FREQ DLPF;
+    mpu6050_session_t session;
+    byte interrupt_enable;              // shadow of INT_ENABLE
+    byte accel_high_pass;               // ACCEL_HPF bits of ACCEL_CONFIG, set for motion detection
+    bool low_power;                     // in accelerometer only cycle mode
+
+    bool fifo_enabled;
+    byte fifo_channels;                 // channels in each FIFO frame
+    size_t fifo_frame_size;
+    mpu6050_fifo_stats_t fifo_stats;
+
+    // temperature decimation: the last count read and when the next read is due (esp_timer clock)
+    int64_t temperature_interval_us;
+    int64_t temperature_due_us;
+    mpu6050_raw_data temperature;
+
+    // data-ready interrupt. The ISR only writes 32 bit values so the task never sees a torn update
+    gpio_num_t data_ready_pin;
+    void* data_ready_task;              // TaskHandle_t to notify, NULL if the ISR only timestamps
+    volatile uint32_t isr_timestamp_us;
+    uint32_t last_isr_timestamp_us;
+    mpu6050_data_ready_stats_t data_ready_stats;
+} mpu6050_t;
+
+/**
+ * Timing of paired reads (see mpu6050_pair_read_on_data_ready()). The skew is the
+ * follower's data-ready time minus the leader's, i.e. how far apart the two samples
+ * of a pair were taken.
+ */
+typedef struct {
+    uint32_t pairs;
+    uint32_t follower_repeats;  // pairs for which the follower had no new sample
+    int32_t min_skew_us;
+    int32_t max_skew_us;
+    int64_t total_skew_us;
+    uint32_t max_read_us;       // longest shared bus session
+} mpu6050_pair_stats_t;
+
+/**
+ * Two sensors sampled together: the leader's data-ready interrupt paces the pair and
+ * both are read in one bus session right after it.
+ */
+typedef struct {
+    mpu6050_t* leader;
+    mpu6050_t* follower;
+    mpu6050_pair_stats_t stats;
+} mpu6050_pair_t;
+
 /**
  * @brief Initialize the MPU6050 with specified accelerometer and gyroscope ranges.
  *
  * Resets the sensor, sets accelerometer/gyro full-scale ranges, selects PLL clock,
  * applies a ~44 Hz DLPF, and sets the sample rate to 1 kHz.
  *
+ * @param dev Sensor state to fill in.
+ * @param address MPU6050_ADDRESS or MPU6050_ADDRESS_AD0_HIGH.
  * @param accel_range Desired accelerometer range (±2/4/8/16 g).
  * @param gyro_range Desired gyroscope range (±250/500/1000/2000 deg/s).
  * @return true on success, false if any I2C transaction fails.
  */
-bool mpu6050_init(MPU6050_ACCELEROMETER_RANGE accel_range,
+bool mpu6050_init(mpu6050_t* dev, byte address,
+                  MPU6050_ACCELEROMETER_RANGE accel_range,
                   MPU6050_GYROSCOPE_RANGE gyro_range);
 
 /**
  * @brief Change the gyroscope full-scale range.
  *
- * Writes to the GYRO_CONFIG register and updates @ref current_gyro_range.
+ * Writes to the GYRO_CONFIG register and updates the tracked range and session scale.
  *
+ * @param dev Sensor set up with mpu6050_init().
  * @param gyro_range Desired range (±250/500/1000/2000 deg/s).
  * @return true if the register write succeeds, false otherwise.
  */
-bool mpu6050_set_gyro_range(MPU6050_GYROSCOPE_RANGE gyro_range);
+bool mpu6050_set_gyro_range(mpu6050_t* dev, MPU6050_GYROSCOPE_RANGE gyro_range);
 
 /**
  * @brief Change the accelerometer full-scale range.
  *
- * Writes to the ACCEL_CONFIG register and updates @ref current_accel_range.
+ * Writes to the ACCEL_CONFIG register and updates the tracked range and session scale.
  *
+ * @param dev Sensor set up with mpu6050_init().
  * @param accel_range Desired range (±2/4/8/16 g).
  * @return true if the register write succeeds, false otherwise.
  */
-bool mpu6050_set_accel_range(MPU6050_ACCELEROMETER_RANGE accel_range);
+bool mpu6050_set_accel_range(mpu6050_t* dev, MPU6050_ACCELEROMETER_RANGE accel_range);
 
 /**
  * @brief Read acceleration, gyroscope, and temperature data in one I2C transaction.
@@ -118,24 +267,81 @@ bool mpu6050_set_accel_range(MPU6050_ACCELEROMETER_RANGE accel_range);
  * ACCEL_XOUT_H. Converts raw readings into floating-point units based on current
  * full-scale settings.
  *
+ * @param dev Sensor set up with mpu6050_init().
  * @param accel Pointer to receive scaled acceleration data in g.
  * @param gyro Pointer to receive scaled gyro data in deg/s.
  * @param temperature Pointer to receive temperature in degrees Celsius.
  * @return true if the read succeeds, false otherwise.
  */
-bool mpu6050_read_all(mpu6050_xyz_data* accel,
+bool mpu6050_read_all(mpu6050_t* dev,
+                      mpu6050_xyz_data* accel,
                       mpu6050_xyz_data* gyro,
                       float* temperature);
 
+/**
+ * @brief Read one sample as raw counts in one I2C transaction.
+ *
+ * Only the registers of the channels selected with mpu6050_set_channels() are read:
+ * one burst from the first to the last selected register (6 bytes for accel only,
+ * 14 for everything). No float conversion. Channels that are not selected read as 0;
+ * a decimated temperature keeps its last value until it is due again.
+ *
+ * @param dev Sensor set up with mpu6050_init().
+ * @param frame Pointer to receive the sample.
+ * @return true if the read succeeds, false otherwise.
+ */
+bool mpu6050_read_raw(mpu6050_t* dev, mpu6050_raw_frame* frame);
+
+/**
+ * @brief Select the channels that are read and buffered in the FIFO.
+ *
+ * Drives both the direct reads (mpu6050_read_raw() and everything built on it) and the
+ * FIFO_EN bits. A decimated temperature is kept out of the FIFO and read directly (2 bytes)
+ * at most once per interval. Changing the channels while the FIFO runs resets it, since
+ * the frame size changes. mpu6050_read_all() always reads everything.
+ *
+ * @param dev Sensor set up with mpu6050_init().
+ * @param channels MPU6050_CHANNEL mask, at least one channel.
+ * @param temperature_interval_ms Shortest time between temperature reads, 0 reads it with every sample.
+ * @return true if the configuration is valid and the register writes succeed, false otherwise.
+ */
+bool mpu6050_set_channels(mpu6050_t* dev, byte channels, uint32_t temperature_interval_ms);
+
+/**
+ * @brief Channels selected with mpu6050_set_channels() (MPU6050_CHANNEL_ALL by default).
+ */
+byte mpu6050_get_channels(const mpu6050_t* dev);
+
+/**
+ * @brief Convert raw counts to g, deg/s and degrees Celsius.
+ *
+ * Uses the scales stored in the session (one multiply per axis), so frames read back
+ * from the log convert with the session record logged with them.
+ *
+ * @param session Session of the sensor the frame came from.
+ * @param frame Raw sample.
+ * @param accel Pointer to receive scaled acceleration data in g.
+ * @param gyro Pointer to receive scaled gyro data in deg/s.
+ * @param temperature Pointer to receive temperature in degrees Celsius.
+ */
+void mpu6050_raw_to_float(const mpu6050_session_t* session, const mpu6050_raw_frame* frame,
+                          mpu6050_xyz_data* accel, mpu6050_xyz_data* gyro, float* temperature);
+
+/**
+ * @brief Current ranges, rate and the scales that go with them.
+ */
+const mpu6050_session_t* mpu6050_get_session(const mpu6050_t* dev);
+
 /**
  * @brief Configure the digital low-pass filter (DLPF).
  *
- * Writes to CONFIG register and updates @ref current_DLPF_val.
+ * Writes to CONFIG register and updates the tracked setting.
  *
+ * @param dev Sensor set up with mpu6050_init().
  * @param freq Desired DLPF setting (0–7).
  * @return true if the register write succeeds, false otherwise.
  */
-bool mpu6050_set_DLPF_frequency(MPU6050_DLPF_FREQ freq);
+bool mpu6050_set_DLPF_frequency(mpu6050_t* dev, MPU6050_DLPF_FREQ freq);
 
 /**
  * @brief Set the output sample rate.
@@ -143,9 +349,263 @@ bool mpu6050_set_DLPF_frequency(MPU6050_DLPF_FREQ freq);
  * The base rate is 8 kHz if DLPF is disabled, otherwise 1 kHz.  
  * The actual rate is base_rate / (1 + divider).  
  *
+ * @param dev Sensor set up with mpu6050_init().
  * @param sample_rate_hz Desired rate in Hz (must be ≤ base rate and > 0).
  * @return true if the register write succeeds, false otherwise.
  */
-bool mpu6050_set_sample_rate(uint32_t sample_rate_hz);
+bool mpu6050_set_sample_rate(mpu6050_t* dev, uint32_t sample_rate_hz);
+
+/**
+ * @brief Start buffering samples in the hardware FIFO.
+ *
+ * Enables the selected channels (see mpu6050_set_channels()) in FIFO_EN, resets the
+ * FIFO and enables it in USER_CTRL. From now on every sample (see mpu6050_set_sample_rate()) is kept
+ * until it is drained with mpu6050_fifo_read_frames(), even while the bus is busy.
+ *
+ * @param dev Sensor set up with mpu6050_init().
+ * @return true if the register writes succeed, false otherwise.
+ */
+bool mpu6050_fifo_enable(mpu6050_t* dev);
+
+/**
+ * @brief Stop the FIFO and go back to reading the output registers.
+ *
+ * @param dev Sensor set up with mpu6050_init().
+ * @return true if the register writes succeed, false otherwise.
+ */
+bool mpu6050_fifo_disable(mpu6050_t* dev);
+
+/**
+ * @brief Read the number of bytes waiting in the FIFO (FIFO_COUNT).
+ *
+ * @param dev Sensor set up with mpu6050_init().
+ * @param bytes Pointer to receive the count.
+ * @return true if the read succeeds, false otherwise.
+ */
+bool mpu6050_fifo_get_count(mpu6050_t* dev, uint16_t* bytes);
+
+/**
+ * @brief Drain whole frames from the FIFO.
+ *
+ * Reads FIFO_COUNT, then up to max_frames complete frames with a single burst
+ * read of FIFO_R_W into buffer (mpu6050_fifo_get_frame_size() bytes per frame: the
+ * selected channels in register order). A frame still being written stays in the FIFO
+ * for the next call.
+ *
+ * If the FIFO overflowed, the frame boundaries are lost: the FIFO is reset, the
+ * overflow is counted and no frames are returned.
+ *
+ * @param dev Sensor set up with mpu6050_init().
+ * @param buffer Receives the raw frames.
+ * @param max_frames Capacity of buffer in frames.
+ * @param frames_read Pointer to receive the number of frames stored in buffer.
+ * @return true if the I2C transactions succeed, false otherwise.
+ */
+bool mpu6050_fifo_read_frames(mpu6050_t* dev, byte* buffer, size_t max_frames, size_t* frames_read);
+
+/**
+ * @brief Drain whole frames from the FIFO as raw counts.
+ *
+ * Same as mpu6050_fifo_read_frames(), with the big endian frames expanded to
+ * mpu6050_raw_frame in place. A decimated temperature is read directly when due and
+ * copied into every frame.
+ *
+ * @param dev Sensor set up with mpu6050_init().
+ * @param frames Receives the samples.
+ * @param max_frames Capacity of frames.
+ * @param frames_read Pointer to receive the number of samples stored.
+ * @return true if the I2C transactions succeed, false otherwise.
+ */
+bool mpu6050_fifo_read_raw(mpu6050_t* dev, mpu6050_raw_frame* frames, size_t max_frames, size_t* frames_read);
+
+/**
+ * @brief Bytes per FIFO frame for the selected channels (MPU6050_FIFO_FRAME_SIZE for all).
+ */
+size_t mpu6050_fifo_get_frame_size(const mpu6050_t* dev);
+
+/**
+ * @brief Convert one full FIFO frame (all channels, big endian bytes) to raw counts.
+ */
+void mpu6050_frame_to_raw(const byte* frame, mpu6050_raw_frame* raw);
+
+/**
+ * @brief Convert one raw FIFO frame like mpu6050_read_all() does.
+ *
+ * @param session Session of the sensor the frame came from.
+ * @param frame MPU6050_FIFO_FRAME_SIZE bytes from mpu6050_fifo_read_frames() (all channels selected).
+ * @param accel Pointer to receive scaled acceleration data in g.
+ * @param gyro Pointer to receive scaled gyro data in deg/s.
+ * @param temperature Pointer to receive temperature in degrees Celsius.
+ */
+void mpu6050_fifo_frame_to_float(const mpu6050_session_t* session, const byte* frame,
+                                 mpu6050_xyz_data* accel, mpu6050_xyz_data* gyro, float* temperature);
+
+/**
+ * @brief FIFO counters since the FIFO was last enabled.
+ */
+const mpu6050_fifo_stats_t* mpu6050_fifo_get_stats(const mpu6050_t* dev);
+
+/**
+ * @brief Drive sampling from the sensor's data-ready interrupt.
+ *
+ * Configures INT_PIN_CFG (active high 50 us pulse) and DATA_RDY_EN in INT_ENABLE, and
+ * installs a rising edge ISR on int_pin. The ISR timestamps each sample with
+ * esp_timer_get_time() and notifies the task that called this function.
+ *
+ * @param dev Sensor whose INT pin is wired to int_pin.
+ * @param int_pin GPIO wired to the MPU6050 INT pin.
+ * @return true on success, false if the register writes or the ISR setup fail.
+ */
+bool mpu6050_data_ready_enable(mpu6050_t* dev, gpio_num_t int_pin);
+
+/**
+ * @brief Remove the ISR and disable the data-ready interrupt.
+ *
+ * @param dev Sensor set up with mpu6050_init().
+ * @return true if the register write succeeds, false otherwise.
+ */
+bool mpu6050_data_ready_disable(mpu6050_t* dev);
+
+/**
+ * @brief Wait for the next data-ready interrupt and read exactly that sample.
+ *
+ * Blocks the calling task (the one that enabled the interrupt) until the ISR notifies it,
+ * then reads the output registers like mpu6050_read_raw(). Interrupts that arrive while
+ * the previous sample was still being handled are counted as missed.
+ *
+ * @param dev Sensor set up with mpu6050_init().
+ * @param timeout_ms Longest time to wait for the interrupt.
+ * @param frame Pointer to receive the raw sample.
+ * @param timestamp_us Pointer to receive the interrupt time (esp_timer_get_time() clock).
+ * @return true if a sample was read, false on timeout or I2C failure.
+ */
+bool mpu6050_read_on_data_ready(mpu6050_t* dev, uint32_t timeout_ms, mpu6050_raw_frame* frame, int64_t* timestamp_us);
+
+/**
+ * @brief Interrupt latency statistics since the interrupt was enabled.
+ */
+const mpu6050_data_ready_stats_t* mpu6050_data_ready_get_stats(const mpu6050_t* dev);
+
+/**
+ * @brief Print the data-ready statistics (mean, min/max latency and jitter).
+ */
+void mpu6050_print_data_ready_stats(const mpu6050_t* dev);
+
+/**
+ * @brief Enable the motion detection interrupt on the INT pin.
+ *
+ * Sets the accelerometer high pass filter (5 Hz) that motion detection runs on, MOT_THR
+ * and MOT_DUR, and MOT_EN in INT_ENABLE. A sample counts as motion when any axis of the
+ * high passed acceleration exceeds the threshold; the interrupt fires once that lasted
+ * duration_ms. Works at full rate and in low power cycle mode (wake-on-motion). The ISR
+ * notifies the calling task, see mpu6050_wait_for_motion().
+ *
+ * @param dev Sensor set up with mpu6050_init().
+ * @param int_pin GPIO wired to the MPU6050 INT pin.
+ * @param threshold_mg Motion threshold in mg (2 mg steps, up to 510 mg).
+ * @param duration_ms Time the threshold has to be exceeded (1 ms steps).
+ * @return true on success, false if a register write or the ISR setup fails.
+ */
+bool mpu6050_motion_enable(mpu6050_t* dev, gpio_num_t int_pin, uint16_t threshold_mg, uint8_t duration_ms);
+
+/**
+ * @brief Check (and clear) the motion flag in INT_STATUS.
+ *
+ * One register read. Also clears the other INT_STATUS bits, which no other part of the
+ * driver depends on.
+ *
+ * @param dev Sensor set up with mpu6050_motion_enable().
+ * @param motion Pointer to receive whether motion was detected since the last check.
+ * @return true if the register read succeeds, false otherwise.
+ */
+bool mpu6050_read_motion_status(mpu6050_t* dev, bool* motion);
+
+/**
+ * @brief Block until the motion interrupt fires or timeout_ms passes.
+ *
+ * @param dev Sensor set up with mpu6050_motion_enable().
+ * @param timeout_ms Longest time to wait.
+ * @param motion Pointer to receive whether motion was detected (false on timeout).
+ * @param timestamp_us Pointer to receive the interrupt time (esp_timer_get_time() clock).
+ * @return true unless the INT_STATUS read fails (a timeout is not an error).
+ */
+bool mpu6050_wait_for_motion(mpu6050_t* dev, uint32_t timeout_ms, bool* motion, int64_t* timestamp_us);
+
+/**
+ * @brief Switch to accelerometer only low power cycle mode.
+ *
+ * The gyros and the temperature sensor go to standby and the sensor wakes at wake_freq
+ * to take one accelerometer sample (a few uA instead of ~4 mA). Motion detection keeps
+ * running. Disable the FIFO first: samples taken in this mode are not meant for logging.
+ *
+ * @param dev Sensor set up with mpu6050_init().
+ * @param wake_freq Accelerometer sample rate while in cycle mode.
+ * @return true if the register writes succeed, false otherwise.
+ */
+bool mpu6050_low_power_enter(mpu6050_t* dev, MPU6050_WAKE_FREQ wake_freq);
+
+/**
+ * @brief Return to full operation (PLL clock, all sensors on) at the configured rate.
+ *
+ * The gyros need about 30 ms to settle, so the first samples after this may be off.
+ *
+ * @param dev Sensor in low power mode.
+ * @return true if the register writes succeed, false otherwise.
+ */
+bool mpu6050_low_power_exit(mpu6050_t* dev);
+
+/**
+ * @brief Read two sensors back to back in one bus session.
+ *
+ * Both register bursts go out as one I2C transmission (repeated START between them, one
+ * STOP), each covering the channels selected on its sensor, so the reads are a few tens
+ * of microseconds apart and nothing else can get onto the bus in between.
+ *
+ * @return true if the read succeeds, false otherwise.
+ */
+bool mpu6050_read_raw_pair(mpu6050_t* first, mpu6050_t* second,
+                           mpu6050_raw_frame* first_frame, mpu6050_raw_frame* second_frame);
+
+/**
+ * @brief Sample two sensors together, paced by the leader's data-ready interrupt.
+ *
+ * Enables the data-ready interrupt of both sensors. The leader's ISR wakes the calling
+ * task; the follower's ISR (if follower_int_pin is wired) only timestamps, which is what
+ * measures the skew between the two sample clocks. Both sensors should run the same
+ * sample rate and DLPF.
+ *
+ * @param pair Pair state to fill in.
+ * @param leader Sensor that paces the pair.
+ * @param leader_int_pin GPIO wired to the leader's INT pin.
+ * @param follower Second sensor.
+ * @param follower_int_pin GPIO wired to the follower's INT pin, or GPIO_NUM_NC (skew unknown).
+ * @return true on success, false if a register write or the ISR setup fails.
+ */
+bool mpu6050_pair_init(mpu6050_pair_t* pair, mpu6050_t* leader, gpio_num_t leader_int_pin,
+                       mpu6050_t* follower, gpio_num_t follower_int_pin);
+
+/**
+ * @brief Wait for the leader's next sample and read both sensors in one bus session.
+ *
+ * Both frames share the leader's interrupt time. follower_offset_us is when the
+ * follower's frame was actually sampled relative to it (its own data-ready time), so
+ * the two streams can be aligned to the microsecond; 0 without a follower INT pin.
+ *
+ * @param pair Pair set up with mpu6050_pair_init().
+ * @param timeout_ms Longest time to wait for the leader's interrupt.
+ * @param leader_frame Pointer to receive the leader's sample.
+ * @param follower_frame Pointer to receive the follower's sample.
+ * @param timestamp_us Pointer to receive the shared timestamp (esp_timer_get_time() clock).
+ * @param follower_offset_us Pointer to receive the follower's sample time minus timestamp_us.
+ * @return true if both sensors were read, false on timeout or I2C failure.
+ */
+bool mpu6050_pair_read_on_data_ready(mpu6050_pair_t* pair, uint32_t timeout_ms,
+                                     mpu6050_raw_frame* leader_frame, mpu6050_raw_frame* follower_frame,
+                                     int64_t* timestamp_us, int32_t* follower_offset_us);
+
+/**
+ * @brief Print the pair statistics (skew mean and range, bus session time).
+ */
+void mpu6050_print_pair_stats(const mpu6050_pair_t* pair);
 
 #endif /* mpu6050_H */
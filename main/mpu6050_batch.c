@@ -0,0 +1,138 @@
+#include "mpu6050_batch.h"
+#include <string.h>
+
+// byte offsets of the channels inside a FIFO frame
+#define FRAME_ACCEL_OFFSET        0
+#define FRAME_TEMPERATURE_OFFSET  6
+#define FRAME_GYRO_OFFSET         8
+
+// same conversion as mpu6050_raw_to_float()
+#define TEMPERATURE_C_PER_LSB     (1.0f / 340.0f)
+#define TEMPERATURE_OFFSET_C      36.53f
+
+static inline int16_t frame_count_at(const byte* frame, size_t offset);
+#ifndef __XTENSA__
+static inline int16_t frame_count_swapped(const byte* count);
+static void channel_to_f32(const byte* restrict frames, size_t frame_count, size_t offset,
+                           float scale, float bias, float* restrict out);
+static void channel_to_q15(const byte* restrict frames, size_t frame_count, size_t offset, int16_t* restrict out);
+#endif
+
+#ifndef __XTENSA__
+/*
+one channel per pass. The loop body is branch free with a constant stride, which gcc -O3
+turns into vector loads, shuffles and multiplies
+*/
+void mpu6050_batch_to_f32(const byte* frames, size_t frame_count, const mpu6050_session_t* session,
+                          const mpu6050_channels_f32* out) {
+    for (int axis = 0; axis < 3; axis++) {
+        if (out->accel[axis]) {
+            channel_to_f32(frames, frame_count, FRAME_ACCEL_OFFSET + 2 * axis, session->accel_g_per_LSB, 0.0f, out->accel[axis]);
+        }
+        if (out->gyro[axis]) {
+            channel_to_f32(frames, frame_count, FRAME_GYRO_OFFSET + 2 * axis, session->gyro_dps_per_LSB, 0.0f, out->gyro[axis]);
+        }
+    }
+    if (out->temperature) {
+        channel_to_f32(frames, frame_count, FRAME_TEMPERATURE_OFFSET, TEMPERATURE_C_PER_LSB, TEMPERATURE_OFFSET_C, out->temperature);
+    }
+}
+
+void mpu6050_batch_to_q15(const byte* frames, size_t frame_count, const mpu6050_channels_q15* out) {
+    for (int axis = 0; axis < 3; axis++) {
+        if (out->accel[axis]) channel_to_q15(frames, frame_count, FRAME_ACCEL_OFFSET + 2 * axis, out->accel[axis]);
+        if (out->gyro[axis]) channel_to_q15(frames, frame_count, FRAME_GYRO_OFFSET + 2 * axis, out->gyro[axis]);
+    }
+    if (out->temperature) channel_to_q15(frames, frame_count, FRAME_TEMPERATURE_OFFSET, out->temperature);
+}
+
+static void channel_to_f32(const byte* restrict frames, size_t frame_count, size_t offset,
+                           float scale, float bias, float* restrict out) {
+    frames += offset;
+    for (size_t i = 0; i < frame_count; i++) {
+        out[i] = (float)frame_count_swapped(&frames[i * MPU6050_FIFO_FRAME_SIZE]) * scale + bias;
+    }
+}
+
+static void channel_to_q15(const byte* restrict frames, size_t frame_count, size_t offset, int16_t* restrict out) {
+    frames += offset;
+    for (size_t i = 0; i < frame_count; i++) {
+        out[i] = frame_count_swapped(&frames[i * MPU6050_FIFO_FRAME_SIZE]);
+    }
+}
+
+// one 16 bit load and a byte swap: the form the vectorizer recognizes (byte loads are not)
+static inline int16_t frame_count_swapped(const byte* count) {
+    uint16_t value;
+    memcpy(&value, count, sizeof(value));
+    return (int16_t)__builtin_bswap16(value);
+}
+
+#else
+/*
+Xtensa LX6: no vector unit, so every frame is read once and all channels are converted
+while it is in registers. Two frames per iteration give the FPU independent multiplies to
+pipeline. Skipped channels write to a scratch slot instead of adding a branch per value
+*/
+void mpu6050_batch_to_f32(const byte* frames, size_t frame_count, const mpu6050_session_t* session,
+                          const mpu6050_channels_f32* out) {
+    // frame order: accel xyz, temperature, gyro xyz
+    const float scale[7] = {session->accel_g_per_LSB, session->accel_g_per_LSB, session->accel_g_per_LSB,
+                            TEMPERATURE_C_PER_LSB,
+                            session->gyro_dps_per_LSB, session->gyro_dps_per_LSB, session->gyro_dps_per_LSB};
+    const float bias[7] = {0.0f, 0.0f, 0.0f, TEMPERATURE_OFFSET_C, 0.0f, 0.0f, 0.0f};
+    float* requested[7] = {out->accel[0], out->accel[1], out->accel[2], out->temperature,
+                           out->gyro[0], out->gyro[1], out->gyro[2]};
+    float scratch[2];
+    float* channel[7];
+    size_t step[7];
+    for (int c = 0; c < 7; c++) {
+        channel[c] = requested[c] ? requested[c] : scratch;
+        step[c] = requested[c] ? 2 : 0;
+    }
+
+    size_t i = 0;
+    for (; i + 2 <= frame_count; i += 2) {
+        const byte* f0 = &frames[i * MPU6050_FIFO_FRAME_SIZE];
+        const byte* f1 = f0 + MPU6050_FIFO_FRAME_SIZE;
+        for (int c = 0; c < 7; c++) {
+            float v0 = frame_count_at(f0, 2 * c) * scale[c] + bias[c];
+            float v1 = frame_count_at(f1, 2 * c) * scale[c] + bias[c];
+            channel[c][0] = v0;
+            channel[c][1] = v1;
+            channel[c] += step[c];
+        }
+    }
+    if (i < frame_count) {
+        const byte* f = &frames[i * MPU6050_FIFO_FRAME_SIZE];
+        for (int c = 0; c < 7; c++) {
+            channel[c][0] = frame_count_at(f, 2 * c) * scale[c] + bias[c];
+        }
+    }
+}
+
+void mpu6050_batch_to_q15(const byte* frames, size_t frame_count, const mpu6050_channels_q15* out) {
+    int16_t* requested[7] = {out->accel[0], out->accel[1], out->accel[2], out->temperature,
+                             out->gyro[0], out->gyro[1], out->gyro[2]};
+    int16_t scratch[1];
+    int16_t* channel[7];
+    size_t step[7];
+    for (int c = 0; c < 7; c++) {
+        channel[c] = requested[c] ? requested[c] : scratch;
+        step[c] = requested[c] ? 1 : 0;
+    }
+    for (size_t i = 0; i < frame_count; i++) {
+        const byte* f = &frames[i * MPU6050_FIFO_FRAME_SIZE];
+        // constant trip count: unrolls into 7 load/swap/store groups
+        for (int c = 0; c < 7; c++) {
+            *channel[c] = frame_count_at(f, 2 * c);
+            channel[c] += step[c];
+        }
+    }
+}
+#endif
+
+// big endian count at frame + offset
+static inline int16_t frame_count_at(const byte* frame, size_t offset) {
+    return (int16_t)((frame[offset] << 8) | frame[offset + 1]);
+}
@@ -0,0 +1,41 @@
+#ifndef MPU6050_BATCH_H
+#define MPU6050_BATCH_H
+#include "mpu6050_I2C.h"
+/*
+Batch conversion of MPU6050 FIFO frames into one buffer per channel (structure of arrays).
+
+The input is what mpu6050_fifo_read_frames() returns with all channels selected:
+interleaved 14 byte big endian frames (accel xyz, temperature, gyro xyz). Converting a
+whole burst at once avoids a call and a switch per sample, and the per channel output is
+what filters, windows and FFTs want.
+
+Host builds convert one channel per pass with a branch free strided loop that the compiler
+vectorizes (gcc -O3). The ESP32 has an FPU but no SIMD, so there one pass over the frames
+converts all 7 channels, unrolled two frames at a time so loads and multiplies overlap.
+
+Any channel pointer may be NULL to skip that channel.
+*/
+
+typedef struct {
+    float* accel[3];        // g
+    float* gyro[3];         // deg/s
+    float* temperature;     // degrees Celsius
+} mpu6050_channels_f32;
+
+/*
+Q15: a count is already a Q15 fraction of the full scale range (32767 = +full scale), so
+the Q15 kernel only byte swaps and de-interleaves. Multiply by the range (e.g. 8 g) to get units.
+Temperature stays in raw counts.
+*/
+typedef struct {
+    int16_t* accel[3];
+    int16_t* gyro[3];
+    int16_t* temperature;
+} mpu6050_channels_q15;
+
+// converts frame_count frames with the scales of session. Outputs must hold frame_count values
+void mpu6050_batch_to_f32(const byte* frames, size_t frame_count, const mpu6050_session_t* session,
+                          const mpu6050_channels_f32* out);
+void mpu6050_batch_to_q15(const byte* frames, size_t frame_count, const mpu6050_channels_q15* out);
+
+#endif /* MPU6050_BATCH_H */
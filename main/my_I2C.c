@@ -161,6 +161,36 @@ bool I2C_read_many(byte slave_address, byte starting_register, size_t number_of_
     return true;
 }
 
+/*
+every read after the first starts with a repeated START instead of STOP + START, so the bus is
+never released and the reads follow each other as closely as the bus allows
+*/
+bool I2C_read_sequence(const I2C_read_request* requests, size_t number_of_requests) {
+    if (!requests) {
+        printf("passed NULL pointer\n");
+        return false;
+    }
+    for (size_t r = 0; r < number_of_requests; r++) {
+        const I2C_read_request* request = &requests[r];
+        if (!request->read_bytes || request->number_of_bytes_to_read == 0) {
+            printf("invalid read request %u\n", (unsigned)r);
+            I2C_stop();
+            return false;
+        }
+        I2C_start();
+        if (!transmit_address_and_RW(request->slave_address, WRITE)) { I2C_stop(); return false; }
+        if (!I2C_write_byte(request->starting_register)) { I2C_stop(); return false; }
+        I2C_start();
+        if (!transmit_address_and_RW(request->slave_address, READ)) { I2C_stop(); return false; }
+        for (size_t i = 0; i < request->number_of_bytes_to_read; i++) {
+            // NACK the last byte of each read so the slave releases SDA for the next START
+            request->read_bytes[i] = I2C_read_byte(i != request->number_of_bytes_to_read - 1);
+        }
+    }
+    I2C_stop();
+    return true;
+}
+
 bool I2C_find_device(byte address_of_device) {
     I2C_start();
     bool success = transmit_address_and_RW(address_of_device, WRITE);
@@ -17,6 +17,14 @@ typedef enum {
     WRITE = 0x0
 } READ_OR_WRITE;
 
+// one register block read of I2C_read_sequence()
+typedef struct {
+    byte slave_address;
+    byte starting_register;
+    size_t number_of_bytes_to_read;
+    byte* read_bytes;
+} I2C_read_request;
+
 void I2C_init(void);
 byte I2C_read_byte(bool ack);
 bool I2C_send_byte_stream(byte slave_address, const byte *stream_of_bytes,
@@ -24,6 +32,8 @@ bool I2C_send_byte_stream(byte slave_address, const byte *stream_of_bytes,
                           bool start_transmission, bool end_transmission);
 bool I2C_read_one(byte slave_address, byte register_to_read, byte* value);
 bool I2C_read_many(byte slave_address, byte starting_register, size_t number_of_bytes_to_read, byte* read_bytes);
+// several block reads (e.g. from different slaves) as one transmission: repeated STARTs in between, one STOP
+bool I2C_read_sequence(const I2C_read_request* requests, size_t number_of_requests);
 
 // make sure init has been called already for this to work
 bool I2C_find_device(byte address_of_device);
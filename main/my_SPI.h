@@ -2,8 +2,10 @@
 #define MY_SPI_H
 #include "driver/gpio.h"
 #include "esp_rtc_time.h" // to estimate frequency
+#ifndef SPI_HOST_EMULATION
 #include "soc/gpio_struct.h"
 #include "soc/gpio_reg.h"
+#endif
 
 #define SPI_MAX_ATTACHED_DEVICES 8
 
@@ -34,9 +36,15 @@ typedef struct {
     SPI_MODE mode;
 } SPI_device_t;
 
+#ifndef SPI_HOST_EMULATION
 // NOTE: CS must be in range 0-31
 inline void SPI_cs_low(gpio_num_t CS) {GPIO.out_w1tc = 1U << CS;}
 inline void SPI_cs_high(gpio_num_t CS) {GPIO.out_w1ts = 1U << CS;}
+#else
+// host builds route the bus to an emulated device instead of GPIOs (see host/sd_emulator.h)
+void SPI_cs_low(gpio_num_t CS);
+void SPI_cs_high(gpio_num_t CS);
+#endif
 
 bool SPI_init(void);
 // attatch a SPI device to utilize SPI functions
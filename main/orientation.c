@@ -0,0 +1,279 @@
+#include "orientation.h"
+#include "fixed_math.h"
+#include <string.h>
+
+#define PI_F 3.14159265f
+#define DEG_180 (180 * ORIENTATION_DEG_ONE)
+#define DEG_360_Q32 ((int64_t)360 << 32)
+#define DEG_180_Q32 ((int64_t)180 << 32)
+#define DEG_90_Q32 ((int64_t)90 << 32)
+// cos(83 degrees) in Q30: closer to pitch +-90 the Euler rates are held at this value
+#define COS_PITCH_MIN 130856211
+// 1 / CORDIC gain in Q30
+#define CORDIC_INVERSE_GAIN 652032874
+#define CORDIC_ITERATIONS 16
+
+// atan(2^-i) in Q16 degrees
+static const int32_t cordic_angles[CORDIC_ITERATIONS] = {
+    2949120, 1740967, 919879, 466945, 234379, 117304, 58666, 29335,
+    14668, 7334, 3667, 1833, 917, 458, 229, 115
+};
+
+// helpers not to be used outside of this file
+static void cordic_sincos(int32_t angle, int32_t* sine, int32_t* cosine);
+static bool normalize_q30(const int64_t* v, int32_t* unit, int n);
+static int32_t mul_q30(int32_t a, int32_t b);
+static int32_t wrap_180(int32_t angle);
+static void gate_from_session(const mpu6050_session_t* session, int64_t* min_squared, int64_t* max_squared);
+static bool accel_usable(const mpu6050_raw_frame* frame, int64_t min_squared, int64_t max_squared);
+
+void orientation_complementary_init(orientation_complementary_t* filter, const mpu6050_session_t* session, float time_constant_s) {
+    memset(filter, 0, sizeof(*filter));
+    filter->time_constant_s = time_constant_s;
+    orientation_complementary_set_session(filter, session);
+}
+
+void orientation_complementary_set_session(orientation_complementary_t* filter, const mpu6050_session_t* session) {
+    float dt = 1.0f / session->sample_rate_hz;
+    filter->gyro_step = (int32_t)(session->gyro_dps_per_LSB * dt * 4294967296.0f + 0.5f);
+    filter->alpha = (int32_t)(dt / (filter->time_constant_s + dt) * ORIENTATION_DEG_ONE + 0.5f);
+    gate_from_session(session, &filter->gate_min_squared, &filter->gate_max_squared);
+}
+
+void orientation_complementary_update(orientation_complementary_t* filter, const mpu6050_raw_frame* frame) {
+    filter->stats.samples++;
+    // body rates in Q20 degrees per sample
+    int64_t rate[3];
+    for (int axis = 0; axis < 3; axis++) rate[axis] = ((int64_t)frame->gyro[axis] * filter->gyro_step) >> 12;
+    // body rates to Euler angle rates at the current roll and pitch
+    int32_t sin_roll, cos_roll, sin_pitch, cos_pitch;
+    cordic_sincos((int32_t)(filter->angle[0] >> 16), &sin_roll, &cos_roll);
+    cordic_sincos((int32_t)(filter->angle[1] >> 16), &sin_pitch, &cos_pitch);
+    if (cos_pitch < COS_PITCH_MIN) cos_pitch = COS_PITCH_MIN;
+    int64_t secant = ((int64_t)1 << 60) / cos_pitch;
+    // rate about the z axis of the frame that is only pitched, not rolled
+    int64_t turn = (rate[1] * sin_roll + rate[2] * cos_roll) >> 30;
+    filter->angle[0] += (rate[0] + ((((turn * sin_pitch) >> 30) * secant) >> 30)) * 4096;
+    filter->angle[1] += ((rate[1] * cos_roll - rate[2] * sin_roll) >> 30) * 4096;
+    filter->angle[2] += ((turn * secant) >> 30) * 4096;
+    if (!accel_usable(frame, filter->gate_min_squared, filter->gate_max_squared)) {
+        filter->stats.accel_rejected++;
+    } else {
+        // tilt seen by the accelerometer: roll from y/z, pitch from x against the length in the y/z plane
+        int32_t ay = frame->accel[1], az = frame->accel[2];
+        uint32_t yz_length = fixed_sqrt32((uint32_t)(ay * ay) + (uint32_t)(az * az));
+        int32_t accel_tilt[2];
+        accel_tilt[0] = fixed_atan2(ay, az);
+        accel_tilt[1] = fixed_atan2(-frame->accel[0], (int32_t)yz_length);
+        for (int axis = 0; axis < 2; axis++) {
+            if (!filter->aligned) {
+                filter->angle[axis] = (int64_t)accel_tilt[axis] << 16;
+                continue;
+            }
+            int32_t error = wrap_180(accel_tilt[axis] - (int32_t)(filter->angle[axis] >> 16));
+            filter->angle[axis] += (int64_t)error * filter->alpha;
+        }
+        filter->aligned = true;
+    }
+    // past straight up the gyro would flip roll and yaw: held at 90 instead
+    if (filter->angle[1] > DEG_90_Q32) filter->angle[1] = DEG_90_Q32;
+    if (filter->angle[1] < -DEG_90_Q32) filter->angle[1] = -DEG_90_Q32;
+    for (int axis = 0; axis < 3; axis += 2) {
+        if (filter->angle[axis] > DEG_180_Q32) filter->angle[axis] -= DEG_360_Q32;
+        else if (filter->angle[axis] <= -DEG_180_Q32) filter->angle[axis] += DEG_360_Q32;
+    }
+}
+
+void orientation_complementary_get_euler(const orientation_complementary_t* filter, orientation_euler_t* euler) {
+    euler->roll = (int32_t)(filter->angle[0] >> 16);
+    euler->pitch = (int32_t)(filter->angle[1] >> 16);
+    euler->yaw = (int32_t)(filter->angle[2] >> 16);
+}
+
+const orientation_stats_t* orientation_complementary_get_stats(const orientation_complementary_t* filter) {
+    return &filter->stats;
+}
+
+void orientation_madgwick_init(orientation_madgwick_t* filter, const mpu6050_session_t* session, float beta) {
+    memset(filter, 0, sizeof(*filter));
+    filter->q.w = ORIENTATION_Q30_ONE;
+    filter->beta = beta;
+    orientation_madgwick_set_session(filter, session);
+}
+
+void orientation_madgwick_set_session(orientation_madgwick_t* filter, const mpu6050_session_t* session) {
+    float dt = 1.0f / session->sample_rate_hz;
+    filter->gyro_step = (int32_t)(session->gyro_dps_per_LSB * (PI_F / 180.0f) * 0.5f * dt * 1099511627776.0f + 0.5f);
+    filter->beta_step = (int32_t)(filter->beta * dt * ORIENTATION_Q30_ONE + 0.5f);
+    gate_from_session(session, &filter->gate_min_squared, &filter->gate_max_squared);
+}
+
+/*
+q += q * (0, w) with w half the rotation of one sample period, then one gradient descent
+step of beta / sample rate towards the q that turns gravity into the measured acceleration
+*/
+void orientation_madgwick_update(orientation_madgwick_t* filter, const mpu6050_raw_frame* frame) {
+    filter->stats.samples++;
+    int32_t q0 = filter->q.w, q1 = filter->q.x, q2 = filter->q.y, q3 = filter->q.z;
+    int32_t wx = (int32_t)(((int64_t)frame->gyro[0] * filter->gyro_step) >> 10);
+    int32_t wy = (int32_t)(((int64_t)frame->gyro[1] * filter->gyro_step) >> 10);
+    int32_t wz = (int32_t)(((int64_t)frame->gyro[2] * filter->gyro_step) >> 10);
+    int32_t dq0 = -mul_q30(q1, wx) - mul_q30(q2, wy) - mul_q30(q3, wz);
+    int32_t dq1 = mul_q30(q0, wx) + mul_q30(q2, wz) - mul_q30(q3, wy);
+    int32_t dq2 = mul_q30(q0, wy) - mul_q30(q1, wz) + mul_q30(q3, wx);
+    int32_t dq3 = mul_q30(q0, wz) + mul_q30(q1, wy) - mul_q30(q2, wx);
+
+    int64_t accel[3] = {frame->accel[0], frame->accel[1], frame->accel[2]};
+    int32_t a[3];
+    if (!accel_usable(frame, filter->gate_min_squared, filter->gate_max_squared) || !normalize_q30(accel, a, 3)) {
+        filter->stats.accel_rejected++;
+    } else if (!filter->aligned) {
+        // the shortest rotation from the measured gravity to straight down; upside down it is 180 degrees about x
+        int64_t tilt[4] = {(int64_t)ORIENTATION_Q30_ONE + a[2], a[1], -(int64_t)a[0], 0};
+        int32_t q[4];
+        if (!normalize_q30(tilt, q, 4)) {
+            q[0] = 0;
+            q[1] = ORIENTATION_Q30_ONE;
+            q[2] = q[3] = 0;
+        }
+        filter->q = (orientation_quaternion_t){.w = q[0], .x = q[1], .y = q[2], .z = q[3]};
+        filter->aligned = true;
+        return;
+    } else {
+        // f: gravity turned into the sensor frame by q minus the measured direction, Q30
+        int64_t f0 = (2 * ((int64_t)q1 * q3 - (int64_t)q0 * q2) >> 30) - a[0];
+        int64_t f1 = (2 * ((int64_t)q0 * q1 + (int64_t)q2 * q3) >> 30) - a[1];
+        int64_t f2 = ((((int64_t)1 << 60) - 2 * ((int64_t)q1 * q1 + (int64_t)q2 * q2)) >> 30) - a[2];
+        // gradient J^T f, Q30; each product is shifted down before the factor so it stays in 64 bits
+        int64_t gradient[4] = {
+            -2 * ((q2 * f0) >> 30) + 2 * ((q1 * f1) >> 30),
+            2 * ((q3 * f0) >> 30) + 2 * ((q0 * f1) >> 30) - 4 * ((q1 * f2) >> 30),
+            -2 * ((q0 * f0) >> 30) + 2 * ((q3 * f1) >> 30) - 4 * ((q2 * f2) >> 30),
+            2 * ((q1 * f0) >> 30) + 2 * ((q2 * f1) >> 30)
+        };
+        int32_t step[4];
+        // zero when q already matches the acceleration
+        if (normalize_q30(gradient, step, 4)) {
+            dq0 -= mul_q30(filter->beta_step, step[0]);
+            dq1 -= mul_q30(filter->beta_step, step[1]);
+            dq2 -= mul_q30(filter->beta_step, step[2]);
+            dq3 -= mul_q30(filter->beta_step, step[3]);
+        }
+    }
+    q0 += dq0;
+    q1 += dq1;
+    q2 += dq2;
+    q3 += dq3;
+    // one Newton step of 1/sqrt(n) from 1: q only moved by a fraction of a percent
+    int64_t norm = ((int64_t)q0 * q0 + (int64_t)q1 * q1 + (int64_t)q2 * q2 + (int64_t)q3 * q3) >> 30;
+    int32_t factor = (int32_t)((((int64_t)3 << 30) - norm) >> 1);
+    filter->q.w = mul_q30(q0, factor);
+    filter->q.x = mul_q30(q1, factor);
+    filter->q.y = mul_q30(q2, factor);
+    filter->q.z = mul_q30(q3, factor);
+}
+
+void orientation_madgwick_get_quaternion(const orientation_madgwick_t* filter, orientation_quaternion_t* q) {
+    *q = filter->q;
+}
+
+void orientation_madgwick_get_euler(const orientation_madgwick_t* filter, orientation_euler_t* euler) {
+    orientation_quaternion_to_euler(&filter->q, euler);
+}
+
+const orientation_stats_t* orientation_madgwick_get_stats(const orientation_madgwick_t* filter) {
+    return &filter->stats;
+}
+
+void orientation_quaternion_to_euler(const orientation_quaternion_t* q, orientation_euler_t* euler) {
+    int64_t w = q->w, x = q->x, y = q->y, z = q->z;
+    const int64_t one = (int64_t)1 << 60;
+    euler->roll = fixed_atan2((int32_t)((2 * (w * x + y * z)) >> 31), (int32_t)((one - 2 * (x * x + y * y)) >> 31));
+    euler->yaw = fixed_atan2((int32_t)((2 * (w * z + x * y)) >> 31), (int32_t)((one - 2 * (y * y + z * z)) >> 31));
+    // asin as atan2 against the cosine, clamped for a q that is not quite unit length
+    int64_t sine = (2 * (w * y - z * x)) >> 30;
+    if (sine > ORIENTATION_Q30_ONE) sine = ORIENTATION_Q30_ONE;
+    if (sine < -ORIENTATION_Q30_ONE) sine = -ORIENTATION_Q30_ONE;
+    uint32_t cosine = fixed_sqrt64((uint64_t)(one - sine * sine));
+    euler->pitch = fixed_atan2((int32_t)sine, (int32_t)cosine);
+}
+
+float orientation_deg_to_float(int32_t angle) {
+    return angle / (float)ORIENTATION_DEG_ONE;
+}
+
+// sine and cosine in Q30 of an angle in Q16 degrees, (-180, 180]
+static void cordic_sincos(int32_t angle, int32_t* sine, int32_t* cosine) {
+    // the rotations converge within +-90: the other half is the same vector negated
+    int32_t sign = 1;
+    if (angle > DEG_180 / 2) {
+        angle -= DEG_180;
+        sign = -1;
+    } else if (angle < -DEG_180 / 2) {
+        angle += DEG_180;
+        sign = -1;
+    }
+    // starting at the inverse gain leaves a unit vector
+    int32_t x = CORDIC_INVERSE_GAIN, y = 0;
+    for (int i = 0; i < CORDIC_ITERATIONS; i++) {
+        int32_t x_shifted = x >> i;
+        if (angle >= 0) {
+            x -= y >> i;
+            y += x_shifted;
+            angle -= cordic_angles[i];
+        } else {
+            x += y >> i;
+            y -= x_shifted;
+            angle += cordic_angles[i];
+        }
+    }
+    *sine = sign * y;
+    *cosine = sign * x;
+}
+
+/*
+v scaled to unit length in Q30 (n up to 4 components). The components are first scaled
+so the largest has 29 bits, which keeps the sum of squares in 64 bits for any input.
+false if v is zero
+*/
+static bool normalize_q30(const int64_t* v, int32_t* unit, int n) {
+    uint64_t bits = 0;
+    for (int i = 0; i < n; i++) bits |= (uint64_t)(v[i] < 0 ? -v[i] : v[i]);
+    if (bits == 0) return false;
+    int shift = 28 - (63 - __builtin_clzll(bits));
+    int32_t scaled[4];
+    uint64_t sum = 0;
+    for (int i = 0; i < n; i++) {
+        scaled[i] = (int32_t)(shift >= 0 ? (int64_t)((uint64_t)v[i] << shift) : v[i] >> -shift);
+        sum += (uint64_t)((int64_t)scaled[i] * scaled[i]);
+    }
+    // length is at least 2^28, so the inverse fits in 33 bits and a component times it in 62
+    int64_t inverse = (int64_t)fixed_inv_sqrt64(sum, 60);
+    for (int i = 0; i < n; i++) unit[i] = (int32_t)((scaled[i] * inverse) >> 30);
+    return true;
+}
+
+static int32_t mul_q30(int32_t a, int32_t b) {
+    return (int32_t)(((int64_t)a * b) >> 30);
+}
+
+static int32_t wrap_180(int32_t angle) {
+    if (angle > DEG_180) return angle - 2 * DEG_180;
+    if (angle <= -DEG_180) return angle + 2 * DEG_180;
+    return angle;
+}
+
+static void gate_from_session(const mpu6050_session_t* session, int64_t* min_squared, int64_t* max_squared) {
+    float counts_per_g = 1.0f / session->accel_g_per_LSB;
+    float min_counts = ORIENTATION_ACCEL_GATE_MIN_G * counts_per_g;
+    float max_counts = ORIENTATION_ACCEL_GATE_MAX_G * counts_per_g;
+    *min_squared = (int64_t)(min_counts * min_counts);
+    *max_squared = (int64_t)(max_counts * max_counts);
+}
+
+// only a sample close to 1 g shows where gravity is
+static bool accel_usable(const mpu6050_raw_frame* frame, int64_t min_squared, int64_t max_squared) {
+    int64_t squared = 0;
+    for (int axis = 0; axis < 3; axis++) squared += (int32_t)frame->accel[axis] * frame->accel[axis];
+    return squared >= min_squared && squared <= max_squared;
+}
@@ -0,0 +1,99 @@
+#ifndef ORIENTATION_H
+#define ORIENTATION_H
+#include "mpu6050_I2C.h"
+/*
+Orientation (roll, pitch, heading) from raw MPU6050 frames, in fixed point.
+
+Two filters, both fed one mpu6050_raw_frame per sample in the order they were taken:
+
+- complementary: turns the gyro's body rates into Euler angle rates at the current roll
+  and pitch, integrates them and pulls roll and pitch towards the tilt the accelerometer
+  sees, with a time constant. Easy to tune, but like any Euler angles it breaks down near
+  pitch +-90 (the rates are held at 83 degrees and the pitch at 90)
+- Madgwick (IMU version): integrates the gyro into a quaternion and takes one gradient
+  descent step of size beta towards the gravity direction per sample. No gimbal lock and
+  correct at any attitude
+
+There is no magnetometer, so the heading (yaw) of both is the integrated gyro only: it is
+relative to the start and drifts with the gyro offset. The accelerometer only corrects a
+sample if the acceleration is between ORIENTATION_ACCEL_GATE_MIN_G and _MAX_G: outside of
+that the sensor is being shaken and the accelerometer does not point at gravity.
+
+The per sample work uses int32/int64 only (Q30 quaternions, CORDIC for sine and cosine,
+fixed_math.h for atan2, the square root and the inverse square root of the
+normalizations); floats only appear in the init and when the session changes. The first sample with a usable acceleration sets the tilt directly, so
+neither filter has to converge from level. See host/orientation_replay.c for a replay of
+recorded data and the accuracy against a known motion.
+*/
+
+#define ORIENTATION_Q30_ONE (1 << 30)
+#define ORIENTATION_DEG_ONE (1 << 16)
+#define ORIENTATION_ACCEL_GATE_MIN_G 0.5f
+#define ORIENTATION_ACCEL_GATE_MAX_G 1.5f
+
+typedef struct {
+    int32_t w, x, y, z;     // Q30: ORIENTATION_Q30_ONE is 1.0
+} orientation_quaternion_t;
+
+typedef struct {
+    int32_t roll;           // rotation about x, (-180, 180]
+    int32_t pitch;          // rotation about y, [-90, 90]
+    int32_t yaw;            // rotation about z (heading), (-180, 180]
+} orientation_euler_t;      // Q16 degrees: ORIENTATION_DEG_ONE is 1 degree
+
+typedef struct {
+    uint64_t samples;
+    uint64_t accel_rejected;    // samples whose acceleration was outside of the gate
+} orientation_stats_t;
+
+typedef struct {
+    int64_t angle[3];           // roll, pitch, yaw in Q32 degrees
+    float time_constant_s;
+    int32_t gyro_step;          // Q32 degrees per gyro count per sample
+    int32_t alpha;              // Q16 weight of the accelerometer tilt per sample
+    int64_t gate_min_squared;   // acceleration gate in squared counts
+    int64_t gate_max_squared;
+    bool aligned;
+    orientation_stats_t stats;
+} orientation_complementary_t;
+
+typedef struct {
+    orientation_quaternion_t q; // sensor frame to earth frame
+    float beta;
+    int32_t gyro_step;          // Q40 half radians per gyro count per sample
+    int32_t beta_step;          // Q30 beta per sample
+    int64_t gate_min_squared;
+    int64_t gate_max_squared;
+    bool aligned;
+    orientation_stats_t stats;
+} orientation_madgwick_t;
+
+/*
+time_constant_s: how long the accelerometer takes to pull the gyro angles back (about 1 s;
+shorter follows the accelerometer noise, longer follows the gyro drift)
+*/
+void orientation_complementary_init(orientation_complementary_t* filter, const mpu6050_session_t* session, float time_constant_s);
+// new sample rate or ranges; keeps the angles
+void orientation_complementary_set_session(orientation_complementary_t* filter, const mpu6050_session_t* session);
+void orientation_complementary_update(orientation_complementary_t* filter, const mpu6050_raw_frame* frame);
+void orientation_complementary_get_euler(const orientation_complementary_t* filter, orientation_euler_t* euler);
+const orientation_stats_t* orientation_complementary_get_stats(const orientation_complementary_t* filter);
+
+/*
+beta: gradient step in rad/s (about 0.05 - 0.1; larger trusts the accelerometer more and
+follows its noise, smaller lets gyro errors stand longer)
+*/
+void orientation_madgwick_init(orientation_madgwick_t* filter, const mpu6050_session_t* session, float beta);
+// new sample rate or ranges; keeps the quaternion
+void orientation_madgwick_set_session(orientation_madgwick_t* filter, const mpu6050_session_t* session);
+void orientation_madgwick_update(orientation_madgwick_t* filter, const mpu6050_raw_frame* frame);
+void orientation_madgwick_get_quaternion(const orientation_madgwick_t* filter, orientation_quaternion_t* q);
+void orientation_madgwick_get_euler(const orientation_madgwick_t* filter, orientation_euler_t* euler);
+const orientation_stats_t* orientation_madgwick_get_stats(const orientation_madgwick_t* filter);
+
+// aerospace (z-y-x) Euler angles of a unit quaternion
+void orientation_quaternion_to_euler(const orientation_quaternion_t* q, orientation_euler_t* euler);
+// Q16 degrees to float degrees, for the display
+float orientation_deg_to_float(int32_t angle);
+
+#endif /* ORIENTATION_H */
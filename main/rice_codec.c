@@ -0,0 +1,262 @@
+#include "rice_codec.h"
+#include <string.h>
+
+#define RICE_RECORD_SLOTS (RICE_READY_RECORDS + 1)
+
+// helpers not to be used outside of this file
+static void encode_block(rice_encoder_t* encoder);
+static void close_record(rice_encoder_t* encoder);
+static rice_record_t* filling_record(rice_encoder_t* encoder);
+static uint32_t choose_parameter(const uint16_t* values, size_t count, int* parameter);
+static uint32_t coded_bits(const uint16_t* values, size_t count, int parameter);
+static void put_bits(rice_encoder_t* encoder, uint32_t value, int bits);
+static void put_value(rice_encoder_t* encoder, uint16_t value, int parameter);
+static uint16_t zigzag(int16_t delta);
+static int16_t unzigzag(uint16_t value);
+static uint32_t get_bits(const uint8_t* data, uint32_t* position, int bits);
+
+bool rice_encoder_init(rice_encoder_t* encoder, uint16_t record_length) {
+    if (!encoder) {
+        printf("passed NULL pointer to rice_encoder_init() function\n");
+        return false;
+    }
+    if (record_length < RICE_MIN_RECORD_LENGTH || record_length > RICE_MAX_RECORD_LENGTH) {
+        printf("rice: records of %u bytes not supported\n", (unsigned)record_length);
+        return false;
+    }
+    memset(encoder, 0, sizeof(*encoder));
+    encoder->record_length = record_length;
+    return true;
+}
+
+bool rice_encoder_add(rice_encoder_t* encoder, const mpu6050_raw_frame* frame, uint32_t sample_index) {
+    if (encoder->has_previous && sample_index != encoder->next_index) {
+        // the frames after a hole are not deltas of the ones before it
+        encoder->stats.restarts++;
+        rice_encoder_flush(encoder);
+        encoder->has_previous = false;
+    }
+    int16_t* values = encoder->block[encoder->block_frames];
+    memcpy(values, frame, RICE_CHANNELS * sizeof(int16_t));
+    if (!encoder->has_previous) {
+        memcpy(encoder->previous, values, sizeof(encoder->previous));
+        encoder->has_previous = true;
+    }
+    if (encoder->block_frames == 0) encoder->block_first_index = sample_index;
+    encoder->next_index = sample_index + 1;
+    encoder->stats.frames++;
+    if (++encoder->block_frames == RICE_BLOCK_FRAMES) encode_block(encoder);
+    return encoder->ready_count > 0;
+}
+
+bool rice_encoder_flush(rice_encoder_t* encoder) {
+    if (encoder->block_frames > 0) encode_block(encoder);
+    if (encoder->record_frames > 0) close_record(encoder);
+    return encoder->ready_count > 0;
+}
+
+bool rice_encoder_next_record(rice_encoder_t* encoder, const uint8_t** data, uint16_t* length) {
+    if (encoder->ready_count == 0) return false;
+    const rice_record_t* record = &encoder->records[encoder->ready_first];
+    *data = record->data;
+    *length = record->length;
+    encoder->ready_first = (encoder->ready_first + 1) % RICE_RECORD_SLOTS;
+    encoder->ready_count--;
+    return true;
+}
+
+const rice_stats_t* rice_encoder_get_stats(const rice_encoder_t* encoder) {
+    return &encoder->stats;
+}
+
+static rice_record_t* filling_record(rice_encoder_t* encoder) {
+    return &encoder->records[(encoder->ready_first + encoder->ready_count) % RICE_RECORD_SLOTS];
+}
+
+/*
+codes the waiting frames as one block. If it does not fit behind the blocks already in the
+record, the record is closed and the block starts the next one, where it always fits
+(record_length is at least a header and a worst case block)
+*/
+static void encode_block(rice_encoder_t* encoder) {
+    size_t count = encoder->block_frames;
+    uint16_t values[RICE_CHANNELS][RICE_BLOCK_FRAMES];
+    int parameters[RICE_CHANNELS];
+    uint32_t bits = 0;
+    for (int c = 0; c < RICE_CHANNELS; c++) {
+        int16_t previous = encoder->previous[c];
+        for (size_t i = 0; i < count; i++) {
+            values[c][i] = zigzag((int16_t)(encoder->block[i][c] - previous));
+            previous = encoder->block[i][c];
+        }
+        bits += RICE_PARAMETER_BITS + choose_parameter(values[c], count, &parameters[c]);
+    }
+    uint32_t capacity = (uint32_t)(encoder->record_length - RICE_HEADER_LENGTH) * 8;
+    if (encoder->record_frames > 0 && encoder->record_bits + bits > capacity) close_record(encoder);
+    if (encoder->record_frames == 0) {
+        // the deltas of the first block are taken from the reference in the header
+        memcpy(filling_record(encoder)->data + sizeof(uint32_t) + sizeof(uint16_t), encoder->previous, sizeof(encoder->previous));
+        encoder->record_first_index = encoder->block_first_index;
+        encoder->write_position = RICE_HEADER_LENGTH;
+        encoder->record_bits = 0;
+    }
+    for (int c = 0; c < RICE_CHANNELS; c++) {
+        put_bits(encoder, (uint32_t)parameters[c], RICE_PARAMETER_BITS);
+        for (size_t i = 0; i < count; i++) put_value(encoder, values[c][i], parameters[c]);
+    }
+    encoder->record_bits += bits;
+    encoder->record_frames += (uint16_t)count;
+    memcpy(encoder->previous, encoder->block[count - 1], sizeof(encoder->previous));
+    encoder->block_frames = 0;
+}
+
+// pads the bit stream to a byte, fills in the header and queues the record
+static void close_record(rice_encoder_t* encoder) {
+    if (encoder->buffered_bits > 0) put_bits(encoder, 0, 8 - encoder->buffered_bits);
+    rice_record_t* record = filling_record(encoder);
+    memcpy(record->data, &encoder->record_first_index, sizeof(uint32_t));
+    memcpy(record->data + sizeof(uint32_t), &encoder->record_frames, sizeof(uint16_t));
+    record->length = encoder->write_position;
+    encoder->stats.records++;
+    encoder->stats.encoded_bytes += record->length;
+    if (encoder->ready_count == RICE_READY_RECORDS) {
+        // nobody took the oldest: it makes room for the next record to be filled
+        encoder->ready_first = (encoder->ready_first + 1) % RICE_RECORD_SLOTS;
+        encoder->stats.dropped_records++;
+    } else {
+        encoder->ready_count++;
+    }
+    encoder->record_frames = 0;
+}
+
+/*
+the k with the fewest bits for the block. count * (k + 1) + sum(u >> k) is convex in k, so
+walking downhill from the estimate log2(mean) finds the minimum in a step or two; if even
+that is over 16 bits per value the channel is stored raw. Returns the bits of the values
+(without the 4 of k)
+*/
+static uint32_t choose_parameter(const uint16_t* values, size_t count, int* parameter) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < count; i++) sum += values[i];
+    int k = 0;
+    while (k < RICE_MAX_PARAMETER && ((uint32_t)count << (k + 1)) <= sum) k++;
+    uint32_t best = coded_bits(values, count, k);
+    while (k > 0) {
+        uint32_t bits = coded_bits(values, count, k - 1);
+        if (bits >= best) break;
+        best = bits;
+        k--;
+    }
+    while (k < RICE_MAX_PARAMETER) {
+        uint32_t bits = coded_bits(values, count, k + 1);
+        if (bits >= best) break;
+        best = bits;
+        k++;
+    }
+    if (best >= (uint32_t)count * 16) {
+        *parameter = RICE_RAW_PARAMETER;
+        return (uint32_t)count * 16;
+    }
+    *parameter = k;
+    return best;
+}
+
+static uint32_t coded_bits(const uint16_t* values, size_t count, int parameter) {
+    uint32_t bits = (uint32_t)count * (parameter + 1);
+    for (size_t i = 0; i < count; i++) bits += values[i] >> parameter;
+    return bits;
+}
+
+// appends the low bits of value (up to 24) to the record, most significant first
+static void put_bits(rice_encoder_t* encoder, uint32_t value, int bits) {
+    uint8_t* data = filling_record(encoder)->data;
+    encoder->bit_buffer = (encoder->bit_buffer << bits) | value;
+    encoder->buffered_bits += bits;
+    while (encoder->buffered_bits >= 8) {
+        encoder->buffered_bits -= 8;
+        data[encoder->write_position++] = (uint8_t)(encoder->bit_buffer >> encoder->buffered_bits);
+    }
+}
+
+static void put_value(rice_encoder_t* encoder, uint16_t value, int parameter) {
+    if (parameter == RICE_RAW_PARAMETER) {
+        put_bits(encoder, value, 16);
+        return;
+    }
+    uint32_t quotient = value >> parameter;
+    while (quotient >= 8) {
+        put_bits(encoder, 0, 8);
+        quotient -= 8;
+    }
+    // quotient zeros, the 1 that ends them, the low bits: at most 23
+    uint32_t low = value & ((1u << parameter) - 1);
+    put_bits(encoder, (1u << parameter) | low, (int)quotient + 1 + parameter);
+}
+
+static uint16_t zigzag(int16_t delta) {
+    return (uint16_t)(((uint16_t)delta << 1) ^ (uint16_t)(delta >> 15));
+}
+
+static int16_t unzigzag(uint16_t value) {
+    return (int16_t)((value >> 1) ^ (uint16_t)-(int16_t)(value & 1));
+}
+
+// the next bits of the stream at *position (most significant first), which moves past them
+static uint32_t get_bits(const uint8_t* data, uint32_t* position, int bits) {
+    uint32_t value = 0;
+    for (int b = 0; b < bits; b++, (*position)++) value = (value << 1) | ((data[*position / 8] >> (7 - *position % 8)) & 1);
+    return value;
+}
+
+bool rice_decode(const uint8_t* data, uint16_t length, mpu6050_raw_frame* frames, size_t max_frames,
+                 uint32_t* first_index, size_t* frame_count) {
+    if (length < RICE_HEADER_LENGTH) {
+        printf("rice: record of %u bytes is shorter than its header\n", (unsigned)length);
+        return false;
+    }
+    uint16_t count;
+    int16_t previous[RICE_CHANNELS];
+    memcpy(first_index, data, sizeof(uint32_t));
+    memcpy(&count, data + sizeof(uint32_t), sizeof(uint16_t));
+    memcpy(previous, data + sizeof(uint32_t) + sizeof(uint16_t), sizeof(previous));
+    if (count > max_frames) {
+        printf("rice: record of %u frames, room for %u\n", (unsigned)count, (unsigned)max_frames);
+        return false;
+    }
+    int16_t values[RICE_BLOCK_FRAMES][RICE_CHANNELS];
+    uint32_t position = RICE_HEADER_LENGTH * 8, end = (uint32_t)length * 8;
+    for (size_t block = 0; block < count; block += RICE_BLOCK_FRAMES) {
+        size_t block_count = count - block < RICE_BLOCK_FRAMES ? count - block : RICE_BLOCK_FRAMES;
+        for (int c = 0; c < RICE_CHANNELS; c++) {
+            if (position + RICE_PARAMETER_BITS > end) {
+                printf("rice: record ends inside block %u\n", (unsigned)(block / RICE_BLOCK_FRAMES));
+                return false;
+            }
+            int parameter = (int)get_bits(data, &position, RICE_PARAMETER_BITS);
+            for (size_t i = 0; i < block_count; i++) {
+                uint32_t value;
+                if (parameter == RICE_RAW_PARAMETER) {
+                    if (position + 16 > end) {
+                        printf("rice: record ends inside block %u\n", (unsigned)(block / RICE_BLOCK_FRAMES));
+                        return false;
+                    }
+                    value = get_bits(data, &position, 16);
+                } else {
+                    uint32_t quotient = 0;
+                    bool terminated = false;
+                    while (position < end && !(terminated = get_bits(data, &position, 1))) quotient++;
+                    if (!terminated || position + parameter > end || (quotient << parameter) > UINT16_MAX) {
+                        printf("rice: invalid value in block %u\n", (unsigned)(block / RICE_BLOCK_FRAMES));
+                        return false;
+                    }
+                    value = (quotient << parameter) | get_bits(data, &position, parameter);
+                }
+                previous[c] = (int16_t)(previous[c] + unzigzag((uint16_t)value));
+                values[i][c] = previous[c];
+            }
+        }
+        for (size_t i = 0; i < block_count; i++) memcpy(&frames[block + i], values[i], sizeof(values[i]));
+    }
+    *frame_count = count;
+    return true;
+}
@@ -0,0 +1,94 @@
+#ifndef RICE_CODEC_H
+#define RICE_CODEC_H
+#include "mpu6050_I2C.h"
+/*
+Lossless compression of raw MPU6050 frames for the log. Consecutive samples are close to
+each other, so every channel is coded as the difference to its previous sample:
+
+- delta: x[n] - x[n - 1], wrapped to 16 bits (the decoder wraps the same way, so even a
+  full scale step is exact)
+- zigzag: the signed delta to an unsigned value, small magnitudes first
+  (0, -1, 1, -2, ... -> 0, 1, 2, 3, ...)
+- Rice: a value u with parameter k is u >> k in unary (that many 0 bits and a 1), then
+  the low k bits of u. The frames go in blocks of RICE_BLOCK_FRAMES, and every channel of
+  a block gets the k that codes it in the fewest bits (4 bits in front of its values), so
+  a quiet gyro axis costs 1 to 2 bits per sample and a vibrating accel axis adapts within
+  a block. k = RICE_RAW_PARAMETER stores the values as plain 16 bits instead, so noise
+  that does not compress costs no more than the raw frames (plus the 4 bits)
+
+The encoder fills records of at most record_length bytes, so a record fits in one log
+sector and decodes on its own:
+
+    uint32 sample index of the first frame, uint16 frames,
+    mpu6050_raw_frame reference: the frame before the first (the first itself after a restart),
+    then the bit stream, most significant bit first, padded to a byte:
+    per block (the last one can be short), per channel in mpu6050_raw_frame order:
+    4 bits k, then the channel's values of the block
+
+Samples are fed with their sample index; a jump in the index (missed samples, a FIFO
+overflow) closes the record, and the next one starts from a new reference. Records come
+out of rice_encoder_next_record(), at most RICE_READY_RECORDS after any one call.
+*/
+
+#define RICE_CHANNELS 7                 // all fields of mpu6050_raw_frame
+#define RICE_BLOCK_FRAMES 16
+#define RICE_PARAMETER_BITS 4
+#define RICE_MAX_PARAMETER 14
+#define RICE_RAW_PARAMETER 15           // the block's values of the channel are 16 bit zigzag values
+#define RICE_HEADER_LENGTH (sizeof(uint32_t) + sizeof(uint16_t) + sizeof(mpu6050_raw_frame))
+// a block where every value costs the most, in bytes
+#define RICE_MAX_BLOCK_LENGTH ((RICE_CHANNELS * (RICE_PARAMETER_BITS + RICE_BLOCK_FRAMES * 16) + 7) / 8)
+#define RICE_MIN_RECORD_LENGTH (RICE_HEADER_LENGTH + RICE_MAX_BLOCK_LENGTH)
+#define RICE_MAX_RECORD_LENGTH 480      // SD_LOG_MAX_RECORD_LENGTH
+#define RICE_READY_RECORDS 2
+
+typedef struct {
+    uint64_t frames;
+    uint64_t encoded_bytes;     // records including their headers
+    uint32_t records;
+    uint32_t restarts;          // jumps in the input index
+    uint32_t dropped_records;   // overwritten before rice_encoder_next_record() took them
+} rice_stats_t;
+
+typedef struct {
+    uint16_t length;
+    uint8_t data[RICE_MAX_RECORD_LENGTH];
+} rice_record_t;
+
+typedef struct {
+    uint16_t record_length;
+    // the ready records and the one being filled after them, in a ring
+    rice_record_t records[RICE_READY_RECORDS + 1];
+    uint8_t ready_first;
+    uint8_t ready_count;
+    // the record being filled
+    uint32_t record_first_index;
+    uint16_t record_frames;
+    uint32_t record_bits;       // of the bit stream so far
+    uint16_t write_position;
+    uint32_t bit_buffer;
+    uint8_t buffered_bits;
+    // frames waiting for their block to fill
+    int16_t block[RICE_BLOCK_FRAMES][RICE_CHANNELS];
+    uint16_t block_frames;
+    uint32_t block_first_index;
+    int16_t previous[RICE_CHANNELS];    // the frame before the block
+    bool has_previous;
+    uint32_t next_index;
+    rice_stats_t stats;
+} rice_encoder_t;
+
+// record_length: RICE_MIN_RECORD_LENGTH to RICE_MAX_RECORD_LENGTH bytes per record
+bool rice_encoder_init(rice_encoder_t* encoder, uint16_t record_length);
+// adds one sample; returns true if a record is ready
+bool rice_encoder_add(rice_encoder_t* encoder, const mpu6050_raw_frame* frame, uint32_t sample_index);
+// codes the frames still waiting and closes the record; returns true if a record is ready
+bool rice_encoder_flush(rice_encoder_t* encoder);
+// takes the oldest ready record, valid until the next add or flush. Returns false if there is none
+bool rice_encoder_next_record(rice_encoder_t* encoder, const uint8_t** data, uint16_t* length);
+const rice_stats_t* rice_encoder_get_stats(const rice_encoder_t* encoder);
+// decodes one record into at most max_frames frames
+bool rice_decode(const uint8_t* data, uint16_t length, mpu6050_raw_frame* frames, size_t max_frames,
+                 uint32_t* first_index, size_t* frame_count);
+
+#endif /* RICE_CODEC_H */
@@ -0,0 +1,151 @@
+#include "rollup.h"
+#include <string.h>
+
+// helpers not to be used outside of this file
+static void level_reset(rollup_level_t* level);
+static void complete_entry(rollup_t* rollup, size_t level_number);
+static void store_entry(rollup_t* rollup, rollup_level_t* level, const rollup_entry_t* entry);
+
+bool rollup_init(rollup_t* rollup, const uint32_t* spans, size_t level_count) {
+    if (!rollup || !spans) {
+        printf("passed NULL pointer to rollup_init() function\n");
+        return false;
+    }
+    if (level_count == 0 || level_count > ROLLUP_MAX_LEVELS) {
+        printf("rollup: %u levels not supported\n", (unsigned)level_count);
+        return false;
+    }
+    memset(rollup, 0, sizeof(*rollup));
+    rollup->level_count = level_count;
+    for (size_t l = 0; l < level_count; l++) {
+        if (spans[l] < 2) {
+            printf("rollup: span %lu of level %u too short\n", (unsigned long)spans[l], (unsigned)l);
+            return false;
+        }
+        rollup->levels[l].span = spans[l];
+        rollup->levels[l].record.level = (uint8_t)l;
+        level_reset(&rollup->levels[l]);
+    }
+    return true;
+}
+
+bool rollup_set_samples_per_entry(rollup_t* rollup, uint32_t samples_per_entry) {
+    if (samples_per_entry < 2) {
+        printf("rollup: %lu samples per entry too few\n", (unsigned long)samples_per_entry);
+        return false;
+    }
+    if (rollup->levels[0].samples > 0) complete_entry(rollup, 0);
+    rollup->levels[0].span = samples_per_entry;
+    return true;
+}
+
+bool rollup_add(rollup_t* rollup, const mpu6050_raw_frame* frame, uint32_t sample_index) {
+    rollup_level_t* level = &rollup->levels[0];
+    if (rollup->started && sample_index != rollup->next_index) {
+        // the entry so far ends at the hole; its count says how much of its span it covers
+        rollup->stats.restarts++;
+        if (level->samples > 0) complete_entry(rollup, 0);
+    }
+    int16_t values[ROLLUP_CHANNELS];
+    memcpy(values, frame, sizeof(values));
+    if (level->samples == 0) level->first_index = sample_index;
+    for (int c = 0; c < ROLLUP_CHANNELS; c++) {
+        level->sum[c] += values[c];
+        if (values[c] < level->min[c]) level->min[c] = values[c];
+        if (values[c] > level->max[c]) level->max[c] = values[c];
+    }
+    rollup->started = true;
+    rollup->next_index = sample_index + 1;
+    rollup->stats.samples++;
+    if (++level->samples == level->span) complete_entry(rollup, 0);
+    for (size_t l = 0; l < rollup->level_count; l++) {
+        if (rollup->levels[l].ready) return true;
+    }
+    return false;
+}
+
+bool rollup_flush(rollup_t* rollup) {
+    bool ready = false;
+    for (size_t l = 0; l < rollup->level_count; l++) {
+        rollup_level_t* level = &rollup->levels[l];
+        if (level->record.entry_count > 0 && !level->closed) level->ready = level->closed = true;
+        ready = ready || level->ready;
+    }
+    return ready;
+}
+
+bool rollup_next_record(rollup_t* rollup, rollup_record_t** record, uint16_t* length) {
+    for (size_t l = 0; l < rollup->level_count; l++) {
+        rollup_level_t* level = &rollup->levels[l];
+        if (!level->ready) continue;
+        level->ready = false;
+        *record = &level->record;
+        *length = (uint16_t)(ROLLUP_RECORD_HEADER_LENGTH + level->record.entry_count * sizeof(rollup_entry_t));
+        rollup->stats.records++;
+        return true;
+    }
+    return false;
+}
+
+const rollup_stats_t* rollup_get_stats(const rollup_t* rollup) {
+    return &rollup->stats;
+}
+
+void rollup_print_stats(const rollup_t* rollup) {
+    printf("Rollup: %llu samples, entries per level:", (unsigned long long)rollup->stats.samples);
+    for (size_t l = 0; l < rollup->level_count; l++) printf(" %lu", (unsigned long)rollup->stats.entries[l]);
+    printf(", %lu records, %lu restarts, %lu dropped\n", (unsigned long)rollup->stats.records,
+           (unsigned long)rollup->stats.restarts, (unsigned long)rollup->stats.dropped_records);
+}
+
+static void level_reset(rollup_level_t* level) {
+    level->samples = 0;
+    level->children = 0;
+    memset(level->sum, 0, sizeof(level->sum));
+    for (int c = 0; c < ROLLUP_CHANNELS; c++) {
+        level->min[c] = INT16_MAX;
+        level->max[c] = INT16_MIN;
+    }
+}
+
+// turns the sums of a level into an entry and adds them to the entry of the level above
+static void complete_entry(rollup_t* rollup, size_t level_number) {
+    rollup_level_t* level = &rollup->levels[level_number];
+    rollup_entry_t entry = {.first_index = level->first_index, .samples = level->samples};
+    memcpy(entry.min, level->min, sizeof(entry.min));
+    memcpy(entry.max, level->max, sizeof(entry.max));
+    int64_t half = level->samples / 2;
+    for (int c = 0; c < ROLLUP_CHANNELS; c++) {
+        int64_t sum = level->sum[c];
+        entry.mean[c] = (int16_t)((sum >= 0 ? sum + half : sum - half) / (int64_t)level->samples);
+    }
+    store_entry(rollup, level, &entry);
+    if (level_number + 1 < rollup->level_count) {
+        rollup_level_t* above = &rollup->levels[level_number + 1];
+        if (above->samples == 0) above->first_index = level->first_index;
+        above->samples += level->samples;
+        for (int c = 0; c < ROLLUP_CHANNELS; c++) {
+            above->sum[c] += level->sum[c];
+            if (level->min[c] < above->min[c]) above->min[c] = level->min[c];
+            if (level->max[c] > above->max[c]) above->max[c] = level->max[c];
+        }
+        level_reset(level);
+        if (++above->children == above->span) complete_entry(rollup, level_number + 1);
+        return;
+    }
+    level_reset(level);
+}
+
+static void store_entry(rollup_t* rollup, rollup_level_t* level, const rollup_entry_t* entry) {
+    rollup_record_t* record = &level->record;
+    if (level->closed) {
+        // full or flushed: a new record starts, whether or not the old one was taken
+        if (level->ready) rollup->stats.dropped_records++;
+        level->ready = false;
+        level->closed = false;
+        record->entry_count = 0;
+    }
+    record->entries[record->entry_count++] = *entry;
+    rollup->stats.entries[record->level]++;
+    if (record->entry_count == ROLLUP_ENTRIES_PER_RECORD) level->ready = level->closed = true;
+}
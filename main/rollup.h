@@ -0,0 +1,100 @@
+#ifndef ROLLUP_H
+#define ROLLUP_H
+#include "mpu6050_I2C.h"
+/*
+A pyramid of rollups of raw MPU6050 frames, kept while the samples are logged, so an
+overview of a long log (a month of it) can be drawn without decoding every sample.
+
+Level 0 sums up spans[0] samples per entry (e.g. a second), and every level above
+spans[level] entries of the one below (e.g. 60: minutes, then hours). An entry holds the
+sample index of its first sample, the number of samples in it and min, max and mean of
+every channel in raw counts. The levels combine exactly: min of the mins, max of the maxes,
+and the mean from the integer sums, not from the rounded means below. A jump in the sample
+index (missed samples, a FIFO overflow, an idle motion gate) closes the level 0 entry
+early; the entry's first index and sample count show the gap.
+
+The entries of each level are collected into records of their own (ROLLUP_ENTRIES_PER_RECORD
+entries, so one fits in a log sector), a separate thin stream per level next to the raw
+samples: with 1 s / 1 min / 1 h levels, level 0 adds a record every 9 s and level 2 one
+every 9 h. Each record also carries, for every level, the log sector (sequence number)
+of the latest record of that level before it, filled in by the logger. A reader finds any
+record near the end of a time range (SD_log_find_time() and a few sectors forward), then
+follows the chain of the level that fits the range back to its start: one sector per
+ROLLUP_ENTRIES_PER_RECORD entries instead of every sector of samples.
+
+Per sample the cost is a compare, a compare and an add per channel; the levels above only
+work when an entry completes. Nothing here writes to the card: completed records come out
+of rollup_next_record() for the logger to append like any other.
+*/
+
+#define ROLLUP_CHANNELS 7               // all fields of mpu6050_raw_frame
+#define ROLLUP_MAX_LEVELS 4
+#define ROLLUP_NO_SEQUENCE UINT32_MAX   // no record of that level yet
+#define ROLLUP_MAX_RECORD_LENGTH 480    // SD_LOG_MAX_RECORD_LENGTH
+
+typedef struct __attribute__((packed)) {
+    uint32_t first_index;   // sample index of the first sample
+    uint32_t samples;
+    int16_t min[ROLLUP_CHANNELS];
+    int16_t max[ROLLUP_CHANNELS];
+    int16_t mean[ROLLUP_CHANNELS];      // rounded
+} rollup_entry_t;
+
+#define ROLLUP_RECORD_HEADER_LENGTH (2 * sizeof(uint8_t) + ROLLUP_MAX_LEVELS * sizeof(uint32_t))
+#define ROLLUP_ENTRIES_PER_RECORD ((ROLLUP_MAX_RECORD_LENGTH - ROLLUP_RECORD_HEADER_LENGTH) / sizeof(rollup_entry_t))
+
+typedef struct __attribute__((packed)) {
+    uint8_t level;
+    uint8_t entry_count;
+    uint32_t latest_sequence[ROLLUP_MAX_LEVELS];    // set by the logger, ROLLUP_NO_SEQUENCE if none
+    rollup_entry_t entries[ROLLUP_ENTRIES_PER_RECORD];
+} rollup_record_t;
+
+typedef struct {
+    uint32_t span;          // samples (level 0) or entries of the level below per entry
+    // the entry being summed up
+    uint32_t first_index;
+    uint32_t samples;
+    uint32_t children;
+    int64_t sum[ROLLUP_CHANNELS];
+    int16_t min[ROLLUP_CHANNELS];
+    int16_t max[ROLLUP_CHANNELS];
+    // completed entries, until the record is full or flushed
+    rollup_record_t record;
+    bool closed;            // full or flushed: the next entry starts a new record
+    bool ready;             // closed and not taken yet
+} rollup_level_t;
+
+typedef struct {
+    uint64_t samples;
+    uint32_t entries[ROLLUP_MAX_LEVELS];
+    uint32_t records;
+    uint32_t restarts;          // jumps in the input index
+    uint32_t dropped_records;   // full again before rollup_next_record() took them
+} rollup_stats_t;
+
+typedef struct {
+    size_t level_count;
+    rollup_level_t levels[ROLLUP_MAX_LEVELS];
+    bool started;
+    uint32_t next_index;
+    rollup_stats_t stats;
+} rollup_t;
+
+// spans: level_count (1 to ROLLUP_MAX_LEVELS) spans, each at least 2
+bool rollup_init(rollup_t* rollup, const uint32_t* spans, size_t level_count);
+// closes the level 0 entry so far and sums up samples_per_entry from the next sample on (e.g. a new sample rate)
+bool rollup_set_samples_per_entry(rollup_t* rollup, uint32_t samples_per_entry);
+// adds one sample; returns true if a record is ready
+bool rollup_add(rollup_t* rollup, const mpu6050_raw_frame* frame, uint32_t sample_index);
+// makes the completed entries of every level a record (not the entries still summing up); returns true if one is ready
+bool rollup_flush(rollup_t* rollup);
+/*
+takes a ready record, lowest level first: fill in latest_sequence and log the first length
+bytes. Valid until the next add or flush. Returns false if there is none
+*/
+bool rollup_next_record(rollup_t* rollup, rollup_record_t** record, uint16_t* length);
+const rollup_stats_t* rollup_get_stats(const rollup_t* rollup);
+void rollup_print_stats(const rollup_t* rollup);
+
+#endif /* ROLLUP_H */
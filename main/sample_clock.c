@@ -0,0 +1,100 @@
+#include "sample_clock.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+// helpers not to be used outside of this file
+static void fit(sample_clock_t* clock);
+
+void sample_clock_init(sample_clock_t* clock, float nominal_rate_hz) {
+    memset(clock, 0, sizeof(*clock));
+    clock->nominal_rate_hz = nominal_rate_hz;
+    clock->period_us = 1e6 / nominal_rate_hz;
+}
+
+bool sample_clock_add_anchor(sample_clock_t* clock, uint32_t sample_index, int64_t time_us) {
+    if (clock->anchor_count > 0) {
+        const sample_clock_anchor_t* newest = &clock->anchors[(clock->first_anchor + clock->anchor_count - 1) % SAMPLE_CLOCK_ANCHORS];
+        // 32 bit difference, so the index may wrap
+        if ((int32_t)(sample_index - newest->sample_index) <= 0 || time_us <= newest->time_us) {
+            printf("sample clock: anchor %lu out of order, ignored\n", (unsigned long)sample_index);
+            return false;
+        }
+    }
+    if (clock->anchor_count == SAMPLE_CLOCK_ANCHORS) {
+        clock->first_anchor = (clock->first_anchor + 1) % SAMPLE_CLOCK_ANCHORS;
+        clock->anchor_count--;
+    }
+    clock->anchors[(clock->first_anchor + clock->anchor_count) % SAMPLE_CLOCK_ANCHORS] =
+        (sample_clock_anchor_t){.sample_index = sample_index, .time_us = time_us};
+    clock->anchor_count++;
+    clock->total_anchors++;
+    fit(clock);
+    return true;
+}
+
+/*
+least squares over the window, relative to the oldest anchor so the doubles only hold
+seconds worth of microseconds. 32 anchors every second or so: the cost does not matter
+*/
+static void fit(sample_clock_t* clock) {
+    const sample_clock_anchor_t* reference = &clock->anchors[clock->first_anchor];
+    clock->reference_index = reference->sample_index;
+    clock->reference_time_us = reference->time_us;
+    if (clock->anchor_count < 2) {
+        clock->offset_us = 0;
+        clock->max_residual_us = 0;
+        return;
+    }
+    double n = clock->anchor_count;
+    double sum_x = 0, sum_y = 0;
+    for (uint32_t a = 0; a < clock->anchor_count; a++) {
+        const sample_clock_anchor_t* anchor = &clock->anchors[(clock->first_anchor + a) % SAMPLE_CLOCK_ANCHORS];
+        sum_x += (double)(uint32_t)(anchor->sample_index - reference->sample_index);
+        sum_y += (double)(anchor->time_us - reference->time_us);
+    }
+    double mean_x = sum_x / n, mean_y = sum_y / n;
+    double covariance = 0, variance = 0;
+    for (uint32_t a = 0; a < clock->anchor_count; a++) {
+        const sample_clock_anchor_t* anchor = &clock->anchors[(clock->first_anchor + a) % SAMPLE_CLOCK_ANCHORS];
+        double dx = (double)(uint32_t)(anchor->sample_index - reference->sample_index) - mean_x;
+        double dy = (double)(anchor->time_us - reference->time_us) - mean_y;
+        covariance += dx * dy;
+        variance += dx * dx;
+    }
+    clock->period_us = covariance / variance;
+    clock->offset_us = mean_y - clock->period_us * mean_x;
+
+    clock->max_residual_us = 0;
+    for (uint32_t a = 0; a < clock->anchor_count; a++) {
+        const sample_clock_anchor_t* anchor = &clock->anchors[(clock->first_anchor + a) % SAMPLE_CLOCK_ANCHORS];
+        double residual = fabs((double)(anchor->time_us - reference->time_us) - clock->offset_us -
+                               clock->period_us * (double)(uint32_t)(anchor->sample_index - reference->sample_index));
+        if (residual > clock->max_residual_us) clock->max_residual_us = residual;
+    }
+}
+
+int64_t sample_clock_time_us(const sample_clock_t* clock, uint32_t sample_index) {
+    // signed: samples before the reference anchor are fine too
+    double samples = (double)(int32_t)(sample_index - clock->reference_index);
+    return clock->reference_time_us + (int64_t)llround(clock->offset_us + clock->period_us * samples);
+}
+
+uint32_t sample_clock_index_at(const sample_clock_t* clock, int64_t time_us) {
+    double samples = ((double)(time_us - clock->reference_time_us) - clock->offset_us) / clock->period_us;
+    return clock->reference_index + (uint32_t)(int32_t)lround(samples);
+}
+
+double sample_clock_get_rate_hz(const sample_clock_t* clock) {
+    return 1e6 / clock->period_us;
+}
+
+double sample_clock_get_drift_ppm(const sample_clock_t* clock) {
+    return (sample_clock_get_rate_hz(clock) / clock->nominal_rate_hz - 1.0) * 1e6;
+}
+
+void sample_clock_print_stats(const sample_clock_t* clock) {
+    printf("Sample clock: %.4f Hz (%+.1f ppm vs %.1f Hz), %lu anchors, %lu in the fit, max residual %.1f us\n",
+           sample_clock_get_rate_hz(clock), sample_clock_get_drift_ppm(clock), clock->nominal_rate_hz,
+           (unsigned long)clock->total_anchors, (unsigned long)clock->anchor_count, clock->max_residual_us);
+}
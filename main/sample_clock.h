@@ -0,0 +1,61 @@
+#ifndef SAMPLE_CLOCK_H
+#define SAMPLE_CLOCK_H
+#include <stdbool.h>
+#include <stdint.h>
+/*
+Sample times rebuilt from a sample index instead of stored per sample.
+
+A sensor samples on its own oscillator, which runs a little fast or slow against the
+ESP32 clock and drifts with temperature. Every now and then the caller pairs the
+index of one sample with the time that sample was taken on the host clock (an anchor).
+A least squares line through the last SAMPLE_CLOCK_ANCHORS anchors gives the effective
+sample period and an offset, and from that the time of any sample:
+
+    time(index) = time(reference anchor) + offset + period * (index - reference index)
+
+Per sample only the index is needed (implied by the position in the log), so samples are
+logged without timestamps and the anchors, with the estimated rate, go in the log every
+few seconds. The fit follows slow drift (temperature) because old anchors drop out of the
+window; jitter of the individual anchor times (task wake-up, a FIFO read landing anywhere
+within a sample period) averages out over the window.
+*/
+
+#define SAMPLE_CLOCK_ANCHORS 32
+
+typedef struct {
+    uint32_t sample_index;
+    int64_t time_us;
+} sample_clock_anchor_t;
+
+typedef struct {
+    float nominal_rate_hz;
+    sample_clock_anchor_t anchors[SAMPLE_CLOCK_ANCHORS];    // ring, oldest at first_anchor
+    uint32_t first_anchor;
+    uint32_t anchor_count;
+    uint32_t total_anchors;
+    // the fit: time = reference time + offset_us + period_us * (index - reference index)
+    uint32_t reference_index;
+    int64_t reference_time_us;
+    double offset_us;
+    double period_us;
+    double max_residual_us;     // largest distance of an anchor in the window from the line
+} sample_clock_t;
+
+// starts with the nominal period until there are two anchors. Call again when the sample rate changes
+void sample_clock_init(sample_clock_t* clock, float nominal_rate_hz);
+/*
+adds the time the sample with sample_index was taken and refits. Anchors must come in
+increasing index order; returns false (and ignores the anchor) otherwise
+*/
+bool sample_clock_add_anchor(sample_clock_t* clock, uint32_t sample_index, int64_t time_us);
+// time the sample with sample_index was taken (same clock as the anchors)
+int64_t sample_clock_time_us(const sample_clock_t* clock, uint32_t sample_index);
+// index of the sample taken closest to time_us, e.g. to continue the count across a gap
+uint32_t sample_clock_index_at(const sample_clock_t* clock, int64_t time_us);
+// effective sample rate from the fit
+double sample_clock_get_rate_hz(const sample_clock_t* clock);
+// deviation of the effective rate from the nominal one in ppm
+double sample_clock_get_drift_ppm(const sample_clock_t* clock);
+void sample_clock_print_stats(const sample_clock_t* clock);
+
+#endif /* SAMPLE_CLOCK_H */
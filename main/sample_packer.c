@@ -0,0 +1,162 @@
+#include "sample_packer.h"
+#include <string.h>
+
+// helpers not to be used outside of this file
+static void close_record(sample_packer_t* packer);
+static void put_bits(sample_packer_t* packer, uint32_t value, int bits);
+static uint32_t get_bits(const uint8_t* data, uint32_t* position, int bits);
+static bool valid_bits(uint8_t bits);
+
+bool sample_packer_init(sample_packer_t* packer, const uint8_t* bits, uint16_t record_length) {
+    if (!packer || !bits) {
+        printf("passed NULL pointer to sample_packer_init() function\n");
+        return false;
+    }
+    uint16_t frame_bits = 0;
+    for (int c = 0; c < SAMPLE_PACKER_CHANNELS; c++) {
+        if (!valid_bits(bits[c])) {
+            printf("packer: %u bits for channel %d not supported\n", (unsigned)bits[c], c);
+            return false;
+        }
+        frame_bits += bits[c];
+    }
+    if (frame_bits == 0 || record_length > SAMPLE_PACKER_MAX_RECORD_LENGTH ||
+        record_length < SAMPLE_PACKER_HEADER_LENGTH + (2 * frame_bits + 7) / 8) {
+        printf("packer: records of %u bytes not supported\n", (unsigned)record_length);
+        return false;
+    }
+    memset(packer, 0, sizeof(*packer));
+    memcpy(packer->bits, bits, sizeof(packer->bits));
+    packer->frame_bits = frame_bits;
+    packer->frames_per_record = (uint16_t)((record_length - SAMPLE_PACKER_HEADER_LENGTH) * 8 / frame_bits);
+    return true;
+}
+
+static bool valid_bits(uint8_t bits) {
+    return bits == 0 || (bits >= SAMPLE_PACKER_MIN_BITS && bits <= 16);
+}
+
+bool sample_packer_add(sample_packer_t* packer, const mpu6050_raw_frame* frame, uint32_t sample_index) {
+    if (packer->record_frames > 0 && sample_index != packer->next_index) {
+        // the index of a frame is the first index plus its position: a hole needs a new record
+        packer->stats.restarts++;
+        close_record(packer);
+    }
+    if (packer->record_frames == 0) {
+        packer->record_first_index = sample_index;
+        packer->write_position = SAMPLE_PACKER_HEADER_LENGTH;
+    }
+    int16_t values[SAMPLE_PACKER_CHANNELS];
+    memcpy(values, frame, sizeof(values));
+    for (int c = 0; c < SAMPLE_PACKER_CHANNELS; c++) {
+        int bits = packer->bits[c];
+        if (bits == 0) continue;
+        int shift = 16 - bits;
+        // round to the nearest step; the largest counts would round past the top
+        int32_t value = shift > 0 ? (values[c] + (1 << (shift - 1))) >> shift : values[c];
+        int32_t top = (1 << (bits - 1)) - 1;
+        if (value > top) value = top;
+        put_bits(packer, (uint32_t)value & ((1u << bits) - 1), bits);
+    }
+    packer->next_index = sample_index + 1;
+    packer->stats.frames++;
+    if (++packer->record_frames == packer->frames_per_record) close_record(packer);
+    return packer->ready;
+}
+
+bool sample_packer_flush(sample_packer_t* packer) {
+    if (packer->record_frames > 0) close_record(packer);
+    return packer->ready;
+}
+
+bool sample_packer_next_record(sample_packer_t* packer, const uint8_t** data, uint16_t* length) {
+    if (!packer->ready) return false;
+    *data = packer->records[1 - packer->filling];
+    *length = packer->record_lengths[1 - packer->filling];
+    packer->ready = false;
+    return true;
+}
+
+const sample_packer_stats_t* sample_packer_get_stats(const sample_packer_t* packer) {
+    return &packer->stats;
+}
+
+// pads the last byte, fills in the header and swaps the two records
+static void close_record(sample_packer_t* packer) {
+    if (packer->buffered_bits > 0) put_bits(packer, 0, 8 - packer->buffered_bits);
+    uint8_t* record = packer->records[packer->filling];
+    memcpy(record, &packer->record_first_index, sizeof(uint32_t));
+    memcpy(record + sizeof(uint32_t), &packer->record_frames, sizeof(uint16_t));
+    memcpy(record + sizeof(uint32_t) + sizeof(uint16_t), packer->bits, SAMPLE_PACKER_CHANNELS);
+    packer->record_lengths[packer->filling] = packer->write_position;
+    packer->stats.records++;
+    packer->stats.packed_bytes += packer->write_position;
+    // nobody took the last one: it is overwritten next
+    if (packer->ready) packer->stats.dropped_records++;
+    packer->ready = true;
+    packer->filling = 1 - packer->filling;
+    packer->record_frames = 0;
+}
+
+// appends the low bits of value (up to 24) to the record, most significant first
+static void put_bits(sample_packer_t* packer, uint32_t value, int bits) {
+    uint8_t* data = packer->records[packer->filling];
+    packer->bit_buffer = (packer->bit_buffer << bits) | value;
+    packer->buffered_bits += bits;
+    while (packer->buffered_bits >= 8) {
+        packer->buffered_bits -= 8;
+        data[packer->write_position++] = (uint8_t)(packer->bit_buffer >> packer->buffered_bits);
+    }
+}
+
+// the next bits of the stream at *position (most significant first), which moves past them
+static uint32_t get_bits(const uint8_t* data, uint32_t* position, int bits) {
+    uint32_t value = 0;
+    // what is left of the current byte at a time: at most 3 bytes for 16 bits
+    while (bits > 0) {
+        int offset = *position % 8;
+        int taken = 8 - offset < bits ? 8 - offset : bits;
+        value = (value << taken) | ((data[*position / 8] >> (8 - offset - taken)) & ((1u << taken) - 1));
+        *position += taken;
+        bits -= taken;
+    }
+    return value;
+}
+
+bool sample_packer_unpack(const uint8_t* data, uint16_t length, mpu6050_raw_frame* frames, size_t max_frames,
+                          uint32_t* first_index, size_t* frame_count) {
+    if (length < SAMPLE_PACKER_HEADER_LENGTH) {
+        printf("packer: record of %u bytes is shorter than its header\n", (unsigned)length);
+        return false;
+    }
+    uint16_t count;
+    uint8_t bits[SAMPLE_PACKER_CHANNELS];
+    memcpy(first_index, data, sizeof(uint32_t));
+    memcpy(&count, data + sizeof(uint32_t), sizeof(uint16_t));
+    memcpy(bits, data + sizeof(uint32_t) + sizeof(uint16_t), sizeof(bits));
+    uint32_t frame_bits = 0;
+    for (int c = 0; c < SAMPLE_PACKER_CHANNELS; c++) {
+        if (!valid_bits(bits[c])) {
+            printf("packer: record with %u bits for channel %d\n", (unsigned)bits[c], c);
+            return false;
+        }
+        frame_bits += bits[c];
+    }
+    if (count > max_frames || SAMPLE_PACKER_HEADER_LENGTH * 8 + (uint32_t)count * frame_bits > (uint32_t)length * 8) {
+        printf("packer: record of %u frames does not fit %u bytes / room for %u\n", (unsigned)count, (unsigned)length,
+               (unsigned)max_frames);
+        return false;
+    }
+    uint32_t position = SAMPLE_PACKER_HEADER_LENGTH * 8;
+    for (size_t i = 0; i < count; i++) {
+        int16_t values[SAMPLE_PACKER_CHANNELS] = {0};
+        for (int c = 0; c < SAMPLE_PACKER_CHANNELS; c++) {
+            if (bits[c] == 0) continue;
+            // the top bits back in place; the sign comes with them
+            values[c] = (int16_t)(uint16_t)(get_bits(data, &position, bits[c]) << (16 - bits[c]));
+        }
+        memcpy(&frames[i], values, sizeof(values));
+    }
+    *frame_count = count;
+    return true;
+}
@@ -0,0 +1,76 @@
+#ifndef SAMPLE_PACKER_H
+#define SAMPLE_PACKER_H
+#include "mpu6050_I2C.h"
+/*
+Packs raw MPU6050 frames into fewer bits per channel for the log. At +-8 g the accelerometer
+counts are 0.24 mg and the noise is about 4 mg, so the low 4 bits of every sample are
+noise; storing 12 bits of it loses nothing that was measured. Each channel keeps its top
+bits[c] bits (SAMPLE_PACKER_MIN_BITS to 16, or 0 to leave the channel out):
+
+- pack: the count rounded to the nearest multiple of 2^(16 - bits), saturated at the top,
+  keeps the upper bits as a two's complement value
+- unpack: that value shifted back up, so the frames come back in the same raw counts (and
+  the same session scales) with an error of at most half a step (a whole step within the
+  last step below full scale, where the rounding saturates)
+
+There is no entropy coding: every sample costs the same bits, a shift and a mask per
+channel. The values are packed back to back, most significant bit first, with no padding
+between samples or channels, into records of at most record_length bytes (so one fits in a
+log sector and decodes on its own):
+
+    uint32 sample index of the first frame, uint16 frames,
+    uint8 bits of each channel in mpu6050_raw_frame order, then the packed frames
+
+A record is closed as soon as it holds all the frames that fit, so less than one frame of
+it is unused. Samples are fed with their sample index; a jump in the index closes the record.
+Records come out of sample_packer_next_record(), at most one after any one call.
+*/
+
+#define SAMPLE_PACKER_CHANNELS 7            // all fields of mpu6050_raw_frame
+#define SAMPLE_PACKER_MIN_BITS 10
+#define SAMPLE_PACKER_HEADER_LENGTH (sizeof(uint32_t) + sizeof(uint16_t) + SAMPLE_PACKER_CHANNELS)
+#define SAMPLE_PACKER_MAX_RECORD_LENGTH 480 // SD_LOG_MAX_RECORD_LENGTH
+
+typedef struct {
+    uint64_t frames;
+    uint64_t packed_bytes;      // records including their headers
+    uint32_t records;
+    uint32_t restarts;          // jumps in the input index
+    uint32_t dropped_records;   // overwritten before sample_packer_next_record() took them
+} sample_packer_stats_t;
+
+typedef struct {
+    uint8_t bits[SAMPLE_PACKER_CHANNELS];
+    uint16_t frame_bits;
+    uint16_t frames_per_record;
+    // the record being filled and the ready one
+    uint8_t records[2][SAMPLE_PACKER_MAX_RECORD_LENGTH];
+    uint16_t record_lengths[2];
+    uint8_t filling;            // which of the two is being filled
+    bool ready;
+    uint16_t record_frames;
+    uint32_t record_first_index;
+    uint16_t write_position;
+    uint32_t bit_buffer;
+    uint8_t buffered_bits;
+    uint32_t next_index;
+    sample_packer_stats_t stats;
+} sample_packer_t;
+
+/*
+bits: per channel in mpu6050_raw_frame order, SAMPLE_PACKER_MIN_BITS to 16 or 0 (not
+stored). record_length: up to SAMPLE_PACKER_MAX_RECORD_LENGTH, with room for two frames
+*/
+bool sample_packer_init(sample_packer_t* packer, const uint8_t* bits, uint16_t record_length);
+// adds one sample; returns true if a record is ready
+bool sample_packer_add(sample_packer_t* packer, const mpu6050_raw_frame* frame, uint32_t sample_index);
+// closes the record being filled; returns true if a record is ready
+bool sample_packer_flush(sample_packer_t* packer);
+// takes the ready record, valid until the next add or flush. Returns false if there is none
+bool sample_packer_next_record(sample_packer_t* packer, const uint8_t** data, uint16_t* length);
+const sample_packer_stats_t* sample_packer_get_stats(const sample_packer_t* packer);
+// unpacks one record into at most max_frames frames (channels that were left out are 0)
+bool sample_packer_unpack(const uint8_t* data, uint16_t length, mpu6050_raw_frame* frames, size_t max_frames,
+                          uint32_t* first_index, size_t* frame_count);
+
+#endif /* SAMPLE_PACKER_H */
@@ -0,0 +1,182 @@
+#include "spectrum.h"
+#include <string.h>
+#include <math.h>
+
+#define SPECTRUM_PI 3.14159265358979
+
+// helpers not to be used outside of this file
+static void fft(spectrum_t* spectrum);
+static void accumulate(spectrum_t* spectrum, int channel, bool pair);
+static float bin_power(const spectrum_t* spectrum, int channel, int bin);
+
+bool spectrum_init(spectrum_t* spectrum, uint8_t log2_points, uint16_t averages) {
+    if (!spectrum) {
+        printf("passed NULL pointer to spectrum_init() function\n");
+        return false;
+    }
+    if (log2_points < SPECTRUM_MIN_LOG2_POINTS || log2_points > SPECTRUM_MAX_LOG2_POINTS ||
+        averages == 0 || averages > SPECTRUM_MAX_AVERAGES) {
+        printf("spectrum: 2^%u points / %u averages not supported\n", (unsigned)log2_points, (unsigned)averages);
+        return false;
+    }
+    memset(spectrum, 0, sizeof(*spectrum));
+    spectrum->log2_points = log2_points;
+    spectrum->points = 1 << log2_points;
+    spectrum->averages = averages;
+    // the periodic Hann window: its overlap by half adds up to a constant
+    for (int n = 0; n < spectrum->points; n++) {
+        spectrum->hann[n] = (int16_t)lround((0.5 - 0.5 * cos(2 * SPECTRUM_PI * n / spectrum->points)) * 32767);
+    }
+    for (int k = 0; k < spectrum->points / 2; k++) {
+        spectrum->twiddle_cos[k] = (int16_t)lround(cos(2 * SPECTRUM_PI * k / spectrum->points) * 32767);
+        spectrum->twiddle_sin[k] = (int16_t)lround(sin(2 * SPECTRUM_PI * k / spectrum->points) * 32767);
+    }
+    return true;
+}
+
+bool spectrum_add(spectrum_t* spectrum, const mpu6050_raw_frame* frame, uint32_t sample_index) {
+    if (spectrum->filled > 0 && sample_index != spectrum->next_index) {
+        // a window with a hole in it is not a piece of the signal
+        spectrum->stats.restarts++;
+        spectrum->filled = 0;
+    }
+    if (spectrum->filled == 0) spectrum->window_first_index = sample_index;
+    for (int c = 0; c < SPECTRUM_CHANNELS; c++) spectrum->samples[c][spectrum->filled] = frame->accel[c];
+    spectrum->next_index = sample_index + 1;
+    return ++spectrum->filled == spectrum->points;
+}
+
+bool spectrum_process(spectrum_t* spectrum) {
+    if (spectrum->filled < spectrum->points) return false;
+    if (spectrum->complete) {
+        // the last spectrum was read: start the next one
+        memset(spectrum->power, 0, sizeof(spectrum->power));
+        spectrum->windows = 0;
+        spectrum->complete = false;
+    }
+    if (spectrum->windows == 0) spectrum->first_index = spectrum->window_first_index;
+    for (int c = 0; c < SPECTRUM_CHANNELS; c += 2) {
+        // two real axes in one complex transform
+        bool pair = c + 1 < SPECTRUM_CHANNELS;
+        for (int n = 0; n < spectrum->points; n++) {
+            spectrum->re[n] = ((int32_t)spectrum->samples[c][n] * spectrum->hann[n]) >> (15 - SPECTRUM_INPUT_SHIFT);
+            spectrum->im[n] = pair ? ((int32_t)spectrum->samples[c + 1][n] * spectrum->hann[n]) >> (15 - SPECTRUM_INPUT_SHIFT) : 0;
+        }
+        fft(spectrum);
+        accumulate(spectrum, c, pair);
+    }
+    // the second half is the first half of the next window
+    uint16_t half = spectrum->points / 2;
+    for (int c = 0; c < SPECTRUM_CHANNELS; c++) {
+        memmove(spectrum->samples[c], &spectrum->samples[c][half], half * sizeof(int16_t));
+    }
+    spectrum->filled = half;
+    spectrum->window_first_index += half;
+    spectrum->stats.windows++;
+    if (++spectrum->windows < spectrum->averages) return false;
+    spectrum->complete = true;
+    spectrum->stats.spectra++;
+    return true;
+}
+
+/*
+in place over re / im: bit reversed order first, then log2_points stages of butterflies
+X = a + w b, Y = a - w b, both halved. The halving keeps every value within the largest
+input magnitude, so int32 with 2^SPECTRUM_INPUT_SHIFT headroom never overflows
+*/
+static void fft(spectrum_t* spectrum) {
+    int32_t* re = spectrum->re;
+    int32_t* im = spectrum->im;
+    int points = spectrum->points;
+    for (int i = 1, j = 0; i < points; i++) {
+        int bit = points >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j |= bit;
+        if (i < j) {
+            int32_t t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+    for (int size = 2; size <= points; size <<= 1) {
+        int half = size >> 1;
+        int step = points / size;
+        for (int start = 0; start < points; start += size) {
+            for (int k = 0; k < half; k++) {
+                // w = exp(-2 pi i k / size)
+                int32_t wr = spectrum->twiddle_cos[k * step];
+                int32_t wi = -spectrum->twiddle_sin[k * step];
+                int a = start + k, b = a + half;
+                int32_t tr = (int32_t)(((int64_t)re[b] * wr - (int64_t)im[b] * wi) >> 15);
+                int32_t ti = (int32_t)(((int64_t)re[b] * wi + (int64_t)im[b] * wr) >> 15);
+                re[b] = (re[a] - tr) >> 1;
+                im[b] = (im[a] - ti) >> 1;
+                re[a] = (re[a] + tr) >> 1;
+                im[a] = (im[a] + ti) >> 1;
+            }
+        }
+    }
+}
+
+/*
+Z = X + iY with X, Y real: X[k] = (Z[k] + conj(Z[N - k])) / 2 and
+Y[k] = (Z[k] - conj(Z[N - k])) / 2i
+*/
+static void accumulate(spectrum_t* spectrum, int channel, bool pair) {
+    const int32_t* re = spectrum->re;
+    const int32_t* im = spectrum->im;
+    int points = spectrum->points;
+    for (int k = 0; k <= points / 2; k++) {
+        if (!pair) {
+            spectrum->power[channel][k] += (uint64_t)((int64_t)re[k] * re[k] + (int64_t)im[k] * im[k]);
+            continue;
+        }
+        int m = (points - k) & (points - 1);
+        int64_t xr = (re[k] + re[m]) >> 1, xi = (im[k] - im[m]) >> 1;
+        int64_t yr = (im[k] + im[m]) >> 1, yi = (re[m] - re[k]) >> 1;
+        spectrum->power[channel][k] += (uint64_t)(xr * xr + xi * xi);
+        spectrum->power[channel + 1][k] += (uint64_t)(yr * yr + yi * yi);
+    }
+}
+
+uint16_t spectrum_get_points(const spectrum_t* spectrum) {
+    return spectrum->points;
+}
+
+uint32_t spectrum_get_first_index(const spectrum_t* spectrum) {
+    return spectrum->first_index;
+}
+
+uint16_t spectrum_get_windows(const spectrum_t* spectrum) {
+    return spectrum->windows;
+}
+
+static float bin_power(const spectrum_t* spectrum, int channel, int bin) {
+    if (spectrum->windows == 0) return 0;
+    return (float)((double)spectrum->power[channel][bin] / spectrum->windows / (1 << (2 * SPECTRUM_INPUT_SHIFT)));
+}
+
+void spectrum_get_power(const spectrum_t* spectrum, int channel, float* power) {
+    for (int k = 0; k <= spectrum->points / 2; k++) power[k] = bin_power(spectrum, channel, k);
+}
+
+void spectrum_get_levels(const spectrum_t* spectrum, int channel, float* peak_power, uint8_t* levels) {
+    int peak_bin = 0;
+    for (int k = 1; k <= spectrum->points / 2; k++) {
+        if (spectrum->power[channel][k] > spectrum->power[channel][peak_bin]) peak_bin = k;
+    }
+    uint64_t peak = spectrum->power[channel][peak_bin];
+    for (int k = 0; k <= spectrum->points / 2; k++) {
+        uint64_t power = spectrum->power[channel][k];
+        if (power == 0) {
+            levels[k] = 255;
+            continue;
+        }
+        float steps = 10.0f * log10f((float)peak / (float)power) / SPECTRUM_DB_STEP + 0.5f;
+        levels[k] = steps >= 255.0f ? 255 : (uint8_t)steps;
+    }
+    *peak_power = bin_power(spectrum, channel, peak_bin);
+}
+
+const spectrum_stats_t* spectrum_get_stats(const spectrum_t* spectrum) {
+    return &spectrum->stats;
+}
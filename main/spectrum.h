@@ -0,0 +1,88 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+#include "mpu6050_I2C.h"
+/*
+Vibration spectra of the accelerometer axes in fixed point, for monitoring a machine over
+months without keeping the raw waveform.
+
+The samples of each axis are collected into windows of 2^log2_points that overlap by half.
+Every full window gets a Hann window and an in place radix-2 FFT, and the power of its bins
+0 .. points / 2 is added up; averages windows make one spectrum (Welch's method: the
+average of many short spectra instead of one long, noisy one).
+
+- the FFT is decimation in time over int32 data with Q15 twiddles from a table. The
+  samples enter shifted up by SPECTRUM_INPUT_SHIFT and every stage halves its outputs, so
+  nothing can overflow and the result is the DFT / points (times 2^SPECTRUM_INPUT_SHIFT)
+- the input is real, so two axes share one complex FFT (x as the real, y as the imaginary
+  part) and are separated afterwards from the symmetry of the bins. Three axes cost two FFTs
+- the power of a bin is |X|^2 in counts^2 of the DFT / points: a sine of amplitude A
+  counts on a bin centre shows as A^2 / 16 (Hann coherent gain 1/2, half of the power in
+  the negative frequencies). Gravity stays in bins 0 and 1
+
+Samples are fed with their sample index; a jump in the index (missed samples, a FIFO
+overflow) starts the current window over. The windows of one spectrum are then no longer
+back to back, which Welch's average does not need.
+*/
+
+#define SPECTRUM_MIN_LOG2_POINTS 4
+#define SPECTRUM_MAX_LOG2_POINTS 10
+#define SPECTRUM_MAX_POINTS (1 << SPECTRUM_MAX_LOG2_POINTS)
+#define SPECTRUM_MAX_BINS (SPECTRUM_MAX_POINTS / 2 + 1)
+#define SPECTRUM_CHANNELS 3         // accel x, y, z
+#define SPECTRUM_INPUT_SHIFT 8      // headroom bits below the int16 samples
+#define SPECTRUM_MAX_AVERAGES 4096  // keeps the power sums within 64 bits
+#define SPECTRUM_DB_STEP 0.5f       // of the compact levels
+
+typedef struct {
+    uint64_t windows;
+    uint32_t spectra;
+    uint32_t restarts;          // jumps in the input index
+} spectrum_stats_t;
+
+typedef struct {
+    uint8_t log2_points;
+    uint16_t points;
+    uint16_t averages;          // windows per spectrum
+    int16_t hann[SPECTRUM_MAX_POINTS];              // Q15
+    int16_t twiddle_cos[SPECTRUM_MAX_POINTS / 2];   // Q15 cos(2 pi k / points)
+    int16_t twiddle_sin[SPECTRUM_MAX_POINTS / 2];
+    int16_t samples[SPECTRUM_CHANNELS][SPECTRUM_MAX_POINTS];   // the current window, oldest first
+    uint16_t filled;
+    uint32_t next_index;
+    uint32_t window_first_index;
+    int32_t re[SPECTRUM_MAX_POINTS];                // FFT work area
+    int32_t im[SPECTRUM_MAX_POINTS];
+    uint64_t power[SPECTRUM_CHANNELS][SPECTRUM_MAX_BINS];  // sum over the windows of the spectrum
+    uint16_t windows;           // in power
+    uint32_t first_index;       // sample index of the first window of the spectrum
+    bool complete;
+    spectrum_stats_t stats;
+} spectrum_t;
+
+/*
+log2_points: SPECTRUM_MIN_LOG2_POINTS to SPECTRUM_MAX_LOG2_POINTS (the bins are
+sample rate / points apart); averages: windows per spectrum, 1 to SPECTRUM_MAX_AVERAGES.
+Call again to change them (starts over)
+*/
+bool spectrum_init(spectrum_t* spectrum, uint8_t log2_points, uint16_t averages);
+// stores the acceleration of one sample; returns true if it completed a window, which spectrum_process() then takes
+bool spectrum_add(spectrum_t* spectrum, const mpu6050_raw_frame* frame, uint32_t sample_index);
+/*
+windows, transforms and accumulates the full window and keeps its second half for the
+next one. Returns true if that completed a spectrum: it stays readable until the next call
+*/
+bool spectrum_process(spectrum_t* spectrum);
+uint16_t spectrum_get_points(const spectrum_t* spectrum);
+// sample index of the first sample of the first window, and the windows averaged
+uint32_t spectrum_get_first_index(const spectrum_t* spectrum);
+uint16_t spectrum_get_windows(const spectrum_t* spectrum);
+// mean power of bins 0 .. points / 2 of a completed spectrum, in counts^2
+void spectrum_get_power(const spectrum_t* spectrum, int channel, float* power);
+/*
+the same in one byte per bin: peak_power is the largest bin and levels[k] how far bin k is
+below it in SPECTRUM_DB_STEP dB steps (255: that far or further)
+*/
+void spectrum_get_levels(const spectrum_t* spectrum, int channel, float* peak_power, uint8_t* levels);
+const spectrum_stats_t* spectrum_get_stats(const spectrum_t* spectrum);
+
+#endif /* SPECTRUM_H */
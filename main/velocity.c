@@ -0,0 +1,186 @@
+#include "velocity.h"
+#include "fixed_math.h"
+#include <string.h>
+#include <math.h>
+
+#define VELOCITY_PI 3.14159265358979
+#define VELOCITY_MAX_FRACTION 0.45      // of the sample rate, for the upper edge
+
+// helpers not to be used outside of this file
+static bool apply_session(velocity_t* velocity, const mpu6050_session_t* session);
+static int32_t to_q30(double coefficient);
+static void butterworth(velocity_biquad_t* biquad, double frequency_hz, double rate_hz, bool high_pass);
+static int32_t biquad_step(const velocity_biquad_t* biquad, velocity_biquad_state_t* state, int32_t x);
+static void restart(velocity_t* velocity);
+static void finish_window(velocity_t* velocity);
+static uint16_t to_centi_mm_s(const velocity_t* velocity, uint64_t mean_square);
+
+bool velocity_init(velocity_t* velocity, const velocity_config_t* config, const mpu6050_session_t* session) {
+    if (!velocity || !config || !session) {
+        printf("passed NULL pointer to velocity_init() function\n");
+        return false;
+    }
+    if (config->low_hz == 0 || config->high_hz <= config->low_hz || config->window_ms < 1000 / config->low_hz) {
+        printf("velocity: band %u to %u Hz / %u ms windows not supported\n", (unsigned)config->low_hz,
+               (unsigned)config->high_hz, (unsigned)config->window_ms);
+        return false;
+    }
+    memset(velocity, 0, sizeof(*velocity));
+    velocity->config = *config;
+    return apply_session(velocity, session);
+}
+
+bool velocity_set_session(velocity_t* velocity, const mpu6050_session_t* session) {
+    // the states were filtered at the old rate: the next sample starts over
+    velocity->started = false;
+    return apply_session(velocity, session);
+}
+
+static bool apply_session(velocity_t* velocity, const mpu6050_session_t* session) {
+    const velocity_config_t* config = &velocity->config;
+    uint32_t rate_hz = session->sample_rate_hz;
+    uint32_t window_samples = (uint32_t)config->window_ms * rate_hz / 1000;
+    if (rate_hz == 0 || !(session->accel_g_per_LSB > 0) || window_samples > VELOCITY_MAX_WINDOW) {
+        printf("velocity: %u ms windows at %lu Hz not supported\n", (unsigned)config->window_ms, (unsigned long)rate_hz);
+        return false;
+    }
+    velocity->window_samples = window_samples;
+    velocity->settle_samples = VELOCITY_SETTLE_PERIODS * rate_hz / config->low_hz;
+    velocity->mm_s_per_unit = session->accel_g_per_LSB * VELOCITY_MM_S_PER_G / rate_hz;
+    double high_hz = config->high_hz < VELOCITY_MAX_FRACTION * rate_hz ? config->high_hz : VELOCITY_MAX_FRACTION * rate_hz;
+    velocity->high_hz = (uint16_t)high_hz;
+    velocity->measurable = high_hz >= 2.0 * config->low_hz;
+    if (!velocity->measurable) {
+        printf("velocity: %lu Hz cannot hold %u to %u Hz, no windows at this rate\n", (unsigned long)rate_hz,
+               (unsigned)config->low_hz, (unsigned)config->high_hz);
+        return true;
+    }
+    butterworth(&velocity->high_pass, config->low_hz, rate_hz, true);
+    butterworth(&velocity->low_pass, high_hz, rate_hz, false);
+    // bilinear 1st order high-pass: pole (1 - k) / (1 + k), so 1 - pole is 2 k / (1 + k)
+    double k = tan(VELOCITY_PI * config->low_hz / 4.0 / rate_hz);
+    velocity->leak = to_q30(2.0 * k / (1.0 + k));
+    return true;
+}
+
+static int32_t to_q30(double coefficient) {
+    double scaled = round(coefficient * (1 << 30));
+    // -2.0 fits, +2.0 does not; no coefficient of a stable biquad gets past either
+    if (scaled > INT32_MAX) return INT32_MAX;
+    if (scaled < INT32_MIN) return INT32_MIN;
+    return (int32_t)scaled;
+}
+
+// 2nd order Butterworth by the bilinear transform, with the edge prewarped
+static void butterworth(velocity_biquad_t* biquad, double frequency_hz, double rate_hz, bool high_pass) {
+    double k = tan(VELOCITY_PI * frequency_hz / rate_hz);
+    double norm = 1.0 / (1.0 + sqrt(2.0) * k + k * k);
+    double b0 = high_pass ? norm : k * k * norm;
+    biquad->b0 = to_q30(b0);
+    biquad->b1 = to_q30(high_pass ? -2.0 * b0 : 2.0 * b0);
+    biquad->b2 = biquad->b0;
+    biquad->a1 = to_q30(2.0 * (k * k - 1.0) * norm);
+    biquad->a2 = to_q30((1.0 - sqrt(2.0) * k + k * k) * norm);
+}
+
+// direct form I: Q30 times Q12 (at most 2^31 * 2^29, five of them fit in 64 bits), rounded back to Q12
+static int32_t biquad_step(const velocity_biquad_t* biquad, velocity_biquad_state_t* state, int32_t x) {
+    int64_t sum = (int64_t)biquad->b0 * x + (int64_t)biquad->b1 * state->x1 + (int64_t)biquad->b2 * state->x2 -
+                  (int64_t)biquad->a1 * state->y1 - (int64_t)biquad->a2 * state->y2;
+    int32_t y = (int32_t)((sum + (1 << 29)) >> 30);
+    state->x2 = state->x1;
+    state->x1 = x;
+    state->y2 = state->y1;
+    state->y1 = y;
+    return y;
+}
+
+static void restart(velocity_t* velocity) {
+    memset(velocity->high_pass_state, 0, sizeof(velocity->high_pass_state));
+    memset(velocity->low_pass_state, 0, sizeof(velocity->low_pass_state));
+    memset(velocity->previous, 0, sizeof(velocity->previous));
+    memset(velocity->velocity, 0, sizeof(velocity->velocity));
+    memset(velocity->sum_squares, 0, sizeof(velocity->sum_squares));
+    velocity->primed = false;
+    velocity->settle_left = velocity->settle_samples;
+    velocity->count = 0;
+}
+
+bool velocity_add(velocity_t* velocity, const mpu6050_raw_frame* frame, uint32_t sample_index) {
+    if (velocity->started && sample_index != velocity->next_index) {
+        // the filters would ring on the step at the hole
+        velocity->stats.restarts++;
+        restart(velocity);
+    }
+    if (!velocity->started) restart(velocity);
+    velocity->started = true;
+    velocity->next_index = sample_index + 1;
+    velocity->stats.samples++;
+    if (!velocity->measurable) {
+        velocity->stats.unmeasured++;
+        return false;
+    }
+    bool counted = velocity->settle_left == 0;
+    if (counted && velocity->count == 0) velocity->window_first_index = sample_index;
+    for (int axis = 0; axis < VELOCITY_AXES; axis++) {
+        int32_t x = (int32_t)frame->accel[axis] * (1 << 12);
+        velocity_biquad_state_t* high_pass_state = &velocity->high_pass_state[axis];
+        if (!velocity->primed) {
+            // as if the first sample had always been there: no step of gravity to settle from
+            high_pass_state->x1 = high_pass_state->x2 = x;
+        }
+        int32_t a = biquad_step(&velocity->low_pass, &velocity->low_pass_state[axis],
+                                biquad_step(&velocity->high_pass, high_pass_state, x));
+        int64_t step = (7 * (int64_t)a + velocity->previous[axis]) >> 3;
+        int64_t v = velocity->velocity[axis];
+        // v pole + step (1 + pole) / 2, the leak taken off both
+        v += step - ((step * velocity->leak + (1 << 30)) >> 31) - ((v * velocity->leak + (1 << 29)) >> 30);
+        velocity->velocity[axis] = v;
+        velocity->previous[axis] = a;
+        if (counted) {
+            int64_t units = (v + (1 << 11)) >> 12;
+            velocity->sum_squares[axis] += (uint64_t)(units * units);
+        }
+    }
+    velocity->primed = true;
+    if (!counted) {
+        velocity->settle_left--;
+        return false;
+    }
+    if (++velocity->count < velocity->window_samples) return false;
+    finish_window(velocity);
+    return true;
+}
+
+static void finish_window(velocity_t* velocity) {
+    velocity_record_t* record = &velocity->record;
+    record->first_index = velocity->window_first_index;
+    record->samples = (uint16_t)velocity->count;
+    record->low_hz = velocity->config.low_hz;
+    record->high_hz = velocity->high_hz;
+    uint64_t total = 0;
+    for (int axis = 0; axis < VELOCITY_AXES; axis++) {
+        uint64_t mean_square = velocity->sum_squares[axis] / velocity->count;
+        record->rms[axis] = to_centi_mm_s(velocity, mean_square);
+        total += mean_square;
+        velocity->sum_squares[axis] = 0;
+    }
+    record->overall = to_centi_mm_s(velocity, total);
+    velocity->count = 0;
+    velocity->stats.windows++;
+}
+
+// the square root with 8 more bits (a mean square of at most 3 * 2^44 units), in 0.01 mm/s
+static uint16_t to_centi_mm_s(const velocity_t* velocity, uint64_t mean_square) {
+    float rms_units = fixed_sqrt64(mean_square << 16) / 256.0f;
+    float centi_mm_s = rms_units * velocity->mm_s_per_unit * 100.0f + 0.5f;
+    return centi_mm_s >= UINT16_MAX ? UINT16_MAX : (uint16_t)centi_mm_s;
+}
+
+const velocity_record_t* velocity_get_record(const velocity_t* velocity) {
+    return &velocity->record;
+}
+
+const velocity_stats_t* velocity_get_stats(const velocity_t* velocity) {
+    return &velocity->stats;
+}
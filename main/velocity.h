@@ -0,0 +1,101 @@
+#ifndef VELOCITY_H
+#define VELOCITY_H
+#include "mpu6050_I2C.h"
+/*
+Vibration severity as maintenance reads it (ISO 10816 style): the RMS of the vibration
+velocity in mm/s over a band, window by window, from the accelerometer axes.
+
+Per axis and sample, all in integers:
+
+- a 2nd order Butterworth high-pass at low_hz removes gravity, tilt and drift
+- a 2nd order Butterworth low-pass at the upper edge: high_hz, or 0.45 of the sample rate
+  if that is lower (a 1 kHz rate cannot see 1 kHz; the DLPF of the session limits the band
+  too)
+- a leaky integrator turns the acceleration into velocity. It adds 7/8 of this sample and
+  1/8 of the last (Al-Alaoui), which stays within 3% of a true integral up to 0.4 of the
+  sample rate; the trapezoid rule would already read 20% low at a quarter of it. It leaks
+  like a 1st order high-pass at a quarter of low_hz, only so that what the high-pass
+  leaves of an offset cannot run away (0.3 dB at low_hz)
+- the squared velocity is summed over the window
+
+The filters are biquads with Q30 coefficients (from float math when the session is set)
+on Q12 counts, int64 sums; the velocity is in counts times sample periods. Only the end of
+a window converts to mm/s (session scale and rate) and takes the square roots. The
+filters need a few periods of low_hz to settle: after a start or a jump in the sample
+index (missed samples, a FIFO overflow) the first VELOCITY_SETTLE_PERIODS periods are
+filtered but not counted, and the window starts after them. When the sample rate cannot hold the band (upper edge below twice low_hz) no
+windows are made until a session that can.
+*/
+
+#define VELOCITY_AXES 3
+#define VELOCITY_MAX_WINDOW 16384       // samples, keeps the sums of squares in 64 bits
+#define VELOCITY_SETTLE_PERIODS 4       // of low_hz
+#define VELOCITY_MM_S_PER_G 9806.65f
+
+typedef struct {
+    uint16_t low_hz;
+    uint16_t high_hz;
+    uint16_t window_ms;
+} velocity_config_t;
+
+// one window; RMS in 0.01 mm/s, saturated
+typedef struct __attribute__((packed)) {
+    uint32_t first_index;       // sample index of the first sample
+    uint16_t samples;
+    uint16_t low_hz;
+    uint16_t high_hz;           // the upper edge in use
+    uint16_t rms[VELOCITY_AXES];
+    uint16_t overall;           // of the velocity vector: sqrt of the sum of the axes' mean squares
+} velocity_record_t;
+
+typedef struct {
+    int32_t b0, b1, b2, a1, a2; // Q30, a0 = 1
+} velocity_biquad_t;
+
+typedef struct {
+    int32_t x1, x2, y1, y2;     // Q12 counts
+} velocity_biquad_state_t;
+
+typedef struct {
+    uint64_t samples;
+    uint32_t windows;
+    uint32_t restarts;          // jumps in the input index
+    uint64_t unmeasured;        // samples at a rate that cannot hold the band
+} velocity_stats_t;
+
+typedef struct {
+    velocity_config_t config;
+    bool measurable;
+    uint16_t high_hz;
+    uint32_t window_samples;
+    uint32_t settle_samples;
+    float mm_s_per_unit;        // velocity unit (counts times sample periods) to mm/s
+    velocity_biquad_t high_pass;
+    velocity_biquad_t low_pass;
+    int32_t leak;               // Q30 1 - pole of the 1st order high-pass in the integrator
+    velocity_biquad_state_t high_pass_state[VELOCITY_AXES];
+    velocity_biquad_state_t low_pass_state[VELOCITY_AXES];
+    int32_t previous[VELOCITY_AXES];        // band-limited acceleration of the last sample, Q12
+    int64_t velocity[VELOCITY_AXES];        // Q12 counts times sample periods
+    bool started;
+    uint32_t next_index;
+    bool primed;                            // filter states set from the first sample after a start
+    uint32_t settle_left;
+    // the window being summed up
+    uint32_t count;
+    uint32_t window_first_index;
+    uint64_t sum_squares[VELOCITY_AXES];    // velocity in whole units, squared
+    velocity_record_t record;               // the last completed window
+    velocity_stats_t stats;
+} velocity_t;
+
+// low_hz at least 1, high_hz above it, window_ms at least one period of low_hz
+bool velocity_init(velocity_t* velocity, const velocity_config_t* config, const mpu6050_session_t* session);
+// a new sample rate or range: recomputes the filters and starts over
+bool velocity_set_session(velocity_t* velocity, const mpu6050_session_t* session);
+// adds one sample; returns true if it completed a window, whose record is then in velocity_get_record()
+bool velocity_add(velocity_t* velocity, const mpu6050_raw_frame* frame, uint32_t sample_index);
+const velocity_record_t* velocity_get_record(const velocity_t* velocity);
+const velocity_stats_t* velocity_get_stats(const velocity_t* velocity);
+
+#endif /* VELOCITY_H */
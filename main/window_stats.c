@@ -0,0 +1,171 @@
+#include "window_stats.h"
+#include <string.h>
+#include <math.h>
+
+// helpers not to be used outside of this file
+static void tumbling_reset(window_stats_tumbling_t* window);
+static void sliding_reset(window_stats_sliding_t* window);
+static void queue_push(window_stats_queue_t* queue, const int16_t* samples, uint16_t position, bool keep_larger);
+static uint16_t queue_front(const window_stats_queue_t* queue);
+static void fill_snapshot(window_stats_snapshot_t* snapshot, uint32_t first_index, uint32_t count, const int64_t* sum,
+                          const int64_t* sum_squares, const int16_t* min, const int16_t* max);
+
+bool window_stats_tumbling_init(window_stats_tumbling_t* window, uint32_t length) {
+    if (!window) {
+        printf("passed NULL pointer to window_stats_tumbling_init() function\n");
+        return false;
+    }
+    if (length == 0 || length > WINDOW_STATS_MAX_TUMBLING) {
+        printf("window stats: tumbling window of %lu samples, 1 to %d\n", (unsigned long)length, WINDOW_STATS_MAX_TUMBLING);
+        return false;
+    }
+    memset(window, 0, sizeof(*window));
+    window->length = length;
+    return true;
+}
+
+bool window_stats_tumbling_add(window_stats_tumbling_t* window, const mpu6050_raw_frame* frame, uint32_t sample_index) {
+    int16_t values[WINDOW_STATS_CHANNELS];
+    memcpy(values, frame, sizeof(values));
+    if (window->count > 0 && sample_index != window->next_index) {
+        // a window with a hole in it would not be length samples of signal
+        window->restarts++;
+        tumbling_reset(window);
+    }
+    if (window->count == 0) {
+        window->first_index = sample_index;
+        memcpy(window->min, values, sizeof(values));
+        memcpy(window->max, values, sizeof(values));
+    }
+    for (int c = 0; c < WINDOW_STATS_CHANNELS; c++) {
+        int32_t x = values[c];
+        window->sum[c] += x;
+        window->sum_squares[c] += x * x;
+        if (x < window->min[c]) window->min[c] = (int16_t)x;
+        if (x > window->max[c]) window->max[c] = (int16_t)x;
+    }
+    window->next_index = sample_index + 1;
+    if (++window->count < window->length) return false;
+    fill_snapshot(&window->last, window->first_index, window->count, window->sum, window->sum_squares, window->min, window->max);
+    window->windows++;
+    tumbling_reset(window);
+    return true;
+}
+
+static void tumbling_reset(window_stats_tumbling_t* window) {
+    window->count = 0;
+    memset(window->sum, 0, sizeof(window->sum));
+    memset(window->sum_squares, 0, sizeof(window->sum_squares));
+}
+
+const window_stats_snapshot_t* window_stats_tumbling_get_last(const window_stats_tumbling_t* window) {
+    return &window->last;
+}
+
+bool window_stats_sliding_init(window_stats_sliding_t* window, uint32_t length) {
+    if (!window) {
+        printf("passed NULL pointer to window_stats_sliding_init() function\n");
+        return false;
+    }
+    if (length == 0 || length > WINDOW_STATS_MAX_SLIDING) {
+        printf("window stats: sliding window of %lu samples, 1 to %d\n", (unsigned long)length, WINDOW_STATS_MAX_SLIDING);
+        return false;
+    }
+    memset(window, 0, sizeof(*window));
+    window->length = length;
+    return true;
+}
+
+void window_stats_sliding_add(window_stats_sliding_t* window, const mpu6050_raw_frame* frame, uint32_t sample_index) {
+    int16_t values[WINDOW_STATS_CHANNELS];
+    memcpy(values, frame, sizeof(values));
+    if (window->count > 0 && sample_index != window->next_index) {
+        window->restarts++;
+        sliding_reset(window);
+    }
+    uint16_t position = window->position;
+    bool full = window->count == window->length;
+    for (int c = 0; c < WINDOW_STATS_CHANNELS; c++) {
+        int16_t* samples = window->samples[c];
+        if (full) {
+            // the oldest sample leaves; if it is still queued it is at the front
+            int32_t old = samples[position];
+            window->sum[c] -= old;
+            window->sum_squares[c] -= old * old;
+            window_stats_queue_t* max_queue = &window->max_queue[c];
+            window_stats_queue_t* min_queue = &window->min_queue[c];
+            if (max_queue->count > 0 && queue_front(max_queue) == position) {
+                max_queue->head = (max_queue->head + 1) % WINDOW_STATS_MAX_SLIDING;
+                max_queue->count--;
+            }
+            if (min_queue->count > 0 && queue_front(min_queue) == position) {
+                min_queue->head = (min_queue->head + 1) % WINDOW_STATS_MAX_SLIDING;
+                min_queue->count--;
+            }
+        }
+        int32_t x = values[c];
+        samples[position] = (int16_t)x;
+        window->sum[c] += x;
+        window->sum_squares[c] += x * x;
+        queue_push(&window->max_queue[c], samples, position, true);
+        queue_push(&window->min_queue[c], samples, position, false);
+    }
+    window->position = (uint32_t)position + 1 == window->length ? 0 : position + 1;
+    if (!full) window->count++;
+    window->next_index = sample_index + 1;
+}
+
+static void sliding_reset(window_stats_sliding_t* window) {
+    window->count = 0;
+    window->position = 0;
+    memset(window->sum, 0, sizeof(window->sum));
+    memset(window->sum_squares, 0, sizeof(window->sum_squares));
+    memset(window->max_queue, 0, sizeof(window->max_queue));
+    memset(window->min_queue, 0, sizeof(window->min_queue));
+}
+
+/*
+drops the queued samples from the back that the new one beats (they can never be the
+extreme again while it is in the window), then queues it
+*/
+static void queue_push(window_stats_queue_t* queue, const int16_t* samples, uint16_t position, bool keep_larger) {
+    int16_t x = samples[position];
+    while (queue->count > 0) {
+        int16_t back = samples[queue->positions[(queue->head + queue->count - 1) % WINDOW_STATS_MAX_SLIDING]];
+        if (keep_larger ? back > x : back < x) break;
+        queue->count--;
+    }
+    queue->positions[(queue->head + queue->count) % WINDOW_STATS_MAX_SLIDING] = position;
+    queue->count++;
+}
+
+static uint16_t queue_front(const window_stats_queue_t* queue) {
+    return queue->positions[queue->head];
+}
+
+bool window_stats_sliding_snapshot(const window_stats_sliding_t* window, window_stats_snapshot_t* snapshot) {
+    if (window->count == 0) return false;
+    int16_t min[WINDOW_STATS_CHANNELS], max[WINDOW_STATS_CHANNELS];
+    for (int c = 0; c < WINDOW_STATS_CHANNELS; c++) {
+        min[c] = window->samples[c][queue_front(&window->min_queue[c])];
+        max[c] = window->samples[c][queue_front(&window->max_queue[c])];
+    }
+    fill_snapshot(snapshot, window->next_index - window->count, window->count, window->sum, window->sum_squares, min, max);
+    return true;
+}
+
+// n * sum(x^2) - sum(x)^2 is n^2 times the variance, exactly, as long as both products fit in 63 bits
+static void fill_snapshot(window_stats_snapshot_t* snapshot, uint32_t first_index, uint32_t count, const int64_t* sum,
+                          const int64_t* sum_squares, const int16_t* min, const int16_t* max) {
+    snapshot->first_index = first_index;
+    snapshot->count = count;
+    double n = count;
+    for (int c = 0; c < WINDOW_STATS_CHANNELS; c++) {
+        int64_t scaled_variance = (int64_t)count * sum_squares[c] - sum[c] * sum[c];
+        snapshot->mean[c] = (float)(sum[c] / n);
+        snapshot->std_dev[c] = (float)(sqrt((double)scaled_variance) / n);
+        snapshot->rms[c] = (float)sqrt(sum_squares[c] / n);
+        snapshot->min[c] = min[c];
+        snapshot->max[c] = max[c];
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef WINDOW_STATS_H
+#define WINDOW_STATS_H
+#include "mpu6050_I2C.h"
+/*
+Streaming per channel statistics of raw MPU6050 frames over windows of samples: mean,
+standard deviation, RMS, min, max (and so peak to peak).
+
+- tumbling: consecutive windows of a fixed number of samples that do not overlap. Every
+  completed window leaves a snapshot, e.g. for a summary record once a second
+- sliding: the last length samples, updated with every sample, e.g. for the display
+
+Both cost O(1) per sample and channel. The sums are kept as exact integers (the counts
+are int16): the variance n * sum(x^2) - sum(x)^2 is then exact however long the window
+and whatever the offset, which is what Welford's update buys in floating point, and a
+sliding window can take the oldest sample back out without any rounding piling up. Floats
+only appear in the snapshots. The sliding min and max come from monotonic queues of ring
+positions: a new sample drops the queued ones it beats, so the front is always the
+extreme and each sample enters and leaves a queue once.
+
+Samples are fed with their sample index; a jump in the index (missed samples, a FIFO
+overflow) starts the window over. All values are in raw counts, scaled like the frames
+with the session of the sensor.
+*/
+
+#define WINDOW_STATS_CHANNELS 7             // all fields of mpu6050_raw_frame
+#define WINDOW_STATS_MAX_SLIDING 512
+#define WINDOW_STATS_MAX_TUMBLING 65535     // keeps n * sum(x^2) within 63 bits
+
+typedef struct {
+    uint32_t first_index;   // sample index of the oldest sample in the window
+    uint32_t count;         // samples in the window
+    float mean[WINDOW_STATS_CHANNELS];
+    float std_dev[WINDOW_STATS_CHANNELS];
+    float rms[WINDOW_STATS_CHANNELS];
+    int16_t min[WINDOW_STATS_CHANNELS];
+    int16_t max[WINDOW_STATS_CHANNELS];
+} window_stats_snapshot_t;
+
+typedef struct {
+    uint32_t length;
+    uint32_t count;
+    uint32_t first_index;
+    uint32_t next_index;
+    int64_t sum[WINDOW_STATS_CHANNELS];
+    int64_t sum_squares[WINDOW_STATS_CHANNELS];
+    int16_t min[WINDOW_STATS_CHANNELS];
+    int16_t max[WINDOW_STATS_CHANNELS];
+    window_stats_snapshot_t last;   // the last completed window
+    uint32_t windows;
+    uint32_t restarts;
+} window_stats_tumbling_t;
+
+typedef struct {
+    uint16_t head;
+    uint16_t count;
+    uint16_t positions[WINDOW_STATS_MAX_SLIDING];   // ring positions of the samples, front first
+} window_stats_queue_t;
+
+typedef struct {
+    uint32_t length;
+    uint32_t count;
+    uint32_t next_index;
+    uint16_t position;      // where the next sample goes
+    int16_t samples[WINDOW_STATS_CHANNELS][WINDOW_STATS_MAX_SLIDING];
+    int64_t sum[WINDOW_STATS_CHANNELS];
+    int64_t sum_squares[WINDOW_STATS_CHANNELS];
+    window_stats_queue_t max_queue[WINDOW_STATS_CHANNELS];  // decreasing values from the front
+    window_stats_queue_t min_queue[WINDOW_STATS_CHANNELS];  // increasing values from the front
+    uint32_t restarts;
+} window_stats_sliding_t;
+
+// length in samples, 1 to WINDOW_STATS_MAX_TUMBLING. Call again to change it (starts over)
+bool window_stats_tumbling_init(window_stats_tumbling_t* window, uint32_t length);
+// adds one sample; returns true if it completed a window, whose snapshot is then in window_stats_tumbling_get_last()
+bool window_stats_tumbling_add(window_stats_tumbling_t* window, const mpu6050_raw_frame* frame, uint32_t sample_index);
+const window_stats_snapshot_t* window_stats_tumbling_get_last(const window_stats_tumbling_t* window);
+
+// length in samples, 1 to WINDOW_STATS_MAX_SLIDING. Call again to change it (starts over)
+bool window_stats_sliding_init(window_stats_sliding_t* window, uint32_t length);
+void window_stats_sliding_add(window_stats_sliding_t* window, const mpu6050_raw_frame* frame, uint32_t sample_index);
+// statistics of the samples in the window (fewer than length until it filled up); false if it is empty
+bool window_stats_sliding_snapshot(const window_stats_sliding_t* window, window_stats_snapshot_t* snapshot);
+
+#endif /* WINDOW_STATS_H */